@@ -0,0 +1,109 @@
+#!/bin/sh
+# Benchmark every example fragment shader headlessly across resolutions and
+# models, write the results as CSV, and flag regressions against a baseline.
+#
+# Usage: bench/run.sh <shadertest> <results.csv> <baseline.csv>
+# Environment:
+#   BENCH_FRAMES     Frames measured per run (default: 60)
+#   BENCH_SIZES      Space-separated WxH list (default: 400x400 1920x1080 3840x2160)
+#   BENCH_MODELS     Space-separated model list (default: rectangle triangle)
+#   BENCH_METRIC     Column compared against the baseline (default: cpu_median)
+#   BENCH_TOLERANCE  Allowed relative slowdown (default: 0.10)
+
+set -u
+
+EXE=${1:?missing shadertest executable}
+RESULTS=${2:?missing results path}
+BASELINE=${3:?missing baseline path}
+FRAMES=${BENCH_FRAMES:-60}
+SIZES=${BENCH_SIZES:-400x400 1920x1080 3840x2160}
+MODELS=${BENCH_MODELS:-rectangle triangle}
+METRIC=${BENCH_METRIC:-cpu_median}
+TOLERANCE=${BENCH_TOLERANCE:-0.10}
+VERTEX=examples/basic.vert
+HEADER=vertex,fragment,model,width,height,frames,fps,cpu_min,cpu_median,cpu_p95,cpu_p99,cpu_mean,gpu_min,gpu_median,gpu_p95,gpu_p99,gpu_mean,vertices,triangles,mvertices_per_s,mtriangles_per_s
+
+echo "${HEADER}" > "${RESULTS}"
+status=0
+for fragment in examples/*.frag; do
+  for size in ${SIZES}; do
+    for model in ${MODELS}; do
+      echo "Benchmarking ${fragment} (${model}, ${size})" >&2
+      if ! "${EXE}" --headless --size="${size}" --model="${model}" \
+          --bench="${FRAMES}" --bench-format=csv \
+          -vs "${VERTEX}" -fs "${fragment}" >> "${RESULTS}"; then
+        echo "FAILED: ${fragment} (${model}, ${size})" >&2
+        status=1
+      fi
+    done
+  done
+done
+
+# A missing baseline, or one with only the header (as checked in, since
+# baselines are machine-specific), is recorded from a clean run instead.
+if [ ! -f "${BASELINE}" ] || [ "$(wc -l < "${BASELINE}")" -le 1 ]; then
+  if [ ${status} -eq 0 ]; then
+    echo "WARNING: No baseline rows in ${BASELINE}; recording these results as the baseline" >&2
+    cp "${RESULTS}" "${BASELINE}"
+  else
+    echo "WARNING: No baseline rows in ${BASELINE}; not recording one from a failed run" >&2
+  fi
+  exit ${status}
+fi
+
+# Rows are keyed by fragment, model and size. Rows missing from either file
+# are reported but never counted as regressions; a baseline that matches no
+# row at all fails, since nothing was compared.
+awk -F, -v metric="${METRIC}" -v tolerance="${TOLERANCE}" '
+  FNR == 1 {
+    column = 0
+    for (i = 1; i <= NF; ++i) {
+      if ($i == metric) {
+        column = i
+      }
+    }
+    if (column == 0) {
+      print "Unknown metric " metric > "/dev/stderr"
+      unknownMetric = 1
+      exit
+    }
+    next
+  }
+  {
+    key = $2 " " $3 " " $4 "x" $5
+  }
+  NR == FNR {
+    baseline[key] = $column
+    next
+  }
+  {
+    if (!(key in baseline)) {
+      printf "  new   %-50s %s=%s\n", key, metric, $column
+      next
+    }
+    compared++
+    ratio = baseline[key] > 0 ? $column / baseline[key] : 1
+    if (ratio > 1 + tolerance) {
+      printf "  SLOW  %-50s %s=%s (baseline %s, %+.1f%%)\n", key, metric, $column, baseline[key], (ratio - 1) * 100
+      regressions++
+    } else {
+      printf "  ok    %-50s %s=%s (baseline %s, %+.1f%%)\n", key, metric, $column, baseline[key], (ratio - 1) * 100
+    }
+  }
+  END {
+    # Exiting from a rule still runs this block.
+    if (unknownMetric) {
+      exit 2
+    }
+    if (compared == 0) {
+      print "No baseline rows match the results; record a baseline on this machine with make bench-baseline" > "/dev/stderr"
+      exit 1
+    }
+    if (regressions > 0) {
+      printf "%d regression(s) beyond %.0f%% tolerance\n", regressions, tolerance * 100
+      exit 1
+    }
+  }
+' "${BASELINE}" "${RESULTS}" || status=1
+
+exit ${status}
@@ -65,7 +65,9 @@ vec2 cdiv(in vec2 a, in vec2 b) {
   return vec2((a.x*b.x + a.y*b.y)/d, (a.y*b.x - a.x*b.y)/d);
 }
 
+#ifndef MAX_N
 #define MAX_N 10
+#endif
 vec2 cpowz(in vec2 z, in int n) {
   if (n == 0) {
     return R;
@@ -181,11 +183,20 @@ vec3 complex2hsv(vec2 point) {
  * Primary complex functions.
  */
 
+// Each of these can be overridden with -D, e.g. -D SCALE=.2.
+#ifndef OFFSET_X
 #define OFFSET_X 0.
+#endif
+#ifndef OFFSET_Y
 #define OFFSET_Y 0.
+#endif
+#ifndef SCALE
 #define SCALE .10
+#endif
 
+#if !defined FUNCTION_A && !defined FUNCTION_B && !defined FUNCTION_C
 #define FUNCTION_A
+#endif
 
 #ifdef FUNCTION_A
 vec2 func(vec2 z) {
@@ -0,0 +1,16 @@
+#version 320 es
+
+#include "partial/base.part.frag"
+#include "partial/colors.part.frag"
+
+/**
+ * Main code.
+ */
+
+void setColor(out vec4 fragColor, in vec4 fragCoord) {
+  vec2 c = vec2(resolution)*.5;
+  vec2 uv = (fragCoord.xy - c) / min(float(resolution.x), float(resolution.y));
+  float d = distance(vec2(0.), uv);
+  vec3 hsv = vec3(d, 1., 1.);
+  fragColor = hsvCycled2rgba(hsv, 2., .1);
+}
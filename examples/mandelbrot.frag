@@ -44,9 +44,13 @@ vec4 hsvCycled2rgba(in vec3 hsv, in float spread, in float speed) {
   return hsv2rgba(hsv);
 }
 
+#ifndef MAX_ITERATIONS
+#define MAX_ITERATIONS 1000
+#endif
+
 int mandelbrot(in vec2 p) {
   vec2 t = vec2(0., 0.);
-  const int maxIterations = 1000;
+  const int maxIterations = MAX_ITERATIONS;
   for (int i = 0; i < maxIterations - 1; i++) {
     if (t.x*t.x + t.y*t.y > 4.) {
       return i;
@@ -61,8 +65,11 @@ struct Params {
   float zoom;
 };
 
-#define PARAMS_1
-#ifdef PARAMS_1
+// The view, chosen with e.g. -D PARAMS=2.
+#ifndef PARAMS
+#define PARAMS 1
+#endif
+#if PARAMS == 1
 Params params = Params(vec2(-1., .3), 1.);
 #else
 Params params = Params(vec2(-1., 0.), -.5);
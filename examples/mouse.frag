@@ -0,0 +1,19 @@
+#version 320 es
+
+#include "partial/base.part.frag"
+#include "partial/colors.part.frag"
+#include "partial/inputs.part.frag"
+
+/**
+ * Main code.
+ */
+
+void setColor(out vec4 fragColor, in vec4 fragCoord) {
+  vec2 size = vec2(inputs.resolution);
+  float scale = min(size.x, size.y);
+  float d = distance(fragCoord.xy, inputs.mouse.xy)/scale;
+  float ring = .5 + .5*sin(d*40. - inputs.time*4.);
+  float seconds = fract(inputs.date.w/60.);
+  vec3 hsv = vec3(d + seconds, 1. - .5*inputs.mouse.z, ring);
+  fragColor = hsv2rgba(hsv);
+}
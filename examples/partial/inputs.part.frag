@@ -0,0 +1,8 @@
+layout(std140) uniform ShaderTestInputs {
+  ivec2 resolution;
+  float time;
+  float deltaTime;
+  vec4 mouse;
+  int frame;
+  vec4 date;
+} inputs;
@@ -0,0 +1,21 @@
+#version 320 es
+
+#include "../partial/base.part.frag"
+
+uniform sampler2D trail;
+
+/**
+ * Main code.
+ */
+
+void setColor(out vec4 fragColor, in vec4 fragCoord) {
+  vec2 size = vec2(resolution);
+  vec2 uv = fragCoord.xy/size;
+  vec2 step = vec2(1., 0.)/size;
+  fragColor = vec4(0.);
+  for (int i = -4; i <= 4; ++i) {
+    float weight = exp(-float(i*i)/8.);
+    fragColor += texture(trail, uv + float(i)*step)*weight;
+  }
+  fragColor /= 4.898;
+}
@@ -0,0 +1,16 @@
+#version 320 es
+
+#include "../partial/base.part.frag"
+
+uniform sampler2D trail;
+uniform sampler2D blurY;
+
+/**
+ * Main code.
+ */
+
+void setColor(out vec4 fragColor, in vec4 fragCoord) {
+  vec2 uv = fragCoord.xy/vec2(resolution);
+  vec3 color = texture(trail, uv).rgb + 1.5*texture(blurY, uv).rgb;
+  fragColor = vec4(color, 1.);
+}
@@ -0,0 +1,20 @@
+#version 320 es
+
+#include "../partial/base.part.frag"
+#include "../partial/colors.part.frag"
+
+uniform sampler2D trail;
+
+/**
+ * Main code.
+ */
+
+void setColor(out vec4 fragColor, in vec4 fragCoord) {
+  vec2 size = vec2(resolution);
+  vec2 uv = (fragCoord.xy - size*.5)/min(size.x, size.y);
+  vec2 dot = .35*vec2(sin(time*1.3), sin(time*2.1));
+  float d = distance(uv, dot);
+  vec4 previous = texture(trail, fragCoord.xy/size);
+  vec4 color = hsvCycled2rgba(vec3(0., 1., 1.), 1., .2);
+  fragColor = max(previous*.97, color*smoothstep(.03, .02, d));
+}
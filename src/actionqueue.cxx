@@ -0,0 +1,45 @@
+#include "actionqueue.hxx"
+
+#include <chrono>
+
+auto ActionQueue::push(const WindowAction& action) -> bool {
+  const std::size_t tail{_tail.load(std::memory_order_relaxed)};
+  if (tail - _head.load(std::memory_order_acquire) == _capacity) {
+    return false;
+  }
+  _actions[tail%_capacity] = action;
+  // Sequentially consistent with the check in wait(), so that either the
+  // consumer sees the action or this sees the consumer sleeping.
+  _tail.store(tail + 1);
+  if (_sleeping.load()) {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _pushed.notify_one();
+  }
+  return true;
+}
+
+auto ActionQueue::pop() -> std::optional<WindowAction> {
+  const std::size_t head{_head.load(std::memory_order_relaxed)};
+  if (head == _tail.load(std::memory_order_acquire)) {
+    return {};
+  }
+  const WindowAction action{_actions[head%_capacity]};
+  _head.store(head + 1, std::memory_order_release);
+  return action;
+}
+
+auto ActionQueue::wait(std::optional<double> timeoutSeconds) -> void {
+  std::unique_lock<std::mutex> lock{_mutex};
+  _sleeping = true;
+  const auto hasActions{[this]() {
+    return _head.load(std::memory_order_relaxed) != _tail.load();
+  }};
+  if (timeoutSeconds) {
+    _pushed.wait_for(
+      lock, std::chrono::duration<double>{*timeoutSeconds}, hasActions
+    );
+  } else {
+    _pushed.wait(lock, hasActions);
+  }
+  _sleeping = false;
+}
@@ -0,0 +1,74 @@
+#ifndef ACTIONQUEUE_HXX
+#define ACTIONQUEUE_HXX
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+
+#include "geometry.hxx"
+
+enum class WindowActionType {
+  // The window is closing; nothing follows.
+  Close,
+  ChangeModel,
+  PauseResume,
+  NextShader,
+  PreviousShader,
+  // Any other input or an expose event that calls for a new frame.
+  Redraw,
+  Resize,
+  Mouse
+};
+
+// Input for the render thread. Only the fields of its type are set.
+struct WindowAction {
+  WindowActionType type{WindowActionType::Redraw};
+  GeometryType modelType{GeometryType::Rectangle};
+  // Framebuffer size in pixels.
+  int width{};
+  int height{};
+  // Cursor in framebuffer pixels, origin at the bottom left.
+  double mouseX{};
+  double mouseY{};
+  bool mouseDown{false};
+};
+
+/**
+ * A bounded queue of window actions from the event thread (the only
+ * producer) to the render thread (the only consumer). Pushing and popping
+ * take no locks: each side only writes its own index, and publishes it
+ * with release ordering after touching the slot. The mutex is only taken
+ * to wake a consumer that sleeps in wait().
+ */
+class ActionQueue {
+public:
+  ActionQueue() = default;
+  ActionQueue(const ActionQueue&) = delete;
+  ActionQueue(ActionQueue&&) = delete;
+  ActionQueue operator=(const ActionQueue&) = delete;
+  ActionQueue operator=(ActionQueue&&) = delete;
+
+  // Producer only; false if the queue is full.
+  auto push(const WindowAction& action) -> bool;
+  // Consumer only.
+  auto pop() -> std::optional<WindowAction>;
+  // Consumer only: sleeps until an action arrives, or the timeout passes.
+  auto wait(std::optional<double> timeoutSeconds) -> void;
+
+private:
+  static constexpr std::size_t _capacity{1024};
+
+  std::array<WindowAction, _capacity> _actions{};
+  // Both count up forever; slots are taken modulo the capacity. They sit
+  // on separate cache lines, so that the two sides do not contend.
+  alignas(64) std::atomic<std::size_t> _head{};
+  alignas(64) std::atomic<std::size_t> _tail{};
+  std::atomic<bool> _sleeping{false};
+  std::mutex _mutex{};
+  std::condition_variable _pushed{};
+};
+
+#endif // ACTIONQUEUE_HXX
@@ -0,0 +1,183 @@
+#include "batch.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "process.hxx"
+
+namespace {
+
+struct Shard {
+  int firstFrame;
+  int lastFrame;
+  std::string partPath;
+  std::unique_ptr<ChildProcess> process;
+};
+
+auto getFormatName(CaptureFormat format) -> std::string {
+  switch (format) {
+    case CaptureFormat::Raw:
+      return "raw";
+    case CaptureFormat::Y4M:
+      return "y4m";
+    default:
+      return "png";
+  }
+}
+
+// A prefix for part files that no other batch uses at the same time.
+auto getPartPrefix(const std::string& capturePath) -> std::string {
+  if (capturePath != "-") {
+    return capturePath;
+  }
+  std::random_device random{};
+  std::ostringstream name{};
+  name << "shadertest-" << std::hex << random() << random();
+  return (std::filesystem::temp_directory_path()/name.str()).string();
+}
+
+// Appends a part file to the output, without the stream header for every
+// Y4M part but the first.
+auto appendPart(
+  const std::string& partPath, std::FILE* output, bool skipHeader
+) -> bool {
+  std::FILE* part{std::fopen(partPath.c_str(), "rb")};
+  if (!part) {
+    return false;
+  }
+  if (skipHeader) {
+    int c{};
+    while ((c = std::fgetc(part)) != EOF && c != '\n') {}
+  }
+  std::vector<char> buffer(1 << 20);
+  bool written{true};
+  std::size_t size{};
+  while ((size = std::fread(buffer.data(), 1, buffer.size(), part)) > 0) {
+    if (std::fwrite(buffer.data(), 1, size, output) != size) {
+      written = false;
+      break;
+    }
+  }
+  std::fclose(part);
+  return written;
+}
+
+} // namespace
+
+auto runBatch(const BatchSettings& settings) -> bool {
+  const int jobs{std::max(std::min(settings.jobCount, settings.frameCount), 1)};
+  const bool stitched{
+    settings.capturePath && settings.captureFormat != CaptureFormat::PNG
+  };
+  const std::string partPrefix{
+    stitched ? getPartPrefix(*settings.capturePath) : std::string{}
+  };
+  // Workers would otherwise each start one rasterizer thread per core, e.g.
+  // with llvmpipe; 0 rasterizes on the worker's own thread.
+  const unsigned cores{std::max(std::thread::hardware_concurrency(), 1u)};
+  const unsigned coresPerJob{cores/static_cast<unsigned>(jobs)};
+  setEnvironmentDefault(
+    "LP_NUM_THREADS", std::to_string(coresPerJob > 1 ? coresPerJob : 0)
+  );
+
+  const auto startTime{std::chrono::steady_clock::now()};
+  bool succeeded{true};
+  std::vector<Shard> shards{};
+  for (int job{0}; job < jobs; ++job) {
+    Shard shard{
+      settings.firstFrame + settings.frameCount*job/jobs,
+      settings.firstFrame + settings.frameCount*(job + 1)/jobs - 1,
+      stitched ? partPrefix + ".part" + std::to_string(job) : std::string{},
+      nullptr
+    };
+    std::vector<std::string> arguments{settings.arguments};
+    arguments.push_back("--headless");
+    arguments.push_back(
+      "--frame-range=" + std::to_string(shard.firstFrame) + '-'
+        + std::to_string(shard.lastFrame)
+    );
+    if (settings.capturePath) {
+      arguments.push_back(
+        "--capture=" + (stitched ? shard.partPath : *settings.capturePath)
+      );
+      arguments.push_back(
+        "--capture-format=" + getFormatName(settings.captureFormat)
+      );
+    }
+    try {
+      shard.process = std::make_unique<ChildProcess>(
+        settings.program, arguments
+      );
+    } catch (const std::runtime_error& ex) {
+      std::cerr << ex.what() << '\n';
+      succeeded = false;
+      break;
+    }
+    shards.push_back(std::move(shard));
+  }
+
+  std::FILE* output{};
+  if (stitched && succeeded && *settings.capturePath == "-") {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    output = stdout;
+  } else if (stitched && succeeded) {
+    output = std::fopen(settings.capturePath->c_str(), "wb");
+    if (!output) {
+      std::cerr << "Failed to open " << *settings.capturePath << '\n';
+      succeeded = false;
+    }
+  }
+  // Shards are stitched in order, each as soon as it and those before it
+  // are done.
+  for (std::size_t index{0}; index < shards.size(); ++index) {
+    Shard& shard{shards[index]};
+    const int exitCode{shard.process->wait()};
+    if (exitCode != 0) {
+      std::cerr << "Shard " << index << " (frames " << shard.firstFrame
+        << '-' << shard.lastFrame << ") failed with exit code " << exitCode
+        << '\n';
+      succeeded = false;
+    }
+    if (stitched) {
+      if (succeeded && !appendPart(
+        shard.partPath, output,
+        index > 0 && settings.captureFormat == CaptureFormat::Y4M
+      )) {
+        std::cerr << "Failed to stitch " << shard.partPath << '\n';
+        succeeded = false;
+      }
+      std::error_code error{};
+      std::filesystem::remove(shard.partPath, error);
+    }
+  }
+  if (output == stdout) {
+    std::fflush(output);
+  } else if (output) {
+    std::fclose(output);
+  }
+  if (!succeeded) {
+    return false;
+  }
+  const std::chrono::duration<double> elapsed{
+    std::chrono::steady_clock::now() - startTime
+  };
+  std::cout << "Rendered " << settings.frameCount << " frames in "
+    << elapsed.count()*1000. << " ms on " << jobs << " processes ("
+    << settings.frameCount/elapsed.count() << " fps)\n";
+  return true;
+}
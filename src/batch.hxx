@@ -0,0 +1,33 @@
+#ifndef BATCH_HXX
+#define BATCH_HXX
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "framewriter.hxx"
+
+struct BatchSettings {
+  std::string program;
+  // Passed to every worker, which also gets --headless, its frame range
+  // and its capture output.
+  std::vector<std::string> arguments;
+  int firstFrame;
+  int frameCount;
+  int jobCount;
+  std::optional<std::string> capturePath;
+  CaptureFormat captureFormat;
+};
+
+/**
+ * Splits a frame range into contiguous shards and renders each one in a
+ * worker process of the given program, with a headless context of its own.
+ * Raw and Y4M captures are written to one part file per shard and stitched
+ * in order into the capture path (or stdout) as the shards finish; PNG
+ * frames are numbered by frame, so they need no stitching. Returns whether
+ * every shard succeeded.
+ */
+auto runBatch(const BatchSettings& settings) -> bool;
+
+#endif // BATCH_HXX
@@ -0,0 +1,297 @@
+#include "cache.hxx"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "debug.hxx"
+#include "trace.hxx"
+
+namespace {
+
+constexpr std::array<char, 4> entryMagic{'S', 'T', 'P', 'B'};
+constexpr std::uint32_t entryVersion{1};
+constexpr const char* entryExtension{".bin"};
+constexpr const char* temporaryExtension{".tmp"};
+// Older temporary files were left by writers that failed or were killed.
+constexpr std::chrono::minutes staleTemporaryAge{10};
+
+struct EntryHeader {
+  std::array<char, 4> magic;
+  std::uint32_t version;
+  std::uint32_t format;
+  std::uint32_t length;
+};
+
+auto getProcessId() -> long {
+#ifdef _WIN32
+  return static_cast<long>(_getpid());
+#else
+  return static_cast<long>(getpid());
+#endif
+}
+
+// 64-bit FNV-1a. Each part is followed by a separator byte that cannot occur
+// in GLSL source, so that e.g. ("ab", "c") and ("a", "bc") hash differently.
+class Hasher {
+public:
+  auto add(std::string_view part) -> Hasher& {
+    for (const char c : part) {
+      addByte(static_cast<unsigned char>(c));
+    }
+    addByte(0xff);
+    return *this;
+  }
+
+  // Hashes the concatenated text, independent of how it is split.
+  auto add(const ShaderSource& source) -> Hasher& {
+    for (const std::string_view segment : source.segments) {
+      for (const char c : segment) {
+        addByte(static_cast<unsigned char>(c));
+      }
+    }
+    addByte(0xff);
+    return *this;
+  }
+
+  auto get() const -> std::uint64_t {
+    return _hash;
+  }
+
+private:
+  auto addByte(unsigned char byte) -> void {
+    _hash ^= byte;
+    _hash *= 0x100000001b3;
+  }
+
+  std::uint64_t _hash{0xcbf29ce484222325};
+};
+
+} // namespace
+
+ProgramCache::ProgramCache(
+  std::filesystem::path directory, std::uintmax_t maxBytes
+) : _directory{std::move(directory)}, _maxBytes{maxBytes} {
+  GLint formatCount{};
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  if (formatCount <= 0) {
+    LOG("Program binaries are unsupported by the driver\n");
+    return;
+  }
+  std::error_code error{};
+  std::filesystem::create_directories(_directory, error);
+  if (error) {
+    LOG_ERROR("Failed to create cache directory: " << _directory << '\n');
+    return;
+  }
+  _driver = std::string{reinterpret_cast<const char*>(glGetString(GL_VENDOR))}
+    + '\n' + reinterpret_cast<const char*>(glGetString(GL_RENDERER))
+    + '\n' + reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  _supported = true;
+}
+
+auto ProgramCache::getDefaultDirectory() -> std::filesystem::path {
+#ifdef _WIN32
+  if (const char* localAppData{std::getenv("LOCALAPPDATA")}) {
+    return std::filesystem::path{localAppData} / "ShaderTest" / "cache";
+  }
+#else
+  if (const char* cacheHome{std::getenv("XDG_CACHE_HOME")}) {
+    return std::filesystem::path{cacheHome} / "shadertest";
+  }
+  if (const char* home{std::getenv("HOME")}) {
+    return std::filesystem::path{home} / ".cache" / "shadertest";
+  }
+#endif
+  return std::filesystem::temp_directory_path() / "shadertest";
+}
+
+auto ProgramCache::load(const ShaderSources& sources) -> std::optional<GLuint> {
+  if (!_supported) {
+    return {};
+  }
+  TRACE_SPAN("io", "load program binary");
+  const std::filesystem::path path{getEntryPath(sources)};
+  std::vector<char> binary{};
+  EntryHeader header{};
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    std::ifstream stream{path, std::ios::binary};
+    if (!stream) {
+      ++_misses;
+      return {};
+    }
+    stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (
+      !stream || header.magic != entryMagic || header.version != entryVersion
+    ) {
+      ++_rejected;
+      ++_misses;
+      return {};
+    }
+    // A corrupt length must not allocate more than the file holds.
+    std::error_code error{};
+    const std::uintmax_t fileSize{std::filesystem::file_size(path, error)};
+    if (error || header.length > fileSize - sizeof(header)) {
+      ++_rejected;
+      ++_misses;
+      return {};
+    }
+    binary.resize(header.length);
+    stream.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!stream) {
+      ++_rejected;
+      ++_misses;
+      return {};
+    }
+    // Refresh the modification time, which eviction uses as the last use.
+    std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now(), error
+    );
+  }
+  const GLuint program{glCreateProgram()};
+  glProgramBinary(
+    program, header.format, binary.data(), static_cast<GLsizei>(binary.size())
+  );
+  GLint status{};
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (!status) {
+    // Typically a driver update; the entry will be replaced after the
+    // program has been rebuilt from source.
+    LOG("Driver rejected cached program binary " << path << '\n');
+    glDeleteProgram(program);
+    ++_rejected;
+    ++_misses;
+    return {};
+  }
+  ++_hits;
+  return program;
+}
+
+auto ProgramCache::store(const ShaderSources& sources, GLuint program) -> void {
+  if (!_supported) {
+    return;
+  }
+  TRACE_SPAN("io", "store program binary");
+  GLint length{};
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(static_cast<std::size_t>(length));
+  GLenum format{};
+  glGetProgramBinary(program, length, nullptr, &format, binary.data());
+  const EntryHeader header{
+    entryMagic, entryVersion, format, static_cast<std::uint32_t>(length)
+  };
+
+  std::lock_guard<std::mutex> lock{_mutex};
+  const std::filesystem::path path{getEntryPath(sources)};
+  // A name of its own, as other processes (e.g. batch workers) may store
+  // the same entry at the same time.
+  std::random_device random{};
+  std::ostringstream suffix{};
+  suffix << '.' << getProcessId() << '-' << std::hex << random()
+    << temporaryExtension;
+  std::filesystem::path temporaryPath{path};
+  temporaryPath += suffix.str();
+  bool written{};
+  {
+    std::ofstream stream{temporaryPath, std::ios::binary | std::ios::trunc};
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+    written = static_cast<bool>(stream);
+  }
+  std::error_code error{};
+  if (!written) {
+    LOG_ERROR("Failed to write program cache entry " << path << '\n');
+    std::filesystem::remove(temporaryPath, error);
+    return;
+  }
+  // Renaming is atomic and every writer has its own temporary file, so
+  // concurrent instances never read partial or mixed entries.
+  std::filesystem::rename(temporaryPath, path, error);
+  if (error) {
+    std::filesystem::remove(temporaryPath, error);
+    return;
+  }
+  evict();
+}
+
+auto ProgramCache::getStatistics() const -> ProgramCacheStatistics {
+  return {_hits.load(), _misses.load(), _rejected.load()};
+}
+
+auto ProgramCache::getEntryPath(
+  const ShaderSources& sources
+) const -> std::filesystem::path {
+  const std::uint64_t key{
+    Hasher{}.add(_driver).add(sources.vertex).add(sources.fragment).get()
+  };
+  std::ostringstream name{};
+  name << std::hex << std::setw(16) << std::setfill('0') << key
+    << entryExtension;
+  return _directory / name.str();
+}
+
+auto ProgramCache::evict() -> void {
+  struct Entry {
+    std::filesystem::path path;
+    std::filesystem::file_time_type lastUse;
+    std::uintmax_t size;
+  };
+  std::vector<Entry> entries{};
+  std::uintmax_t totalSize{};
+  std::error_code error{};
+  const auto now{std::filesystem::file_time_type::clock::now()};
+  for (
+    const auto& file : std::filesystem::directory_iterator{_directory, error}
+  ) {
+    const std::filesystem::path extension{file.path().extension()};
+    if (extension != entryExtension && extension != temporaryExtension) {
+      continue;
+    }
+    const std::uintmax_t size{file.file_size(error)};
+    const auto lastUse{file.last_write_time(error)};
+    if (error) {
+      continue;
+    }
+    // Temporary files of writers still at work are left alone.
+    if (extension == temporaryExtension) {
+      if (now - lastUse > staleTemporaryAge) {
+        std::filesystem::remove(file.path(), error);
+      }
+      continue;
+    }
+    entries.push_back({file.path(), lastUse, size});
+    totalSize += size;
+  }
+  if (totalSize <= _maxBytes) {
+    return;
+  }
+  std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+    return a.lastUse < b.lastUse;
+  });
+  for (const Entry& entry : entries) {
+    if (totalSize <= _maxBytes) {
+      break;
+    }
+    if (std::filesystem::remove(entry.path, error)) {
+      totalSize -= entry.size;
+      LOG("Evicted program cache entry " << entry.path << '\n');
+    }
+  }
+}
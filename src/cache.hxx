@@ -0,0 +1,61 @@
+#ifndef CACHE_HXX
+#define CACHE_HXX
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <glad/gl.h>
+
+#include "parameters.hxx"
+
+struct ProgramCacheSettings {
+  std::filesystem::path directory;
+  std::uintmax_t maxBytes;
+};
+
+struct ProgramCacheStatistics {
+  unsigned hits{};
+  unsigned misses{};
+  unsigned rejected{};
+};
+
+/**
+ * Persists linked program binaries on disk, keyed by a hash of the shader
+ * sources and the renderer/driver version. The directory is kept under a
+ * size limit by evicting the least recently used entries, and temporary
+ * files that failed or killed writers left behind are removed.
+ */
+class ProgramCache {
+public:
+  ProgramCache(std::filesystem::path directory, std::uintmax_t maxBytes);
+  ProgramCache() = delete;
+  ProgramCache(const ProgramCache&) = delete;
+  ProgramCache(ProgramCache&&) = delete;
+  ProgramCache operator=(const ProgramCache&) = delete;
+  ProgramCache operator=(ProgramCache&&) = delete;
+
+  static auto getDefaultDirectory() -> std::filesystem::path;
+  auto load(const ShaderSources& sources) -> std::optional<GLuint>;
+  auto store(const ShaderSources& sources, GLuint program) -> void;
+  auto getStatistics() const -> ProgramCacheStatistics;
+
+private:
+  auto getEntryPath(const ShaderSources& sources) const
+    -> std::filesystem::path;
+  auto evict() -> void;
+
+  std::filesystem::path _directory;
+  std::uintmax_t _maxBytes;
+  std::string _driver{};
+  bool _supported{false};
+  std::mutex _mutex{};
+  std::atomic<unsigned> _hits{};
+  std::atomic<unsigned> _misses{};
+  std::atomic<unsigned> _rejected{};
+};
+
+#endif // CACHE_HXX
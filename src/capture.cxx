@@ -0,0 +1,108 @@
+#include "capture.hxx"
+
+#include <cstring>
+
+FrameCapture::FrameCapture(const CaptureSettings& settings) :
+  _nextNumber{settings.firstNumber}, _dropFrames{settings.dropFrames},
+  _writer{settings} {
+  for (Readback& readback : _ring) {
+    glGenBuffers(1, &readback.buffer);
+  }
+}
+
+FrameCapture::~FrameCapture() {
+  finish();
+  for (Readback& readback : _ring) {
+    glDeleteBuffers(1, &readback.buffer);
+  }
+}
+
+auto FrameCapture::capture(
+  GLuint framebuffer, GLsizei width, GLsizei height
+) -> void {
+  collect(false);
+  if (_inFlight == ringSize) {
+    // The GPU is more than a ring behind.
+    if (_dropFrames) {
+      ++_frames;
+      ++_nextNumber;
+      ++_dropped;
+      return;
+    }
+    ++_stalls;
+    collect(true);
+  }
+  Readback& readback{_ring[_next]};
+  const GLsizeiptr size{static_cast<GLsizeiptr>(width)*height*4};
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+  if (size > readback.capacity) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    readback.capacity = size;
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  readback.width = width;
+  readback.height = height;
+  readback.number = _nextNumber++;
+  ++_frames;
+  _next = (_next + 1)%ringSize;
+  ++_inFlight;
+}
+
+auto FrameCapture::finish() -> void {
+  while (_inFlight > 0) {
+    collect(true);
+  }
+  _writer.finish();
+}
+
+auto FrameCapture::getStatistics() const -> CaptureStatistics {
+  CaptureStatistics statistics{_writer.getStatistics()};
+  statistics.frames = _frames;
+  statistics.dropped += _dropped;
+  statistics.stalls += _stalls;
+  return statistics;
+}
+
+auto FrameCapture::collect(bool waitForOldest) -> void {
+  bool wait{waitForOldest};
+  while (_inFlight > 0) {
+    Readback& readback{_ring[(_next + ringSize - _inFlight)%ringSize]};
+    const GLenum status{glClientWaitSync(
+      readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+      wait ? GL_TIMEOUT_IGNORED : 0
+    )};
+    wait = false;
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+    --_inFlight;
+    const auto size{
+      static_cast<std::size_t>(readback.width)*readback.height*4
+    };
+    CapturedFrame frame{
+      readback.number,
+      {readback.width, readback.height, _writer.takeBuffer(size)}
+    };
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const void* data{glMapBufferRange(
+      GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(size),
+      GL_MAP_READ_BIT
+    )};
+    if (data) {
+      std::memcpy(frame.image.pixels.data(), data, size);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!data) {
+      ++_dropped;
+      continue;
+    }
+    _writer.push(std::move(frame));
+  }
+}
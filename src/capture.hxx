@@ -0,0 +1,62 @@
+#ifndef CAPTURE_HXX
+#define CAPTURE_HXX
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/gl.h>
+
+#include "framewriter.hxx"
+
+/**
+ * Reads rendered frames back without stalling the GPU: each frame is copied
+ * into the next of a ring of pixel pack buffers, and only mapped once its
+ * fence has signalled, a frame or two later. Mapped frames go to a
+ * FrameWriter. The render thread only waits when every buffer of the ring
+ * is still in flight, or for space in the writer's queue.
+ */
+class FrameCapture {
+public:
+  explicit FrameCapture(const CaptureSettings& settings);
+  FrameCapture() = delete;
+  FrameCapture(const FrameCapture&) = delete;
+  FrameCapture(FrameCapture&&) = delete;
+  FrameCapture operator=(const FrameCapture&) = delete;
+  FrameCapture operator=(FrameCapture&&) = delete;
+  ~FrameCapture();
+
+  // Starts reading back the color buffer of the framebuffer, and hands the
+  // frames whose readback has finished to the writer.
+  auto capture(GLuint framebuffer, GLsizei width, GLsizei height) -> void;
+  // Waits for every readback and for the writer.
+  auto finish() -> void;
+  auto getStatistics() const -> CaptureStatistics;
+
+private:
+  struct Readback {
+    GLuint buffer{};
+    GLsizeiptr capacity{};
+    GLsync fence{};
+    GLsizei width{};
+    GLsizei height{};
+    std::uint64_t number{};
+  };
+
+  // Hands over finished readbacks in order, first waiting for the oldest
+  // one if asked to.
+  auto collect(bool waitForOldest) -> void;
+
+  static constexpr std::size_t ringSize{3};
+  std::array<Readback, ringSize> _ring{};
+  std::size_t _next{0};
+  std::size_t _inFlight{0};
+  std::uint64_t _frames{0};
+  std::uint64_t _nextNumber;
+  std::uint64_t _dropped{0};
+  std::uint64_t _stalls{0};
+  const bool _dropFrames;
+  FrameWriter _writer;
+};
+
+#endif // CAPTURE_HXX
@@ -0,0 +1,392 @@
+#include "channels.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include "debug.hxx"
+#include "framewriter.hxx"
+#include "png.hxx"
+#include "trace.hxx"
+
+namespace {
+
+auto isRawPath(const std::string& path) -> bool {
+  const std::string extension{std::filesystem::path{path}.extension().string()};
+  return extension == ".rgba" || extension == ".raw";
+}
+
+// A frame of a raw RGBA file, flipped to put the bottom row first.
+auto readRawFrame(
+  const MappedFile& file, std::size_t frame, int width, int height
+) -> std::optional<Image> {
+  const auto rowSize{static_cast<std::size_t>(width)*4};
+  const std::size_t frameSize{rowSize*static_cast<std::size_t>(height)};
+  if (!file.getData() || file.getSize() < (frame + 1)*frameSize) {
+    return {};
+  }
+  const auto source{reinterpret_cast<const std::uint8_t*>(
+    file.getData() + frame*frameSize
+  )};
+  Image image{width, height, std::vector<std::uint8_t>(frameSize)};
+  for (std::size_t y{0}; y < static_cast<std::size_t>(height); ++y) {
+    std::memcpy(
+      image.pixels.data() + (height - 1 - y)*rowSize, source + y*rowSize,
+      rowSize
+    );
+  }
+  return image;
+}
+
+auto readImageFile(
+  const std::string& path, int rawWidth, int rawHeight
+) -> std::optional<Image> {
+  if (isRawPath(path)) {
+    return readRawFrame(MappedFile{path}, 0, rawWidth, rawHeight);
+  }
+  if (std::filesystem::path{path}.extension() == ".png") {
+    const MappedFile file{path};
+    return decodePNG(
+      reinterpret_cast<const std::uint8_t*>(file.getData()), file.getSize()
+    );
+  }
+  return readImage(path);
+}
+
+// The existing files of a numbered sequence, from 0 or from 1 on.
+auto findSequenceFrames(
+  const std::string& pattern
+) -> std::vector<std::string> {
+  std::vector<std::string> paths{};
+  std::uint64_t number{std::filesystem::exists(formatFramePath(pattern, 0))
+    ? 0u : 1u};
+  for (;; ++number) {
+    std::string path{formatFramePath(pattern, number)};
+    if (!std::filesystem::exists(path)) {
+      return paths;
+    }
+    paths.push_back(std::move(path));
+  }
+}
+
+auto getLevelCount(int width, int height) -> GLsizei {
+  GLsizei levels{1};
+  for (int size{std::max(width, height)}; size > 1; size /= 2) {
+    ++levels;
+  }
+  return levels;
+}
+
+} // namespace
+
+TextureChannels::TextureChannels(const ChannelSettings& settings) :
+  _fps{settings.fps}, _prefetch{std::max<std::size_t>(settings.prefetch, 1)},
+  _pool{settings.threadCount} {
+  for (const ChannelDescription& description : settings.channels) {
+    auto channel{std::make_unique<Channel>()};
+    channel->index = description.index;
+    channel->width = description.width;
+    channel->height = description.height;
+    if (description.path.find('#') != std::string::npos) {
+      channel->framePaths = findSequenceFrames(description.path);
+      channel->frameCount = channel->framePaths.size();
+    } else if (isRawPath(description.path)) {
+      if (description.width <= 0 || description.height <= 0) {
+        throw std::runtime_error{
+          "Raw channel " + description.path + " needs a size"
+        };
+      }
+      channel->rawFile = std::make_unique<MappedFile>(description.path);
+      channel->frameCount = channel->rawFile->getSize()
+        /(static_cast<std::size_t>(description.width)*description.height*4);
+    } else {
+      channel->framePaths = {description.path};
+    }
+    if (channel->frameCount == 0) {
+      throw std::runtime_error{"No frames found for " + description.path};
+    }
+    _channels.push_back(std::move(channel));
+  }
+
+  // The first frames set the texture sizes, and are decoded together.
+  std::vector<std::optional<Image>> firstFrames(_channels.size());
+  _pool.run(_channels.size(), [this, &firstFrames](std::size_t c, std::size_t) {
+    firstFrames.at(c) = decode(*_channels.at(c), 0);
+  });
+  for (std::size_t c{0}; c < _channels.size(); ++c) {
+    if (!firstFrames.at(c)) {
+      throw std::runtime_error{
+        "Failed to load channel " + std::to_string(_channels.at(c)->index)
+          + " from " + settings.channels.at(c).path
+      };
+    }
+  }
+
+  for (Upload& upload : _uploads) {
+    glGenBuffers(1, &upload.buffer);
+  }
+  for (std::size_t c{0}; c < _channels.size(); ++c) {
+    Channel& channel{*_channels.at(c)};
+    const Image& image{*firstFrames.at(c)};
+    channel.width = image.width;
+    channel.height = image.height;
+    glGenTextures(1, &channel.texture);
+    // Each texture stays bound to its unit.
+    glActiveTexture(
+      GL_TEXTURE0 + firstUnit + static_cast<GLuint>(channel.index)
+    );
+    glBindTexture(GL_TEXTURE_2D, channel.texture);
+    glTexStorage2D(
+      GL_TEXTURE_2D, getLevelCount(image.width, image.height), GL_RGBA8,
+      image.width, image.height
+    );
+    glTexParameteri(
+      GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR
+    );
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glActiveTexture(GL_TEXTURE0);
+    upload(channel, image);
+    channel.shownFrame = 0;
+    if (channel.frameCount > 1) {
+      channel.frames.emplace(
+        0, std::make_shared<const Image>(std::move(*firstFrames.at(c)))
+      );
+    }
+  }
+  LOG("Loaded " << _channels.size() << " texture channels\n");
+  if (isAnimated()) {
+    _loader = std::thread{&TextureChannels::load, this};
+  }
+}
+
+TextureChannels::~TextureChannels() {
+  if (_loader.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      _stopping = true;
+    }
+    _wanted.notify_one();
+    _loader.join();
+  }
+  for (Upload& upload : _uploads) {
+    if (upload.fence) {
+      glDeleteSync(upload.fence);
+    }
+    glDeleteBuffers(1, &upload.buffer);
+  }
+  for (const std::unique_ptr<Channel>& channel : _channels) {
+    glDeleteTextures(1, &channel->texture);
+  }
+}
+
+auto TextureChannels::assignTextureUnits(GLuint program) const -> void {
+  for (const std::unique_ptr<Channel>& channel : _channels) {
+    const std::string name{"channel" + std::to_string(channel->index)};
+    const GLint location{glGetUniformLocation(program, name.c_str())};
+    if (location >= 0) {
+      glProgramUniform1i(
+        program, location, static_cast<GLint>(firstUnit) + channel->index
+      );
+    }
+  }
+}
+
+auto TextureChannels::isAnimated() const -> bool {
+  return std::any_of(
+    _channels.begin(), _channels.end(),
+    [](const std::unique_ptr<Channel>& channel) {
+      return channel->frameCount > 1;
+    }
+  );
+}
+
+auto TextureChannels::update(double time, bool wait) -> void {
+  if (!_loader.joinable()) {
+    return;
+  }
+  const auto position{static_cast<long long>(std::floor(time*_fps))};
+  std::vector<std::pair<Channel*, std::shared_ptr<const Image>>> shown{};
+  {
+    std::unique_lock<std::mutex> lock{_mutex};
+    for (const std::unique_ptr<Channel>& channel : _channels) {
+      if (channel->frameCount == 1) {
+        continue;
+      }
+      const auto count{static_cast<long long>(channel->frameCount)};
+      const auto frame{
+        static_cast<std::size_t>((position%count + count)%count)
+      };
+      const bool moved{channel->wantedFrame != frame};
+      if (moved) {
+        channel->wantedFrame = frame;
+        for (auto it{channel->frames.begin()}; it != channel->frames.end();) {
+          it = isInWindow(*channel, it->first)
+            ? std::next(it) : channel->frames.erase(it);
+        }
+        _wanted.notify_one();
+      }
+      if (channel->shownFrame == frame) {
+        continue;
+      }
+      auto found{channel->frames.find(frame)};
+      if (found == channel->frames.end() && wait) {
+        TRACE_SPAN("channels", "wait for frame");
+        _decoded.wait(lock, [&channel, frame]() {
+          return channel->frames.count(frame) > 0;
+        });
+        found = channel->frames.find(frame);
+      }
+      if (found == channel->frames.end()) {
+        if (moved) {
+          LOG("Channel " << channel->index << " frame " << frame
+            << " is late\n");
+        }
+        continue;
+      }
+      channel->shownFrame = frame;
+      shown.emplace_back(channel.get(), found->second);
+    }
+  }
+  // The loader keeps decoding during the uploads.
+  for (const auto& [channel, image] : shown) {
+    if (!image->pixels.empty()) {
+      upload(*channel, *image);
+    }
+  }
+}
+
+auto TextureChannels::decode(
+  const Channel& channel, std::size_t frame
+) const -> std::optional<Image> {
+  TRACE_SPAN("channels", "decode frame");
+  std::optional<Image> image{
+    channel.rawFile
+      ? readRawFrame(*channel.rawFile, frame, channel.width, channel.height)
+      : readImageFile(
+        channel.framePaths.at(frame), channel.width, channel.height
+      )
+  };
+  // Frames of a sequence must all have the size of the first one.
+  if (
+    image && frame > 0
+    && (image->width != channel.width || image->height != channel.height)
+  ) {
+    std::cerr << "Frame " << frame << " of channel " << channel.index
+      << " is not " << channel.width << 'x' << channel.height << '\n';
+    return {};
+  }
+  return image;
+}
+
+auto TextureChannels::isInWindow(
+  const Channel& channel, std::size_t frame
+) const -> bool {
+  // Sequences loop, so the window wraps around.
+  const std::size_t ahead{
+    (frame + channel.frameCount - channel.wantedFrame)%channel.frameCount
+  };
+  return ahead < _prefetch;
+}
+
+auto TextureChannels::upload(Channel& channel, const Image& image) -> void {
+  TRACE_SPAN("gl", "upload channel");
+  Upload& slot{_uploads[_nextUpload]};
+  _nextUpload = (_nextUpload + 1)%uploadRingSize;
+  // Only waits when the GPU is a whole ring of uploads behind.
+  if (slot.fence) {
+    glClientWaitSync(
+      slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED
+    );
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+  }
+  const auto size{static_cast<GLsizeiptr>(image.pixels.size())};
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+  if (size > slot.capacity) {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    slot.capacity = size;
+  }
+  void* data{glMapBufferRange(
+    GL_PIXEL_UNPACK_BUFFER, 0, size,
+    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+      | GL_MAP_UNSYNCHRONIZED_BIT
+  )};
+  if (data) {
+    std::memcpy(data, image.pixels.data(), image.pixels.size());
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glActiveTexture(
+      GL_TEXTURE0 + firstUnit + static_cast<GLuint>(channel.index)
+    );
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(
+      GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA,
+      GL_UNSIGNED_BYTE, nullptr
+    );
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glActiveTexture(GL_TEXTURE0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+auto TextureChannels::load() -> void {
+  setTraceThreadName("channel loader");
+  // Small batches, nearest frames first, so that the loader follows the
+  // wanted frames closely.
+  const std::size_t batchSize{_pool.getThreadCount()};
+  std::vector<std::pair<Channel*, std::size_t>> batch{};
+  std::unique_lock<std::mutex> lock{_mutex};
+  while (!_stopping) {
+    batch.clear();
+    for (std::size_t ahead{0}; ahead < _prefetch; ++ahead) {
+      for (const std::unique_ptr<Channel>& channel : _channels) {
+        if (ahead >= channel->frameCount || batch.size() == batchSize) {
+          continue;
+        }
+        const std::size_t frame{
+          (channel->wantedFrame + ahead)%channel->frameCount
+        };
+        if (
+          channel->frames.count(frame) == 0
+          && channel->decoding.insert(frame).second
+        ) {
+          batch.emplace_back(channel.get(), frame);
+        }
+      }
+    }
+    if (batch.empty()) {
+      _wanted.wait(lock);
+      continue;
+    }
+    lock.unlock();
+    _pool.run(batch.size(), [this, &batch](std::size_t b, std::size_t) {
+      const auto [channel, frame]{batch.at(b)};
+      std::optional<Image> image{decode(*channel, frame)};
+      if (!image) {
+        std::cerr << "Failed to load frame " << frame << " of channel "
+          << channel->index << '\n';
+        image = Image{};
+      }
+      {
+        std::lock_guard<std::mutex> guard{_mutex};
+        channel->decoding.erase(frame);
+        // The wanted frames may have moved on meanwhile.
+        if (!isInWindow(*channel, frame)) {
+          return;
+        }
+        channel->frames.emplace(
+          frame, std::make_shared<const Image>(std::move(*image))
+        );
+      }
+      _decoded.notify_all();
+    });
+    lock.lock();
+  }
+}
@@ -0,0 +1,122 @@
+#ifndef CHANNELS_HXX
+#define CHANNELS_HXX
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "image.hxx"
+#include "io.hxx"
+#include "threadpool.hxx"
+
+// An image file, or a sequence of them, bound as "channel<index>".
+struct ChannelDescription {
+  int index;
+  // PNG, PPM, PAM, or raw RGBA (".rgba" or ".raw", top row first), which
+  // may hold several frames back to back. A run of '#' in the path makes
+  // it a sequence of files numbered from 0 or 1.
+  std::string path;
+  // The frame size of raw files.
+  int width{};
+  int height{};
+};
+
+struct ChannelSettings {
+  std::vector<ChannelDescription> channels;
+  // Sequence frames per second of shader time.
+  double fps;
+  // The most frames of each sequence decoded ahead of the one shown.
+  std::size_t prefetch;
+  std::size_t threadCount;
+};
+
+/**
+ * Textures sampled as "uniform sampler2D channel0" to "channel7", each
+ * bound to its own unit from firstUnit on. Still images are decoded once.
+ * Sequences loop at a fixed rate against shader time and are streamed: a
+ * loader thread keeps the frames from the one shown up to the prefetch
+ * window decoded on a thread pool, so that the render thread only copies
+ * them into the next of a ring of pixel unpack buffers and uploads them
+ * from there. Textures have immutable storage, and their mipmaps are
+ * generated on the GPU after every upload.
+ */
+class TextureChannels {
+public:
+  static constexpr int maxChannels{8};
+  // Past the units of render graph inputs.
+  static constexpr GLuint firstUnit{16};
+
+  // Throws if the first frame of a channel fails to load.
+  explicit TextureChannels(const ChannelSettings& settings);
+  TextureChannels() = delete;
+  TextureChannels(const TextureChannels&) = delete;
+  TextureChannels(TextureChannels&&) = delete;
+  TextureChannels operator=(const TextureChannels&) = delete;
+  TextureChannels operator=(TextureChannels&&) = delete;
+  ~TextureChannels();
+
+  // Points the channel samplers of a program at their texture units.
+  auto assignTextureUnits(GLuint program) const -> void;
+  auto isAnimated() const -> bool;
+  // Shows the sequence frames for the given time. Frames that are not
+  // decoded yet leave the previous ones in place, unless waiting for them.
+  auto update(double time, bool wait) -> void;
+
+private:
+  struct Channel {
+    int index;
+    // One path per frame, or a single raw file holding every frame.
+    std::vector<std::string> framePaths{};
+    std::unique_ptr<MappedFile> rawFile{};
+    std::size_t frameCount{1};
+    // Of every frame, as set by the first one.
+    int width{};
+    int height{};
+    GLuint texture{};
+    std::optional<std::size_t> shownFrame{};
+    // Under _mutex. Frames that failed to load are kept empty, so that
+    // they are not tried again.
+    std::size_t wantedFrame{};
+    std::map<std::size_t, std::shared_ptr<const Image>> frames{};
+    std::set<std::size_t> decoding{};
+  };
+
+  struct Upload {
+    GLuint buffer{};
+    GLsizeiptr capacity{};
+    GLsync fence{};
+  };
+
+  auto decode(
+    const Channel& channel, std::size_t frame
+  ) const -> std::optional<Image>;
+  auto isInWindow(const Channel& channel, std::size_t frame) const -> bool;
+  auto upload(Channel& channel, const Image& image) -> void;
+  auto load() -> void;
+
+  const double _fps;
+  const std::size_t _prefetch;
+  std::vector<std::unique_ptr<Channel>> _channels{};
+  ThreadPool _pool;
+  static constexpr std::size_t uploadRingSize{3};
+  std::array<Upload, uploadRingSize> _uploads{};
+  std::size_t _nextUpload{0};
+  std::mutex _mutex{};
+  // Wakes the loader when the wanted frames move.
+  std::condition_variable _wanted{};
+  std::condition_variable _decoded{};
+  bool _stopping{false};
+  std::thread _loader{};
+};
+
+#endif // CHANNELS_HXX
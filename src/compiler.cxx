@@ -0,0 +1,83 @@
+#include "compiler.hxx"
+
+#include <iostream>
+
+#include <GLFW/glfw3.h>
+
+#include "graphics.hxx"
+#include "trace.hxx"
+
+ShaderCompiler::ShaderCompiler(
+  GLFWwindow* sharedContext, ProgramCache* cache
+) : _sharedContext{sharedContext}, _cache{cache},
+    _thread{&ShaderCompiler::run, this} {}
+
+ShaderCompiler::~ShaderCompiler() {
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _stopping = true;
+  }
+  _condition.notify_one();
+  _thread.join();
+  // Results that were never picked up belong to the shared namespace, so
+  // they can be released from the render context.
+  for (CompiledProgram& result : _results) {
+    glDeleteSync(result.fence);
+    glDeleteProgram(result.program);
+  }
+  glfwDestroyWindow(_sharedContext);
+}
+
+auto ShaderCompiler::submit(ShaderSources sources) -> void {
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    // Only the latest request matters; older ones are superseded.
+    _request = std::move(sources);
+  }
+  _condition.notify_one();
+}
+
+auto ShaderCompiler::poll() -> std::optional<GLuint> {
+  std::lock_guard<std::mutex> lock{_mutex};
+  if (_results.empty()) {
+    return {};
+  }
+  CompiledProgram& result{_results.front()};
+  const GLenum status{glClientWaitSync(result.fence, 0, 0)};
+  if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+    return {};
+  }
+  const GLuint program{result.program};
+  glDeleteSync(result.fence);
+  _results.pop_front();
+  return program;
+}
+
+auto ShaderCompiler::run() -> void {
+  setTraceThreadName("shader compiler");
+  glfwMakeContextCurrent(_sharedContext);
+  while (true) {
+    std::optional<ShaderSources> sources{};
+    {
+      std::unique_lock<std::mutex> lock{_mutex};
+      _condition.wait(lock, [this]() { return _stopping || _request; });
+      if (_stopping) {
+        break;
+      }
+      sources = std::move(_request);
+      _request.reset();
+    }
+    const std::optional<GLuint> program{
+      GraphicsEngine::createProgram(*sources, _cache)
+    };
+    if (!program) {
+      std::cerr << "Failed to build shaders; keeping the current program\n";
+      continue;
+    }
+    const GLsync fence{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)};
+    glFlush();
+    std::lock_guard<std::mutex> lock{_mutex};
+    _results.push_back({*program, fence});
+  }
+  glfwMakeContextCurrent(nullptr);
+}
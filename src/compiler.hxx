@@ -0,0 +1,54 @@
+#ifndef COMPILER_HXX
+#define COMPILER_HXX
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <glad/gl.h>
+
+#include "cache.hxx"
+#include "parameters.hxx"
+
+struct GLFWwindow;
+
+/**
+ * Compiles and links programs on a worker thread that owns a context shared
+ * with the render context, so the render thread never blocks on the driver.
+ * Finished programs are handed over together with a fence and only become
+ * available once the fence has signaled.
+ */
+class ShaderCompiler {
+public:
+  ShaderCompiler(GLFWwindow* sharedContext, ProgramCache* cache);
+  ShaderCompiler() = delete;
+  ShaderCompiler(const ShaderCompiler&) = delete;
+  ShaderCompiler(ShaderCompiler&&) = delete;
+  ShaderCompiler operator=(const ShaderCompiler&) = delete;
+  ShaderCompiler operator=(ShaderCompiler&&) = delete;
+  ~ShaderCompiler();
+
+  auto submit(ShaderSources sources) -> void;
+  auto poll() -> std::optional<GLuint>;
+
+private:
+  struct CompiledProgram {
+    GLuint program;
+    GLsync fence;
+  };
+
+  auto run() -> void;
+
+  GLFWwindow* _sharedContext;
+  ProgramCache* _cache;
+  std::mutex _mutex{};
+  std::condition_variable _condition{};
+  std::optional<ShaderSources> _request{};
+  std::deque<CompiledProgram> _results{};
+  bool _stopping{false};
+  std::thread _thread;
+};
+
+#endif // COMPILER_HXX
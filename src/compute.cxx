@@ -0,0 +1,360 @@
+#include "compute.hxx"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "debug.hxx"
+#include "graphics.hxx"
+#include "image.hxx"
+#include "png.hxx"
+#include "trace.hxx"
+
+namespace {
+
+struct ImageFormatName {
+  const char* name;
+  GLenum format;
+};
+
+constexpr ImageFormatName imageFormats[]{
+  {"rgba8", GL_RGBA8}, {"rgba16f", GL_RGBA16F}, {"rgba32f", GL_RGBA32F},
+  {"r32f", GL_R32F}
+};
+
+auto writeFile(
+  const std::filesystem::path& path, const void* data, std::size_t size
+) -> bool {
+  std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+  stream.write(
+    static_cast<const char*>(data), static_cast<std::streamsize>(size)
+  );
+  if (!stream) {
+    std::cerr << "Failed to write " << path.string() << '\n';
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+auto parseImageFormat(const std::string& name) -> std::optional<GLenum> {
+  for (const ImageFormatName& format : imageFormats) {
+    if (name == format.name) {
+      return format.format;
+    }
+  }
+  return {};
+}
+
+ComputeEngine::ComputeEngine(
+  GLuint program, const ComputeSettings& settings
+) : _program{program}, _slots(_ringSize) {
+  glGetProgramiv(_program, GL_COMPUTE_WORK_GROUP_SIZE, _localSize.data());
+  _timeLocation = glGetUniformLocation(_program, "time");
+  _frameLocation = glGetUniformLocation(_program, "frame");
+
+  GLint maxBufferBindings{};
+  glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxBufferBindings);
+  for (const ComputeBufferDescription& description : settings.buffers) {
+    if (description.binding >= static_cast<GLuint>(maxBufferBindings)) {
+      throw std::runtime_error{
+        "Storage buffer binding " + std::to_string(description.binding)
+          + " is beyond the limit of " + std::to_string(maxBufferBindings)
+      };
+    }
+    std::vector<char> data(description.size);
+    if (description.initialPath) {
+      std::ifstream stream{*description.initialPath, std::ios::binary};
+      if (!stream) {
+        throw std::runtime_error{
+          "Failed to open " + *description.initialPath
+        };
+      }
+      stream.read(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    Buffer buffer{description.binding, 0, description.size};
+    glGenBuffers(1, &buffer.buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.buffer);
+    glBufferStorage(
+      GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(data.size()),
+      data.data(), 0
+    );
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, buffer.binding, buffer.buffer);
+    _buffers.push_back(buffer);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  GLint maxImageUnits{};
+  glGetIntegerv(GL_MAX_IMAGE_UNITS, &maxImageUnits);
+  for (const ComputeImageDescription& description : settings.images) {
+    if (description.binding >= static_cast<GLuint>(maxImageUnits)) {
+      throw std::runtime_error{
+        "Image binding " + std::to_string(description.binding)
+          + " is beyond the limit of " + std::to_string(maxImageUnits)
+      };
+    }
+    Texture texture{
+      description.binding, 0, description.width, description.height
+    };
+    glGenTextures(1, &texture.texture);
+    glBindTexture(GL_TEXTURE_2D, texture.texture);
+    glTexStorage2D(
+      GL_TEXTURE_2D, 1, description.format, texture.width, texture.height
+    );
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glClearTexImage(texture.texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindImageTexture(
+      texture.binding, texture.texture, 0, GL_FALSE, 0, GL_READ_WRITE,
+      description.format
+    );
+    if (
+      settings.blitBinding
+        ? *settings.blitBinding == description.binding
+        : !_shownTexture
+    ) {
+      _shownTexture = _textures.size();
+    }
+    _textures.push_back(texture);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  if (settings.blitBinding && !_shownTexture) {
+    throw std::runtime_error{
+      "No image at binding " + std::to_string(*settings.blitBinding)
+    };
+  }
+  if (!_textures.empty()) {
+    const GLint resolutionLocation{
+      glGetUniformLocation(_program, "resolution")
+    };
+    glProgramUniform2i(
+      _program, resolutionLocation, _textures.front().width,
+      _textures.front().height
+    );
+  }
+
+  if (settings.groupCount) {
+    _groupCount = *settings.groupCount;
+  } else if (!settings.images.empty()) {
+    const ComputeImageDescription& image{settings.images.front()};
+    _groupCount[0] = static_cast<GLuint>(
+      (image.width + _localSize[0] - 1)/_localSize[0]
+    );
+    _groupCount[1] = static_cast<GLuint>(
+      (image.height + _localSize[1] - 1)/_localSize[1]
+    );
+  }
+  for (GLuint axis{0}; axis < 3; ++axis) {
+    GLint maxCount{};
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, axis, &maxCount);
+    if (_groupCount[axis] > static_cast<GLuint>(maxCount)) {
+      throw std::runtime_error{
+        "Work group count " + std::to_string(_groupCount[axis])
+          + " is beyond the limit of " + std::to_string(maxCount)
+      };
+    }
+  }
+  LOG("Compute grid " << _groupCount[0] << 'x' << _groupCount[1] << 'x'
+    << _groupCount[2] << " of " << _localSize[0] << 'x' << _localSize[1]
+    << 'x' << _localSize[2] << '\n');
+
+  for (QuerySlot& slot : _slots) {
+    glGenQueries(1, &slot.query);
+  }
+  glGenFramebuffers(1, &_readFramebuffer);
+  if (_shownTexture) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _readFramebuffer);
+    glFramebufferTexture2D(
+      GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+      _textures[*_shownTexture].texture, 0
+    );
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  }
+}
+
+ComputeEngine::~ComputeEngine() {
+  for (QuerySlot& slot : _slots) {
+    glDeleteQueries(1, &slot.query);
+  }
+  glDeleteFramebuffers(1, &_readFramebuffer);
+  for (const Texture& texture : _textures) {
+    glDeleteTextures(1, &texture.texture);
+  }
+  for (const Buffer& buffer : _buffers) {
+    glDeleteBuffers(1, &buffer.buffer);
+  }
+  glDeleteProgram(_program);
+}
+
+auto ComputeEngine::createProgram(
+  const ShaderSource& source
+) -> std::optional<GLuint> {
+  if (!GLAD_GL_VERSION_4_3) {
+    std::cerr << "Compute shaders need OpenGL 4.3\n";
+    return {};
+  }
+  const GLuint shader{
+    GraphicsEngine::createShader(GL_COMPUTE_SHADER, source)
+  };
+  const GLuint program{glCreateProgram()};
+  glAttachShader(program, shader);
+  glLinkProgram(program);
+  GLint status{};
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (!status) {
+    GLsizei logLength{};
+    std::string log{};
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+    if (logLength > 0) {
+      log.resize(logLength);
+      glGetShaderInfoLog(shader, logLength, nullptr, log.data());
+      std::cerr << "GL compute shader error: " << source.remapLog(log)
+        << '\n';
+    } else {
+      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+      log.resize(logLength);
+      glGetProgramInfoLog(program, logLength, nullptr, log.data());
+      std::cerr << "GL program error: " << log << '\n';
+    }
+  }
+  glDetachShader(program, shader);
+  glDeleteShader(shader);
+  if (!status) {
+    glDeleteProgram(program);
+    return {};
+  }
+  return program;
+}
+
+auto ComputeEngine::dispatch(GLfloat time, GLint frame) -> void {
+  TRACE_SPAN("compute", "dispatch");
+  QuerySlot& slot{_slots[_current]};
+  if (slot.pending) {
+    // Issued _ringSize dispatches ago, as in FrameProfiler.
+    collect(slot, true);
+  }
+  glUseProgram(_program);
+  if (_timeLocation >= 0) {
+    glUniform1f(_timeLocation, time);
+  }
+  if (_frameLocation >= 0) {
+    glUniform1i(_frameLocation, frame);
+  }
+  glBeginQuery(GL_TIME_ELAPSED, slot.query);
+  glDispatchCompute(_groupCount[0], _groupCount[1], _groupCount[2]);
+  glEndQuery(GL_TIME_ELAPSED);
+  // The next dispatch, blit or readback sees this one's writes.
+  glMemoryBarrier(
+    GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+      | GL_FRAMEBUFFER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT
+      | GL_TEXTURE_UPDATE_BARRIER_BIT
+  );
+  slot.pending = true;
+  _current = (_current + 1) % _slots.size();
+  for (std::size_t i{}; i < _slots.size(); ++i) {
+    QuerySlot& oldest{_slots[(_current + i) % _slots.size()]};
+    if (oldest.pending && !collect(oldest, false)) {
+      break;
+    }
+  }
+}
+
+auto ComputeEngine::blit(GLsizei width, GLsizei height) -> void {
+  if (!_shownTexture) {
+    return;
+  }
+  const Texture& texture{_textures[*_shownTexture]};
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, _readFramebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(
+    0, 0, texture.width, texture.height, 0, 0, width, height,
+    GL_COLOR_BUFFER_BIT, GL_NEAREST
+  );
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+auto ComputeEngine::capture(FrameCapture& capture) -> void {
+  if (_shownTexture) {
+    const Texture& texture{_textures[*_shownTexture]};
+    capture.capture(_readFramebuffer, texture.width, texture.height);
+  }
+}
+
+auto ComputeEngine::finish() -> void {
+  for (std::size_t i{}; i < _slots.size(); ++i) {
+    QuerySlot& slot{_slots[(_current + i) % _slots.size()]};
+    if (slot.pending) {
+      collect(slot, true);
+    }
+  }
+}
+
+auto ComputeEngine::getGroupCount() const -> std::array<GLuint, 3> {
+  return _groupCount;
+}
+
+auto ComputeEngine::getLocalSize() const -> std::array<GLint, 3> {
+  return _localSize;
+}
+
+auto ComputeEngine::getDispatchTimes() const -> const std::vector<double>& {
+  return _dispatchTimes;
+}
+
+auto ComputeEngine::dump(
+  const std::string& directory, ThreadPool& pool
+) -> bool {
+  std::error_code error{};
+  std::filesystem::create_directories(directory, error);
+  bool written{true};
+  std::vector<char> data{};
+  for (const Buffer& buffer : _buffers) {
+    data.resize(buffer.size);
+    glGetNamedBufferSubData(
+      buffer.buffer, 0, static_cast<GLsizeiptr>(buffer.size), data.data()
+    );
+    written = writeFile(
+      std::filesystem::path{directory}
+        /("buffer" + std::to_string(buffer.binding) + ".bin"),
+      data.data(), data.size()
+    ) && written;
+  }
+  for (const Texture& texture : _textures) {
+    Image image{
+      texture.width, texture.height,
+      std::vector<std::uint8_t>(
+        static_cast<std::size_t>(texture.width)*texture.height*4
+      )
+    };
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTextureImage(
+      texture.texture, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+      static_cast<GLsizei>(image.pixels.size()), image.pixels.data()
+    );
+    const std::vector<std::uint8_t> file{encodePNG(image, pool)};
+    written = writeFile(
+      std::filesystem::path{directory}
+        /("image" + std::to_string(texture.binding) + ".png"),
+      file.data(), file.size()
+    ) && written;
+  }
+  return written;
+}
+
+auto ComputeEngine::collect(QuerySlot& slot, bool wait) -> bool {
+  if (!wait) {
+    GLint available{};
+    glGetQueryObjectiv(slot.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      return false;
+    }
+  }
+  GLuint64 elapsed{};
+  glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &elapsed);
+  _dispatchTimes.push_back(static_cast<double>(elapsed)/1.e6);
+  slot.pending = false;
+  return true;
+}
@@ -0,0 +1,120 @@
+#ifndef COMPUTE_HXX
+#define COMPUTE_HXX
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "capture.hxx"
+#include "source.hxx"
+#include "threadpool.hxx"
+
+// A shader storage buffer, zeroed or filled from the start of a file.
+struct ComputeBufferDescription {
+  GLuint binding;
+  std::size_t size;
+  std::optional<std::string> initialPath;
+};
+
+// A 2D image, bound for reading and writing, e.g. as
+// "layout(rgba8, binding = 0) uniform image2D".
+struct ComputeImageDescription {
+  GLuint binding;
+  GLsizei width;
+  GLsizei height;
+  GLenum format;
+};
+
+struct ComputeSettings {
+  std::vector<ComputeBufferDescription> buffers;
+  std::vector<ComputeImageDescription> images;
+  // By default, enough work groups to cover the first image, or just one.
+  std::optional<std::array<GLuint, 3>> groupCount;
+  // The image to show in the window; the first one by default.
+  std::optional<GLuint> blitBinding;
+};
+
+// The image format of a layout qualifier name, e.g. GL_RGBA32F for
+// "rgba32f".
+auto parseImageFormat(const std::string& name) -> std::optional<GLenum>;
+
+/**
+ * Runs a compute program over a grid of work groups once per frame, on
+ * buffers and images that persist across dispatches, so a shader can
+ * reduce or simulate in place. The time and frame number are set as the
+ * "time" and "frame" uniforms, and the size of the first image as
+ * "resolution". Each dispatch is timed with a GL_TIME_ELAPSED query from a
+ * ring that is only read back once it wraps around.
+ */
+class ComputeEngine {
+public:
+  // Throws if the resources do not fit the implementation's limits.
+  ComputeEngine(GLuint program, const ComputeSettings& settings);
+  ComputeEngine() = delete;
+  ComputeEngine(const ComputeEngine&) = delete;
+  ComputeEngine(ComputeEngine&&) = delete;
+  ComputeEngine operator=(const ComputeEngine&) = delete;
+  ComputeEngine operator=(ComputeEngine&&) = delete;
+  ~ComputeEngine();
+
+  static auto createProgram(
+    const ShaderSource& source
+  ) -> std::optional<GLuint>;
+  auto dispatch(GLfloat time, GLint frame) -> void;
+  // Scales the shown image to the default framebuffer; does nothing
+  // without images.
+  auto blit(GLsizei width, GLsizei height) -> void;
+  // Reads the shown image back, as a frame of the capture.
+  auto capture(FrameCapture& capture) -> void;
+  // Waits for the last dispatch and collects every timing.
+  auto finish() -> void;
+  auto getGroupCount() const -> std::array<GLuint, 3>;
+  auto getLocalSize() const -> std::array<GLint, 3>;
+  // GPU milliseconds per dispatch, in order.
+  auto getDispatchTimes() const -> const std::vector<double>&;
+  // Writes buffers as "buffer<binding>.bin" and images, converted to RGBA8,
+  // as "image<binding>.png".
+  auto dump(const std::string& directory, ThreadPool& pool) -> bool;
+
+private:
+  struct Buffer {
+    GLuint binding;
+    GLuint buffer;
+    std::size_t size;
+  };
+
+  struct Texture {
+    GLuint binding;
+    GLuint texture;
+    GLsizei width;
+    GLsizei height;
+  };
+
+  struct QuerySlot {
+    GLuint query{};
+    bool pending{false};
+  };
+
+  auto collect(QuerySlot& slot, bool wait) -> bool;
+
+  GLuint _program;
+  std::vector<Buffer> _buffers{};
+  std::vector<Texture> _textures{};
+  std::array<GLuint, 3> _groupCount{1, 1, 1};
+  std::array<GLint, 3> _localSize{};
+  GLint _timeLocation{};
+  GLint _frameLocation{};
+  std::optional<std::size_t> _shownTexture{};
+  // Has the shown image attached.
+  GLuint _readFramebuffer{};
+  static constexpr std::size_t _ringSize{5};
+  std::vector<QuerySlot> _slots{};
+  std::size_t _current{};
+  std::vector<double> _dispatchTimes{};
+};
+
+#endif // COMPUTE_HXX
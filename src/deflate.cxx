@@ -0,0 +1,816 @@
+#include "deflate.hxx"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace {
+
+constexpr std::size_t windowSize{32768};
+constexpr std::size_t minMatch{3};
+constexpr std::size_t maxMatch{258};
+constexpr int hashBits{15};
+// Candidates tried per position; longer chains barely help filtered images.
+constexpr std::size_t maxChain{16};
+// Symbols per block; each block gets its own Huffman codes.
+constexpr std::size_t blockTokens{1 << 16};
+constexpr std::size_t noPosition{std::numeric_limits<std::size_t>::max()};
+
+constexpr std::array<std::uint16_t, 29> lengthBase{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+  67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+constexpr std::array<std::uint8_t, 29> lengthExtra{
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5,
+  5, 5, 5, 0
+};
+constexpr std::array<std::uint16_t, 30> distanceBase{
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+  769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+constexpr std::array<std::uint8_t, 30> distanceExtra{
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+  11, 11, 12, 12, 13, 13
+};
+// The order in which the lengths of the code length code are stored.
+constexpr std::array<std::uint8_t, 19> codeLengthOrder{
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Maps match lengths and distances to their symbols.
+struct CodeTables {
+  std::array<std::uint8_t, maxMatch + 1> lengthCodes{};
+  // Distances up to 256 directly, then by (distance - 1) >> 7 from 256 on.
+  std::array<std::uint8_t, 512> distanceCodes{};
+
+  CodeTables() {
+    for (std::size_t code{0}; code < lengthBase.size(); ++code) {
+      const std::size_t first{lengthBase[code]};
+      const std::size_t last{std::min(
+        first + (std::size_t{1} << lengthExtra[code]), maxMatch + 1
+      )};
+      for (std::size_t length{first}; length < last; ++length) {
+        lengthCodes[length] = static_cast<std::uint8_t>(code);
+      }
+    }
+    for (std::size_t code{0}; code < distanceBase.size(); ++code) {
+      const std::size_t first{distanceBase[code]};
+      const std::size_t last{first + (std::size_t{1} << distanceExtra[code])};
+      for (std::size_t distance{first}; distance < last; ++distance) {
+        const std::size_t index{
+          distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)
+        };
+        distanceCodes[index] = static_cast<std::uint8_t>(code);
+      }
+    }
+  }
+
+  auto getDistanceCode(std::size_t distance) const -> std::size_t {
+    return distance <= 256
+      ? distanceCodes[distance - 1]
+      : distanceCodes[256 + ((distance - 1) >> 7)];
+  }
+};
+
+const CodeTables codeTables{};
+
+// A literal byte when length is zero, otherwise a match.
+struct Token {
+  std::uint16_t length;
+  std::uint16_t value;
+};
+
+class BitWriter {
+public:
+  explicit BitWriter(std::vector<std::uint8_t>& output) : _output{output} {}
+  BitWriter() = delete;
+  BitWriter(const BitWriter&) = delete;
+  BitWriter(BitWriter&&) = delete;
+  BitWriter operator=(const BitWriter&) = delete;
+  BitWriter operator=(BitWriter&&) = delete;
+
+  auto write(std::uint32_t bits, int count) -> void {
+    _buffer |= static_cast<std::uint64_t>(bits) << _count;
+    _count += count;
+    while (_count >= 8) {
+      _output.push_back(static_cast<std::uint8_t>(_buffer));
+      _buffer >>= 8;
+      _count -= 8;
+    }
+  }
+
+  auto align() -> void {
+    if (_count > 0) {
+      _output.push_back(static_cast<std::uint8_t>(_buffer));
+    }
+    _buffer = 0;
+    _count = 0;
+  }
+
+private:
+  std::vector<std::uint8_t>& _output;
+  std::uint64_t _buffer{};
+  int _count{};
+};
+
+// Deflate codes need at least two symbols to be complete.
+auto useTwoSymbols(std::vector<std::uint32_t>& frequencies) -> void {
+  std::size_t used{static_cast<std::size_t>(std::count_if(
+    frequencies.begin(), frequencies.end(),
+    [](std::uint32_t frequency) { return frequency > 0; }
+  ))};
+  for (std::size_t symbol{0}; used < 2; ++symbol) {
+    if (frequencies[symbol] == 0) {
+      frequencies[symbol] = 1;
+      ++used;
+    }
+  }
+}
+
+// Huffman code lengths of at most limit bits, shortening the deepest codes
+// as zlib and miniz do when the optimal tree is too deep.
+auto buildLengths(
+  const std::vector<std::uint32_t>& frequencies, int limit
+) -> std::vector<std::uint8_t> {
+  std::vector<std::size_t> symbols{};
+  for (std::size_t symbol{0}; symbol < frequencies.size(); ++symbol) {
+    if (frequencies[symbol] > 0) {
+      symbols.push_back(symbol);
+    }
+  }
+  std::sort(
+    symbols.begin(), symbols.end(),
+    [&frequencies](std::size_t a, std::size_t b) {
+      return frequencies[a] < frequencies[b];
+    }
+  );
+  // The two-queue construction: leaves in order, then internal nodes, which
+  // are created in order of weight.
+  const std::size_t leafCount{symbols.size()};
+  std::vector<std::uint64_t> weights(leafCount);
+  for (std::size_t leaf{0}; leaf < leafCount; ++leaf) {
+    weights[leaf] = frequencies[symbols[leaf]];
+  }
+  std::vector<std::size_t> parents(leafCount);
+  std::size_t nextLeaf{0};
+  std::size_t nextInternal{leafCount};
+  const auto takeSmallest{[&]() {
+    if (
+      nextLeaf < leafCount
+      && (nextInternal >= weights.size()
+        || weights[nextLeaf] <= weights[nextInternal])
+    ) {
+      return nextLeaf++;
+    }
+    return nextInternal++;
+  }};
+  for (std::size_t merge{1}; merge < leafCount; ++merge) {
+    const std::size_t a{takeSmallest()};
+    const std::size_t b{takeSmallest()};
+    parents[a] = weights.size();
+    parents[b] = weights.size();
+    weights.push_back(weights[a] + weights[b]);
+    parents.push_back(0);
+  }
+  std::vector<int> depths(weights.size());
+  for (std::size_t node{weights.size() - 1}; node-- > 0;) {
+    depths[node] = depths[parents[node]] + 1;
+  }
+  std::vector<std::size_t> lengthCounts(static_cast<std::size_t>(limit) + 1);
+  for (std::size_t leaf{0}; leaf < leafCount; ++leaf) {
+    ++lengthCounts[static_cast<std::size_t>(std::min(
+      std::max(depths[leaf], 1), limit
+    ))];
+  }
+  std::size_t total{0};
+  for (int length{1}; length <= limit; ++length) {
+    total += lengthCounts[static_cast<std::size_t>(length)] << (limit - length);
+  }
+  const std::size_t full{std::size_t{1} << limit};
+  while (leafCount > 1 && total > full) {
+    --lengthCounts[static_cast<std::size_t>(limit)];
+    for (std::size_t length{static_cast<std::size_t>(limit) - 1}; length > 0;
+      --length) {
+      if (lengthCounts[length] > 0) {
+        --lengthCounts[length];
+        lengthCounts[length + 1] += 2;
+        break;
+      }
+    }
+    --total;
+  }
+  // The most frequent symbols get the shortest codes.
+  std::vector<std::uint8_t> lengths(frequencies.size());
+  std::size_t leaf{leafCount};
+  for (std::size_t length{1}; length < lengthCounts.size(); ++length) {
+    for (std::size_t count{0}; count < lengthCounts[length]; ++count) {
+      lengths[symbols[--leaf]] = static_cast<std::uint8_t>(length);
+    }
+  }
+  return lengths;
+}
+
+// Canonical codes, bit-reversed since deflate writes them from the top bit.
+auto buildCodes(
+  const std::vector<std::uint8_t>& lengths
+) -> std::vector<std::uint16_t> {
+  std::array<std::uint16_t, 16> lengthCounts{};
+  for (const std::uint8_t length : lengths) {
+    ++lengthCounts[length];
+  }
+  lengthCounts[0] = 0;
+  std::array<std::uint16_t, 16> nextCodes{};
+  std::uint16_t code{0};
+  for (std::size_t length{1}; length < nextCodes.size(); ++length) {
+    code = static_cast<std::uint16_t>((code + lengthCounts[length - 1]) << 1);
+    nextCodes[length] = code;
+  }
+  std::vector<std::uint16_t> codes(lengths.size());
+  for (std::size_t symbol{0}; symbol < lengths.size(); ++symbol) {
+    const std::uint8_t length{lengths[symbol]};
+    if (length == 0) {
+      continue;
+    }
+    const std::uint16_t canonical{nextCodes[length]++};
+    std::uint16_t reversed{0};
+    for (std::uint8_t bit{0}; bit < length; ++bit) {
+      reversed = static_cast<std::uint16_t>(
+        (reversed << 1) | ((canonical >> bit) & 1)
+      );
+    }
+    codes[symbol] = reversed;
+  }
+  return codes;
+}
+
+// A symbol of the code length alphabet with its repeat count bits.
+struct LengthSymbol {
+  std::uint8_t symbol;
+  std::uint8_t extra;
+};
+
+// Run-length encodes code lengths with symbols 16 (repeat the previous
+// length), 17 and 18 (runs of zeros).
+auto encodeLengths(
+  const std::vector<std::uint8_t>& lengths
+) -> std::vector<LengthSymbol> {
+  std::vector<LengthSymbol> symbols{};
+  for (std::size_t index{0}; index < lengths.size();) {
+    const std::uint8_t length{lengths[index]};
+    std::size_t run{1};
+    while (index + run < lengths.size() && lengths[index + run] == length) {
+      ++run;
+    }
+    index += run;
+    if (length == 0) {
+      while (run >= 11) {
+        const std::size_t count{std::min<std::size_t>(run, 138)};
+        symbols.push_back({18, static_cast<std::uint8_t>(count - 11)});
+        run -= count;
+      }
+      if (run >= 3) {
+        symbols.push_back({17, static_cast<std::uint8_t>(run - 3)});
+        run = 0;
+      }
+    } else {
+      symbols.push_back({length, 0});
+      --run;
+      while (run >= 3) {
+        const std::size_t count{std::min<std::size_t>(run, 6)};
+        symbols.push_back({16, static_cast<std::uint8_t>(count - 3)});
+        run -= count;
+      }
+    }
+    for (; run > 0; --run) {
+      symbols.push_back({length, 0});
+    }
+  }
+  return symbols;
+}
+
+auto writeBlock(
+  BitWriter& writer, const std::vector<Token>& tokens, bool final
+) -> void {
+  std::vector<std::uint32_t> literalFrequencies(286);
+  std::vector<std::uint32_t> distanceFrequencies(30);
+  for (const Token& token : tokens) {
+    if (token.length == 0) {
+      ++literalFrequencies[token.value];
+    } else {
+      ++literalFrequencies[257 + codeTables.lengthCodes[token.length]];
+      ++distanceFrequencies[codeTables.getDistanceCode(token.value)];
+    }
+  }
+  literalFrequencies[256] = 1;
+  useTwoSymbols(literalFrequencies);
+  useTwoSymbols(distanceFrequencies);
+  const std::vector<std::uint8_t> literalLengths{
+    buildLengths(literalFrequencies, 15)
+  };
+  const std::vector<std::uint8_t> distanceLengths{
+    buildLengths(distanceFrequencies, 15)
+  };
+  std::size_t literalCount{286};
+  while (literalLengths[literalCount - 1] == 0) {
+    --literalCount;
+  }
+  std::size_t distanceCount{30};
+  while (distanceLengths[distanceCount - 1] == 0) {
+    --distanceCount;
+  }
+  std::vector<std::uint8_t> lengths(
+    literalLengths.begin(),
+    literalLengths.begin() + static_cast<std::ptrdiff_t>(literalCount)
+  );
+  lengths.insert(
+    lengths.end(), distanceLengths.begin(),
+    distanceLengths.begin() + static_cast<std::ptrdiff_t>(distanceCount)
+  );
+  const std::vector<LengthSymbol> lengthSymbols{encodeLengths(lengths)};
+  std::vector<std::uint32_t> lengthFrequencies(19);
+  for (const LengthSymbol& symbol : lengthSymbols) {
+    ++lengthFrequencies[symbol.symbol];
+  }
+  useTwoSymbols(lengthFrequencies);
+  const std::vector<std::uint8_t> lengthLengths{
+    buildLengths(lengthFrequencies, 7)
+  };
+  std::size_t lengthCount{19};
+  while (
+    lengthCount > 4 && lengthLengths[codeLengthOrder[lengthCount - 1]] == 0
+  ) {
+    --lengthCount;
+  }
+
+  writer.write(final ? 1 : 0, 1);
+  writer.write(2, 2);
+  writer.write(static_cast<std::uint32_t>(literalCount - 257), 5);
+  writer.write(static_cast<std::uint32_t>(distanceCount - 1), 5);
+  writer.write(static_cast<std::uint32_t>(lengthCount - 4), 4);
+  for (std::size_t index{0}; index < lengthCount; ++index) {
+    writer.write(lengthLengths[codeLengthOrder[index]], 3);
+  }
+  const std::vector<std::uint16_t> lengthCodes{buildCodes(lengthLengths)};
+  for (const LengthSymbol& symbol : lengthSymbols) {
+    writer.write(lengthCodes[symbol.symbol], lengthLengths[symbol.symbol]);
+    if (symbol.symbol == 16) {
+      writer.write(symbol.extra, 2);
+    } else if (symbol.symbol == 17) {
+      writer.write(symbol.extra, 3);
+    } else if (symbol.symbol == 18) {
+      writer.write(symbol.extra, 7);
+    }
+  }
+
+  const std::vector<std::uint16_t> literalCodes{buildCodes(literalLengths)};
+  const std::vector<std::uint16_t> distanceCodes{buildCodes(distanceLengths)};
+  for (const Token& token : tokens) {
+    if (token.length == 0) {
+      writer.write(literalCodes[token.value], literalLengths[token.value]);
+      continue;
+    }
+    const std::size_t lengthCode{codeTables.lengthCodes[token.length]};
+    writer.write(
+      literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]
+    );
+    writer.write(
+      static_cast<std::uint32_t>(token.length - lengthBase[lengthCode]),
+      lengthExtra[lengthCode]
+    );
+    const std::size_t distanceCode{codeTables.getDistanceCode(token.value)};
+    writer.write(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+    writer.write(
+      static_cast<std::uint32_t>(token.value - distanceBase[distanceCode]),
+      distanceExtra[distanceCode]
+    );
+  }
+  writer.write(literalCodes[256], literalLengths[256]);
+}
+
+auto hash(const std::uint8_t* bytes) -> std::size_t {
+  const std::uint32_t value{
+    static_cast<std::uint32_t>(bytes[0])
+    | static_cast<std::uint32_t>(bytes[1]) << 8
+    | static_cast<std::uint32_t>(bytes[2]) << 16
+  };
+  return (value*2654435761u) >> (32 - hashBits);
+}
+
+// Codes of up to this many bits are decoded with one table lookup.
+constexpr int fastBits{10};
+constexpr int maxCodeBits{15};
+
+// Reads bits least significant first, 64 at a time.
+struct BitReader {
+  const std::uint8_t* data;
+  std::size_t size;
+  std::size_t position{};
+  std::uint64_t buffer{};
+  int bits{};
+  // Zero bytes added past the end, which must never be consumed.
+  std::size_t padding{};
+
+  auto refill() -> void {
+    while (bits <= 56) {
+      std::uint64_t byte{0};
+      if (position < size) {
+        byte = data[position++];
+      } else {
+        ++padding;
+      }
+      buffer |= byte << bits;
+      bits += 8;
+    }
+  }
+
+  auto take(int count) -> std::uint32_t {
+    if (bits < count) {
+      refill();
+    }
+    const auto value{static_cast<std::uint32_t>(
+      buffer & ((std::uint64_t{1} << count) - 1)
+    )};
+    buffer >>= count;
+    bits -= count;
+    return value;
+  }
+
+  auto alignToByte() -> void {
+    take(bits%8);
+  }
+
+  auto isOverrun() const -> bool {
+    return padding*8 > static_cast<std::size_t>(bits);
+  }
+};
+
+// A canonical Huffman code, decoded with a table for short codes and a
+// search by length for the others, as in zlib's puff.
+struct HuffmanDecoder {
+  // Symbol << 4 | length, or 0 for codes longer than fastBits.
+  std::array<std::uint16_t, 1 << fastBits> fast{};
+  std::array<std::uint16_t, maxCodeBits + 1> counts{};
+  std::array<std::uint16_t, 288> symbols{};
+
+  // False if the lengths describe more codes than there are; incomplete
+  // codes are allowed, e.g. a single distance code.
+  auto build(const std::uint8_t* lengths, std::size_t count) -> bool {
+    counts.fill(0);
+    for (std::size_t symbol{0}; symbol < count; ++symbol) {
+      ++counts[lengths[symbol]];
+    }
+    counts[0] = 0;
+    int left{1};
+    for (int length{1}; length <= maxCodeBits; ++length) {
+      left = (left << 1) - counts[length];
+      if (left < 0) {
+        return false;
+      }
+    }
+    std::array<std::uint16_t, maxCodeBits + 2> offsets{};
+    std::array<std::uint32_t, maxCodeBits + 1> nextCodes{};
+    for (int length{1}; length <= maxCodeBits; ++length) {
+      offsets[length + 1] = offsets[length] + counts[length];
+      nextCodes[length] = length > 1
+        ? (nextCodes[length - 1] + counts[length - 1]) << 1 : 0;
+    }
+    fast.fill(0);
+    for (std::size_t symbol{0}; symbol < count; ++symbol) {
+      const int length{lengths[symbol]};
+      if (length == 0) {
+        continue;
+      }
+      symbols[offsets[length]++] = static_cast<std::uint16_t>(symbol);
+      const std::uint32_t code{nextCodes[length]++};
+      if (length > fastBits) {
+        continue;
+      }
+      // Codes are stored most significant bit first.
+      std::uint32_t reversed{0};
+      for (int bit{0}; bit < length; ++bit) {
+        reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+      }
+      for (
+        std::uint32_t index{reversed}; index < fast.size();
+        index += 1u << length
+      ) {
+        fast[index] = static_cast<std::uint16_t>(symbol << 4 | length);
+      }
+    }
+    return true;
+  }
+
+  // -1 for invalid codes.
+  auto decode(BitReader& reader) const -> int {
+    if (reader.bits < maxCodeBits) {
+      reader.refill();
+    }
+    const std::uint16_t entry{fast[reader.buffer & (fast.size() - 1)]};
+    if (entry) {
+      reader.take(entry & 15);
+      return entry >> 4;
+    }
+    int code{0};
+    int first{0};
+    int index{0};
+    for (int length{1}; length <= maxCodeBits; ++length) {
+      code |= static_cast<int>((reader.buffer >> (length - 1)) & 1);
+      const int count{counts[length]};
+      if (code - first < count) {
+        reader.take(length);
+        return symbols[index + code - first];
+      }
+      index += count;
+      first = (first + count) << 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+};
+
+struct FixedDecoders {
+  HuffmanDecoder literals{};
+  HuffmanDecoder distances{};
+
+  FixedDecoders() {
+    std::array<std::uint8_t, 288> literalLengths{};
+    std::fill(literalLengths.begin(), literalLengths.begin() + 144, 8);
+    std::fill(literalLengths.begin() + 144, literalLengths.begin() + 256, 9);
+    std::fill(literalLengths.begin() + 256, literalLengths.begin() + 280, 7);
+    std::fill(literalLengths.begin() + 280, literalLengths.end(), 8);
+    literals.build(literalLengths.data(), literalLengths.size());
+    std::array<std::uint8_t, 30> distanceLengths{};
+    distanceLengths.fill(5);
+    distances.build(distanceLengths.data(), distanceLengths.size());
+  }
+};
+
+auto readDynamicDecoders(
+  BitReader& reader, HuffmanDecoder& literals, HuffmanDecoder& distances
+) -> bool {
+  const std::size_t literalCount{reader.take(5) + 257u};
+  const std::size_t distanceCount{reader.take(5) + 1u};
+  const std::size_t codeLengthCount{reader.take(4) + 4u};
+  if (literalCount > 286 || distanceCount > 30) {
+    return false;
+  }
+  std::array<std::uint8_t, 19> codeLengthLengths{};
+  for (std::size_t index{0}; index < codeLengthCount; ++index) {
+    codeLengthLengths[codeLengthOrder[index]]
+      = static_cast<std::uint8_t>(reader.take(3));
+  }
+  HuffmanDecoder codeLengths{};
+  if (!codeLengths.build(codeLengthLengths.data(), codeLengthLengths.size())) {
+    return false;
+  }
+  std::array<std::uint8_t, 286 + 30> lengths{};
+  std::size_t index{0};
+  while (index < literalCount + distanceCount) {
+    const int symbol{codeLengths.decode(reader)};
+    if (symbol < 0) {
+      return false;
+    }
+    if (symbol < 16) {
+      lengths[index++] = static_cast<std::uint8_t>(symbol);
+      continue;
+    }
+    std::uint8_t value{0};
+    std::size_t repeat{};
+    if (symbol == 16) {
+      if (index == 0) {
+        return false;
+      }
+      value = lengths[index - 1];
+      repeat = 3 + reader.take(2);
+    } else if (symbol == 17) {
+      repeat = 3 + reader.take(3);
+    } else {
+      repeat = 11 + reader.take(7);
+    }
+    if (index + repeat > literalCount + distanceCount) {
+      return false;
+    }
+    std::fill_n(lengths.begin() + index, repeat, value);
+    index += repeat;
+  }
+  // A block without an end code could never end.
+  return lengths[256] > 0
+    && literals.build(lengths.data(), literalCount)
+    && distances.build(lengths.data() + literalCount, distanceCount);
+}
+
+auto inflateBlock(
+  BitReader& reader, const HuffmanDecoder& literals,
+  const HuffmanDecoder& distances, std::vector<std::uint8_t>& output
+) -> bool {
+  while (true) {
+    const int symbol{literals.decode(reader)};
+    if (symbol < 0) {
+      return false;
+    }
+    if (symbol < 256) {
+      output.push_back(static_cast<std::uint8_t>(symbol));
+      continue;
+    }
+    if (symbol == 256) {
+      return true;
+    }
+    const std::size_t lengthCode{static_cast<std::size_t>(symbol) - 257};
+    if (lengthCode >= lengthBase.size()) {
+      return false;
+    }
+    const std::size_t length{
+      lengthBase[lengthCode] + reader.take(lengthExtra[lengthCode])
+    };
+    const int distanceCode{distances.decode(reader)};
+    if (distanceCode < 0 || distanceCode >= 30) {
+      return false;
+    }
+    const std::size_t distance{
+      distanceBase[distanceCode] + reader.take(distanceExtra[distanceCode])
+    };
+    if (distance > output.size()) {
+      return false;
+    }
+    // Copied byte by byte, since a match may overlap itself.
+    const std::size_t start{output.size()};
+    output.resize(start + length);
+    for (std::size_t index{0}; index < length; ++index) {
+      output[start + index] = output[start - distance + index];
+    }
+  }
+}
+
+constexpr std::uint32_t adlerBase{65521};
+// The most bytes that can be summed before the sums overflow 32 bits.
+constexpr std::size_t adlerChunk{5552};
+
+} // namespace
+
+auto deflateSegment(
+  const std::uint8_t* data, std::size_t begin, std::size_t end, bool last,
+  std::vector<std::uint8_t>& output
+) -> void {
+  // Chains of earlier positions with the same hash, newest first.
+  std::vector<std::size_t> heads(std::size_t{1} << hashBits, noPosition);
+  std::vector<std::size_t> previous(windowSize, noPosition);
+  const auto insert{[&](std::size_t position) {
+    if (position + minMatch <= end) {
+      const std::size_t key{hash(data + position)};
+      previous[position & (windowSize - 1)] = heads[key];
+      heads[key] = position;
+    }
+  }};
+  for (
+    std::size_t position{begin > windowSize ? begin - windowSize : 0};
+    position < begin; ++position
+  ) {
+    insert(position);
+  }
+
+  BitWriter writer{output};
+  std::vector<Token> tokens{};
+  tokens.reserve(std::min(blockTokens, end - begin + 1));
+  for (std::size_t position{begin}; position < end;) {
+    std::size_t bestLength{0};
+    std::size_t bestDistance{0};
+    if (position + minMatch <= end) {
+      const std::size_t limit{std::min(maxMatch, end - position)};
+      std::size_t candidate{heads[hash(data + position)]};
+      for (
+        std::size_t chain{0};
+        chain < maxChain && candidate != noPosition
+          && position - candidate <= windowSize;
+        ++chain
+      ) {
+        if (data[candidate + bestLength] == data[position + bestLength]) {
+          std::size_t length{0};
+          while (
+            length < limit
+            && data[candidate + length] == data[position + length]
+          ) {
+            ++length;
+          }
+          if (length > bestLength) {
+            bestLength = length;
+            bestDistance = position - candidate;
+            if (length == limit) {
+              break;
+            }
+          }
+        }
+        const std::size_t next{previous[candidate & (windowSize - 1)]};
+        // Older links may have been overwritten by newer positions.
+        if (next == noPosition || next >= candidate) {
+          break;
+        }
+        candidate = next;
+      }
+    }
+    if (bestLength >= minMatch) {
+      tokens.push_back({
+        static_cast<std::uint16_t>(bestLength),
+        static_cast<std::uint16_t>(bestDistance)
+      });
+      for (std::size_t offset{0}; offset < bestLength; ++offset) {
+        insert(position + offset);
+      }
+      position += bestLength;
+    } else {
+      tokens.push_back({0, data[position]});
+      insert(position);
+      ++position;
+    }
+    if (tokens.size() == blockTokens && position < end) {
+      writeBlock(writer, tokens, false);
+      tokens.clear();
+    }
+  }
+  writeBlock(writer, tokens, last);
+  if (!last) {
+    // An empty stored block, as zlib's Z_SYNC_FLUSH writes.
+    writer.write(0, 3);
+    writer.align();
+    output.insert(output.end(), {0x00, 0x00, 0xff, 0xff});
+  }
+  writer.align();
+}
+
+auto adler32(
+  const std::uint8_t* data, std::size_t size, std::uint32_t adler
+) -> std::uint32_t {
+  std::uint32_t a{adler & 0xffff};
+  std::uint32_t b{adler >> 16};
+  while (size > 0) {
+    const std::size_t count{std::min(size, adlerChunk)};
+    for (std::size_t index{0}; index < count; ++index) {
+      a += data[index];
+      b += a;
+    }
+    a %= adlerBase;
+    b %= adlerBase;
+    data += count;
+    size -= count;
+  }
+  return a | (b << 16);
+}
+
+auto combineAdler32(
+  std::uint32_t first, std::uint32_t second, std::size_t secondSize
+) -> std::uint32_t {
+  // As zlib's adler32_combine().
+  const auto remainder{static_cast<std::uint32_t>(secondSize % adlerBase)};
+  std::uint32_t a{first & 0xffff};
+  std::uint32_t b{static_cast<std::uint32_t>(
+    static_cast<std::uint64_t>(remainder)*a % adlerBase
+  )};
+  a += (second & 0xffff) + adlerBase - 1;
+  b += (first >> 16) + (second >> 16) + adlerBase - remainder;
+  if (a >= adlerBase) {
+    a -= adlerBase;
+  }
+  if (a >= adlerBase) {
+    a -= adlerBase;
+  }
+  if (b >= adlerBase << 1) {
+    b -= adlerBase << 1;
+  }
+  if (b >= adlerBase) {
+    b -= adlerBase;
+  }
+  return a | (b << 16);
+}
+
+auto inflate(
+  const std::uint8_t* data, std::size_t size,
+  std::vector<std::uint8_t>& output
+) -> bool {
+  static const FixedDecoders fixed{};
+  BitReader reader{data, size};
+  HuffmanDecoder literals{};
+  HuffmanDecoder distances{};
+  bool last{false};
+  while (!last) {
+    last = reader.take(1);
+    const std::uint32_t type{reader.take(2)};
+    bool valid{false};
+    if (type == 0) {
+      reader.alignToByte();
+      const std::uint32_t length{reader.take(16)};
+      const std::uint32_t complement{reader.take(16)};
+      valid = length == (~complement & 0xffff);
+      for (std::uint32_t index{0}; valid && index < length; ++index) {
+        output.push_back(static_cast<std::uint8_t>(reader.take(8)));
+      }
+    } else if (type == 1) {
+      valid = inflateBlock(reader, fixed.literals, fixed.distances, output);
+    } else if (type == 2) {
+      valid = readDynamicDecoders(reader, literals, distances)
+        && inflateBlock(reader, literals, distances, output);
+    }
+    if (!valid || reader.isOverrun()) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,36 @@
+#ifndef DEFLATE_HXX
+#define DEFLATE_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Compresses data[begin, end) as raw DEFLATE blocks with dynamic Huffman
+ * codes and appends them to output. Matches may reach back into the 32 KiB
+ * before begin, so consecutive segments compressed independently (and in
+ * parallel) concatenate into one stream, as in pigz. Every segment but the
+ * last ends with an empty stored block to realign to a byte boundary.
+ */
+auto deflateSegment(
+  const std::uint8_t* data, std::size_t begin, std::size_t end, bool last,
+  std::vector<std::uint8_t>& output
+) -> void;
+
+// Decompresses a raw DEFLATE stream up to its last block and appends the
+// result to output; false if the stream is invalid or truncated.
+auto inflate(
+  const std::uint8_t* data, std::size_t size,
+  std::vector<std::uint8_t>& output
+) -> bool;
+
+auto adler32(
+  const std::uint8_t* data, std::size_t size, std::uint32_t adler = 1
+) -> std::uint32_t;
+// The checksum of the concatenation, given that of each part and the size
+// of the second.
+auto combineAdler32(
+  std::uint32_t first, std::uint32_t second, std::size_t secondSize
+) -> std::uint32_t;
+
+#endif // DEFLATE_HXX
@@ -0,0 +1,73 @@
+#include "framebuffer.hxx"
+
+#include <stdexcept>
+
+Framebuffer::Framebuffer(
+  GLsizei width, GLsizei height, GLenum format
+) : _width{width}, _height{height}, _format{format} {
+  create();
+}
+
+Framebuffer::~Framebuffer() {
+  destroy();
+}
+
+auto Framebuffer::getFramebuffer() const -> GLuint {
+  return _framebuffer;
+}
+
+auto Framebuffer::getTexture() const -> GLuint {
+  return _texture;
+}
+
+auto Framebuffer::getWidth() const -> GLsizei {
+  return _width;
+}
+
+auto Framebuffer::getHeight() const -> GLsizei {
+  return _height;
+}
+
+auto Framebuffer::getFormat() const -> GLenum {
+  return _format;
+}
+
+auto Framebuffer::resize(GLsizei width, GLsizei height) -> void {
+  if (width == _width && height == _height) {
+    return;
+  }
+  destroy();
+  _width = width;
+  _height = height;
+  create();
+}
+
+auto Framebuffer::create() -> void {
+  glGenTextures(1, &_texture);
+  glBindTexture(GL_TEXTURE_2D, _texture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, _format, _width, _height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+  glFramebufferTexture2D(
+    GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _texture, 0
+  );
+  const GLenum status{glCheckFramebufferStatus(GL_FRAMEBUFFER)};
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    destroy();
+    throw std::runtime_error{"Failed to create offscreen framebuffer"};
+  }
+}
+
+auto Framebuffer::destroy() -> void {
+  glDeleteFramebuffers(1, &_framebuffer);
+  glDeleteTextures(1, &_texture);
+  _framebuffer = 0;
+  _texture = 0;
+}
@@ -0,0 +1,34 @@
+#ifndef FRAMEBUFFER_HXX
+#define FRAMEBUFFER_HXX
+
+#include <glad/gl.h>
+
+class Framebuffer {
+public:
+  Framebuffer(GLsizei width, GLsizei height, GLenum format = GL_RGBA8);
+  Framebuffer() = delete;
+  Framebuffer(const Framebuffer&) = delete;
+  Framebuffer(Framebuffer&&) = delete;
+  Framebuffer operator=(const Framebuffer&) = delete;
+  Framebuffer operator=(Framebuffer&&) = delete;
+  ~Framebuffer();
+
+  auto getFramebuffer() const -> GLuint;
+  auto getTexture() const -> GLuint;
+  auto getWidth() const -> GLsizei;
+  auto getHeight() const -> GLsizei;
+  auto getFormat() const -> GLenum;
+  auto resize(GLsizei width, GLsizei height) -> void;
+
+private:
+  auto create() -> void;
+  auto destroy() -> void;
+
+  GLuint _framebuffer{};
+  GLuint _texture{};
+  GLsizei _width;
+  GLsizei _height;
+  const GLenum _format;
+};
+
+#endif // FRAMEBUFFER_HXX
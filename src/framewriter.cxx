@@ -0,0 +1,324 @@
+#include "framewriter.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "debug.hxx"
+#include "png.hxx"
+#include "trace.hxx"
+
+namespace {
+
+// Chroma rows per Y4M conversion task.
+constexpr std::size_t y4mBandRows{16};
+
+// BT.601 with 16-235 luma, in 8-bit fixed point.
+auto toLuma(int r, int g, int b) -> std::uint8_t {
+  return static_cast<std::uint8_t>(((66*r + 129*g + 25*b + 128) >> 8) + 16);
+}
+
+auto toBlueDifference(int r, int g, int b) -> std::uint8_t {
+  return static_cast<std::uint8_t>(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+}
+
+auto toRedDifference(int r, int g, int b) -> std::uint8_t {
+  return static_cast<std::uint8_t>(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+}
+
+} // namespace
+
+auto formatFramePath(
+  const std::string& pattern, std::uint64_t number
+) -> std::string {
+  std::ostringstream path{};
+  const std::size_t last{pattern.find_last_of('#')};
+  if (last == std::string::npos) {
+    const std::filesystem::path base{pattern};
+    path << (base.parent_path()/base.stem()).string() << '-'
+      << std::setw(5) << std::setfill('0') << number
+      << base.extension().string();
+    return path.str();
+  }
+  std::size_t first{last};
+  while (first > 0 && pattern[first - 1] == '#') {
+    --first;
+  }
+  path << pattern.substr(0, first)
+    << std::setw(static_cast<int>(last + 1 - first)) << std::setfill('0')
+    << number << pattern.substr(last + 1);
+  return path.str();
+}
+
+auto guessCaptureFormat(const std::string& path) -> CaptureFormat {
+  const std::string extension{std::filesystem::path{path}.extension().string()};
+  if (path == "-" || extension == ".y4m") {
+    return CaptureFormat::Y4M;
+  }
+  if (extension == ".rgba" || extension == ".raw") {
+    return CaptureFormat::Raw;
+  }
+  return CaptureFormat::PNG;
+}
+
+FrameWriter::FrameWriter(const CaptureSettings& settings) :
+  _settings{settings}, _pool{settings.threadCount} {
+  if (_settings.format == CaptureFormat::PNG) {
+    const std::filesystem::path directory{
+      std::filesystem::path{_settings.path}.parent_path()
+    };
+    std::error_code error{};
+    if (!directory.empty()) {
+      std::filesystem::create_directories(directory, error);
+    }
+  } else if (_settings.path == "-") {
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    _stream = stdout;
+  } else {
+    _stream = std::fopen(_settings.path.c_str(), "wb");
+    if (!_stream) {
+      throw std::runtime_error{"Failed to open " + _settings.path};
+    }
+  }
+  _thread = std::thread{&FrameWriter::run, this};
+}
+
+FrameWriter::~FrameWriter() {
+  finish();
+}
+
+auto FrameWriter::takeBuffer(std::size_t size) -> std::vector<std::uint8_t> {
+  std::vector<std::uint8_t> buffer{};
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    if (!_buffers.empty()) {
+      buffer = std::move(_buffers.back());
+      _buffers.pop_back();
+    }
+  }
+  buffer.resize(size);
+  return buffer;
+}
+
+auto FrameWriter::push(CapturedFrame frame) -> bool {
+  std::unique_lock<std::mutex> lock{_mutex};
+  if (_queue.size() >= _settings.queueDepth) {
+    if (_settings.dropFrames) {
+      ++_statistics.dropped;
+      lock.unlock();
+      recycle(std::move(frame.image.pixels));
+      return false;
+    }
+    ++_statistics.stalls;
+    _space.wait(lock, [this]() {
+      return _queue.size() < _settings.queueDepth;
+    });
+  }
+  _queue.push_back(std::move(frame));
+  _statistics.maxQueueDepth = std::max(
+    _statistics.maxQueueDepth, _queue.size()
+  );
+  _depthSum += static_cast<double>(_queue.size());
+  ++_statistics.frames;
+  lock.unlock();
+  _queued.notify_one();
+  return true;
+}
+
+auto FrameWriter::finish() -> void {
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _finishing = true;
+  }
+  _queued.notify_one();
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+  if (_stream && _stream != stdout) {
+    std::fclose(_stream);
+  } else if (_stream) {
+    std::fflush(_stream);
+  }
+  _stream = nullptr;
+}
+
+auto FrameWriter::getStatistics() const -> CaptureStatistics {
+  std::lock_guard<std::mutex> lock{_mutex};
+  CaptureStatistics statistics{_statistics};
+  if (statistics.frames > 0) {
+    statistics.meanQueueDepth
+      = _depthSum/static_cast<double>(statistics.frames);
+  }
+  return statistics;
+}
+
+auto FrameWriter::run() -> void {
+  setTraceThreadName("capture writer");
+  while (true) {
+    std::unique_lock<std::mutex> lock{_mutex};
+    _queued.wait(lock, [this]() { return !_queue.empty() || _finishing; });
+    if (_queue.empty()) {
+      return;
+    }
+    CapturedFrame frame{std::move(_queue.front())};
+    _queue.pop_front();
+    lock.unlock();
+    _space.notify_one();
+    const bool written{!_failed && write(frame)};
+    lock.lock();
+    if (written) {
+      ++_statistics.written;
+    } else {
+      ++_statistics.dropped;
+    }
+    lock.unlock();
+    recycle(std::move(frame.image.pixels));
+  }
+}
+
+auto FrameWriter::recycle(std::vector<std::uint8_t> buffer) -> void {
+  std::lock_guard<std::mutex> lock{_mutex};
+  // Enough for a full queue, plus the frames being written and mapped.
+  if (_buffers.size() < _settings.queueDepth + 2) {
+    _buffers.push_back(std::move(buffer));
+  }
+}
+
+auto FrameWriter::write(const CapturedFrame& frame) -> bool {
+  TRACE_SPAN("capture", "write frame");
+  if (_settings.format == CaptureFormat::PNG) {
+    return writePNG(frame);
+  }
+  if (_streamWidth == 0) {
+    _streamWidth = frame.image.width;
+    _streamHeight = frame.image.height;
+    if (_settings.format == CaptureFormat::Y4M) {
+      std::ostringstream header{};
+      // Rates like 29.97 become NTSC-style ratios (30000:1001).
+      const bool whole{std::round(_settings.fps) == _settings.fps};
+      const auto rate{static_cast<long long>(
+        std::round(_settings.fps*(whole ? 1. : 1001.))
+      )};
+      header << "YUV4MPEG2 W" << _streamWidth << " H" << _streamHeight
+        << " F" << rate << ':' << (whole ? 1 : 1001)
+        << " Ip A1:1 C420jpeg\n";
+      const std::string text{header.str()};
+      if (std::fwrite(text.data(), 1, text.size(), _stream) != text.size()) {
+        _failed = true;
+        std::cerr << "Failed to write " << _settings.path << '\n';
+        return false;
+      }
+    }
+  } else if (
+    frame.image.width != _streamWidth || frame.image.height != _streamHeight
+  ) {
+    // Streams cannot change size; the frames are dropped until it is back.
+    LOG_ERROR("Dropped capture frame " << frame.number << " of size "
+      << frame.image.width << 'x' << frame.image.height << '\n');
+    return false;
+  }
+  const bool written{
+    _settings.format == CaptureFormat::Raw
+      ? writeRaw(frame.image) : writeY4M(frame.image)
+  };
+  if (!written) {
+    _failed = true;
+    std::cerr << "Failed to write " << _settings.path << '\n';
+  }
+  return written;
+}
+
+auto FrameWriter::writePNG(const CapturedFrame& frame) -> bool {
+  const std::vector<std::uint8_t> file{encodePNG(frame.image, _pool)};
+  const std::string path{formatFramePath(_settings.path, frame.number)};
+  std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+  stream.write(
+    reinterpret_cast<const char*>(file.data()),
+    static_cast<std::streamsize>(file.size())
+  );
+  if (!stream) {
+    _failed = true;
+    std::cerr << "Failed to write " << path << '\n';
+    return false;
+  }
+  return true;
+}
+
+auto FrameWriter::writeRaw(const Image& image) -> bool {
+  const auto width{static_cast<std::size_t>(image.width)};
+  const auto height{static_cast<std::size_t>(image.height)};
+  const std::size_t rowBytes{width*4};
+  for (std::size_t y{height}; y-- > 0;) {
+    if (std::fwrite(
+      image.pixels.data() + y*rowBytes, 1, rowBytes, _stream
+    ) != rowBytes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto FrameWriter::writeY4M(const Image& image) -> bool {
+  const auto width{static_cast<std::size_t>(image.width)};
+  const auto height{static_cast<std::size_t>(image.height)};
+  const std::size_t chromaWidth{(width + 1)/2};
+  const std::size_t chromaHeight{(height + 1)/2};
+  constexpr char frameHeader[]{"FRAME\n"};
+  const std::size_t headerSize{sizeof(frameHeader) - 1};
+  const std::size_t lumaSize{width*height};
+  const std::size_t chromaSize{chromaWidth*chromaHeight};
+  _encoded.resize(headerSize + lumaSize + 2*chromaSize);
+  std::copy(frameHeader, frameHeader + headerSize, _encoded.begin());
+  std::uint8_t* const luma{_encoded.data() + headerSize};
+  std::uint8_t* const blue{luma + lumaSize};
+  std::uint8_t* const red{blue + chromaSize};
+  // Image rows are stored bottom first, Y4M rows top first.
+  const auto getPixel{[&image, width, height](std::size_t x, std::size_t y) {
+    return image.pixels.data() + ((height - 1 - y)*width + x)*4;
+  }};
+  const std::size_t bandCount{(chromaHeight + y4mBandRows - 1)/y4mBandRows};
+  _pool.run(bandCount, [&](std::size_t band, std::size_t) {
+    const std::size_t lastRow{std::min((band + 1)*y4mBandRows, chromaHeight)};
+    for (std::size_t cy{band*y4mBandRows}; cy < lastRow; ++cy) {
+      for (std::size_t y{cy*2}; y < std::min(cy*2 + 2, height); ++y) {
+        for (std::size_t x{0}; x < width; ++x) {
+          const std::uint8_t* pixel{getPixel(x, y)};
+          luma[y*width + x] = toLuma(pixel[0], pixel[1], pixel[2]);
+        }
+      }
+      // Each chroma sample averages the pixels of a 2x2 block.
+      for (std::size_t cx{0}; cx < chromaWidth; ++cx) {
+        int sums[3]{};
+        int count{0};
+        for (std::size_t y{cy*2}; y < std::min(cy*2 + 2, height); ++y) {
+          for (std::size_t x{cx*2}; x < std::min(cx*2 + 2, width); ++x) {
+            const std::uint8_t* pixel{getPixel(x, y)};
+            sums[0] += pixel[0];
+            sums[1] += pixel[1];
+            sums[2] += pixel[2];
+            ++count;
+          }
+        }
+        const int r{(sums[0] + count/2)/count};
+        const int g{(sums[1] + count/2)/count};
+        const int b{(sums[2] + count/2)/count};
+        blue[cy*chromaWidth + cx] = toBlueDifference(r, g, b);
+        red[cy*chromaWidth + cx] = toRedDifference(r, g, b);
+      }
+    }
+  });
+  return std::fwrite(_encoded.data(), 1, _encoded.size(), _stream)
+    == _encoded.size();
+}
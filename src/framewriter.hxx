@@ -0,0 +1,119 @@
+#ifndef FRAMEWRITER_HXX
+#define FRAMEWRITER_HXX
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image.hxx"
+#include "threadpool.hxx"
+
+enum class CaptureFormat {
+  // One file per frame.
+  PNG,
+  // RGBA8 frames, top row first, back to back.
+  Raw,
+  // YUV4MPEG2 with 4:2:0 BT.601 frames, as video encoders read it.
+  Y4M
+};
+
+struct CaptureSettings {
+  // "-" writes raw and Y4M frames to stdout. In PNG paths, the last run of
+  // '#' becomes the zero-padded frame number ("-#####" is added before the
+  // extension without one).
+  std::string path;
+  CaptureFormat format;
+  // Only stored in Y4M headers.
+  double fps;
+  // The number of the first frame, e.g. the start of a frame range.
+  std::uint64_t firstNumber;
+  // The most frames waiting for the writer; further frames wait for space,
+  // or are dropped with dropFrames.
+  std::size_t queueDepth;
+  bool dropFrames;
+  std::size_t threadCount;
+};
+
+struct CaptureStatistics {
+  // Frames rendered while capturing, including dropped ones.
+  std::uint64_t frames{};
+  std::uint64_t written{};
+  std::uint64_t dropped{};
+  // Times the render thread waited for the writer or for a readback.
+  std::uint64_t stalls{};
+  std::size_t maxQueueDepth{};
+  // Sampled whenever a frame is queued.
+  double meanQueueDepth{};
+};
+
+// ".y4m" and stdout are Y4M, ".rgba" and ".raw" raw, anything else PNG.
+auto guessCaptureFormat(const std::string& path) -> CaptureFormat;
+// The path of a numbered frame, as CaptureSettings::path describes.
+auto formatFramePath(
+  const std::string& pattern, std::uint64_t number
+) -> std::string;
+
+struct CapturedFrame {
+  std::uint64_t number;
+  Image image;
+};
+
+/**
+ * Encodes and writes captured frames on a thread of its own, in order. The
+ * queue is bounded, so a slow disk or encoder holds up the render thread
+ * (or drops frames) instead of piling frames up in memory. Rows of PNG and
+ * Y4M frames are encoded in parallel on a thread pool.
+ */
+class FrameWriter {
+public:
+  // Throws if the output stream cannot be opened.
+  explicit FrameWriter(const CaptureSettings& settings);
+  FrameWriter() = delete;
+  FrameWriter(const FrameWriter&) = delete;
+  FrameWriter(FrameWriter&&) = delete;
+  FrameWriter operator=(const FrameWriter&) = delete;
+  FrameWriter operator=(FrameWriter&&) = delete;
+  ~FrameWriter();
+
+  // A pixel buffer of the given size, reusing those of written frames.
+  auto takeBuffer(std::size_t size) -> std::vector<std::uint8_t>;
+  // Returns false if the frame was dropped.
+  auto push(CapturedFrame frame) -> bool;
+  // Writes every queued frame and stops the thread.
+  auto finish() -> void;
+  auto getStatistics() const -> CaptureStatistics;
+
+private:
+  auto run() -> void;
+  auto write(const CapturedFrame& frame) -> bool;
+  auto writePNG(const CapturedFrame& frame) -> bool;
+  auto writeRaw(const Image& image) -> bool;
+  auto writeY4M(const Image& image) -> bool;
+  auto recycle(std::vector<std::uint8_t> buffer) -> void;
+
+  const CaptureSettings _settings;
+  ThreadPool _pool;
+  std::FILE* _stream{};
+  // The size of every frame of a stream, set by the first one.
+  int _streamWidth{};
+  int _streamHeight{};
+  bool _failed{false};
+  std::vector<std::uint8_t> _encoded{};
+  mutable std::mutex _mutex{};
+  std::condition_variable _queued{};
+  std::condition_variable _space{};
+  std::deque<CapturedFrame> _queue{};
+  std::vector<std::vector<std::uint8_t>> _buffers{};
+  CaptureStatistics _statistics{};
+  double _depthSum{};
+  bool _finishing{false};
+  std::thread _thread{};
+};
+
+#endif // FRAMEWRITER_HXX
@@ -1,11 +1,20 @@
 #include "geometry.hxx"
 
+auto VertexLayout::getStride() const -> std::size_t {
+  return 3 + (normals ? 3 : 0) + (texCoords ? 2 : 0);
+}
+
 auto Geometry::createGeometryFromType(GeometryType type) -> std::unique_ptr<Geometry> {
   if (type == GeometryType::Rectangle) {
     return std::make_unique<Rectangle>();
-  } else /* if (type == GeometryType::Triangle) */ {
+  } else if (type == GeometryType::Triangle) {
     return std::make_unique<Triangle>();
   }
+  return {};
+}
+
+auto Geometry::getLayout() const -> VertexLayout {
+  return {};
 }
 
 Geometry::~Geometry() {}
@@ -14,15 +23,15 @@ auto Triangle::getVertices() const -> const float* {
   return _vertices.data();
 }
 
-auto Triangle::getIndices() const -> const unsigned short* {
+auto Triangle::getIndices() const -> const std::uint32_t* {
   return _indices.data();
 }
 
-auto Triangle::getVertexCount() const -> int {
-  return _vertices.size();
+auto Triangle::getVertexCount() const -> std::size_t {
+  return _vertices.size()/3;
 }
 
-auto Triangle::getIndexCount() const -> int {
+auto Triangle::getIndexCount() const -> std::size_t {
   return _indices.size();
 }
 
@@ -32,7 +41,7 @@ const std::array<float, 3*3> Triangle::_vertices{
   0., 1., 0.
 };
 
-const std::array<unsigned short, 1*3> Triangle::_indices{
+const std::array<std::uint32_t, 1*3> Triangle::_indices{
   0, 1, 2
 };
 
@@ -40,15 +49,15 @@ auto Rectangle::getVertices() const -> const float* {
   return _vertices.data();
 }
 
-auto Rectangle::getIndices() const -> const unsigned short* {
+auto Rectangle::getIndices() const -> const std::uint32_t* {
   return _indices.data();
 }
 
-auto Rectangle::getVertexCount() const -> int {
-  return _vertices.size();
+auto Rectangle::getVertexCount() const -> std::size_t {
+  return _vertices.size()/3;
 }
 
-auto Rectangle::getIndexCount() const -> int {
+auto Rectangle::getIndexCount() const -> std::size_t {
   return _indices.size();
 }
 
@@ -59,7 +68,33 @@ const std::array<float, 4*3> Rectangle::_vertices{
   -1., 1., 0.
 };
 
-const std::array<unsigned short, 2*3> Rectangle::_indices{
+const std::array<std::uint32_t, 2*3> Rectangle::_indices{
   0, 1, 2,
   0, 2, 3
 };
+
+Mesh::Mesh(
+  std::vector<float> vertices, std::vector<std::uint32_t> indices,
+  VertexLayout layout
+) : _vertices{std::move(vertices)}, _indices{std::move(indices)},
+    _layout{layout} {}
+
+auto Mesh::getVertices() const -> const float* {
+  return _vertices.data();
+}
+
+auto Mesh::getIndices() const -> const std::uint32_t* {
+  return _indices.data();
+}
+
+auto Mesh::getVertexCount() const -> std::size_t {
+  return _vertices.size()/_layout.getStride();
+}
+
+auto Mesh::getIndexCount() const -> std::size_t {
+  return _indices.size();
+}
+
+auto Mesh::getLayout() const -> VertexLayout {
+  return _layout;
+}
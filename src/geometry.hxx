@@ -2,45 +2,102 @@
 #define MODELS_HXX
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 enum class GeometryType {
   Rectangle,
-  Triangle
+  Triangle,
+  // Loaded from the file given with --mesh.
+  Mesh,
+  // Generated with --subdivisions grid cells along each side (of each face).
+  Plane,
+  Sphere,
+  Cube
+};
+
+// Vertices are interleaved: a position, then a normal and a texture
+// coordinate when the geometry has them.
+struct VertexLayout {
+  bool normals{false};
+  bool texCoords{false};
+
+  // In floats.
+  auto getStride() const -> std::size_t;
+};
+
+// What the engine needs to create geometry beyond its type.
+struct GeometrySettings {
+  std::optional<std::string> meshPath{};
+  int subdivisions{64};
+  // For generating procedural geometry; 0 means one per hardware thread.
+  std::size_t threadCount{0};
 };
 
 class Geometry {
 public:
+  // Only for the built-in shapes; meshes come from loadMesh() (mesh.hxx)
+  // and procedural geometry from createProceduralGeometry()
+  // (procedural.hxx).
   static auto createGeometryFromType(GeometryType type) -> std::unique_ptr<Geometry>;
   virtual auto getVertices() const -> const float* = 0;
-  virtual auto getIndices() const -> const unsigned short* = 0;
-  virtual auto getVertexCount() const -> int = 0;
-  virtual auto getIndexCount() const -> int = 0;
+  virtual auto getIndices() const -> const std::uint32_t* = 0;
+  virtual auto getVertexCount() const -> std::size_t = 0;
+  virtual auto getIndexCount() const -> std::size_t = 0;
+  virtual auto getLayout() const -> VertexLayout;
   virtual ~Geometry();
 };
 
 class Triangle : public Geometry {
 public:
   auto getVertices() const -> const float* final;
-  auto getIndices() const -> const unsigned short* final;
-  auto getVertexCount() const -> int final;
-  auto getIndexCount() const -> int final;
+  auto getIndices() const -> const std::uint32_t* final;
+  auto getVertexCount() const -> std::size_t final;
+  auto getIndexCount() const -> std::size_t final;
 
 private:
   static const std::array<float, 3*3> _vertices;
-  static const std::array<unsigned short, 1*3> _indices;
+  static const std::array<std::uint32_t, 1*3> _indices;
 };
 
 class Rectangle : public Geometry {
 public:
   auto getVertices() const -> const float* final;
-  auto getIndices() const -> const unsigned short* final;
-  auto getVertexCount() const -> int final;
-  auto getIndexCount() const -> int final;
+  auto getIndices() const -> const std::uint32_t* final;
+  auto getVertexCount() const -> std::size_t final;
+  auto getIndexCount() const -> std::size_t final;
 
 private:
   static const std::array<float, 4*3> _vertices;
-  static const std::array<unsigned short, 2*3> _indices;
+  static const std::array<std::uint32_t, 2*3> _indices;
+};
+
+class Mesh : public Geometry {
+public:
+  Mesh(
+    std::vector<float> vertices, std::vector<std::uint32_t> indices,
+    VertexLayout layout
+  );
+  Mesh() = delete;
+  Mesh(const Mesh&) = delete;
+  Mesh(Mesh&&) = delete;
+  Mesh operator=(const Mesh&) = delete;
+  Mesh operator=(Mesh&&) = delete;
+
+  auto getVertices() const -> const float* final;
+  auto getIndices() const -> const std::uint32_t* final;
+  auto getVertexCount() const -> std::size_t final;
+  auto getIndexCount() const -> std::size_t final;
+  auto getLayout() const -> VertexLayout final;
+
+private:
+  std::vector<float> _vertices;
+  std::vector<std::uint32_t> _indices;
+  VertexLayout _layout;
 };
 
 #endif // MODELS_HXX
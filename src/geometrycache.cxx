@@ -0,0 +1,145 @@
+#include "geometrycache.hxx"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "debug.hxx"
+
+GeometryCache::~GeometryCache() {
+  for (auto& [key, entry] : _entries) {
+    destroy(entry);
+  }
+}
+
+auto GeometryCache::acquire(
+  const std::string& key, const Loader& load
+) -> const GeometryBuffers* {
+  if (const auto found{_entries.find(key)}; found != _entries.end()) {
+    ++found->second.users;
+    return &found->second.buffers;
+  }
+  const std::unique_ptr<Geometry> geometry{load()};
+  if (!geometry) {
+    return nullptr;
+  }
+  Entry& entry{_entries.emplace(key, Entry{}).first->second};
+  upload(*geometry, entry);
+  entry.users = 1;
+  LOG("Uploaded geometry " << key << " (" << entry.byteCount << " bytes)\n");
+  return &entry.buffers;
+}
+
+auto GeometryCache::release(const std::string& key) -> void {
+  const auto found{_entries.find(key)};
+  if (found == _entries.end()) {
+    return;
+  }
+  if (--found->second.users == 0) {
+    destroy(found->second);
+    _entries.erase(found);
+  }
+}
+
+auto GeometryCache::getByteCount() const -> std::size_t {
+  std::size_t byteCount{0};
+  for (const auto& [key, entry] : _entries) {
+    byteCount += entry.byteCount;
+  }
+  return byteCount;
+}
+
+auto GeometryCache::createVertexArray(
+  GLuint program, const GeometryBuffers& buffers
+) -> GLuint {
+  GLuint vao{};
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+  const auto stride{static_cast<GLsizei>(
+    buffers.layout.getStride()*sizeof(GLfloat)
+  )};
+  const auto setAttribute{
+    [program, stride](const char* name, GLint size, std::size_t offset) {
+      const GLint location{glGetAttribLocation(program, name)};
+      if (location < 0) {
+        return;
+      }
+      glVertexAttribPointer(
+        static_cast<GLuint>(location), size, GL_FLOAT, GL_FALSE, stride,
+        reinterpret_cast<const void*>(offset*sizeof(GLfloat))
+      );
+      glEnableVertexAttribArray(static_cast<GLuint>(location));
+    }
+  };
+  std::size_t offset{0};
+  setAttribute("position", 3, offset);
+  offset += 3;
+  if (buffers.layout.normals) {
+    setAttribute("normal", 3, offset);
+    offset += 3;
+  }
+  if (buffers.layout.texCoords) {
+    setAttribute("texCoord", 2, offset);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  return vao;
+}
+
+auto GeometryCache::upload(const Geometry& geometry, Entry& entry) -> void {
+  // The index buffer binding belongs to the bound vertex array.
+  glBindVertexArray(0);
+  const VertexLayout layout{geometry.getLayout()};
+  const std::size_t vertexBytes{
+    geometry.getVertexCount()*layout.getStride()*sizeof(GLfloat)
+  };
+  GLuint buffers[2]{};
+  glGenBuffers(2, buffers);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+  glBufferData(
+    GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexBytes),
+    geometry.getVertices(), GL_STATIC_DRAW
+  );
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  // Halve the index traffic when the vertices allow it.
+  const std::size_t indexCount{geometry.getIndexCount()};
+  const std::uint32_t* indices{geometry.getIndices()};
+  std::size_t indexBytes{};
+  GLenum indexType{};
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+  if (
+    geometry.getVertexCount()
+      <= std::size_t{std::numeric_limits<std::uint16_t>::max()} + 1
+  ) {
+    const std::vector<std::uint16_t> shortIndices(
+      indices, indices + indexCount
+    );
+    indexBytes = indexCount*sizeof(std::uint16_t);
+    indexType = GL_UNSIGNED_SHORT;
+    glBufferData(
+      GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indexBytes),
+      shortIndices.data(), GL_STATIC_DRAW
+    );
+  } else {
+    indexBytes = indexCount*sizeof(std::uint32_t);
+    indexType = GL_UNSIGNED_INT;
+    glBufferData(
+      GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indexBytes), indices,
+      GL_STATIC_DRAW
+    );
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  entry.buffers = {
+    buffers[0], buffers[1], static_cast<GLsizei>(indexCount), indexType,
+    layout, geometry.getVertexCount()
+  };
+  entry.byteCount = vertexBytes + indexBytes;
+}
+
+auto GeometryCache::destroy(Entry& entry) -> void {
+  const GLuint buffers[2]{entry.buffers.vertexBuffer, entry.buffers.indexBuffer};
+  glDeleteBuffers(2, buffers);
+}
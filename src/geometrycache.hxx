@@ -0,0 +1,70 @@
+#ifndef GEOMETRYCACHE_HXX
+#define GEOMETRYCACHE_HXX
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <glad/gl.h>
+
+#include "geometry.hxx"
+
+// The GPU copy of a geometry, shared by the vertex arrays of all programs.
+struct GeometryBuffers {
+  GLuint vertexBuffer;
+  GLuint indexBuffer;
+  GLsizei indexCount;
+  // GL_UNSIGNED_SHORT when every index fits, GL_UNSIGNED_INT otherwise.
+  GLenum indexType;
+  VertexLayout layout;
+  std::size_t vertexCount;
+};
+
+/**
+ * Uploads geometry once and hands out its buffers by key, counting users.
+ * The buffers of a geometry are deleted when its last user releases it, or
+ * with the cache.
+ */
+class GeometryCache {
+public:
+  using Loader = std::function<std::unique_ptr<Geometry>()>;
+
+  GeometryCache() = default;
+  GeometryCache(const GeometryCache&) = delete;
+  GeometryCache(GeometryCache&&) = delete;
+  GeometryCache operator=(const GeometryCache&) = delete;
+  GeometryCache operator=(GeometryCache&&) = delete;
+  ~GeometryCache();
+
+  // Calls the loader only if the key is not cached yet; null if it fails.
+  // Every successful acquire() needs a matching release(). Uploads leave
+  // no vertex array bound.
+  auto acquire(
+    const std::string& key, const Loader& load
+  ) -> const GeometryBuffers*;
+  auto release(const std::string& key) -> void;
+  // The size of all buffers held.
+  auto getByteCount() const -> std::size_t;
+
+  // Sets up the attributes of the program that the geometry provides:
+  // position (vec3), normal (vec3) and texCoord (vec2).
+  static auto createVertexArray(
+    GLuint program, const GeometryBuffers& buffers
+  ) -> GLuint;
+
+private:
+  struct Entry {
+    GeometryBuffers buffers;
+    std::size_t byteCount;
+    std::size_t users;
+  };
+
+  static auto upload(const Geometry& geometry, Entry& entry) -> void;
+  static auto destroy(Entry& entry) -> void;
+
+  std::unordered_map<std::string, Entry> _entries{};
+};
+
+#endif // GEOMETRYCACHE_HXX
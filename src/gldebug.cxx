@@ -0,0 +1,131 @@
+#include "gldebug.hxx"
+
+#include <functional>
+#include <iostream>
+
+namespace {
+
+// Distinct messages kept; any others are only counted.
+constexpr std::size_t maxDebugMessages{256};
+
+auto getTypeName(GLenum type) -> const char* {
+  switch (type) {
+    case GL_DEBUG_TYPE_ERROR:
+      return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+      return "deprecated behavior";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+      return "undefined behavior";
+    case GL_DEBUG_TYPE_PORTABILITY:
+      return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE:
+      return "performance";
+    default:
+      return "message";
+  }
+}
+
+auto getSeverityName(GLenum severity) -> const char* {
+  switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH:
+      return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM:
+      return "medium";
+    default:
+      return "low";
+  }
+}
+
+} // namespace
+
+DebugMessageQueue::DebugMessageQueue(GLDebugMode mode) : _mode{mode} {}
+
+DebugMessageQueue::~DebugMessageQueue() {
+  flush();
+  for (const auto& [key, message] : _messages) {
+    if (message.count > 1) {
+      std::cerr << "GL " << getTypeName(message.type) << " repeated "
+        << message.count << " times: " << message.text << '\n';
+    }
+  }
+  if (_overflow > 0) {
+    std::cerr << _overflow << " more GL debug messages were not kept\n";
+  }
+}
+
+auto DebugMessageQueue::install() -> void {
+  if (_mode == GLDebugMode::Off) {
+    return;
+  }
+  if (!GLAD_GL_VERSION_4_3) {
+    std::cerr << "GL debug output is unavailable\n";
+    return;
+  }
+  glEnable(GL_DEBUG_OUTPUT);
+  if (_mode == GLDebugMode::Synchronous) {
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  } else {
+    glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  }
+  glDebugMessageControl(
+    GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr,
+    GL_FALSE
+  );
+  glDebugMessageCallback(onMessageGL, this);
+}
+
+auto DebugMessageQueue::flush() -> void {
+  if (!_pending.load(std::memory_order_acquire)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{_mutex};
+  for (const Message* message : _queue) {
+    std::cerr << "GL " << getTypeName(message->type) << " ("
+      << getSeverityName(message->severity) << "): " << message->text
+      << '\n';
+  }
+  _queue.clear();
+  _pending = false;
+}
+
+auto DebugMessageQueue::onMessageGL(
+  GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+  const GLchar* message, const void* userParam
+) -> void {
+  const std::string_view text{
+    length >= 0
+      ? std::string_view{message, static_cast<std::size_t>(length)}
+      : std::string_view{message}
+  };
+  auto queue{static_cast<DebugMessageQueue*>(const_cast<void*>(userParam))};
+  queue->add(source, type, id, severity, text);
+}
+
+auto DebugMessageQueue::add(
+  GLenum source, GLenum type, GLuint id, GLenum severity,
+  std::string_view text
+) -> void {
+  const Key key{
+    source, type, id, severity, std::hash<std::string_view>{}(text)
+  };
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    const auto found{_messages.find(key)};
+    if (found != _messages.end()) {
+      ++found->second.count;
+      return;
+    }
+    if (_messages.size() >= maxDebugMessages) {
+      ++_overflow;
+      return;
+    }
+    const Message& added{_messages.emplace(
+      key, Message{std::string{text}, type, severity, 1}
+    ).first->second};
+    _queue.push_back(&added);
+    _pending = true;
+  }
+  if (_mode == GLDebugMode::Synchronous) {
+    flush();
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef GLDEBUG_HXX
+#define GLDEBUG_HXX
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <glad/gl.h>
+
+enum class GLDebugMode {
+  Off,
+  // Messages are printed from the callback, on the offending GL call.
+  Synchronous,
+  // Messages are queued and printed later by flush().
+  Asynchronous
+};
+
+/**
+ * Collects the messages of the GL debug output, except notifications. The
+ * driver may report them from any thread and while the offending calls are
+ * still queued; the callback then only counts them, and a message seen
+ * before is never printed again. The number of repeats is printed once the
+ * queue is destroyed.
+ */
+class DebugMessageQueue {
+public:
+  explicit DebugMessageQueue(GLDebugMode mode);
+  DebugMessageQueue() = delete;
+  DebugMessageQueue(const DebugMessageQueue&) = delete;
+  DebugMessageQueue(DebugMessageQueue&&) = delete;
+  DebugMessageQueue operator=(const DebugMessageQueue&) = delete;
+  DebugMessageQueue operator=(DebugMessageQueue&&) = delete;
+  ~DebugMessageQueue();
+
+  // Sends the debug output of the current context here.
+  auto install() -> void;
+  // Prints the messages queued since the last flush; cheap when there are
+  // none.
+  auto flush() -> void;
+
+private:
+  // Source, type, ID, severity and a hash of the text.
+  using Key = std::tuple<GLenum, GLenum, GLuint, GLenum, std::size_t>;
+
+  struct Message {
+    std::string text;
+    GLenum type;
+    GLenum severity;
+    std::uint64_t count;
+  };
+
+  static auto onMessageGL(
+    GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+    const GLchar* message, const void* userParam
+  ) -> void;
+  auto add(
+    GLenum source, GLenum type, GLuint id, GLenum severity,
+    std::string_view text
+  ) -> void;
+
+  const GLDebugMode _mode;
+  std::mutex _mutex{};
+  std::map<Key, Message> _messages{};
+  // New messages, in order, waiting for flush().
+  std::vector<const Message*> _queue{};
+  std::atomic<bool> _pending{false};
+  std::uint64_t _overflow{};
+};
+
+#endif // GLDEBUG_HXX
@@ -0,0 +1,1047 @@
+#include "glsl.hxx"
+
+#include <algorithm>
+#include <cctype>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+struct Token {
+  enum class Kind {
+    Identifier,
+    Number,
+    Symbol,
+    End
+  };
+
+  Kind kind;
+  std::string text;
+  GLSLLocation location;
+  // Whether whitespace comes first, which tells "#define F(x)" apart from
+  // "#define F (x)".
+  bool spaced{false};
+};
+
+class ParseError : public std::runtime_error {
+public:
+  ParseError(GLSLLocation location_, const std::string& message)
+    : std::runtime_error{message}, location{location_} {}
+
+  GLSLLocation location;
+};
+
+// Longest first, so that e.g. "<<=" wins over "<<" and "<".
+constexpr const char* symbols[]{
+  "<<=", ">>=", "++", "--", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=",
+  "==", "!=", "<=", ">=", "&&", "||", "^^", "<<", ">>"
+};
+
+const std::set<std::string> builtinTypes{
+  "void", "float", "int", "uint", "bool", "vec2", "vec3", "vec4", "ivec2",
+  "ivec3", "ivec4", "uvec2", "uvec3", "uvec4", "bvec2", "bvec3", "bvec4",
+  "mat2", "mat3", "mat4", "sampler2D", "samplerCube"
+};
+
+const std::set<std::string> ignoredQualifiers{
+  "highp", "mediump", "lowp", "flat", "smooth", "noperspective", "centroid",
+  "invariant"
+};
+
+// Replaces comments with spaces, keeping line breaks.
+auto stripComments(std::string_view source) -> std::string {
+  std::string result{};
+  result.reserve(source.size());
+  std::size_t position{};
+  while (position < source.size()) {
+    if (source.substr(position, 2) == "//") {
+      while (position < source.size() && source[position] != '\n') {
+        ++position;
+      }
+    } else if (source.substr(position, 2) == "/*") {
+      const std::size_t end{source.find("*/", position + 2)};
+      const std::size_t stop{
+        end == std::string_view::npos ? source.size() : end + 2
+      };
+      for (; position < stop; ++position) {
+        result += source[position] == '\n' ? '\n' : ' ';
+      }
+      result += ' ';
+    } else {
+      result += source[position++];
+    }
+  }
+  return result;
+}
+
+auto tokenizeLine(
+  std::string_view line, GLSLLocation location
+) -> std::vector<Token> {
+  std::vector<Token> tokens{};
+  std::size_t position{};
+  bool spaced{false};
+  const auto push{[&](Token::Kind kind, std::string text) {
+    tokens.push_back({kind, std::move(text), location, spaced});
+    spaced = false;
+  }};
+  while (position < line.size()) {
+    const char c{line[position]};
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++position;
+      spaced = true;
+      continue;
+    }
+    const std::size_t start{position};
+    if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+      while (
+        position < line.size()
+        && (std::isalnum(static_cast<unsigned char>(line[position]))
+          || line[position] == '_')
+      ) {
+        ++position;
+      }
+      push(
+        Token::Kind::Identifier,
+        std::string{line.substr(start, position - start)}
+      );
+      continue;
+    }
+    const bool fraction{
+      c == '.' && position + 1 < line.size()
+      && std::isdigit(static_cast<unsigned char>(line[position + 1]))
+    };
+    if (std::isdigit(static_cast<unsigned char>(c)) || fraction) {
+      if (line.substr(position, 2) == "0x" || line.substr(position, 2) == "0X") {
+        position += 2;
+        while (
+          position < line.size()
+          && std::isxdigit(static_cast<unsigned char>(line[position]))
+        ) {
+          ++position;
+        }
+      } else {
+        while (position < line.size()) {
+          const char d{line[position]};
+          const bool exponentSign{
+            (d == '+' || d == '-')
+            && (line[position - 1] == 'e' || line[position - 1] == 'E')
+          };
+          if (
+            !std::isalnum(static_cast<unsigned char>(d)) && d != '.'
+            && !exponentSign
+          ) {
+            break;
+          }
+          ++position;
+        }
+      }
+      push(
+        Token::Kind::Number, std::string{line.substr(start, position - start)}
+      );
+      continue;
+    }
+    std::string symbol{c};
+    for (const char* candidate : symbols) {
+      const std::string_view text{candidate};
+      if (line.substr(position, text.size()) == text) {
+        symbol = std::string{text};
+        break;
+      }
+    }
+    position += symbol.size();
+    push(Token::Kind::Symbol, symbol);
+  }
+  return tokens;
+}
+
+/**
+ * Runs the directives and expands object-like macros, line by line.
+ */
+class Preprocessor {
+public:
+  explicit Preprocessor(std::string_view source) : _text{stripComments(source)} {
+    _macros["__VERSION__"] = {{Token::Kind::Number, "110", {}}};
+  }
+
+  auto run() -> std::vector<Token> {
+    std::size_t position{};
+    bool first{true};
+    while (position <= _text.size()) {
+      std::size_t end{_text.find('\n', position)};
+      end = end == std::string::npos ? _text.size() : end;
+      const std::string_view line{
+        std::string_view{_text}.substr(position, end - position)
+      };
+      position = end + 1;
+      const GLSLLocation location{_file, _line};
+      ++_line;
+      std::vector<Token> tokens{tokenizeLine(line, location)};
+      if (tokens.empty()) {
+        continue;
+      }
+      if (tokens.front().text == "#") {
+        directive(tokens, first);
+      } else if (isActive()) {
+        expand(tokens, 0, tokens.size(), _output, {});
+      }
+      first = false;
+    }
+    if (!_conditions.empty()) {
+      throw ParseError{{_file, _line}, "missing #endif"};
+    }
+    _output.push_back({Token::Kind::End, "", {_file, _line}});
+    return std::move(_output);
+  }
+
+  auto getVersion() const -> int {
+    return _version;
+  }
+
+private:
+  struct Condition {
+    bool active;
+    bool taken;
+    bool parentActive;
+  };
+
+  auto isActive() const -> bool {
+    return _conditions.empty() || _conditions.back().active;
+  }
+
+  auto directive(const std::vector<Token>& tokens, bool first) -> void {
+    const GLSLLocation location{tokens.front().location};
+    const std::string name{tokens.size() > 1 ? tokens.at(1).text : ""};
+    if (name == "ifdef" || name == "ifndef") {
+      const bool defined{
+        tokens.size() > 2 && _macros.count(tokens.at(2).text) > 0
+      };
+      pushCondition(name == "ifdef" ? defined : !defined);
+    } else if (name == "if") {
+      pushCondition(isActive() && evaluate(tokens, location));
+    } else if (name == "elif") {
+      Condition& condition{currentCondition(location)};
+      const bool active{
+        condition.parentActive && !condition.taken
+        && evaluate(tokens, location)
+      };
+      condition.active = active;
+      condition.taken = condition.taken || active;
+    } else if (name == "else") {
+      Condition& condition{currentCondition(location)};
+      condition.active = condition.parentActive && !condition.taken;
+      condition.taken = true;
+    } else if (name == "endif") {
+      currentCondition(location);
+      _conditions.pop_back();
+    } else if (!isActive()) {
+      return;
+    } else if (name == "version") {
+      if (!first || tokens.size() < 3) {
+        throw ParseError{location, "#version must come first"};
+      }
+      _version = std::stoi(tokens.at(2).text);
+      _macros["__VERSION__"] = {{Token::Kind::Number, tokens.at(2).text, {}}};
+      if (tokens.size() > 3 && tokens.at(3).text == "es") {
+        _es = true;
+        _macros["GL_ES"] = {{Token::Kind::Number, "1", {}}};
+        _macros["GL_FRAGMENT_PRECISION_HIGH"] = {
+          {Token::Kind::Number, "1", {}}
+        };
+      }
+    } else if (name == "define") {
+      if (tokens.size() < 3 || tokens.at(2).kind != Token::Kind::Identifier) {
+        throw ParseError{location, "invalid #define"};
+      }
+      const Token& macro{tokens.at(2)};
+      // A parenthesis right after the name starts a parameter list.
+      if (
+        tokens.size() > 3 && tokens.at(3).text == "(" && !tokens.at(3).spaced
+      ) {
+        throw ParseError{location, "function-like macros are not supported"};
+      }
+      _macros[macro.text] = {tokens.begin() + 3, tokens.end()};
+    } else if (name == "undef") {
+      if (tokens.size() > 2) {
+        _macros.erase(tokens.at(2).text);
+      }
+    } else if (name == "line") {
+      if (tokens.size() < 3) {
+        throw ParseError{location, "invalid #line"};
+      }
+      const bool nextLine{_es ? _version < 300 : _version < 330};
+      _line = std::stoi(tokens.at(2).text) + (nextLine ? 1 : 0);
+      if (tokens.size() > 3) {
+        _file = std::stoi(tokens.at(3).text);
+      }
+    } else if (name == "error") {
+      throw ParseError{location, "#error"};
+    } else if (
+      name != "pragma" && name != "extension" && !name.empty()
+    ) {
+      throw ParseError{location, "unknown directive #" + name};
+    }
+  }
+
+  auto pushCondition(bool value) -> void {
+    const bool parentActive{isActive()};
+    _conditions.push_back({parentActive && value, value, parentActive});
+  }
+
+  auto currentCondition(GLSLLocation location) -> Condition& {
+    if (_conditions.empty()) {
+      throw ParseError{location, "unmatched conditional directive"};
+    }
+    return _conditions.back();
+  }
+
+  auto expand(
+    const std::vector<Token>& tokens, std::size_t begin, std::size_t end,
+    std::vector<Token>& output, const std::vector<std::string>& expanding
+  ) -> void {
+    for (std::size_t t{begin}; t < end; ++t) {
+      const Token& token{tokens.at(t)};
+      const auto macro{_macros.find(token.text)};
+      const bool recursive{
+        std::find(expanding.begin(), expanding.end(), token.text)
+          != expanding.end()
+      };
+      if (
+        token.kind != Token::Kind::Identifier || macro == _macros.end()
+        || recursive
+      ) {
+        output.push_back(token);
+        continue;
+      }
+      std::vector<Token> replacement{macro->second};
+      for (Token& replaced : replacement) {
+        replaced.location = token.location;
+      }
+      std::vector<std::string> nested{expanding};
+      nested.push_back(token.text);
+      expand(replacement, 0, replacement.size(), output, nested);
+    }
+  }
+
+  auto evaluate(
+    const std::vector<Token>& tokens, GLSLLocation location
+  ) -> bool {
+    std::vector<Token> resolved{};
+    for (std::size_t t{2}; t < tokens.size(); ++t) {
+      if (tokens.at(t).text != "defined") {
+        resolved.push_back(tokens.at(t));
+        continue;
+      }
+      const bool parenthesized{
+        t + 1 < tokens.size() && tokens.at(t + 1).text == "("
+      };
+      const std::size_t nameIndex{t + (parenthesized ? 2 : 1)};
+      if (nameIndex >= tokens.size()) {
+        throw ParseError{location, "invalid defined()"};
+      }
+      const bool defined{_macros.count(tokens.at(nameIndex).text) > 0};
+      resolved.push_back({Token::Kind::Number, defined ? "1" : "0", location});
+      t = nameIndex + (parenthesized ? 1 : 0);
+    }
+    std::vector<Token> expanded{};
+    expand(resolved, 0, resolved.size(), expanded, {});
+    std::size_t position{};
+    const long value{evaluateBinary(expanded, position, 0, location)};
+    if (position != expanded.size()) {
+      throw ParseError{location, "invalid #if expression"};
+    }
+    return value != 0;
+  }
+
+  static auto precedenceOf(const std::string& symbol) -> int {
+    static const std::unordered_map<std::string, int> precedences{
+      {"||", 1}, {"&&", 2}, {"|", 3}, {"^", 4}, {"&", 5}, {"==", 6},
+      {"!=", 6}, {"<", 7}, {">", 7}, {"<=", 7}, {">=", 7}, {"<<", 8},
+      {">>", 8}, {"+", 9}, {"-", 9}, {"*", 10}, {"/", 10}, {"%", 10}
+    };
+    const auto found{precedences.find(symbol)};
+    return found == precedences.end() ? 0 : found->second;
+  }
+
+  static auto evaluateBinary(
+    const std::vector<Token>& tokens, std::size_t& position, int minimum,
+    GLSLLocation location
+  ) -> long {
+    long left{evaluateUnary(tokens, position, location)};
+    while (position < tokens.size()) {
+      const std::string& symbol{tokens.at(position).text};
+      const int precedence{precedenceOf(symbol)};
+      if (precedence == 0 || precedence <= minimum) {
+        break;
+      }
+      ++position;
+      const long right{evaluateBinary(tokens, position, precedence, location)};
+      if ((symbol == "/" || symbol == "%") && right == 0) {
+        throw ParseError{location, "division by zero in #if"};
+      }
+      if (symbol == "||") left = left || right;
+      else if (symbol == "&&") left = left && right;
+      else if (symbol == "|") left = left | right;
+      else if (symbol == "^") left = left ^ right;
+      else if (symbol == "&") left = left & right;
+      else if (symbol == "==") left = left == right;
+      else if (symbol == "!=") left = left != right;
+      else if (symbol == "<") left = left < right;
+      else if (symbol == ">") left = left > right;
+      else if (symbol == "<=") left = left <= right;
+      else if (symbol == ">=") left = left >= right;
+      else if (symbol == "<<") left = left << right;
+      else if (symbol == ">>") left = left >> right;
+      else if (symbol == "+") left = left + right;
+      else if (symbol == "-") left = left - right;
+      else if (symbol == "*") left = left*right;
+      else if (symbol == "/") left = left/right;
+      else left = left % right;
+    }
+    return left;
+  }
+
+  static auto evaluateUnary(
+    const std::vector<Token>& tokens, std::size_t& position,
+    GLSLLocation location
+  ) -> long {
+    if (position >= tokens.size()) {
+      throw ParseError{location, "invalid #if expression"};
+    }
+    const Token& token{tokens.at(position++)};
+    if (token.text == "!") {
+      return !evaluateUnary(tokens, position, location);
+    } else if (token.text == "-") {
+      return -evaluateUnary(tokens, position, location);
+    } else if (token.text == "+") {
+      return evaluateUnary(tokens, position, location);
+    } else if (token.text == "~") {
+      return ~evaluateUnary(tokens, position, location);
+    } else if (token.text == "(") {
+      const long value{evaluateBinary(tokens, position, 0, location)};
+      if (position >= tokens.size() || tokens.at(position).text != ")") {
+        throw ParseError{location, "missing ) in #if expression"};
+      }
+      ++position;
+      return value;
+    } else if (token.kind == Token::Kind::Number) {
+      return std::stol(token.text, nullptr, 0);
+    } else if (token.kind == Token::Kind::Identifier) {
+      // Undefined names count as 0, as in C.
+      return 0;
+    }
+    throw ParseError{location, "invalid #if expression"};
+  }
+
+  std::string _text;
+  std::unordered_map<std::string, std::vector<Token>> _macros{};
+  std::vector<Condition> _conditions{};
+  std::vector<Token> _output{};
+  int _version{110};
+  bool _es{false};
+  int _file{0};
+  int _line{1};
+};
+
+class Parser {
+public:
+  explicit Parser(std::vector<Token> tokens) : _tokens{std::move(tokens)} {}
+
+  auto parseUnit(GLSLUnit& unit) -> void {
+    while (peek().kind != Token::Kind::End) {
+      parseExternal(unit);
+    }
+  }
+
+private:
+  auto peek(std::size_t offset = 0) const -> const Token& {
+    return _tokens.at(std::min(_position + offset, _tokens.size() - 1));
+  }
+
+  auto next() -> const Token& {
+    const Token& token{peek()};
+    if (_position < _tokens.size() - 1) {
+      ++_position;
+    }
+    return token;
+  }
+
+  auto accept(const std::string& text) -> bool {
+    if (peek().kind != Token::Kind::Number && peek().text == text) {
+      next();
+      return true;
+    }
+    return false;
+  }
+
+  auto expect(const std::string& text) -> void {
+    if (!accept(text)) {
+      throw ParseError{
+        peek().location, "expected \"" + text + "\" before \""
+          + peek().text + '"'
+      };
+    }
+  }
+
+  auto expectIdentifier() -> std::string {
+    if (peek().kind != Token::Kind::Identifier) {
+      throw ParseError{
+        peek().location, "expected an identifier before \"" + peek().text
+          + '"'
+      };
+    }
+    return next().text;
+  }
+
+  auto isTypeName(const Token& token) const -> bool {
+    return token.kind == Token::Kind::Identifier
+      && (builtinTypes.count(token.text) > 0
+        || _structNames.count(token.text) > 0);
+  }
+
+  auto parseTypeName() -> std::string {
+    if (!isTypeName(peek())) {
+      throw ParseError{peek().location, "unknown type \"" + peek().text + '"'};
+    }
+    return next().text;
+  }
+
+  auto skipLayout() -> void {
+    if (!accept("layout")) {
+      return;
+    }
+    expect("(");
+    while (!accept(")")) {
+      if (peek().kind == Token::Kind::End) {
+        throw ParseError{peek().location, "unterminated layout qualifier"};
+      }
+      next();
+    }
+  }
+
+  auto rejectArray() -> void {
+    if (peek().text == "[") {
+      throw ParseError{peek().location, "arrays are not supported"};
+    }
+  }
+
+  auto parseFields() -> std::vector<std::pair<std::string, std::string>> {
+    std::vector<std::pair<std::string, std::string>> fields{};
+    expect("{");
+    while (!accept("}")) {
+      while (ignoredQualifiers.count(peek().text) > 0) {
+        next();
+      }
+      const std::string typeName{parseTypeName()};
+      do {
+        fields.emplace_back(typeName, expectIdentifier());
+        rejectArray();
+      } while (accept(","));
+      expect(";");
+    }
+    return fields;
+  }
+
+  auto parseExternal(GLSLUnit& unit) -> void {
+    const GLSLLocation location{peek().location};
+    if (accept(";")) {
+      return;
+    }
+    if (accept("precision")) {
+      while (!accept(";")) {
+        next();
+      }
+      return;
+    }
+    if (accept("struct")) {
+      const std::string name{expectIdentifier()};
+      _structNames.insert(name);
+      unit.structs.push_back({name, parseFields()});
+      if (!accept(";")) {
+        parseGlobalDeclarators(unit, GLSLGlobal::Storage::None, name, location);
+      }
+      return;
+    }
+    GLSLGlobal::Storage storage{GLSLGlobal::Storage::None};
+    while (true) {
+      skipLayout();
+      const std::string& text{peek().text};
+      if (text == "const") {
+        storage = GLSLGlobal::Storage::Const;
+      } else if (text == "uniform") {
+        storage = GLSLGlobal::Storage::Uniform;
+      } else if (text == "in" || text == "varying" || text == "attribute") {
+        storage = GLSLGlobal::Storage::In;
+      } else if (text == "out") {
+        storage = GLSLGlobal::Storage::Out;
+      } else if (ignoredQualifiers.count(text) == 0) {
+        break;
+      }
+      next();
+    }
+    if (
+      storage != GLSLGlobal::Storage::None && !isTypeName(peek())
+      && peek(1).text == "{"
+    ) {
+      const std::string blockName{expectIdentifier()};
+      GLSLGlobal block{
+        storage, {blockName, "", false, nullptr}, parseFields(), location
+      };
+      if (peek().kind == Token::Kind::Identifier) {
+        block.declaration.name = next().text;
+        rejectArray();
+      }
+      expect(";");
+      unit.globals.push_back(std::move(block));
+      return;
+    }
+    const std::string typeName{parseTypeName()};
+    if (peek(1).text == "(") {
+      GLSLFunction function{typeName, expectIdentifier(), {}, nullptr, location};
+      expect("(");
+      if (!(peek().text == "void" && peek(1).text == ")")) {
+        while (peek().text != ")") {
+          function.parameters.push_back(parseParameter());
+          if (!accept(",")) {
+            break;
+          }
+        }
+      } else {
+        next();
+      }
+      expect(")");
+      if (!accept(";")) {
+        function.body = parseBlock();
+      }
+      unit.functions.push_back(std::move(function));
+      return;
+    }
+    parseGlobalDeclarators(unit, storage, typeName, location);
+  }
+
+  auto parseGlobalDeclarators(
+    GLSLUnit& unit, GLSLGlobal::Storage storage, const std::string& typeName,
+    GLSLLocation location
+  ) -> void {
+    do {
+      GLSLDeclaration declaration{
+        typeName, expectIdentifier(), storage == GLSLGlobal::Storage::Const,
+        nullptr
+      };
+      rejectArray();
+      if (accept("=")) {
+        declaration.initializer = parseAssignment();
+      }
+      unit.globals.push_back({storage, std::move(declaration), {}, location});
+    } while (accept(","));
+    expect(";");
+  }
+
+  auto parseParameter() -> GLSLParameter {
+    GLSLParameter::Direction direction{GLSLParameter::Direction::In};
+    while (true) {
+      const std::string& text{peek().text};
+      if (text == "out") {
+        direction = GLSLParameter::Direction::Out;
+      } else if (text == "inout") {
+        direction = GLSLParameter::Direction::InOut;
+      } else if (text != "in" && text != "const"
+        && ignoredQualifiers.count(text) == 0) {
+        break;
+      }
+      next();
+    }
+    const std::string typeName{parseTypeName()};
+    std::string name{};
+    if (peek().kind == Token::Kind::Identifier) {
+      name = next().text;
+    }
+    rejectArray();
+    return {typeName, name, direction};
+  }
+
+  auto makeStatement(GLSLStatement::Kind kind, GLSLLocation location)
+    -> std::unique_ptr<GLSLStatement> {
+    auto statement{std::make_unique<GLSLStatement>()};
+    statement->kind = kind;
+    statement->location = location;
+    return statement;
+  }
+
+  auto parseBlock() -> std::unique_ptr<GLSLStatement> {
+    auto block{makeStatement(GLSLStatement::Kind::Block, peek().location)};
+    expect("{");
+    while (!accept("}")) {
+      if (peek().kind == Token::Kind::End) {
+        throw ParseError{peek().location, "missing }"};
+      }
+      block->statements.push_back(parseStatement());
+    }
+    return block;
+  }
+
+  auto isDeclarationStart() const -> bool {
+    const Token& token{peek()};
+    if (token.text == "const" || ignoredQualifiers.count(token.text) > 0) {
+      return true;
+    }
+    return isTypeName(token) && peek(1).kind == Token::Kind::Identifier;
+  }
+
+  auto parseDeclaration() -> std::unique_ptr<GLSLStatement> {
+    auto statement{
+      makeStatement(GLSLStatement::Kind::Declaration, peek().location)
+    };
+    bool isConst{false};
+    while (peek().text == "const" || ignoredQualifiers.count(peek().text) > 0) {
+      isConst = isConst || peek().text == "const";
+      next();
+    }
+    const std::string typeName{parseTypeName()};
+    do {
+      GLSLDeclaration declaration{typeName, expectIdentifier(), isConst, nullptr};
+      rejectArray();
+      if (accept("=")) {
+        declaration.initializer = parseAssignment();
+      }
+      statement->declarations.push_back(std::move(declaration));
+    } while (accept(","));
+    expect(";");
+    return statement;
+  }
+
+  auto parseStatement() -> std::unique_ptr<GLSLStatement> {
+    const GLSLLocation location{peek().location};
+    if (peek().text == "{") {
+      return parseBlock();
+    }
+    if (accept(";")) {
+      return makeStatement(GLSLStatement::Kind::Empty, location);
+    }
+    if (accept("precision")) {
+      while (!accept(";")) {
+        next();
+      }
+      return makeStatement(GLSLStatement::Kind::Empty, location);
+    }
+    if (accept("if")) {
+      auto statement{makeStatement(GLSLStatement::Kind::If, location)};
+      expect("(");
+      statement->expression = parseExpression();
+      expect(")");
+      statement->statements.push_back(parseStatement());
+      if (accept("else")) {
+        statement->statements.push_back(parseStatement());
+      }
+      return statement;
+    }
+    if (accept("for")) {
+      auto statement{makeStatement(GLSLStatement::Kind::For, location)};
+      expect("(");
+      if (isDeclarationStart()) {
+        statement->statements.push_back(parseDeclaration());
+      } else if (accept(";")) {
+        statement->statements.push_back(
+          makeStatement(GLSLStatement::Kind::Empty, location)
+        );
+      } else {
+        auto initializer{
+          makeStatement(GLSLStatement::Kind::Expression, location)
+        };
+        initializer->expression = parseExpression();
+        expect(";");
+        statement->statements.push_back(std::move(initializer));
+      }
+      if (peek().text != ";") {
+        statement->expression = parseExpression();
+      }
+      expect(";");
+      if (peek().text != ")") {
+        statement->step = parseExpression();
+      }
+      expect(")");
+      statement->statements.push_back(parseStatement());
+      return statement;
+    }
+    if (accept("while")) {
+      auto statement{makeStatement(GLSLStatement::Kind::While, location)};
+      expect("(");
+      statement->expression = parseExpression();
+      expect(")");
+      statement->statements.push_back(parseStatement());
+      return statement;
+    }
+    if (accept("do")) {
+      auto statement{makeStatement(GLSLStatement::Kind::DoWhile, location)};
+      statement->statements.push_back(parseStatement());
+      expect("while");
+      expect("(");
+      statement->expression = parseExpression();
+      expect(")");
+      expect(";");
+      return statement;
+    }
+    if (accept("return")) {
+      auto statement{makeStatement(GLSLStatement::Kind::Return, location)};
+      if (peek().text != ";") {
+        statement->expression = parseExpression();
+      }
+      expect(";");
+      return statement;
+    }
+    if (accept("break")) {
+      expect(";");
+      return makeStatement(GLSLStatement::Kind::Break, location);
+    }
+    if (accept("continue")) {
+      expect(";");
+      return makeStatement(GLSLStatement::Kind::Continue, location);
+    }
+    if (accept("discard")) {
+      expect(";");
+      return makeStatement(GLSLStatement::Kind::Discard, location);
+    }
+    if (isDeclarationStart()) {
+      return parseDeclaration();
+    }
+    auto statement{makeStatement(GLSLStatement::Kind::Expression, location)};
+    statement->expression = parseExpression();
+    expect(";");
+    return statement;
+  }
+
+  auto makeExpression(
+    GLSLExpression::Kind kind, std::string text, GLSLLocation location
+  ) -> std::unique_ptr<GLSLExpression> {
+    auto expression{std::make_unique<GLSLExpression>()};
+    expression->kind = kind;
+    expression->text = std::move(text);
+    expression->location = location;
+    return expression;
+  }
+
+  auto parseExpression() -> std::unique_ptr<GLSLExpression> {
+    auto expression{parseAssignment()};
+    if (peek().text == ",") {
+      throw ParseError{peek().location, "the comma operator is not supported"};
+    }
+    return expression;
+  }
+
+  auto parseAssignment() -> std::unique_ptr<GLSLExpression> {
+    auto target{parseTernary()};
+    static const std::set<std::string> operators{
+      "=", "+=", "-=", "*=", "/=", "%="
+    };
+    if (
+      peek().kind == Token::Kind::Symbol && operators.count(peek().text) > 0
+    ) {
+      const Token& token{next()};
+      auto assignment{
+        makeExpression(GLSLExpression::Kind::Assign, token.text, token.location)
+      };
+      assignment->operands.push_back(std::move(target));
+      assignment->operands.push_back(parseAssignment());
+      return assignment;
+    }
+    return target;
+  }
+
+  auto parseTernary() -> std::unique_ptr<GLSLExpression> {
+    auto condition{parseBinary(0)};
+    if (peek().text != "?") {
+      return condition;
+    }
+    const GLSLLocation location{next().location};
+    auto ternary{makeExpression(GLSLExpression::Kind::Ternary, "?", location)};
+    ternary->operands.push_back(std::move(condition));
+    ternary->operands.push_back(parseExpression());
+    expect(":");
+    ternary->operands.push_back(parseAssignment());
+    return ternary;
+  }
+
+  static auto precedenceOf(const Token& token) -> int {
+    static const std::unordered_map<std::string, int> precedences{
+      {"||", 1}, {"^^", 2}, {"&&", 3}, {"|", 4}, {"^", 5}, {"&", 6},
+      {"==", 7}, {"!=", 7}, {"<", 8}, {">", 8}, {"<=", 8}, {">=", 8},
+      {"<<", 9}, {">>", 9}, {"+", 10}, {"-", 10}, {"*", 11}, {"/", 11},
+      {"%", 11}
+    };
+    if (token.kind != Token::Kind::Symbol) {
+      return 0;
+    }
+    const auto found{precedences.find(token.text)};
+    return found == precedences.end() ? 0 : found->second;
+  }
+
+  auto parseBinary(int minimum) -> std::unique_ptr<GLSLExpression> {
+    auto left{parseUnary()};
+    while (true) {
+      const int precedence{precedenceOf(peek())};
+      if (precedence == 0 || precedence <= minimum) {
+        return left;
+      }
+      const Token& token{next()};
+      auto binary{
+        makeExpression(GLSLExpression::Kind::Binary, token.text, token.location)
+      };
+      binary->operands.push_back(std::move(left));
+      binary->operands.push_back(parseBinary(precedence));
+      left = std::move(binary);
+    }
+  }
+
+  auto parseUnary() -> std::unique_ptr<GLSLExpression> {
+    const Token& token{peek()};
+    if (token.kind == Token::Kind::Symbol) {
+      if (token.text == "++" || token.text == "--") {
+        const Token& symbol{next()};
+        auto increment{makeExpression(
+          GLSLExpression::Kind::PreIncrement, symbol.text, symbol.location
+        )};
+        increment->operands.push_back(parseUnary());
+        return increment;
+      }
+      if (
+        token.text == "-" || token.text == "+" || token.text == "!"
+        || token.text == "~"
+      ) {
+        const Token& symbol{next()};
+        auto unary{makeExpression(
+          GLSLExpression::Kind::Unary, symbol.text, symbol.location
+        )};
+        unary->operands.push_back(parseUnary());
+        return unary;
+      }
+    }
+    return parsePostfix();
+  }
+
+  auto parsePostfix() -> std::unique_ptr<GLSLExpression> {
+    auto expression{parsePrimary()};
+    while (true) {
+      const Token& token{peek()};
+      if (token.text == ".") {
+        next();
+        auto member{makeExpression(
+          GLSLExpression::Kind::Member, expectIdentifier(), token.location
+        )};
+        member->operands.push_back(std::move(expression));
+        expression = std::move(member);
+      } else if (token.text == "[") {
+        const GLSLLocation location{next().location};
+        auto index{makeExpression(GLSLExpression::Kind::Index, "[", location)};
+        index->operands.push_back(std::move(expression));
+        index->operands.push_back(parseExpression());
+        expect("]");
+        expression = std::move(index);
+      } else if (
+        token.kind == Token::Kind::Symbol
+        && (token.text == "++" || token.text == "--")
+      ) {
+        const Token& symbol{next()};
+        auto increment{makeExpression(
+          GLSLExpression::Kind::PostIncrement, symbol.text, symbol.location
+        )};
+        increment->operands.push_back(std::move(expression));
+        expression = std::move(increment);
+      } else {
+        return expression;
+      }
+    }
+  }
+
+  auto parsePrimary() -> std::unique_ptr<GLSLExpression> {
+    const Token& token{next()};
+    if (token.kind == Token::Kind::Number) {
+      auto number{makeExpression(
+        GLSLExpression::Kind::Number, token.text, token.location
+      )};
+      std::string text{token.text};
+      const bool hex{text.size() > 1 && (text[1] == 'x' || text[1] == 'X')};
+      while (
+        !text.empty()
+        && (text.back() == 'f' || text.back() == 'F' || text.back() == 'u'
+          || text.back() == 'U')
+        && !hex
+      ) {
+        number->isFloat = number->isFloat || text.back() == 'f'
+          || text.back() == 'F';
+        text.pop_back();
+      }
+      number->isFloat = number->isFloat || (!hex
+        && text.find_first_of(".eE") != std::string::npos);
+      try {
+        number->number = number->isFloat
+          ? std::stod(text)
+          : static_cast<double>(std::stoll(text, nullptr, 0));
+      } catch (const std::exception&) {
+        throw ParseError{token.location, "invalid number \"" + token.text + '"'};
+      }
+      return number;
+    }
+    if (token.kind == Token::Kind::Identifier) {
+      if (token.text == "true" || token.text == "false") {
+        auto boolean{makeExpression(
+          GLSLExpression::Kind::Boolean, token.text, token.location
+        )};
+        boolean->number = token.text == "true" ? 1. : 0.;
+        return boolean;
+      }
+      if (peek().text == "(") {
+        next();
+        auto call{makeExpression(
+          GLSLExpression::Kind::Call, token.text, token.location
+        )};
+        if (!(peek().text == "void" && peek(1).text == ")")) {
+          while (peek().text != ")") {
+            call->operands.push_back(parseAssignment());
+            if (!accept(",")) {
+              break;
+            }
+          }
+        } else {
+          next();
+        }
+        expect(")");
+        return call;
+      }
+      return makeExpression(
+        GLSLExpression::Kind::Identifier, token.text, token.location
+      );
+    }
+    if (token.text == "(") {
+      auto expression{parseExpression()};
+      expect(")");
+      return expression;
+    }
+    throw ParseError{token.location, "unexpected \"" + token.text + '"'};
+  }
+
+  std::vector<Token> _tokens;
+  std::size_t _position{};
+  std::set<std::string> _structNames{};
+};
+
+} // namespace
+
+auto parseGLSL(
+  std::string_view source, std::string& log
+) -> std::optional<GLSLUnit> {
+  try {
+    Preprocessor preprocessor{source};
+    std::vector<Token> tokens{preprocessor.run()};
+    GLSLUnit unit{};
+    unit.version = preprocessor.getVersion();
+    Parser parser{std::move(tokens)};
+    parser.parseUnit(unit);
+    return unit;
+  } catch (const ParseError& error) {
+    log += std::to_string(error.location.file) + ':'
+      + std::to_string(error.location.line) + ": error: " + error.what()
+      + '\n';
+    return {};
+  }
+}
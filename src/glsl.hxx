@@ -0,0 +1,136 @@
+#ifndef GLSL_HXX
+#define GLSL_HXX
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A front end for the subset of GLSL fragment shaders that the software
+ * renderer runs: preprocessor directives (object-like macros, conditionals,
+ * #version and #line), structs, functions and the usual statements and
+ * expressions. Type checking is left to the code generator.
+ */
+
+struct GLSLLocation {
+  int file{};
+  int line{};
+};
+
+struct GLSLExpression {
+  enum class Kind {
+    Number,
+    Boolean,
+    Identifier,
+    Unary,
+    Binary,
+    Assign,
+    Ternary,
+    Call,
+    Member,
+    Index,
+    PreIncrement,
+    PostIncrement
+  };
+
+  Kind kind;
+  // The identifier, operator, called function or member name.
+  std::string text{};
+  double number{};
+  bool isFloat{false};
+  std::vector<std::unique_ptr<GLSLExpression>> operands{};
+  GLSLLocation location{};
+};
+
+struct GLSLDeclaration {
+  std::string typeName;
+  std::string name;
+  bool isConst;
+  std::unique_ptr<GLSLExpression> initializer;
+};
+
+struct GLSLStatement {
+  enum class Kind {
+    Block,
+    Expression,
+    Declaration,
+    If,
+    For,
+    While,
+    DoWhile,
+    Return,
+    Break,
+    Continue,
+    Discard,
+    Empty
+  };
+
+  Kind kind;
+  // Block contents, the branches of an if, the body of a loop, or the
+  // initializer of a for loop followed by its body.
+  std::vector<std::unique_ptr<GLSLStatement>> statements{};
+  std::vector<GLSLDeclaration> declarations{};
+  // The expression, condition or return value; a for loop adds its step.
+  std::unique_ptr<GLSLExpression> expression{};
+  std::unique_ptr<GLSLExpression> step{};
+  GLSLLocation location{};
+};
+
+struct GLSLParameter {
+  enum class Direction {
+    In,
+    Out,
+    InOut
+  };
+
+  std::string typeName;
+  std::string name;
+  Direction direction;
+};
+
+struct GLSLFunction {
+  std::string returnType;
+  std::string name;
+  std::vector<GLSLParameter> parameters;
+  // Prototypes have no body.
+  std::unique_ptr<GLSLStatement> body;
+  GLSLLocation location;
+};
+
+struct GLSLStruct {
+  std::string name;
+  std::vector<std::pair<std::string, std::string>> fields;
+};
+
+struct GLSLGlobal {
+  enum class Storage {
+    None,
+    Const,
+    Uniform,
+    In,
+    Out
+  };
+
+  Storage storage;
+  GLSLDeclaration declaration;
+  // Members of an interface block, which the declaration names.
+  std::vector<std::pair<std::string, std::string>> blockMembers;
+  GLSLLocation location;
+};
+
+struct GLSLUnit {
+  int version{110};
+  std::vector<GLSLStruct> structs{};
+  std::vector<GLSLGlobal> globals{};
+  std::vector<GLSLFunction> functions{};
+};
+
+// Messages look like driver logs ("0:12: error: ..."), so that
+// ShaderSource::remapLog() can name the files.
+auto parseGLSL(
+  std::string_view source, std::string& log
+) -> std::optional<GLSLUnit>;
+
+#endif // GLSL_HXX
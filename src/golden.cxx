@@ -0,0 +1,418 @@
+#include "golden.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "debug.hxx"
+#include "io.hxx"
+#include "lanes.hxx"
+
+namespace {
+
+constexpr int bandHeight{8};
+constexpr int blockSize{8};
+// Sums of squared byte differences in floats stay exact for this many
+// groups of laneCount values (64*255*255 < 2^24).
+constexpr std::size_t exactGroups{64};
+constexpr double ssimC1{(.01*255.)*(.01*255.)};
+constexpr double ssimC2{(.03*255.)*(.03*255.)};
+// Differences at or above this show as white in heatmaps.
+constexpr int heatmapRange{64};
+
+struct BandDifference {
+  int maxError{};
+  double squaredError{};
+  double ssim{};
+  std::size_t blocks{};
+};
+
+auto clearLanes(Lanes& lanes) -> void {
+  for (NativeFloats& part : lanes.parts) {
+    part = nativeSet(0.f);
+  }
+}
+
+auto sumLanes(const Lanes& lanes) -> double {
+  alignas(32) float values[laneCount];
+  for (std::size_t part{0}; part < nativeCount; ++part) {
+    nativeStore(values + part*nativeWidth, lanes.parts[part]);
+  }
+  double sum{};
+  for (const float value : values) {
+    sum += value;
+  }
+  return sum;
+}
+
+auto maxLanes(const Lanes& lanes) -> float {
+  alignas(32) float values[laneCount];
+  for (std::size_t part{0}; part < nativeCount; ++part) {
+    nativeStore(values + part*nativeWidth, lanes.parts[part]);
+  }
+  return *std::max_element(values, values + laneCount);
+}
+
+// Adds the errors of count channel values to the band.
+auto compareChannels(
+  const std::uint8_t* a, const std::uint8_t* b, std::size_t count,
+  BandDifference& band
+) -> void {
+  alignas(32) float differences[laneCount];
+  const NativeFloats zero{nativeSet(0.f)};
+  Lanes maximum{};
+  Lanes squares{};
+  clearLanes(maximum);
+  clearLanes(squares);
+  std::size_t groups{0};
+  std::size_t i{0};
+  for (; i + laneCount <= count; i += laneCount) {
+    for (std::size_t lane{0}; lane < laneCount; ++lane) {
+      differences[lane] = static_cast<float>(a[i + lane] - b[i + lane]);
+    }
+    for (std::size_t part{0}; part < nativeCount; ++part) {
+      const NativeFloats d{nativeLoad(differences + part*nativeWidth)};
+      maximum.parts[part] = nativeMax(
+        maximum.parts[part], nativeMax(d, nativeSub(zero, d))
+      );
+      squares.parts[part] = nativeAdd(squares.parts[part], nativeMul(d, d));
+    }
+    if (++groups == exactGroups) {
+      band.squaredError += sumLanes(squares);
+      clearLanes(squares);
+      groups = 0;
+    }
+  }
+  band.squaredError += sumLanes(squares);
+  band.maxError = std::max(band.maxError, static_cast<int>(maxLanes(maximum)));
+  for (; i < count; ++i) {
+    const int d{a[i] - b[i]};
+    band.maxError = std::max(band.maxError, std::abs(d));
+    band.squaredError += static_cast<double>(d*d);
+  }
+}
+
+auto toLuma(
+  const std::uint8_t* pixels, std::size_t count, float* luma
+) -> void {
+  for (std::size_t x{0}; x < count; ++x) {
+    luma[x] = .299f*pixels[x*4] + .587f*pixels[x*4 + 1]
+      + .114f*pixels[x*4 + 2];
+  }
+}
+
+/**
+ * Adds the SSIM of the 8x8 blocks of a band to it. The sums over the rows
+ * of every column are accumulated laneCount columns at a time and then
+ * added up per block; blocks at the edges may be smaller.
+ */
+auto compareStructure(
+  const Image& a, const Image& b, int top, int rows,
+  std::vector<float>& scratch, BandDifference& band
+) -> void {
+  const auto width{static_cast<std::size_t>(a.width)};
+  const std::size_t padded{(width + laneCount - 1)/laneCount*laneCount};
+  // Luma of both images for every row, then five sums per column.
+  scratch.assign(padded*(2*rows + 5), 0.f);
+  float* lumaA{scratch.data()};
+  float* lumaB{lumaA + padded*rows};
+  float* sums{lumaB + padded*rows};
+  for (int row{0}; row < rows; ++row) {
+    const std::size_t offset{(top + row)*width*4};
+    toLuma(a.pixels.data() + offset, width, lumaA + row*padded);
+    toLuma(b.pixels.data() + offset, width, lumaB + row*padded);
+  }
+  for (std::size_t column{0}; column < padded; column += laneCount) {
+    for (std::size_t part{0}; part < nativeCount; ++part) {
+      const std::size_t start{column + part*nativeWidth};
+      NativeFloats sumX{nativeSet(0.f)};
+      NativeFloats sumY{nativeSet(0.f)};
+      NativeFloats sumXX{nativeSet(0.f)};
+      NativeFloats sumYY{nativeSet(0.f)};
+      NativeFloats sumXY{nativeSet(0.f)};
+      for (int row{0}; row < rows; ++row) {
+        const NativeFloats x{nativeLoad(lumaA + row*padded + start)};
+        const NativeFloats y{nativeLoad(lumaB + row*padded + start)};
+        sumX = nativeAdd(sumX, x);
+        sumY = nativeAdd(sumY, y);
+        sumXX = nativeAdd(sumXX, nativeMul(x, x));
+        sumYY = nativeAdd(sumYY, nativeMul(y, y));
+        sumXY = nativeAdd(sumXY, nativeMul(x, y));
+      }
+      nativeStore(sums + start, sumX);
+      nativeStore(sums + padded + start, sumY);
+      nativeStore(sums + 2*padded + start, sumXX);
+      nativeStore(sums + 3*padded + start, sumYY);
+      nativeStore(sums + 4*padded + start, sumXY);
+    }
+  }
+  for (std::size_t left{0}; left < width; left += blockSize) {
+    const std::size_t right{std::min(left + blockSize, width)};
+    double block[5]{};
+    for (std::size_t sum{0}; sum < 5; ++sum) {
+      for (std::size_t column{left}; column < right; ++column) {
+        block[sum] += sums[sum*padded + column];
+      }
+    }
+    const double count{static_cast<double>((right - left)*rows)};
+    const double meanX{block[0]/count};
+    const double meanY{block[1]/count};
+    const double varianceX{block[2]/count - meanX*meanX};
+    const double varianceY{block[3]/count - meanY*meanY};
+    const double covariance{block[4]/count - meanX*meanY};
+    band.ssim += (2.*meanX*meanY + ssimC1)*(2.*covariance + ssimC2)
+      /((meanX*meanX + meanY*meanY + ssimC1)
+        *(varianceX + varianceY + ssimC2));
+    ++band.blocks;
+  }
+}
+
+auto formatTime(float time) -> std::string {
+  std::ostringstream stream{};
+  stream << time;
+  return stream.str();
+}
+
+auto isNumber(const std::string& field) -> bool {
+  std::istringstream stream{field};
+  float value{};
+  return (stream >> value) && stream.peek() == EOF;
+}
+
+} // namespace
+
+auto compareImages(
+  const Image& a, const Image& b, ThreadPool& pool
+) -> ImageDifference {
+  const auto bands{static_cast<std::size_t>(
+    (a.height + bandHeight - 1)/bandHeight
+  )};
+  std::vector<BandDifference> results(bands);
+  std::vector<std::vector<float>> scratch(pool.getThreadCount());
+  pool.run(bands, [&](std::size_t index, std::size_t worker) {
+    const int top{static_cast<int>(index)*bandHeight};
+    const int rows{std::min(bandHeight, a.height - top)};
+    const std::size_t offset{static_cast<std::size_t>(top)*a.width*4};
+    const std::size_t count{static_cast<std::size_t>(rows)*a.width*4};
+    compareChannels(
+      a.pixels.data() + offset, b.pixels.data() + offset, count,
+      results[index]
+    );
+    compareStructure(a, b, top, rows, scratch[worker], results[index]);
+  });
+  BandDifference total{};
+  for (const BandDifference& band : results) {
+    total.maxError = std::max(total.maxError, band.maxError);
+    total.squaredError += band.squaredError;
+    total.ssim += band.ssim;
+    total.blocks += band.blocks;
+  }
+  const double meanSquaredError{
+    total.squaredError/(static_cast<double>(a.width)*a.height*4)
+  };
+  return {
+    total.maxError,
+    meanSquaredError > 0.
+      ? 10.*std::log10(255.*255./meanSquaredError)
+      : std::numeric_limits<double>::infinity(),
+    total.blocks > 0 ? total.ssim/static_cast<double>(total.blocks) : 1.
+  };
+}
+
+auto makeHeatmap(const Image& a, const Image& b, ThreadPool& pool) -> Image {
+  Image heatmap{a.width, a.height, std::vector<std::uint8_t>(a.pixels.size())};
+  const auto bands{static_cast<std::size_t>(
+    (a.height + bandHeight - 1)/bandHeight
+  )};
+  pool.run(bands, [&](std::size_t index, std::size_t) {
+    const std::size_t top{index*bandHeight};
+    const std::size_t bottom{
+      std::min(top + bandHeight, static_cast<std::size_t>(a.height))
+    };
+    const std::size_t width{static_cast<std::size_t>(a.width)};
+    for (std::size_t i{top*width*4}; i < bottom*width*4; i += 4) {
+      int difference{0};
+      for (std::size_t channel{0}; channel < 4; ++channel) {
+        difference = std::max(
+          difference, std::abs(a.pixels[i + channel] - b.pixels[i + channel])
+        );
+      }
+      // Three ramps of 255 steps each: red, then green, then blue.
+      const int level{std::min(difference, heatmapRange)*765/heatmapRange};
+      heatmap.pixels[i] = static_cast<std::uint8_t>(std::min(level, 255));
+      heatmap.pixels[i + 1] = static_cast<std::uint8_t>(
+        std::clamp(level - 255, 0, 255)
+      );
+      heatmap.pixels[i + 2] = static_cast<std::uint8_t>(
+        std::clamp(level - 510, 0, 255)
+      );
+      heatmap.pixels[i + 3] = 255;
+    }
+  });
+  return heatmap;
+}
+
+auto loadGoldenList(
+  const std::string& path, const std::optional<std::string>& vertexPath
+) -> std::optional<std::vector<GoldenEntry>> {
+  const std::optional<std::string> text{readFile(path)};
+  if (!text) {
+    std::cerr << "Failed to read golden image list " << path << '\n';
+    return {};
+  }
+  const std::filesystem::path directory{
+    std::filesystem::path{path}.parent_path()
+  };
+  std::vector<GoldenEntry> entries{};
+  std::istringstream lines{*text};
+  std::string line{};
+  while (std::getline(lines, line)) {
+    std::istringstream fields{line};
+    std::vector<std::string> paths{};
+    std::vector<float> times{};
+    std::string field{};
+    bool valid{true};
+    while (fields >> field && field.front() != '#') {
+      if (isNumber(field)) {
+        times.push_back(std::stof(field));
+      } else if (times.empty()) {
+        paths.push_back((directory / field).lexically_normal().string());
+      } else {
+        valid = false;
+      }
+    }
+    if (times.empty()) {
+      times.push_back(0.f);
+    }
+    if (valid && paths.size() == 1) {
+      entries.push_back({vertexPath.value_or(""), paths.front(), times});
+    } else if (valid && paths.size() == 2) {
+      entries.push_back({paths.front(), paths.back(), times});
+    } else if (!paths.empty() || !valid) {
+      std::cerr << "Invalid golden image entry \"" << line << "\"\n";
+    }
+  }
+  if (entries.empty()) {
+    std::cerr << "Golden image list " << path << " has no shaders\n";
+    return {};
+  }
+  return entries;
+}
+
+auto runGoldenTests(
+  const GoldenSettings& settings, const std::vector<GoldenEntry>& entries,
+  ShaderPreprocessor& preprocessor, const GoldenRenderer& renderer,
+  std::size_t threadCount
+) -> bool {
+  ThreadPool pool{threadCount};
+  const std::filesystem::path referenceDirectory{
+    std::filesystem::path{settings.listPath}.parent_path()
+  };
+  const std::filesystem::path outputDirectory{settings.outputDirectory};
+  std::size_t passed{0};
+  std::size_t failed{0};
+  std::size_t updated{0};
+  std::chrono::steady_clock::duration compareTime{};
+  const auto writeOutput{[&](const std::string& name, const Image& image) {
+    std::error_code error{};
+    std::filesystem::create_directories(outputDirectory, error);
+    const std::filesystem::path path{outputDirectory / name};
+    if (writeImage(path.string(), image)) {
+      std::cerr << "  wrote " << path.string() << '\n';
+    } else {
+      std::cerr << "  failed to write " << path.string() << '\n';
+    }
+  }};
+  for (const GoldenEntry& entry : entries) {
+    std::optional<ShaderSource> vertex{};
+    if (entry.vertexPath.empty()) {
+      vertex = ShaderSource::fromLiteral(defaultVertexSource);
+    } else {
+      vertex = preprocessor.process(entry.vertexPath, settings.defines);
+    }
+    std::optional<ShaderSource> fragment{
+      preprocessor.process(entry.fragmentPath, settings.defines)
+    };
+    std::optional<std::vector<Image>> images{};
+    if (vertex && fragment) {
+      images = renderer(
+        {std::move(*vertex), std::move(*fragment)}, entry.times
+      );
+    }
+    if (!images) {
+      std::cerr << "Failed to build " << entry.fragmentPath << '\n';
+      failed += entry.times.size();
+      continue;
+    }
+    const std::filesystem::path fragmentPath{entry.fragmentPath};
+    for (std::size_t i{0}; i < entry.times.size(); ++i) {
+      const Image& actual{images->at(i)};
+      const std::string name{
+        fragmentPath.stem().string() + '@' + formatTime(entry.times[i])
+      };
+      const std::filesystem::path referencePath{
+        referenceDirectory / (name + ".pam")
+      };
+      if (settings.update) {
+        if (writeImage(referencePath.string(), actual)) {
+          std::cout << "Updated " << referencePath.string() << '\n';
+          ++updated;
+        } else {
+          std::cerr << "Failed to write " << referencePath.string() << '\n';
+          ++failed;
+        }
+        continue;
+      }
+      std::ostringstream label{};
+      label << fragmentPath.filename().string() << " at "
+        << formatTime(entry.times[i]) << " s";
+      const std::optional<Image> reference{readImage(referencePath.string())};
+      if (
+        !reference || reference->width != actual.width
+        || reference->height != actual.height
+      ) {
+        std::cerr << label.str() << ": "
+          << (reference ? "the reference has a different size"
+            : "no reference; run with --golden-update to create it")
+          << '\n';
+        writeOutput(name + "-actual.pam", actual);
+        ++failed;
+        continue;
+      }
+      const auto compareStart{std::chrono::steady_clock::now()};
+      const ImageDifference difference{compareImages(*reference, actual, pool)};
+      compareTime += std::chrono::steady_clock::now() - compareStart;
+      const bool pass{difference.maxError <= settings.maxError};
+      std::ostringstream report{};
+      report << label.str() << ": max error " << difference.maxError
+        << ", PSNR " << std::setprecision(4) << difference.psnr << " dB, SSIM "
+        << std::fixed << difference.ssim << (pass ? " (pass)" : " (FAIL)")
+        << '\n';
+      if (pass) {
+        std::cout << report.str();
+        ++passed;
+      } else {
+        std::cerr << report.str();
+        writeOutput(name + "-actual.pam", actual);
+        writeOutput(name + "-diff.ppm", makeHeatmap(*reference, actual, pool));
+        ++failed;
+      }
+    }
+  }
+  if (settings.update) {
+    std::cout << "Updated " << updated << " golden images (" << failed
+      << " failed)\n";
+  } else {
+    const std::chrono::duration<double, std::milli> milliseconds{compareTime};
+    std::cout << "Golden images: " << passed << " passed, " << failed
+      << " failed (compared in " << milliseconds.count() << " ms on "
+      << pool.getThreadCount() << " threads)\n";
+  }
+  return failed == 0;
+}
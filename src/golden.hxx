@@ -0,0 +1,78 @@
+#ifndef GOLDEN_HXX
+#define GOLDEN_HXX
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "image.hxx"
+#include "parameters.hxx"
+#include "preprocessor.hxx"
+#include "threadpool.hxx"
+
+struct ImageDifference {
+  // The largest difference of any channel of any pixel, from 0 to 255.
+  int maxError;
+  // Infinite for identical images.
+  double psnr;
+  // The mean structural similarity of the luma over 8x8 blocks, up to 1.
+  double ssim;
+};
+
+/**
+ * Compares two images of the same size. The rows are split into bands that
+ * the pool compares in parallel, laneCount values at a time.
+ */
+auto compareImages(
+  const Image& a, const Image& b, ThreadPool& pool
+) -> ImageDifference;
+// Shows the largest channel difference of every pixel on a ramp from black
+// (none) through red and yellow to white (64 or more).
+auto makeHeatmap(const Image& a, const Image& b, ThreadPool& pool) -> Image;
+
+struct GoldenEntry {
+  // Empty for the default vertex shader.
+  std::string vertexPath;
+  std::string fragmentPath;
+  std::vector<float> times;
+};
+
+/**
+ * Reads a list file with one "[<vertex>] <fragment> [<time>...]" entry per
+ * line; numbers are times in seconds (default: 0). Relative paths are
+ * relative to the list file.
+ */
+auto loadGoldenList(
+  const std::string& path, const std::optional<std::string>& vertexPath
+) -> std::optional<std::vector<GoldenEntry>>;
+
+struct GoldenSettings {
+  std::string listPath;
+  std::string outputDirectory;
+  int maxError;
+  // Writes the rendered images as the new references instead of comparing.
+  bool update;
+  // Defined in every shader, as with -D.
+  ShaderDefines defines;
+};
+
+// Renders one image per time, or nothing if the shaders fail to build.
+using GoldenRenderer = std::function<std::optional<std::vector<Image>>(
+  const ShaderSources& sources, const std::vector<float>& times
+)>;
+
+/**
+ * Renders every entry and compares the images with the references next to
+ * the list file, named "<fragment name>@<time>.pam". The rendered image and
+ * a heatmap of each failure go to the output directory. Returns whether
+ * every image matched within the maximum error.
+ */
+auto runGoldenTests(
+  const GoldenSettings& settings, const std::vector<GoldenEntry>& entries,
+  ShaderPreprocessor& preprocessor, const GoldenRenderer& renderer,
+  std::size_t threadCount
+) -> bool;
+
+#endif // GOLDEN_HXX
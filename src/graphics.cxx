@@ -1,5 +1,9 @@
 #include "graphics.hxx"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -9,61 +13,92 @@
 #include <GLFW/glfw3.h>
 
 #include "debug.hxx"
+#include "mesh.hxx"
+#include "procedural.hxx"
+#include "trace.hxx"
 
-#ifdef DEBUG
-auto debugMessageCallbackGL(
-  GLenum /*source*/, GLenum /*type*/, GLuint /*id*/, GLenum /*severity*/,
-  GLsizei /*length*/, const GLchar* message, const void* /*userParam*/
-) -> void {
-  LOG_ERROR("GL error: " << message << '\n');
-}
-#endif
+namespace {
+
+// Whether links run in the background and GL_COMPLETION_STATUS is available.
+bool parallelShaderCompile{false};
+
+} // namespace
 
 ShaderData::ShaderData(
-  GLuint program_, GLuint vao_, GLsizei indexCount_, GLint timeLocation_,
-  GLint resolutionLocation_
+  GLuint program_, GLuint vao_, GLsizei indexCount_, GLenum indexType_,
+  GLint timeLocation_, GLint resolutionLocation_, bool usesInputBlock_
 ) : program{program_}, vao{vao_}, indexCount{indexCount_},
-    timeLocation{timeLocation_}, resolutionLocation{resolutionLocation_} {}
+    indexType{indexType_}, timeLocation{timeLocation_}, resolutionLocation{resolutionLocation_},
+    usesInputBlock{usesInputBlock_} {}
 
 GraphicsEngine::GraphicsEngine(
   GLFWwindow* window, const std::optional<ShaderSources>& sources,
-  GeometryType modelType
-) : _window{window} {
-  if (!initializeGL()) {
+  GeometryType modelType, const GeometrySettings& geometrySettings,
+  const std::optional<ProgramCacheSettings>& cacheSettings,
+  DebugMessageQueue* debugMessages
+) : _window{window}, _geometrySettings{geometrySettings} {
+  if (!initializeGL(debugMessages)) {
     throw std::runtime_error{"Failed to initialize OpenGL"};
   }
+  if (cacheSettings) {
+    _programCache = std::make_unique<ProgramCache>(
+      cacheSettings->directory, cacheSettings->maxBytes
+    );
+  }
+  _inputBuffer = std::make_unique<InputBuffer>();
+  glfwGetFramebufferSize(_window, &_framebufferWidth, &_framebufferHeight);
+  if (!selectGeometry(modelType)) {
+    throw std::runtime_error{"Failed to load the model"};
+  }
   if (sources) {
-    resetWith(sources, modelType);
+    resetWith(sources, {});
   }
 }
 
 GraphicsEngine::~GraphicsEngine() {
+  for (const GLsync fence : _framesInFlight) {
+    glDeleteSync(fence);
+  }
+  releasePasses();
   if (!_shaderData) {
     return;
   }
   glDeleteVertexArrays(1, &_shaderData->vao);
-  glDeleteProgram(_shaderData->program);
+  if (_ownsProgram) {
+    glDeleteProgram(_shaderData->program);
+  }
 }
 
-auto GraphicsEngine::initializeGL() -> bool {
+auto GraphicsEngine::initializeGL(
+  DebugMessageQueue* debugMessages
+) -> bool {
   if (!gladLoadGL(glfwGetProcAddress)) {
     return false;
   }
-#ifdef DEBUG
-  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-  glDebugMessageCallback(debugMessageCallbackGL, nullptr);
-  // if (GLAD_GL_ARB_debug_output) {
-  //   LOG("GL extension GL_ARB_debug_output available\n");
-  //   glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB);
-  //   glDebugMessageCallbackARB(debugMessageCallbackGL, nullptr /*userParam*/);
-  // }
-  // else {
-  //   LOG("GL extension GL_ARB_debug_output unavailable\n");
-  // }
-#endif
+  // Let the driver use as many compiler threads as it likes.
+  if (GLAD_GL_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    parallelShaderCompile = true;
+  } else if (GLAD_GL_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    parallelShaderCompile = true;
+  }
+  LOG("Parallel shader compilation "
+    << (parallelShaderCompile ? "available" : "unavailable") << '\n');
+  if (debugMessages) {
+    debugMessages->install();
+  }
   return true;
 }
 
+auto GraphicsEngine::getRendererString() -> std::string {
+  return reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+}
+
+auto GraphicsEngine::getVersionString() -> std::string {
+  return reinterpret_cast<const char*>(glGetString(GL_VERSION));
+}
+
 auto GraphicsEngine::resetWith(
   const std::optional<ShaderSources>& shaderSources,
   const std::optional<GeometryType>& modelType
@@ -71,90 +106,489 @@ auto GraphicsEngine::resetWith(
   if (!_shaderData && !shaderSources) {
     return;
   }
-  if (!shaderSources && !modelType) {
+  // A model that fails to load leaves the current one in place.
+  const bool modelChanged{modelType && selectGeometry(*modelType)};
+  if (!shaderSources && !modelChanged) {
     return;
   }
 
   if (_shaderData) {
-    if (shaderSources) {
+    if (shaderSources && _ownsProgram) {
       glDeleteProgram(_shaderData->program);
     }
-    if (modelType) {
+    if (modelChanged) {
       glDeleteVertexArrays(1, &_shaderData->vao);
     }
   }
   const std::optional<GLuint> program{
     (shaderSources || !_shaderData)
-    ? createProgram(*shaderSources)
+    ? createProgram(*shaderSources, _programCache.get())
     : _shaderData->program
   };
-  if (modelType) {
-    _model = Geometry::createGeometryFromType(*modelType);
+  if (modelChanged) {
+    for (ShaderData& data : _passData) {
+      glDeleteVertexArrays(1, &data.vao);
+      data = createShaderData(data.program);
+    }
   }
   if (program) {
-    const GLuint vao{createVertexArrayForModel(*program, _model.get())};
-    const GLint timeLocation{glGetUniformLocation(*program, "time")};
-    const GLint resolutionLocation{
-      glGetUniformLocation(*program, "resolution")
-    };
-    _shaderData = {
-      *program, vao, static_cast<GLsizei>(_model->getIndexCount()),
-      timeLocation, resolutionLocation
-    };
+    if (shaderSources) {
+      _ownsProgram = true;
+    }
+    installProgram(*program);
     resetTime();
   }
 }
 
+auto GraphicsEngine::adoptProgram(GLuint program) -> void {
+  releaseProgram();
+  _ownsProgram = true;
+  // Keep the clock running so that animations continue across reloads.
+  installProgram(program);
+}
+
+auto GraphicsEngine::showProgram(GLuint program) -> void {
+  releaseProgram();
+  _ownsProgram = false;
+  installProgram(program);
+  resetTime();
+}
+
 auto GraphicsEngine::hasValidData() -> bool {
   return _shaderData.has_value();
 }
 
+auto GraphicsEngine::isStatic() const -> bool {
+  // Unused uniforms have no location, so a program without one for time
+  // (or for the input block) draws the same image every frame.
+  if (
+    !_shaderData || _shaderData->timeLocation >= 0
+    || _shaderData->usesInputBlock || (_channels && _channels->isAnimated())
+  ) {
+    return false;
+  }
+  if (_renderGraph) {
+    if (_renderGraph->hasFeedback()) {
+      return false;
+    }
+    for (const ShaderData& data : _passData) {
+      if (data.timeLocation >= 0 || data.usesInputBlock) {
+        return false;
+      }
+    }
+  }
+  return !_progressive || _progressive->hasFinishedImage();
+}
+
+auto GraphicsEngine::setFramebufferSize(int width, int height) -> void {
+  _framebufferWidth = width;
+  _framebufferHeight = height;
+}
+
+auto GraphicsEngine::setMouse(double x, double y, bool pressed) -> void {
+  _inputs.mouse[0] = static_cast<GLfloat>(x);
+  _inputs.mouse[1] = static_cast<GLfloat>(y);
+  _inputs.mouse[2] = pressed ? 1.f : 0.f;
+}
+
+auto GraphicsEngine::setFixedTime(const std::optional<GLfloat>& time) -> void {
+  _fixedTime = time;
+  resetTime();
+}
+
+auto GraphicsEngine::setFrameClock(
+  const std::optional<FrameClock>& clock
+) -> void {
+  _clock = clock;
+  resetTime();
+}
+
+auto GraphicsEngine::setOffscreenTarget(
+  GLsizei width, GLsizei height
+) -> void {
+  if (_offscreen) {
+    _offscreen->resize(width, height);
+  } else {
+    _offscreen = std::make_unique<Framebuffer>(width, height);
+  }
+}
+
 auto GraphicsEngine::render() -> void {
   if (!_shaderData) {
     return;
   }
+  TRACE_SPAN("gl", "render");
   int width{};
   int height{};
-  glfwGetFramebufferSize(_window, &width, &height);
-  glViewport(0, 0, width, height);
+  GLuint framebuffer{};
+  if (_offscreen) {
+    width = _offscreen->getWidth();
+    height = _offscreen->getHeight();
+    framebuffer = _offscreen->getFramebuffer();
+  } else {
+    width = _framebufferWidth;
+    height = _framebufferHeight;
+  }
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  // The scene may be rendered at a lower resolution and upscaled.
+  GLsizei renderWidth{width};
+  GLsizei renderHeight{height};
+  GLuint renderTarget{framebuffer};
+  const double scale{_scaler ? _scaler->update() : 1.};
+  if (scale < 1.) {
+    renderWidth = std::max(static_cast<GLsizei>(std::lround(width*scale)), 1);
+    renderHeight = std::max(
+      static_cast<GLsizei>(std::lround(height*scale)), 1
+    );
+    if (_scaled) {
+      _scaled->resize(renderWidth, renderHeight);
+    } else {
+      _scaled = std::make_unique<Framebuffer>(renderWidth, renderHeight);
+    }
+    renderTarget = _scaled->getFramebuffer();
+  }
+  if (_scaler) {
+    _scaler->beginMeasure();
+  }
   glClearColor(0., .5, 1., 1.);
-  glClear(GL_COLOR_BUFFER_BIT);
-  if (_shaderData) {
-    glUseProgram(_shaderData->program);
-    const GLfloat elapsed = static_cast<GLfloat>(glfwGetTime()) - _initialTime;
-    glUniform1f(_shaderData->timeLocation, elapsed);
-    glUniform2i(_shaderData->resolutionLocation, width, height);
-    glBindVertexArray(_shaderData->vao);
-    glDrawElements(
-      GL_TRIANGLES, _shaderData->indexCount, GL_UNSIGNED_SHORT, nullptr
+  const GLfloat elapsed{getFrameTime()};
+  updateFrameInputs(elapsed);
+  if (_progressive && !_renderGraph) {
+    if (_progressive->beginFrame(renderWidth, renderHeight)) {
+      _imageTime = elapsed;
+    }
+    updateChannels(_imageTime);
+    _progressive->renderTiles([this](GLsizei levelWidth, GLsizei levelHeight) {
+      drawModel(*_shaderData, levelWidth, levelHeight, _imageTime);
+    });
+    _progressive->present(renderTarget);
+  } else {
+    updateChannels(elapsed);
+    if (_renderGraph) {
+      _renderGraph->execute(
+        renderWidth, renderHeight,
+        [this, elapsed](std::size_t pass, GLsizei passWidth,
+          GLsizei passHeight) {
+          drawModel(_passData.at(pass), passWidth, passHeight, elapsed);
+        }
+      );
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTarget);
+    glViewport(0, 0, renderWidth, renderHeight);
+    glClear(GL_COLOR_BUFFER_BIT);
+    drawModel(*_shaderData, renderWidth, renderHeight, elapsed);
+    if (_renderGraph) {
+      _renderGraph->endFrame();
+    }
+  }
+  if (_scaler) {
+    _scaler->endMeasure();
+  }
+  if (renderTarget != framebuffer) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, renderTarget);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glBlitFramebuffer(
+      0, 0, renderWidth, renderHeight, 0, 0, width, height,
+      GL_COLOR_BUFFER_BIT, GL_LINEAR
     );
-    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  }
+  if (_capture) {
+    _capture->capture(framebuffer, width, height);
+  }
+  if (_offscreen) {
+    throttleOffscreenFrames();
+  }
+}
+
+auto GraphicsEngine::setResolutionScaling(
+  const std::optional<ResolutionScaleSettings>& settings
+) -> void {
+  if (settings) {
+    _scaler = std::make_unique<ResolutionScaler>(*settings);
+  } else {
+    _scaler.reset();
+    _scaled.reset();
+  }
+}
+
+auto GraphicsEngine::setProgressive(
+  const std::optional<ProgressiveSettings>& settings
+) -> void {
+  if (settings) {
+    _progressive = std::make_unique<ProgressiveRenderer>(*settings);
+  } else {
+    _progressive.reset();
   }
 }
 
+auto GraphicsEngine::drawModel(
+  ShaderData& data, GLsizei width, GLsizei height, GLfloat time
+) -> void {
+  if (_boundProgram != data.program) {
+    glUseProgram(data.program);
+    _boundProgram = data.program;
+  }
+  if (data.timeLocation >= 0 && data.lastTime != time) {
+    glUniform1f(data.timeLocation, time);
+    data.lastTime = time;
+  }
+  if (
+    data.resolutionLocation >= 0
+    && (data.lastResolution[0] != width || data.lastResolution[1] != height)
+  ) {
+    glUniform2i(data.resolutionLocation, width, height);
+    data.lastResolution[0] = width;
+    data.lastResolution[1] = height;
+  }
+  if (data.usesInputBlock) {
+    _inputs.resolution[0] = width;
+    _inputs.resolution[1] = height;
+    _inputs.time = time;
+    _inputBuffer->update(_inputs);
+  }
+  if (_boundVertexArray != data.vao) {
+    glBindVertexArray(data.vao);
+    _boundVertexArray = data.vao;
+  }
+  if (_instances) {
+    glDrawElementsInstanced(
+      GL_TRIANGLES, data.indexCount, data.indexType, nullptr,
+      _instances->getCount()
+    );
+  } else {
+    glDrawElements(GL_TRIANGLES, data.indexCount, data.indexType, nullptr);
+  }
+  const auto instances{
+    static_cast<std::uint64_t>(_instances ? _instances->getCount() : 1)
+  };
+  _drawCounts.vertices += _geometry->vertexCount*instances;
+  _drawCounts.triangles += static_cast<std::uint64_t>(data.indexCount/3)
+    *instances;
+}
+
+auto GraphicsEngine::updateChannels(GLfloat time) -> void {
+  if (_channels) {
+    // Deterministic frames wait for the sequence frames they show.
+    _channels->update(time, _clock || _fixedTime);
+  }
+}
+
+auto GraphicsEngine::updateFrameInputs(GLfloat time) -> void {
+  _inputBuffer->beginFrame();
+  if (_clock) {
+    // The first frame of a shard still follows a frame of the clock.
+    _inputs.deltaTime = _inputs.frame > 0
+      ? static_cast<GLfloat>(1./_clock->fps) : 0.f;
+  } else {
+    _inputs.deltaTime = _inputs.frame > 0 ? time - _lastFrameTime : 0.f;
+  }
+  _lastFrameTime = time;
+  ++_inputs.frame;
+  // The date would make images at a fixed time differ from day to day.
+  if (!_fixedTime && !_clock) {
+    updateDate(_inputs);
+  }
+}
+
+auto GraphicsEngine::selectGeometry(GeometryType type) -> bool {
+  std::string key{};
+  GeometryCache::Loader load{};
+  const auto report{[](
+    const std::string& verb, const std::string& name, const Mesh& mesh,
+    std::chrono::steady_clock::time_point startTime
+  ) {
+    const std::chrono::duration<double, std::milli> elapsed{
+      std::chrono::steady_clock::now() - startTime
+    };
+    std::cout << verb << ' ' << name << ": " << mesh.getVertexCount()
+      << " vertices, " << mesh.getIndexCount()/3 << " triangles in "
+      << elapsed.count() << " ms\n";
+  }};
+  const std::optional<std::string>& meshPath{_geometrySettings.meshPath};
+  if (type == GeometryType::Mesh) {
+    if (!meshPath) {
+      std::cerr << "No mesh to show; pass one with --mesh\n";
+      return false;
+    }
+    key = "mesh:" + *meshPath;
+    load = [&meshPath, &report]() -> std::unique_ptr<Geometry> {
+      const auto startTime{std::chrono::steady_clock::now()};
+      std::unique_ptr<Mesh> mesh{loadMesh(*meshPath)};
+      if (mesh) {
+        report("Loaded", *meshPath, *mesh, startTime);
+      }
+      return mesh;
+    };
+  } else if (
+    type == GeometryType::Plane || type == GeometryType::Sphere
+    || type == GeometryType::Cube
+  ) {
+    const std::string name{
+      type == GeometryType::Plane ? "plane"
+        : type == GeometryType::Sphere ? "sphere" : "cube"
+    };
+    key = name + ':' + std::to_string(_geometrySettings.subdivisions);
+    load = [this, type, name, &report]() -> std::unique_ptr<Geometry> {
+      const auto startTime{std::chrono::steady_clock::now()};
+      std::unique_ptr<Mesh> mesh{createProceduralGeometry(
+        type, _geometrySettings.subdivisions, _geometrySettings.threadCount
+      )};
+      if (mesh) {
+        report("Generated", name, *mesh, startTime);
+      }
+      return mesh;
+    };
+  } else {
+    key = type == GeometryType::Rectangle ? "rectangle" : "triangle";
+    load = [type]() { return Geometry::createGeometryFromType(type); };
+  }
+  const GeometryBuffers* geometry{_geometryCache.acquire(key, load)};
+  _boundVertexArray = 0;
+  if (!geometry) {
+    return false;
+  }
+  // Acquire before releasing, so that selecting the current geometry again
+  // does not upload it again.
+  if (_geometry) {
+    _geometryCache.release(_geometryKey);
+  }
+  _geometry = geometry;
+  _geometryKey = key;
+  return true;
+}
+
+auto GraphicsEngine::throttleOffscreenFrames() -> void {
+  // Without a swap chain nothing stops the CPU from queueing an unbounded
+  // number of frames, which would delay everything else the loop does
+  // (e.g. reacting to file changes) by seconds.
+  _framesInFlight.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+  if (_framesInFlight.size() <= maxOffscreenFramesInFlight) {
+    return;
+  }
+  const GLsync fence{_framesInFlight.front()};
+  _framesInFlight.pop_front();
+  glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+  glDeleteSync(fence);
+}
+
+auto GraphicsEngine::finish() -> void {
+  glFinish();
+}
+
+auto GraphicsEngine::startCapture(const CaptureSettings& settings) -> void {
+  _capture = std::make_unique<FrameCapture>(settings);
+}
+
+auto GraphicsEngine::stopCapture() -> std::optional<CaptureStatistics> {
+  if (!_capture) {
+    return {};
+  }
+  _capture->finish();
+  const CaptureStatistics statistics{_capture->getStatistics()};
+  _capture.reset();
+  return statistics;
+}
+
+auto GraphicsEngine::getDrawCounts() const -> DrawCounts {
+  return _drawCounts;
+}
+
+auto GraphicsEngine::readPixels() -> std::vector<std::uint8_t> {
+  if (!_offscreen) {
+    return {};
+  }
+  const GLsizei width{_offscreen->getWidth()};
+  const GLsizei height{_offscreen->getHeight()};
+  std::vector<std::uint8_t> pixels(static_cast<std::size_t>(width)*height*4);
+  glBindFramebuffer(GL_FRAMEBUFFER, _offscreen->getFramebuffer());
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return pixels;
+}
+
+auto GraphicsEngine::getProgramCache() -> ProgramCache* {
+  return _programCache.get();
+}
+
 auto GraphicsEngine::createShader(
-  GLenum type, std::string_view source
+  GLenum type, const ShaderSource& source
 ) -> GLuint {
+  TRACE_SPAN("shader", "compile");
   GLuint shader{glCreateShader(type)};
-  const GLchar* sources[]{source.data()};
-  const GLint lengths[]{static_cast<GLint>(source.size())};
-  glShaderSource(shader, 1, sources, lengths);
+  // Pass the segments as they are instead of concatenating them.
+  std::vector<const GLchar*> strings{};
+  std::vector<GLint> lengths{};
+  strings.reserve(source.segments.size());
+  lengths.reserve(source.segments.size());
+  for (const std::string_view segment : source.segments) {
+    strings.push_back(segment.data());
+    lengths.push_back(static_cast<GLint>(segment.size()));
+  }
+  glShaderSource(
+    shader, static_cast<GLsizei>(strings.size()), strings.data(),
+    lengths.data()
+  );
   glCompileShader(shader);
   return shader;
 }
 
 auto GraphicsEngine::createProgram(
-  const ShaderSources& sources
+  const ShaderSources& sources, ProgramCache* cache
 ) -> std::optional<GLuint> {
+  return finishProgram(beginProgram(sources, cache), sources, cache);
+}
+
+auto GraphicsEngine::beginProgram(
+  const ShaderSources& sources, ProgramCache* cache
+) -> PendingProgram {
+  if (cache) {
+    if (const std::optional<GLuint> program{cache->load(sources)}) {
+      return {*program, 0, 0};
+    }
+  }
   GLuint vertexShader{createShader(GL_VERTEX_SHADER, sources.vertex)};
   GLuint fragmentShader{createShader(GL_FRAGMENT_SHADER, sources.fragment)};
   GLuint program{glCreateProgram()};
   glAttachShader(program, vertexShader);
   glAttachShader(program, fragmentShader);
+  if (cache) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  // Querying anything about the program here would wait for the link.
+  TRACE_SPAN("shader", "link");
   glLinkProgram(program);
+  return {program, vertexShader, fragmentShader};
+}
+
+auto GraphicsEngine::isProgramReady(const PendingProgram& pending) -> bool {
+  if (!pending.vertexShader || !parallelShaderCompile) {
+    return true;
+  }
+  GLint completed{};
+  glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &completed);
+  return completed;
+}
+
+auto GraphicsEngine::finishProgram(
+  const PendingProgram& pending, const ShaderSources& sources,
+  ProgramCache* cache
+) -> std::optional<GLuint> {
+  if (!pending.vertexShader) {
+    return pending.program;
+  }
+  const GLuint program{pending.program};
+  const GLuint vertexShader{pending.vertexShader};
+  const GLuint fragmentShader{pending.fragmentShader};
   GLint status{};
-  glGetProgramiv(program, GL_LINK_STATUS, &status);
-#ifdef DEBUG
+  {
+    // Waits for the compiler threads, if they are still busy.
+    TRACE_SPAN("shader", "wait for link");
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+  }
   if (!status) {
     GLsizei logLength{};
     std::string log{};
@@ -169,7 +603,8 @@ auto GraphicsEngine::createProgram(
     if (logLength > 0) {
       log.resize(logLength);
       glGetShaderInfoLog(vertexShader, logLength, nullptr, log.data());
-      std::cerr << "GL vertex shader error: " << log << '\n';
+      std::cerr << "GL vertex shader error: "
+        << sources.vertex.remapLog(log) << '\n';
       log.clear();
     }
 
@@ -177,55 +612,175 @@ auto GraphicsEngine::createProgram(
     if (logLength > 0) {
       log.resize(logLength);
       glGetShaderInfoLog(fragmentShader, logLength, nullptr, log.data());
-      std::cerr << "GL fragment shader error: " << log << '\n';
+      std::cerr << "GL fragment shader error: "
+        << sources.fragment.remapLog(log) << '\n';
       log.clear();
     }
   }
-#endif // DEBUG
   glDetachShader(program, vertexShader);
   glDetachShader(program, fragmentShader);
   glDeleteShader(vertexShader);
   glDeleteShader(fragmentShader);
   if (!status) {
+    glDeleteProgram(program);
     return {};
   }
+  if (cache) {
+    cache->store(sources, program);
+  }
   return program;
 }
 
-auto GraphicsEngine::createVertexArrayForModel(
-  GLuint program, const Geometry* model
-) -> GLuint {
-  const GLint positionLocation{glGetAttribLocation(program, "position")};
-  GLuint vao{};
-  glGenVertexArrays(1, &vao);
-  glBindVertexArray(vao);
-
-  GLuint vertexBuffer;
-  glGenBuffers(1, &vertexBuffer);
-  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-  glBufferData(
-    GL_ARRAY_BUFFER, sizeof(GLfloat)*model->getVertexCount(),
-    model->getVertices(), GL_STATIC_DRAW
-  );
+auto GraphicsEngine::setInstanceCount(GLsizei count) -> bool {
+  if (count <= 1) {
+    _instances.reset();
+    return true;
+  }
+  if (!GLAD_GL_VERSION_4_3) {
+    std::cerr << "Instancing needs shader storage buffers (OpenGL 4.3)\n";
+    return false;
+  }
+  _instances = std::make_unique<InstanceBuffer>(count);
+  if (_shaderData) {
+    InstanceBuffer::bindBlock(_shaderData->program);
+  }
+  for (const ShaderData& data : _passData) {
+    InstanceBuffer::bindBlock(data.program);
+  }
+  return true;
+}
 
-  GLuint indexBuffer;
-  glGenBuffers(1, &indexBuffer);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-  glBufferData(
-    GL_ELEMENT_ARRAY_BUFFER, sizeof(GLshort)*model->getIndexCount(),
-    model->getIndices(), GL_STATIC_DRAW
-  );
+auto GraphicsEngine::setTextureChannels(
+  std::unique_ptr<TextureChannels> channels
+) -> void {
+  _channels = std::move(channels);
+  if (_shaderData) {
+    _channels->assignTextureUnits(_shaderData->program);
+  }
+  for (const ShaderData& data : _passData) {
+    _channels->assignTextureUnits(data.program);
+  }
+}
+
+auto GraphicsEngine::setRenderGraph(
+  std::unique_ptr<RenderGraph> graph,
+  const std::vector<ShaderSources>& sources
+) -> bool {
+  // Link every pass at once, so that the driver can work on them together.
+  std::vector<PendingProgram> pending{};
+  pending.reserve(sources.size());
+  for (const ShaderSources& passSources : sources) {
+    pending.push_back(beginProgram(passSources, _programCache.get()));
+  }
+  std::vector<GLuint> programs{};
+  bool failed{false};
+  for (std::size_t p{0}; p < pending.size(); ++p) {
+    const std::optional<GLuint> program{
+      finishProgram(pending.at(p), sources.at(p), _programCache.get())
+    };
+    if (program) {
+      programs.push_back(*program);
+    } else {
+      failed = true;
+    }
+  }
+  if (failed || programs.size() != graph->getPassCount()) {
+    for (const GLuint program : programs) {
+      glDeleteProgram(program);
+    }
+    return false;
+  }
+  const bool firstProgram{!_shaderData};
+  releasePasses();
+  releaseProgram();
+  for (std::size_t p{0}; p < programs.size(); ++p) {
+    graph->assignTextureUnits(p, programs.at(p));
+  }
+  _renderGraph = std::move(graph);
+  const GLuint imageProgram{programs.back()};
+  programs.pop_back();
+  for (const GLuint program : programs) {
+    _passData.push_back(createShaderData(program));
+  }
+  _ownsProgram = true;
+  installProgram(imageProgram);
+  if (firstProgram) {
+    resetTime();
+  }
+  return true;
+}
 
-  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-  glVertexAttribPointer(positionLocation, 3, GL_FLOAT, false, 0, 0);
-  glEnableVertexAttribArray(positionLocation);
-  glBindVertexArray(0);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+auto GraphicsEngine::createShaderData(GLuint program) -> ShaderData {
+  TRACE_SPAN("gl", "create vertex array");
+  const GLuint vao{GeometryCache::createVertexArray(program, *_geometry)};
+  const GLint timeLocation{glGetUniformLocation(program, "time")};
+  const GLint resolutionLocation{
+    glGetUniformLocation(program, "resolution")
+  };
+  const GLuint blockIndex{
+    glGetUniformBlockIndex(program, InputBuffer::blockName)
+  };
+  if (blockIndex != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program, blockIndex, InputBuffer::bindingPoint);
+  }
+  if (_instances) {
+    InstanceBuffer::bindBlock(program);
+  }
+  if (_channels) {
+    _channels->assignTextureUnits(program);
+  }
+  // Creating the vertex array changed the binding, and the previous
+  // program may be gone.
+  _boundProgram = 0;
+  _boundVertexArray = 0;
+  return {
+    program, vao, _geometry->indexCount, _geometry->indexType, timeLocation,
+    resolutionLocation, blockIndex != GL_INVALID_INDEX
+  };
+}
 
-  return vao;
+auto GraphicsEngine::installProgram(GLuint program) -> void {
+  _shaderData = createShaderData(program);
+  if (_progressive) {
+    _progressive->restart();
+  }
+}
+
+auto GraphicsEngine::releaseProgram() -> void {
+  if (!_shaderData) {
+    return;
+  }
+  if (_ownsProgram) {
+    glDeleteProgram(_shaderData->program);
+  }
+  glDeleteVertexArrays(1, &_shaderData->vao);
+  _shaderData.reset();
+}
+
+auto GraphicsEngine::releasePasses() -> void {
+  for (const ShaderData& data : _passData) {
+    glDeleteProgram(data.program);
+    glDeleteVertexArrays(1, &data.vao);
+  }
+  _passData.clear();
+  _renderGraph.reset();
 }
 
 auto GraphicsEngine::resetTime() -> void {
   _initialTime = static_cast<GLfloat>(glfwGetTime());
+  _inputs.frame = _clock ? _clock->firstFrame : 0;
+}
+
+auto GraphicsEngine::getFrameTime() const -> GLfloat {
+  if (_fixedTime) {
+    return *_fixedTime;
+  }
+  if (_clock) {
+    // From the frame number rather than a sum of steps, so that the time of
+    // a frame does not depend on how many frames came before it.
+    return static_cast<GLfloat>(
+      _clock->startTime + _inputs.frame/_clock->fps
+    );
+  }
+  return static_cast<GLfloat>(glfwGetTime()) - _initialTime;
 }
@@ -1,6 +1,9 @@
 #ifndef GRAPHICS_HXX
 #define GRAPHICS_HXX
 
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -8,30 +11,71 @@
 #include <glad/gl.h>
 #define GLFW_INCLUDE_NONE
 
+#include "cache.hxx"
+#include "capture.hxx"
+#include "channels.hxx"
+#include "framebuffer.hxx"
+#include "gldebug.hxx"
+#include "inputs.hxx"
 #include "geometry.hxx"
+#include "geometrycache.hxx"
+#include "instances.hxx"
 #include "parameters.hxx"
+#include "progressive.hxx"
+#include "rendergraph.hxx"
+#include "scaler.hxx"
 
 struct GLFWwindow;
 
+// Totals over every draw so far; vertices count once per instance.
+struct DrawCounts {
+  std::uint64_t vertices{};
+  std::uint64_t triangles{};
+};
+
+// Frame n of a virtual clock shows time startTime + n/fps, whatever the
+// wall clock says.
+struct FrameClock {
+  double fps;
+  double startTime;
+  int firstFrame;
+};
+
 struct ShaderData {
   GLuint program;
   GLuint vao;
   GLsizei indexCount;
+  GLenum indexType;
   GLint timeLocation;
   GLint resolutionLocation;
+  bool usesInputBlock;
+  // Values last set for the plain uniforms, which belong to the program.
+  GLfloat lastTime{-1.};
+  GLint lastResolution[2]{-1, -1};
 
   ShaderData() = delete;
   ShaderData(
-    GLuint program, GLuint vao, GLsizei indexCount, GLint timeLocation,
-    GLint resolutionLocation
+    GLuint program, GLuint vao, GLsizei indexCount, GLenum indexType,
+    GLint timeLocation, GLint resolutionLocation, bool usesInputBlock
   );
 };
 
+// A program whose link may still be running in the background. Programs
+// loaded from the cache have no shaders and are ready immediately.
+struct PendingProgram {
+  GLuint program;
+  GLuint vertexShader;
+  GLuint fragmentShader;
+};
+
 class GraphicsEngine {
 public:
+  // Throws if OpenGL fails to initialize or the model fails to load.
   GraphicsEngine(
     GLFWwindow* window, const std::optional<ShaderSources>& sources,
-    GeometryType modelType
+    GeometryType modelType, const GeometrySettings& geometrySettings,
+    const std::optional<ProgramCacheSettings>& cacheSettings,
+    DebugMessageQueue* debugMessages
   );
   GraphicsEngine() = delete;
   GraphicsEngine(const GraphicsEngine&) = delete;
@@ -40,29 +84,124 @@ public:
   GraphicsEngine operator=(GraphicsEngine&&) = delete;
   ~GraphicsEngine();
 
-  static auto initializeGL() -> bool;
+  // Sends the debug output to the queue, if any.
+  static auto initializeGL(DebugMessageQueue* debugMessages) -> bool;
+  static auto getRendererString() -> std::string;
+  static auto getVersionString() -> std::string;
   auto resetWith(
     const std::optional<ShaderSources>& shaderSources,
     const std::optional<GeometryType>& modelType
   ) -> void;
+  auto adoptProgram(GLuint program) -> void;
+  auto showProgram(GLuint program) -> void;
   auto hasValidData() -> bool;
+  auto isStatic() const -> bool;
+  auto setOffscreenTarget(GLsizei width, GLsizei height) -> void;
+  auto setFramebufferSize(int width, int height) -> void;
+  auto setMouse(double x, double y, bool pressed) -> void;
+  // Renders every frame at the given time instead of the elapsed time. The
+  // frame count restarts and the date stays zero, so the next frame is the
+  // same whatever came before.
+  auto setFixedTime(const std::optional<GLfloat>& time) -> void;
+  // Advances time by exactly one clock frame per rendered frame, starting
+  // from the clock's first frame whenever a program is installed. The date
+  // stays zero.
+  auto setFrameClock(const std::optional<FrameClock>& clock) -> void;
+  auto setResolutionScaling(
+    const std::optional<ResolutionScaleSettings>& settings
+  ) -> void;
+  auto setProgressive(
+    const std::optional<ProgressiveSettings>& settings
+  ) -> void;
+  // Draws every model that many times, with data from an InstanceBuffer.
+  auto setInstanceCount(GLsizei count) -> bool;
+  // Reads back every frame rendered from now on and writes it out.
+  auto startCapture(const CaptureSettings& settings) -> void;
+  // Writes the frames still in flight; empty when not capturing.
+  auto stopCapture() -> std::optional<CaptureStatistics>;
+  // Binds texture channels to the current and later programs.
+  auto setTextureChannels(std::unique_ptr<TextureChannels> channels) -> void;
+  auto setRenderGraph(
+    std::unique_ptr<RenderGraph> graph,
+    const std::vector<ShaderSources>& sources
+  ) -> bool;
   auto render() -> void;
-
-private:
-  static auto createShader(GLenum type, std::string_view source) -> GLuint;
+  auto finish() -> void;
+  auto getDrawCounts() const -> DrawCounts;
+  // The offscreen target as RGBA8, bottom row first; empty without one.
+  auto readPixels() -> std::vector<std::uint8_t>;
+  auto getProgramCache() -> ProgramCache*;
+  // Compiles without waiting for the result.
+  static auto createShader(
+    GLenum type, const ShaderSource& source
+  ) -> GLuint;
   static auto createProgram(
-    const ShaderSources& sources
+    const ShaderSources& sources, ProgramCache* cache
+  ) -> std::optional<GLuint>;
+  static auto beginProgram(
+    const ShaderSources& sources, ProgramCache* cache
+  ) -> PendingProgram;
+  static auto isProgramReady(const PendingProgram& pending) -> bool;
+  static auto finishProgram(
+    const PendingProgram& pending, const ShaderSources& sources,
+    ProgramCache* cache
   ) -> std::optional<GLuint>;
-  static auto createVertexArrayForModel(
-    GLuint program, const Geometry* model
-  ) -> GLuint;
 
+private:
+  auto drawModel(
+    ShaderData& data, GLsizei width, GLsizei height, GLfloat time
+  ) -> void;
+  auto updateFrameInputs(GLfloat time) -> void;
+  auto updateChannels(GLfloat time) -> void;
+  // Keeps the current geometry if the new one fails to load.
+  auto selectGeometry(GeometryType type) -> bool;
+  auto createShaderData(GLuint program) -> ShaderData;
+  auto installProgram(GLuint program) -> void;
+  auto releaseProgram() -> void;
+  auto releasePasses() -> void;
+  auto throttleOffscreenFrames() -> void;
   auto resetTime() -> void;
+  auto getFrameTime() const -> GLfloat;
 
   GLFWwindow* _window;
   std::optional<ShaderData> _shaderData{};
+  // Programs shown with showProgram() belong to the caller.
+  bool _ownsProgram{true};
   GLfloat _initialTime{};
-  std::unique_ptr<Geometry> _model{};
+  std::optional<GLfloat> _fixedTime{};
+  std::optional<FrameClock> _clock{};
+  // Shared by the vertex arrays of every program; _geometry is the one in
+  // use, held under _geometryKey.
+  GeometryCache _geometryCache{};
+  const GeometryBuffers* _geometry{};
+  std::string _geometryKey{};
+  GeometrySettings _geometrySettings;
+  std::unique_ptr<InstanceBuffer> _instances{};
+  DrawCounts _drawCounts{};
+  std::unique_ptr<FrameCapture> _capture{};
+  std::unique_ptr<Framebuffer> _offscreen{};
+  std::unique_ptr<ProgramCache> _programCache{};
+  std::unique_ptr<ProgressiveRenderer> _progressive{};
+  std::unique_ptr<ResolutionScaler> _scaler{};
+  std::unique_ptr<InputBuffer> _inputBuffer{};
+  std::unique_ptr<TextureChannels> _channels{};
+  // The buffer passes of a render graph; the image pass is _shaderData.
+  std::unique_ptr<RenderGraph> _renderGraph{};
+  std::vector<ShaderData> _passData{};
+  ShaderInputs _inputs{};
+  GLfloat _lastFrameTime{};
+  // Tracked by the resize callback rather than queried every frame.
+  int _framebufferWidth{};
+  int _framebufferHeight{};
+  // Bindings as last set here, to skip redundant calls.
+  GLuint _boundProgram{};
+  GLuint _boundVertexArray{};
+  // The internal render target while the resolution is scaled down.
+  std::unique_ptr<Framebuffer> _scaled{};
+  // The time of the image being rendered progressively.
+  GLfloat _imageTime{};
+  std::deque<GLsync> _framesInFlight{};
+  static constexpr std::size_t maxOffscreenFramesInFlight{2};
 };
 
 #endif // GRAPHICS_HXX
@@ -0,0 +1,134 @@
+#include "image.hxx"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "debug.hxx"
+
+namespace {
+
+// Reads the next header token, skipping comments.
+auto readToken(std::istream& stream) -> std::string {
+  std::string token{};
+  while (stream >> token && token.front() == '#') {
+    std::string comment{};
+    std::getline(stream, comment);
+  }
+  return token;
+}
+
+auto readHeader(
+  std::istream& stream, int& width, int& height, int& channels
+) -> bool {
+  const std::string magic{readToken(stream)};
+  int maximum{};
+  if (magic == "P6") {
+    channels = 3;
+    try {
+      width = std::stoi(readToken(stream));
+      height = std::stoi(readToken(stream));
+      maximum = std::stoi(readToken(stream));
+    } catch (const std::exception&) {
+      return false;
+    }
+  } else if (magic == "P7") {
+    channels = 0;
+    while (true) {
+      const std::string key{readToken(stream)};
+      if (key == "ENDHDR" || key.empty()) {
+        break;
+      }
+      const std::string value{readToken(stream)};
+      try {
+        if (key == "WIDTH") {
+          width = std::stoi(value);
+        } else if (key == "HEIGHT") {
+          height = std::stoi(value);
+        } else if (key == "DEPTH") {
+          channels = std::stoi(value);
+        } else if (key == "MAXVAL") {
+          maximum = std::stoi(value);
+        }
+      } catch (const std::exception&) {
+        return false;
+      }
+    }
+  } else {
+    return false;
+  }
+  // A single whitespace character separates the header from the pixels.
+  stream.get();
+  return width > 0 && height > 0 && maximum == 255
+    && (channels == 3 || channels == 4);
+}
+
+} // namespace
+
+auto readImage(const std::string& path) -> std::optional<Image> {
+  std::ifstream stream{path, std::ios::binary};
+  if (!stream) {
+    return {};
+  }
+  Image image{};
+  int channels{};
+  if (!readHeader(stream, image.width, image.height, channels)) {
+    LOG_ERROR("Unsupported image header in " << path << '\n');
+    return {};
+  }
+  const auto width{static_cast<std::size_t>(image.width)};
+  const auto height{static_cast<std::size_t>(image.height)};
+  std::vector<std::uint8_t> data(width*height*channels);
+  stream.read(
+    reinterpret_cast<char*>(data.data()),
+    static_cast<std::streamsize>(data.size())
+  );
+  if (static_cast<std::size_t>(stream.gcount()) != data.size()) {
+    return {};
+  }
+  image.pixels.resize(width*height*4);
+  for (std::size_t y{0}; y < height; ++y) {
+    const std::uint8_t* source{data.data() + (height - 1 - y)*width*channels};
+    std::uint8_t* target{image.pixels.data() + y*width*4};
+    for (std::size_t x{0}; x < width; ++x) {
+      for (std::size_t c{0}; c < 3; ++c) {
+        target[x*4 + c] = source[x*channels + c];
+      }
+      target[x*4 + 3] = channels == 4 ? source[x*channels + 3] : 255;
+    }
+  }
+  return image;
+}
+
+auto writeImage(const std::string& path, const Image& image) -> bool {
+  const bool hasAlpha{std::filesystem::path{path}.extension() != ".ppm"};
+  const std::size_t channels{hasAlpha ? 4u : 3u};
+  const auto width{static_cast<std::size_t>(image.width)};
+  const auto height{static_cast<std::size_t>(image.height)};
+  std::ostringstream header{};
+  if (hasAlpha) {
+    header << "P7\nWIDTH " << width << "\nHEIGHT " << height
+      << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+  } else {
+    header << "P6\n" << width << ' ' << height << "\n255\n";
+  }
+  std::vector<std::uint8_t> data(width*height*channels);
+  for (std::size_t y{0}; y < height; ++y) {
+    const std::uint8_t* source{image.pixels.data() + (height - 1 - y)*width*4};
+    std::uint8_t* target{data.data() + y*width*channels};
+    for (std::size_t x{0}; x < width; ++x) {
+      for (std::size_t c{0}; c < channels; ++c) {
+        target[x*channels + c] = source[x*4 + c];
+      }
+    }
+  }
+  std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+  stream << header.str();
+  stream.write(
+    reinterpret_cast<const char*>(data.data()),
+    static_cast<std::streamsize>(data.size())
+  );
+  return static_cast<bool>(stream);
+}
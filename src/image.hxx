@@ -0,0 +1,25 @@
+#ifndef IMAGE_HXX
+#define IMAGE_HXX
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// RGBA8 pixels, bottom row first, as glReadPixels returns them.
+struct Image {
+  int width{};
+  int height{};
+  std::vector<std::uint8_t> pixels{};
+};
+
+/**
+ * Netpbm images: PAM ("P7", RGB_ALPHA or RGB) keeps alpha, PPM ("P6") is
+ * readable almost anywhere. Files store the top row first.
+ */
+auto readImage(const std::string& path) -> std::optional<Image>;
+// Picks the format from the extension: ".ppm" drops alpha, anything else
+// is written as PAM.
+auto writeImage(const std::string& path, const Image& image) -> bool;
+
+#endif // IMAGE_HXX
@@ -0,0 +1,127 @@
+#include "inputs.hxx"
+
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+struct Field {
+  std::size_t offset;
+  std::size_t size;
+};
+
+constexpr Field fields[]{
+  {offsetof(ShaderInputs, resolution), sizeof(ShaderInputs::resolution)},
+  {offsetof(ShaderInputs, time), sizeof(ShaderInputs::time)},
+  {offsetof(ShaderInputs, deltaTime), sizeof(ShaderInputs::deltaTime)},
+  {offsetof(ShaderInputs, mouse), sizeof(ShaderInputs::mouse)},
+  {offsetof(ShaderInputs, frame), sizeof(ShaderInputs::frame)},
+  {offsetof(ShaderInputs, date), sizeof(ShaderInputs::date)},
+};
+
+auto isEqual(const ShaderInputs& a, const ShaderInputs& b) -> bool {
+  return std::memcmp(&a, &b, sizeof(ShaderInputs)) == 0;
+}
+
+} // namespace
+
+auto updateDate(ShaderInputs& inputs) -> void {
+  const std::time_t now{std::time(nullptr)};
+  if (const std::tm* local{std::localtime(&now)}) {
+    inputs.date[0] = static_cast<GLfloat>(local->tm_year + 1900);
+    inputs.date[1] = static_cast<GLfloat>(local->tm_mon + 1);
+    inputs.date[2] = static_cast<GLfloat>(local->tm_mday);
+    inputs.date[3] = static_cast<GLfloat>(
+      local->tm_hour*3600 + local->tm_min*60 + local->tm_sec
+    );
+  }
+}
+
+InputBuffer::InputBuffer() {
+  GLint alignment{};
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  const GLintptr size{static_cast<GLintptr>(sizeof(ShaderInputs))};
+  _slotStride = (size + alignment - 1)/alignment*alignment;
+  const GLsizeiptr bufferSize{
+    _slotStride*static_cast<GLsizeiptr>(sectionCount*slotCount)
+  };
+  const GLbitfield flags{
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT
+  };
+  glGenBuffers(1, &_buffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, _buffer);
+  // Every slot starts out zeroed, like its shadow copy.
+  glBufferStorage(GL_UNIFORM_BUFFER, bufferSize, nullptr, flags);
+  _mapping = static_cast<std::byte*>(
+    glMapBufferRange(GL_UNIFORM_BUFFER, 0, bufferSize, flags)
+  );
+  std::memset(_mapping, 0, static_cast<std::size_t>(bufferSize));
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+InputBuffer::~InputBuffer() {
+  for (Section& section : _sections) {
+    glDeleteSync(section.fence);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, _buffer);
+  glUnmapBuffer(GL_UNIFORM_BUFFER);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glDeleteBuffers(1, &_buffer);
+}
+
+auto InputBuffer::beginFrame() -> void {
+  _frameStarted = true;
+}
+
+auto InputBuffer::update(const ShaderInputs& inputs) -> void {
+  if (
+    _bound
+    && isEqual(_sections[_current].contents[_boundSlot], inputs)
+  ) {
+    return;
+  }
+  if (_frameStarted || _usedSlots == slotCount) {
+    nextSection();
+  }
+  const std::size_t slot{_usedSlots++};
+  const GLintptr offset{
+    _slotStride*static_cast<GLintptr>(_current*slotCount + slot)
+  };
+  std::byte* destination{_mapping + offset};
+  const auto* source{reinterpret_cast<const std::byte*>(&inputs)};
+  auto* contents{
+    reinterpret_cast<std::byte*>(&_sections[_current].contents[slot])
+  };
+  for (const Field& field : fields) {
+    const std::byte* value{source + field.offset};
+    if (std::memcmp(contents + field.offset, value, field.size) != 0) {
+      std::memcpy(destination + field.offset, value, field.size);
+      std::memcpy(contents + field.offset, value, field.size);
+    }
+  }
+  glBindBufferRange(
+    GL_UNIFORM_BUFFER, bindingPoint, _buffer, offset,
+    static_cast<GLsizeiptr>(sizeof(ShaderInputs))
+  );
+  _boundSlot = slot;
+  _bound = true;
+}
+
+auto InputBuffer::nextSection() -> void {
+  // Everything that reads the current section has been submitted by now.
+  if (_usedSlots > 0) {
+    _sections[_current].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  _current = (_current + 1) % sectionCount;
+  Section& section{_sections[_current]};
+  if (section.fence) {
+    // Three frames back, so this normally returns at once.
+    glClientWaitSync(
+      section.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED
+    );
+    glDeleteSync(section.fence);
+    section.fence = nullptr;
+  }
+  _usedSlots = 0;
+  _frameStarted = false;
+}
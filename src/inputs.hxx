@@ -0,0 +1,88 @@
+#ifndef INPUTS_HXX
+#define INPUTS_HXX
+
+#include <array>
+#include <cstddef>
+
+#include <glad/gl.h>
+
+/**
+ * Built-in shader inputs, laid out as the std140 block
+ *
+ *   layout(std140) uniform ShaderTestInputs {
+ *     ivec2 resolution; // Render target size in pixels
+ *     float time;       // Seconds since the program was installed
+ *     float deltaTime;  // Seconds since the previous frame
+ *     vec4 mouse;       // Cursor position in pixels (origin bottom left),
+ *                       // z: 1 while the left button is down, w: unused
+ *     int frame;        // Frames rendered since the program was installed
+ *     vec4 date;        // Year, month (1-12), day, seconds since midnight
+ *   } inputs;
+ */
+struct ShaderInputs {
+  GLint resolution[2]{};
+  GLfloat time{};
+  GLfloat deltaTime{};
+  GLfloat mouse[4]{};
+  GLint frame{};
+  GLint padding[3]{};
+  GLfloat date[4]{};
+};
+
+static_assert(sizeof(ShaderInputs) == 64, "ShaderInputs must match std140");
+
+// Sets the date to the current local time.
+auto updateDate(ShaderInputs& inputs) -> void;
+
+/**
+ * A persistently mapped uniform buffer with one section per frame in
+ * flight. A frame's first update moves on to the next section, after
+ * waiting for the fence of the frame that last read from it; draws of the
+ * same frame with other inputs (passes or tiles of other sizes) each take
+ * the next slot of that section. Only the fields that differ from what a
+ * slot already holds are written. If nothing changed at all, the current
+ * slot stays bound and nothing is written.
+ */
+class InputBuffer {
+public:
+  static constexpr GLuint bindingPoint{0};
+  static constexpr const char* blockName{"ShaderTestInputs"};
+
+  InputBuffer();
+  InputBuffer(const InputBuffer&) = delete;
+  InputBuffer(InputBuffer&&) = delete;
+  InputBuffer operator=(const InputBuffer&) = delete;
+  InputBuffer operator=(InputBuffer&&) = delete;
+  ~InputBuffer();
+
+  // Marks the start of a frame; its first change takes a new section.
+  auto beginFrame() -> void;
+  // Binds the inputs for the following draws.
+  auto update(const ShaderInputs& inputs) -> void;
+
+private:
+  static constexpr std::size_t sectionCount{3};
+  // Distinct inputs per frame; a frame with more starts another section
+  // early, which may then wait for the GPU.
+  static constexpr std::size_t slotCount{16};
+
+  struct Section {
+    std::array<ShaderInputs, slotCount> contents{};
+    GLsync fence{};
+  };
+
+  auto nextSection() -> void;
+
+  GLuint _buffer{};
+  std::byte* _mapping{};
+  GLintptr _slotStride{};
+  std::array<Section, sectionCount> _sections{};
+  std::size_t _current{};
+  // Slots of the current section used since it was taken.
+  std::size_t _usedSlots{};
+  std::size_t _boundSlot{};
+  bool _bound{false};
+  bool _frameStarted{true};
+};
+
+#endif // INPUTS_HXX
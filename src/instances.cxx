@@ -0,0 +1,46 @@
+#include "instances.hxx"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+InstanceBuffer::InstanceBuffer(GLsizei count) : _count{count} {
+  const auto columns{static_cast<GLsizei>(
+    std::ceil(std::sqrt(static_cast<double>(count)))
+  )};
+  const GLfloat scale{1.f/static_cast<GLfloat>(columns)};
+  std::vector<GLfloat> data(static_cast<std::size_t>(count)*4);
+  for (GLsizei i{0}; i < count; ++i) {
+    GLfloat* instance{data.data() + static_cast<std::size_t>(i)*4};
+    instance[0] = (2.f*static_cast<GLfloat>(i%columns) + 1.f)*scale - 1.f;
+    instance[1] = (2.f*static_cast<GLfloat>(i/columns) + 1.f)*scale - 1.f;
+    instance[2] = scale;
+    instance[3] = static_cast<GLfloat>(i);
+  }
+  glGenBuffers(1, &_buffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, _buffer);
+  glBufferStorage(
+    GL_SHADER_STORAGE_BUFFER,
+    static_cast<GLsizeiptr>(data.size()*sizeof(GLfloat)), data.data(), 0
+  );
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  // Nothing else uses storage buffers, so the binding can stay.
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, _buffer);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+  glDeleteBuffers(1, &_buffer);
+}
+
+auto InstanceBuffer::getCount() const -> GLsizei {
+  return _count;
+}
+
+auto InstanceBuffer::bindBlock(GLuint program) -> void {
+  const GLuint index{glGetProgramResourceIndex(
+    program, GL_SHADER_STORAGE_BLOCK, blockName
+  )};
+  if (index != GL_INVALID_INDEX) {
+    glShaderStorageBlockBinding(program, index, bindingPoint);
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef INSTANCES_HXX
+#define INSTANCES_HXX
+
+#include <glad/gl.h>
+
+/**
+ * Per-instance data for instanced draws, as the std430 block
+ *
+ *   layout(std430) readonly buffer ShaderTestInstances {
+ *     vec4 instances[]; // xy: centre, z: scale, w: instance index
+ *   };
+ *
+ * read with instances[gl_InstanceID]. The instances are laid out on the
+ * smallest square grid that holds them all, scaled to fill [-1, 1] between
+ * them, so "position*instance.z + vec3(instance.xy, 0.)" tiles the screen.
+ */
+class InstanceBuffer {
+public:
+  static constexpr GLuint bindingPoint{1};
+  static constexpr const char* blockName{"ShaderTestInstances"};
+
+  explicit InstanceBuffer(GLsizei count);
+  InstanceBuffer() = delete;
+  InstanceBuffer(const InstanceBuffer&) = delete;
+  InstanceBuffer(InstanceBuffer&&) = delete;
+  InstanceBuffer operator=(const InstanceBuffer&) = delete;
+  InstanceBuffer operator=(InstanceBuffer&&) = delete;
+  ~InstanceBuffer();
+
+  auto getCount() const -> GLsizei;
+  // Points the program's block, if it has one, at the buffer.
+  static auto bindBlock(GLuint program) -> void;
+
+private:
+  GLuint _buffer{};
+  GLsizei _count;
+};
+
+#endif // INSTANCES_HXX
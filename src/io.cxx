@@ -4,9 +4,22 @@
 #include <fstream>
 #include <sstream>
 
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "debug.hxx"
+#include "trace.hxx"
 
 auto readFile(std::string_view filePath) -> std::optional<std::string> {
+  TRACE_SPAN("io", "read file");
   if (!std::filesystem::exists(filePath)) {
     LOG_ERROR("File does not exist: " << filePath << '\n');
     return {};
@@ -25,3 +38,76 @@ auto readFile(std::string_view filePath) -> std::optional<std::string> {
     return {};
   }
 }
+
+MappedFile::MappedFile(const std::string& filePath) {
+  TRACE_SPAN("io", "map file");
+#ifdef _WIN32
+  const HANDLE file{CreateFileA(
+    filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+    FILE_FLAG_SEQUENTIAL_SCAN, nullptr
+  )};
+  if (file == INVALID_HANDLE_VALUE) {
+    LOG_ERROR("Failed to open " << filePath << '\n');
+    return;
+  }
+  LARGE_INTEGER size{};
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    _mapping = CreateFileMappingA(
+      file, nullptr, PAGE_READONLY, 0, 0, nullptr
+    );
+  }
+  // The mapping keeps the file open.
+  CloseHandle(file);
+  if (!_mapping) {
+    return;
+  }
+  _data = static_cast<const char*>(
+    MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)
+  );
+  if (_data) {
+    _size = static_cast<std::size_t>(size.QuadPart);
+  }
+#else
+  const int file{open(filePath.c_str(), O_RDONLY)};
+  if (file < 0) {
+    LOG_ERROR("Failed to open " << filePath << '\n');
+    return;
+  }
+  struct stat status{};
+  if (fstat(file, &status) == 0 && status.st_size > 0) {
+    const auto size{static_cast<std::size_t>(status.st_size)};
+    void* data{mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0)};
+    if (data != MAP_FAILED) {
+      // Parsers read front to back, so read ahead aggressively.
+      madvise(data, size, MADV_SEQUENTIAL);
+      _data = static_cast<const char*>(data);
+      _size = size;
+    }
+  }
+  // The mapping keeps the file open.
+  close(file);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+  if (_data) {
+    UnmapViewOfFile(_data);
+  }
+  if (_mapping) {
+    CloseHandle(_mapping);
+  }
+#else
+  if (_data) {
+    munmap(const_cast<char*>(_data), _size);
+  }
+#endif
+}
+
+auto MappedFile::getData() const -> const char* {
+  return _data;
+}
+
+auto MappedFile::getSize() const -> std::size_t {
+  return _size;
+}
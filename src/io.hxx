@@ -1,10 +1,38 @@
 #ifndef IO_HXX
 #define IO_HXX
 
+#include <cstddef>
 #include <optional>
 #include <string>
 #include <string_view>
 
 auto readFile(std::string_view filePath) -> std::optional<std::string>;
 
+/**
+ * A read-only view of a whole file, paged in by the OS as it is read rather
+ * than copied up front. Large files can thus be parsed in one pass without
+ * holding a second copy of them.
+ */
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& filePath);
+  MappedFile() = delete;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&&) = delete;
+  MappedFile operator=(const MappedFile&) = delete;
+  MappedFile operator=(MappedFile&&) = delete;
+  ~MappedFile();
+
+  // Null when the file could not be opened or is empty.
+  auto getData() const -> const char*;
+  auto getSize() const -> std::size_t;
+
+private:
+  const char* _data{};
+  std::size_t _size{};
+#ifdef _WIN32
+  void* _mapping{};
+#endif
+};
+
 #endif // IO_HXX
@@ -0,0 +1,254 @@
+#ifndef LANES_HXX
+#define LANES_HXX
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LANES_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LANES_SSE2
+#endif
+
+/**
+ * One value for each of a group of pixels, evaluated together. The group is
+ * made of native vectors: two AVX2 registers, four SSE2 registers, or plain
+ * floats when neither is available at compile time. Native comparisons
+ * return bit masks (1 or 0 for plain floats) for nativeSelect().
+ */
+constexpr std::size_t laneCount{16};
+
+#if defined(LANES_AVX2)
+
+using NativeFloats = __m256;
+constexpr std::size_t nativeWidth{8};
+constexpr const char* lanesInstructionSet{"AVX2"};
+
+inline auto nativeSet(float value) -> NativeFloats {
+  return _mm256_set1_ps(value);
+}
+inline auto nativeLoad(const float* values) -> NativeFloats {
+  return _mm256_loadu_ps(values);
+}
+inline auto nativeStore(float* values, NativeFloats a) -> void {
+  _mm256_storeu_ps(values, a);
+}
+inline auto nativeAdd(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_add_ps(a, b);
+}
+inline auto nativeSub(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_sub_ps(a, b);
+}
+inline auto nativeMul(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_mul_ps(a, b);
+}
+inline auto nativeDiv(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_div_ps(a, b);
+}
+inline auto nativeMin(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_min_ps(a, b);
+}
+inline auto nativeMax(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_max_ps(a, b);
+}
+inline auto nativeSqrt(NativeFloats a) -> NativeFloats {
+  return _mm256_sqrt_ps(a);
+}
+inline auto nativeFloor(NativeFloats a) -> NativeFloats {
+  return _mm256_floor_ps(a);
+}
+inline auto nativeTrunc(NativeFloats a) -> NativeFloats {
+  return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+// Comparisons return all bits set or clear per lane.
+inline auto nativeLess(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+inline auto nativeLessEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+}
+inline auto nativeEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+inline auto nativeNotEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+}
+inline auto nativeAnd(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_and_ps(a, b);
+}
+inline auto nativeOr(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm256_or_ps(a, b);
+}
+inline auto nativeSelect(
+  NativeFloats mask, NativeFloats a, NativeFloats b
+) -> NativeFloats {
+  return _mm256_blendv_ps(b, a, mask);
+}
+inline auto nativeAny(NativeFloats mask) -> bool {
+  return _mm256_movemask_ps(mask) != 0;
+}
+
+#elif defined(LANES_SSE2)
+
+using NativeFloats = __m128;
+constexpr std::size_t nativeWidth{4};
+constexpr const char* lanesInstructionSet{"SSE2"};
+
+inline auto nativeSet(float value) -> NativeFloats {
+  return _mm_set1_ps(value);
+}
+inline auto nativeLoad(const float* values) -> NativeFloats {
+  return _mm_loadu_ps(values);
+}
+inline auto nativeStore(float* values, NativeFloats a) -> void {
+  _mm_storeu_ps(values, a);
+}
+inline auto nativeAdd(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_add_ps(a, b);
+}
+inline auto nativeSub(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_sub_ps(a, b);
+}
+inline auto nativeMul(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_mul_ps(a, b);
+}
+inline auto nativeDiv(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_div_ps(a, b);
+}
+inline auto nativeMin(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_min_ps(a, b);
+}
+inline auto nativeMax(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_max_ps(a, b);
+}
+inline auto nativeSqrt(NativeFloats a) -> NativeFloats {
+  return _mm_sqrt_ps(a);
+}
+inline auto nativeLess(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_cmplt_ps(a, b);
+}
+inline auto nativeLessEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_cmple_ps(a, b);
+}
+inline auto nativeEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_cmpeq_ps(a, b);
+}
+inline auto nativeNotEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_cmpneq_ps(a, b);
+}
+inline auto nativeAnd(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_and_ps(a, b);
+}
+inline auto nativeOr(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return _mm_or_ps(a, b);
+}
+inline auto nativeSelect(
+  NativeFloats mask, NativeFloats a, NativeFloats b
+) -> NativeFloats {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+inline auto nativeAny(NativeFloats mask) -> bool {
+  return _mm_movemask_ps(mask) != 0;
+}
+inline auto nativeTrunc(NativeFloats a) -> NativeFloats {
+  // Values beyond 2^23 are integers already (and may not fit an int32).
+  const NativeFloats magnitude{
+    _mm_andnot_ps(_mm_set1_ps(-0.f), a)
+  };
+  const NativeFloats truncated{_mm_cvtepi32_ps(_mm_cvttps_epi32(a))};
+  return nativeSelect(
+    _mm_cmplt_ps(magnitude, _mm_set1_ps(8388608.f)), truncated, a
+  );
+}
+inline auto nativeFloor(NativeFloats a) -> NativeFloats {
+  const NativeFloats truncated{nativeTrunc(a)};
+  const NativeFloats adjustment{
+    _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.f))
+  };
+  return _mm_sub_ps(truncated, adjustment);
+}
+
+#else
+
+struct NativeFloats {
+  float value;
+};
+constexpr std::size_t nativeWidth{1};
+constexpr const char* lanesInstructionSet{"scalar"};
+
+inline auto nativeSet(float value) -> NativeFloats {
+  return {value};
+}
+inline auto nativeLoad(const float* values) -> NativeFloats {
+  return {*values};
+}
+inline auto nativeStore(float* values, NativeFloats a) -> void {
+  *values = a.value;
+}
+inline auto nativeAdd(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value + b.value};
+}
+inline auto nativeSub(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value - b.value};
+}
+inline auto nativeMul(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value*b.value};
+}
+inline auto nativeDiv(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value/b.value};
+}
+inline auto nativeMin(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value < b.value ? a.value : b.value};
+}
+inline auto nativeMax(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value > b.value ? a.value : b.value};
+}
+inline auto nativeSqrt(NativeFloats a) -> NativeFloats {
+  return {std::sqrt(a.value)};
+}
+inline auto nativeFloor(NativeFloats a) -> NativeFloats {
+  return {std::floor(a.value)};
+}
+inline auto nativeTrunc(NativeFloats a) -> NativeFloats {
+  return {std::trunc(a.value)};
+}
+// Scalar masks are plain 1 or 0.
+inline auto nativeLess(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value < b.value ? 1.f : 0.f};
+}
+inline auto nativeLessEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value <= b.value ? 1.f : 0.f};
+}
+inline auto nativeEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value == b.value ? 1.f : 0.f};
+}
+inline auto nativeNotEqual(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value != b.value ? 1.f : 0.f};
+}
+inline auto nativeAnd(NativeFloats mask, NativeFloats b) -> NativeFloats {
+  return {mask.value != 0.f ? b.value : 0.f};
+}
+inline auto nativeOr(NativeFloats a, NativeFloats b) -> NativeFloats {
+  return {a.value != 0.f || b.value != 0.f ? 1.f : 0.f};
+}
+inline auto nativeSelect(
+  NativeFloats mask, NativeFloats a, NativeFloats b
+) -> NativeFloats {
+  return mask.value != 0.f ? a : b;
+}
+inline auto nativeAny(NativeFloats mask) -> bool {
+  return mask.value != 0.f;
+}
+
+#endif
+
+constexpr std::size_t nativeCount{laneCount/nativeWidth};
+
+struct alignas(32) Lanes {
+  NativeFloats parts[nativeCount];
+};
+
+#endif // LANES_HXX
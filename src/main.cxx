@@ -1,13 +1,43 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <exception>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 
+#include "batch.hxx"
+#include "compiler.hxx"
+#include "compute.hxx"
 #include "debug.hxx"
+#include "framewriter.hxx"
+#include "gldebug.hxx"
+#include "golden.hxx"
 #include "graphics.hxx"
+#include "pacing.hxx"
 #include "parameters.hxx"
+#include "playlist.hxx"
+#include "process.hxx"
+#include "profiler.hxx"
+#include "rendergraph.hxx"
+#include "software.hxx"
+#include "trace.hxx"
+#include "tuner.hxx"
+#include "watcher.hxx"
 #include "window.hxx"
 
+constexpr int benchWarmupFrames{10};
+constexpr std::chrono::milliseconds watchDebounce{100};
+// How often an idle loop still wakes up for background work.
+constexpr double idlePollSeconds{.1};
+
 auto echoSources(const ShaderSources& sources) -> void {
   std::cout << "##### BEGIN VERTEX SHADER #####\n";
   std::cout << sources.vertex << '\n';
@@ -17,47 +47,885 @@ auto echoSources(const ShaderSources& sources) -> void {
   std::cout << "##### END FRAGMENT SHADER #####\n";
 }
 
+auto printCacheStatistics(const ProgramCache& cache) -> void {
+  const ProgramCacheStatistics statistics{cache.getStatistics()};
+  std::cout << "Program cache: " << statistics.hits << " hits, "
+    << statistics.misses << " misses (" << statistics.rejected
+    << " rejected)\n";
+}
+
+// As in benchmark reports: the geometry, then its instance count.
+auto describeModel(
+  const CLIParameters& parameters, GeometryType modelType
+) -> std::string {
+  std::string model{};
+  switch (modelType) {
+    case GeometryType::Rectangle:
+      model = "rectangle";
+      break;
+    case GeometryType::Triangle:
+      model = "triangle";
+      break;
+    case GeometryType::Mesh:
+      model = parameters.meshPath.value_or("mesh");
+      break;
+    case GeometryType::Plane:
+      model = "plane/" + std::to_string(parameters.subdivisions);
+      break;
+    case GeometryType::Sphere:
+      model = "sphere/" + std::to_string(parameters.subdivisions);
+      break;
+    case GeometryType::Cube:
+      model = "cube/" + std::to_string(parameters.subdivisions);
+      break;
+  }
+  if (parameters.instanceCount > 1) {
+    model += 'x' + std::to_string(parameters.instanceCount);
+  }
+  return model;
+}
+
+auto printCaptureStatistics(const CaptureStatistics& statistics) -> void {
+  std::cout << "Captured " << statistics.frames << " frames: "
+    << statistics.written << " written, " << statistics.dropped
+    << " dropped, rendering waited " << statistics.stalls
+    << " times; queue depth mean " << statistics.meanQueueDepth << ", max "
+    << statistics.maxQueueDepth << '\n';
+}
+
+auto getCaptureSettings(const CLIParameters& parameters) -> CaptureSettings {
+  return {
+    *parameters.capturePath,
+    parameters.captureFormat.value_or(
+      guessCaptureFormat(*parameters.capturePath)
+    ),
+    parameters.captureFPS.value_or(parameters.fps.value_or(60.)),
+    static_cast<std::uint64_t>(parameters.firstFrame),
+    static_cast<std::size_t>(parameters.captureQueue),
+    parameters.captureDrop,
+    static_cast<std::size_t>(parameters.threadCount)
+  };
+}
+
+// The arguments of a batch worker: this process's arguments, without those
+// the batch sets per worker. Workers are not traced either, as they would
+// all write to the same file.
+auto getWorkerArguments(
+  int argc, char** argv, const CLIParameters& parameters
+) -> std::vector<std::string> {
+  constexpr std::string_view batchOptions[]{
+    "--jobs=", "--frame-range=", "--frames=", "--capture=",
+    "--capture-format=", "--headless", "--trace="
+  };
+  std::vector<std::string> arguments{};
+  for (int a{1}; a < argc; ++a) {
+    const std::string_view argument{argv[a]};
+    if (std::none_of(
+      std::begin(batchOptions), std::end(batchOptions),
+      [argument](std::string_view option) {
+        return argument.substr(0, option.size()) == option;
+      }
+    )) {
+      arguments.emplace_back(argument);
+    }
+  }
+  // Split the cores between the workers' thread pools too.
+  if (parameters.threadCount == 0) {
+    const unsigned cores{std::max(std::thread::hardware_concurrency(), 1u)};
+    arguments.push_back("--threads=" + std::to_string(std::max(
+      cores/static_cast<unsigned>(parameters.jobCount), 1u
+    )));
+  }
+  return arguments;
+}
+
+auto printCPUUsage(const CPUUsageMeter& meter, int frames) -> void {
+  const double cpu{meter.getCPUTime().count()};
+  const double wall{meter.getWallTime().count()};
+  std::cout << "CPU usage: " << (frames > 0 ? cpu/frames : 0.)
+    << " ms per frame, " << (wall > 0. ? cpu/wall*100. : 0.)
+    << "% of a core over " << wall/1000. << " s\n";
+}
+
+auto renderSoftware(
+  const CLIParameters& parameters, const ShaderSources& sources
+) -> int {
+  if (parameters.echo) {
+    echoSources(sources);
+  }
+  std::optional<SoftwareProgram> program{
+    SoftwareProgram::compile(sources.fragment)
+  };
+  if (!program) {
+    std::cerr << "Failed to build the software program\n";
+    return EXIT_FAILURE;
+  }
+  SoftwareRenderer renderer{
+    std::move(*program), static_cast<std::size_t>(parameters.threadCount)
+  };
+  std::unique_ptr<FrameWriter> writer{};
+  if (parameters.capturePath) {
+    writer = std::make_unique<FrameWriter>(getCaptureSettings(parameters));
+  }
+  ShaderInputs inputs{};
+  inputs.resolution[0] = parameters.width;
+  inputs.resolution[1] = parameters.height;
+  const int frames{parameters.frameCount.value_or(1)};
+  const auto startTime{std::chrono::steady_clock::now()};
+  for (int frame{0}; frame < frames; ++frame) {
+    if (parameters.fps) {
+      // As GraphicsEngine::setFrameClock().
+      const int number{parameters.firstFrame + frame};
+      inputs.deltaTime = number > 0 ? static_cast<float>(1./ *parameters.fps)
+        : 0.f;
+      inputs.time = static_cast<float>(
+        parameters.startTime + number/ *parameters.fps
+      );
+      inputs.frame = number + 1;
+    } else {
+      const std::chrono::duration<float> time{
+        std::chrono::steady_clock::now() - startTime
+      };
+      inputs.deltaTime = frame > 0 ? time.count() - inputs.time : 0.f;
+      inputs.time = time.count();
+      inputs.frame = frame + 1;
+      updateDate(inputs);
+    }
+    renderer.render(parameters.width, parameters.height, inputs);
+    if (writer) {
+      const std::vector<std::uint8_t>& pixels{renderer.getPixels()};
+      std::vector<std::uint8_t> buffer{writer->takeBuffer(pixels.size())};
+      std::copy(pixels.begin(), pixels.end(), buffer.begin());
+      writer->push({
+        static_cast<std::uint64_t>(parameters.firstFrame + frame),
+        {parameters.width, parameters.height, std::move(buffer)}
+      });
+    }
+  }
+  if (writer) {
+    writer->finish();
+  }
+  const std::chrono::duration<double> elapsed{
+    std::chrono::steady_clock::now() - startTime
+  };
+  const double pixels{
+    static_cast<double>(parameters.width)*parameters.height*frames
+  };
+  std::cout << "Rendered " << frames << " frames at "
+    << parameters.width << 'x' << parameters.height << " in "
+    << elapsed.count()*1000. << " ms (" << frames/elapsed.count()
+    << " fps)\n";
+  std::cout << "Software renderer: " << pixels/elapsed.count()/1e6
+    << " Mpixels/s on " << renderer.getThreadCount() << " threads ("
+    << lanesInstructionSet << ", " << laneCount << " lanes, "
+    << renderer.getStealCount() << " tiles stolen)\n";
+  if (writer) {
+    printCaptureStatistics(writer->getStatistics());
+  }
+  return EXIT_SUCCESS;
+}
+
+// Dispatches a compute shader once per frame, showing (and capturing) one
+// of its images, then prints the dispatch times.
+auto runCompute(
+  const CLIParameters& parameters, ShaderPreprocessor& preprocessor,
+  DebugMessageQueue& debugMessages
+) -> int {
+  const std::optional<ShaderSource> source{
+    preprocessor.process(*parameters.computePath, parameters.defines)
+  };
+  if (!source) {
+    std::cerr << "Failed to load " << *parameters.computePath << '\n';
+    return EXIT_FAILURE;
+  }
+  if (parameters.echo) {
+    std::cout << "##### BEGIN COMPUTE SHADER #####\n";
+    std::cout << *source << '\n';
+    std::cout << "##### END COMPUTE SHADER #####\n";
+  }
+  WindowOwner windowOwner{
+    parameters.width, parameters.height, parameters.headless,
+    parameters.glDebugMode != GLDebugMode::Off
+  };
+  if (!GraphicsEngine::initializeGL(&debugMessages)) {
+    throw std::runtime_error{"Failed to initialize OpenGL"};
+  }
+  const std::optional<GLuint> program{ComputeEngine::createProgram(*source)};
+  if (!program) {
+    return EXIT_FAILURE;
+  }
+  ComputeEngine compute{*program, parameters.compute};
+  if (!parameters.channels.empty()) {
+    std::cerr << "Texture channels are not bound in compute mode\n";
+  }
+  std::unique_ptr<FrameCapture> capture{};
+  if (parameters.capturePath) {
+    capture = std::make_unique<FrameCapture>(getCaptureSettings(parameters));
+  }
+  if (parameters.swapInterval && !parameters.headless) {
+    windowOwner.setSwapInterval(*parameters.swapInterval);
+  }
+  // Dispatches are cheap to interleave with events, so this loop handles
+  // both on the main thread.
+  ActionQueue& actions{windowOwner.getActions()};
+  bool running{true};
+  bool paused{false};
+  int width{windowOwner.getFramebufferWidth()};
+  int height{windowOwner.getFramebufferHeight()};
+  int frames{0};
+  const auto startTime{std::chrono::steady_clock::now()};
+  while (running) {
+    TRACE_SPAN("main", "frame");
+    if (parameters.frameCount && frames >= *parameters.frameCount) {
+      break;
+    }
+    while (const std::optional<WindowAction> action{actions.pop()}) {
+      if (action->type == WindowActionType::Close) {
+        running = false;
+      } else if (action->type == WindowActionType::PauseResume) {
+        paused = !paused;
+      } else if (action->type == WindowActionType::Resize) {
+        width = action->width;
+        height = action->height;
+      }
+    }
+    if (!running) {
+      break;
+    }
+    if (!paused) {
+      const int frame{parameters.firstFrame + frames};
+      const std::chrono::duration<float> elapsed{
+        std::chrono::steady_clock::now() - startTime
+      };
+      compute.dispatch(
+        parameters.fps
+          ? static_cast<GLfloat>(parameters.startTime + frame/ *parameters.fps)
+          : elapsed.count(),
+        frame
+      );
+      if (capture) {
+        compute.capture(*capture);
+      }
+      ++frames;
+    }
+    if (!parameters.headless) {
+      compute.blit(width, height);
+    }
+    windowOwner.update();
+    debugMessages.flush();
+  }
+  compute.finish();
+  const std::chrono::duration<double> elapsed{
+    std::chrono::steady_clock::now() - startTime
+  };
+  if (capture) {
+    capture->finish();
+    printCaptureStatistics(capture->getStatistics());
+  }
+  bool dumped{true};
+  if (parameters.dumpDirectory) {
+    ThreadPool pool{static_cast<std::size_t>(parameters.threadCount)};
+    dumped = compute.dump(*parameters.dumpDirectory, pool);
+  }
+  const std::array<GLuint, 3> groups{compute.getGroupCount()};
+  const std::array<GLint, 3> local{compute.getLocalSize()};
+  const FrameStatistics times{
+    FrameStatistics::fromSamples(compute.getDispatchTimes())
+  };
+  const double invocations{
+    static_cast<double>(groups[0])*groups[1]*groups[2]
+      *local[0]*local[1]*local[2]
+  };
+  std::cout << "Dispatched " << frames << " times in "
+    << elapsed.count()*1000. << " ms, " << groups[0] << 'x' << groups[1]
+    << 'x' << groups[2] << " work groups of " << local[0] << 'x'
+    << local[1] << 'x' << local[2] << '\n';
+  std::cout << "Dispatch time (ms): min " << times.min << ", median "
+    << times.median << ", p95 " << times.p95 << ", p99 " << times.p99
+    << ", mean " << times.mean << " ("
+    << (times.mean > 0. ? invocations/times.mean/1e6 : 0.)
+    << " Ginvocations/s)\n";
+  return dumped ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Renders each time as the first frame of a fresh program, in software.
+auto renderSoftwareImages(
+  const CLIParameters& parameters, const ShaderSources& sources,
+  const std::vector<float>& times
+) -> std::optional<std::vector<Image>> {
+  std::optional<SoftwareProgram> program{
+    SoftwareProgram::compile(sources.fragment)
+  };
+  if (!program) {
+    return {};
+  }
+  SoftwareRenderer renderer{
+    std::move(*program), static_cast<std::size_t>(parameters.threadCount)
+  };
+  std::vector<Image> images{};
+  for (const float time : times) {
+    ShaderInputs inputs{};
+    inputs.resolution[0] = parameters.width;
+    inputs.resolution[1] = parameters.height;
+    inputs.time = time;
+    inputs.frame = 1;
+    renderer.render(parameters.width, parameters.height, inputs);
+    images.push_back({
+      parameters.width, parameters.height, renderer.getPixels()
+    });
+  }
+  return images;
+}
+
+auto runTune(
+  const CLIParameters& parameters, ShaderPreprocessor& preprocessor,
+  GraphicsEngine& graphics
+) -> int {
+  if (!parameters.vertexPath || !parameters.fragmentPath) {
+    std::cerr << "Tuning needs a vertex shader and a fragment shader\n";
+    return EXIT_FAILURE;
+  }
+  VariantCache cache{
+    preprocessor, *parameters.vertexPath, *parameters.fragmentPath,
+    graphics.getProgramCache()
+  };
+  const TuneSettings settings{
+    parameters.tuneParameters, parameters.defines, parameters.tuneBudget,
+    parameters.tuneFrames, static_cast<GLfloat>(parameters.startTime)
+  };
+  const std::vector<VariantResult> results{
+    runTuner(graphics, cache, settings)
+  };
+  printTuneResults(std::cout, results, settings, parameters.benchFormat);
+  if (parameters.benchFormat == BenchFormat::Text) {
+    std::cout << "Variant cache: " << cache.getBuildCount() << " built, "
+      << cache.getHitCount() << " reused\n";
+  }
+  const bool built{std::any_of(
+    results.begin(), results.end(),
+    [](const VariantResult& result) { return !result.failed; }
+  )};
+  return built ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+auto runGolden(
+  const CLIParameters& parameters, const std::vector<GoldenEntry>& entries,
+  ShaderPreprocessor& preprocessor, const GoldenRenderer& renderer
+) -> int {
+  const GoldenSettings settings{
+    *parameters.goldenPath, parameters.goldenOutput, parameters.maxError,
+    parameters.goldenUpdate, parameters.defines
+  };
+  const bool passed{runGoldenTests(
+    settings, entries, preprocessor, renderer,
+    static_cast<std::size_t>(parameters.threadCount)
+  )};
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 auto main(int argc, char** argv) -> int {
+  const auto processStartTime{std::chrono::steady_clock::now()};
   CLIParameters parameters{parseCLIArguments(argc, argv)};
   if (parameters.helpOnly) {
     std::cout << usageString << '\n';
     std::exit(EXIT_SUCCESS);
   }
+  if (parameters.invalidSubdivisions) {
+    return EXIT_FAILURE;
+  }
+  if (parameters.benchFrames) {
+    parameters.frameCount = benchWarmupFrames + *parameters.benchFrames;
+  }
+  if (parameters.capturePath == "-") {
+    // Captured frames go to stdout, so everything else goes to stderr.
+    std::cout.rdbuf(std::cerr.rdbuf());
+  }
+  if (parameters.jobCount > 1) {
+    const BatchSettings settings{
+      getExecutablePath(argv[0]), getWorkerArguments(argc, argv, parameters),
+      parameters.firstFrame, parameters.frameCount.value_or(1),
+      parameters.jobCount, parameters.capturePath,
+      parameters.captureFormat.value_or(
+        guessCaptureFormat(parameters.capturePath.value_or(""))
+      )
+    };
+    return runBatch(settings) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  // Written once everything below is done.
+  std::unique_ptr<TraceSession> trace{};
+  if (parameters.tracePath) {
+    trace = std::make_unique<TraceSession>(*parameters.tracePath);
+    setTraceThreadName("main");
+  }
+  DebugMessageQueue debugMessages{parameters.glDebugMode};
+  ShaderPreprocessor preprocessor{parameters.includeDirectories};
   std::optional<ShaderSources> sources{};
-  if (!parameters.vertexPath && !parameters.fragmentPath) {
-    sources = {defaultVertexSource, defaultFragmentSource};
+  std::optional<std::vector<PlaylistEntry>> playlistEntries{};
+  std::optional<std::vector<PassDescription>> passes{};
+  std::optional<std::vector<ShaderSources>> passSources{};
+  std::optional<std::vector<GoldenEntry>> goldenEntries{};
+  if (parameters.goldenPath) {
+    goldenEntries = loadGoldenList(
+      *parameters.goldenPath, parameters.vertexPath
+    );
+    if (!goldenEntries) {
+      return EXIT_FAILURE;
+    }
+  } else if (parameters.passesPath) {
+    passes = loadRenderGraph(*parameters.passesPath);
+    if (passes) {
+      passSources = loadPassSources(
+        *passes, parameters.vertexPath, preprocessor, parameters.defines
+      );
+    }
+  } else if (parameters.playlistPath) {
+    playlistEntries = loadPlaylist(
+      *parameters.playlistPath, parameters.vertexPath
+    );
+  } else if (!parameters.vertexPath && !parameters.fragmentPath) {
+    sources = {
+      ShaderSource::fromLiteral(defaultVertexSource),
+      ShaderSource::fromLiteral(defaultFragmentSource)
+    };
   } else if (parameters.vertexPath && parameters.fragmentPath) {
-    sources = loadShaderSources(parameters);
+    sources = loadShaderSources(parameters, preprocessor);
+  } else if (parameters.software && parameters.fragmentPath) {
+    // Software rendering has no vertex stage.
+    if (std::optional<ShaderSource> fragment{
+      preprocessor.process(*parameters.fragmentPath, parameters.defines)
+    }) {
+      sources = {
+        ShaderSource::fromLiteral(defaultVertexSource), std::move(*fragment)
+      };
+    }
   } else {
     std::cerr << "Please pass in both a vertex shader and a fragment shader\n";
   }
+  if (parameters.computePath) {
+    try {
+      return runCompute(parameters, preprocessor, debugMessages);
+    } catch (std::exception& ex) {
+      std::cerr << ex.what() << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+  if (parameters.software && goldenEntries) {
+    return runGolden(
+      parameters, *goldenEntries, preprocessor,
+      [&parameters](const ShaderSources& entrySources,
+        const std::vector<float>& times) {
+        return renderSoftwareImages(parameters, entrySources, times);
+      }
+    );
+  }
+  if (parameters.software) {
+    if (!sources) {
+      std::cerr << "Software rendering needs a single fragment shader\n";
+      return EXIT_FAILURE;
+    }
+    return renderSoftware(parameters, *sources);
+  }
 
   try {
-    WindowOwner windowOwner{};
+    WindowOwner windowOwner{
+      parameters.width, parameters.height, parameters.headless,
+      parameters.glDebugMode != GLDebugMode::Off
+    };
+    std::optional<ProgramCacheSettings> cacheSettings{};
+    if (parameters.useCache) {
+      cacheSettings = {
+        parameters.cacheDirectory
+          ? std::filesystem::path{*parameters.cacheDirectory}
+          : ProgramCache::getDefaultDirectory(),
+        static_cast<std::uintmax_t>(parameters.cacheSizeMiB)*1024*1024
+      };
+    }
     GraphicsEngine graphics{
-      windowOwner.getWindow(), sources, windowOwner.getActions().modelType
+      windowOwner.getWindow(), sources, parameters.modelType,
+      {
+        parameters.meshPath, parameters.subdivisions,
+        static_cast<std::size_t>(parameters.threadCount)
+      },
+      cacheSettings, &debugMessages
     };
+    if (
+      parameters.instanceCount > 1
+      && !graphics.setInstanceCount(parameters.instanceCount)
+    ) {
+      return EXIT_FAILURE;
+    }
+    if (parameters.headless) {
+      graphics.setOffscreenTarget(parameters.width, parameters.height);
+    }
+    if (parameters.fps) {
+      graphics.setFrameClock({{
+        *parameters.fps, parameters.startTime, parameters.firstFrame
+      }});
+    }
+    if (!parameters.channels.empty()) {
+      graphics.setTextureChannels(std::make_unique<TextureChannels>(
+        ChannelSettings{
+          parameters.channels, parameters.channelFPS,
+          static_cast<std::size_t>(parameters.channelPrefetch),
+          static_cast<std::size_t>(parameters.threadCount)
+        }
+      ));
+    }
+    if (!parameters.tuneParameters.empty()) {
+      return runTune(parameters, preprocessor, graphics);
+    }
+    if (goldenEntries) {
+      return runGolden(
+        parameters, *goldenEntries, preprocessor,
+        [&parameters, &graphics](const ShaderSources& entrySources,
+          const std::vector<float>& times)
+          -> std::optional<std::vector<Image>> {
+          const std::optional<GLuint> program{GraphicsEngine::createProgram(
+            entrySources, graphics.getProgramCache()
+          )};
+          if (!program) {
+            return {};
+          }
+          graphics.adoptProgram(*program);
+          std::vector<Image> images{};
+          for (const float time : times) {
+            graphics.setFixedTime(time);
+            graphics.render();
+            images.push_back({
+              parameters.width, parameters.height, graphics.readPixels()
+            });
+          }
+          return images;
+        }
+      );
+    }
+    if (parameters.targetMilliseconds || parameters.fixedScale) {
+      graphics.setResolutionScaling({{
+        parameters.targetMilliseconds, parameters.fixedScale
+      }});
+    }
+    if (parameters.progressive) {
+      graphics.setProgressive({{
+        parameters.tileBudget, parameters.tileSize, parameters.coarseToFine
+      }});
+    }
+    // Only rebuilds with --watch keep going without a render graph.
+    if (parameters.passesPath) {
+      if (
+        !passes || !passSources
+        || !graphics.setRenderGraph(
+          std::make_unique<RenderGraph>(*passes), *passSources
+        )
+      ) {
+        std::cerr << "Failed to build the render graph\n";
+        return EXIT_FAILURE;
+      }
+    }
+    if (parameters.capturePath) {
+      graphics.startCapture(getCaptureSettings(parameters));
+    }
     if (parameters.echo && sources) {
       echoSources(*sources);
     }
-    WindowActions& actions{windowOwner.getActions()};
+    std::unique_ptr<Playlist> playlist{};
+    if (playlistEntries) {
+      playlist = std::make_unique<Playlist>(
+        std::move(*playlistEntries), preprocessor, parameters.defines,
+        graphics.getProgramCache()
+      );
+    }
+    auto playlistSwitchTime{std::chrono::steady_clock::now()};
+    bool playlistReported{false};
+    std::unique_ptr<FileWatcher> watcher{};
+    std::unique_ptr<ShaderCompiler> compiler{};
+    if (parameters.watch && passes) {
+      // Render graphs are rebuilt as a whole on this thread.
+      watcher = std::make_unique<FileWatcher>(watchDebounce);
+      watcher->setPaths(preprocessor.getFiles());
+    } else if (
+      parameters.watch && parameters.vertexPath && parameters.fragmentPath
+    ) {
+      watcher = std::make_unique<FileWatcher>(watchDebounce);
+      watcher->setPaths(preprocessor.getFiles());
+      compiler = std::make_unique<ShaderCompiler>(
+        windowOwner.createSharedContext(), graphics.getProgramCache()
+      );
+    }
+    std::unique_ptr<FrameProfiler> profiler{};
+    if (parameters.benchFrames) {
+      windowOwner.setSwapInterval(0);
+      profiler = std::make_unique<FrameProfiler>();
+    }
+    if (parameters.swapInterval && !parameters.headless) {
+      windowOwner.setSwapInterval(*parameters.swapInterval);
+    }
+    std::unique_ptr<FrameLimiter> limiter{};
+    if (parameters.maxFPS) {
+      limiter = std::make_unique<FrameLimiter>(*parameters.maxFPS);
+    }
+    // Frames are only produced on demand for a window; headless runs and
+    // benchmarks render every frame they are asked for.
+    const bool idleAllowed{
+      parameters.idle && !parameters.headless && !profiler
+    };
+    std::optional<double> idleTimeout{};
+    if (watcher || playlist) {
+      idleTimeout = idlePollSeconds;
+    }
+    ActionQueue& actions{windowOwner.getActions()};
+    GeometryType modelType{parameters.modelType};
+    // Headless runs have no events to wait for, so they render on this
+    // thread; windows render on their own thread.
+    const bool renderThread{!parameters.headless};
     bool paused{false};
-    while (windowOwner.isActive()) {
-      if (actions.changeModelType) {
-        graphics.resetWith({}, actions.modelType);
-      } else if (actions.closeWindow) {
-        windowOwner.closeWindow();
-      } else if (actions.resetWindowSize) {
-        windowOwner.resetWindowSize();
-      } else if (actions.pauseResume) {
-        paused = !paused;
+    bool redraw{true};
+    int frames{0};
+    double startupMilliseconds{};
+    DrawCounts benchDrawCounts{};
+    const auto startTime{std::chrono::steady_clock::now()};
+    const CPUUsageMeter usageMeter{};
+    const auto renderFrames{[&]() {
+      while (true) {
+        TRACE_SPAN("main", "frame");
+        if (parameters.frameCount && frames >= *parameters.frameCount) {
+          break;
+        }
+        bool closed{false};
+        while (const std::optional<WindowAction> action{actions.pop()}) {
+          redraw = true;
+          switch (action->type) {
+            case WindowActionType::Close:
+              closed = true;
+              break;
+            case WindowActionType::ChangeModel:
+              modelType = action->modelType;
+              graphics.resetWith({}, modelType);
+              break;
+            case WindowActionType::PauseResume:
+              paused = !paused;
+              break;
+            case WindowActionType::NextShader:
+              if (playlist) {
+                playlist->skip(1);
+              }
+              break;
+            case WindowActionType::PreviousShader:
+              if (playlist) {
+                playlist->skip(-1);
+              }
+              break;
+            case WindowActionType::Redraw:
+              break;
+            case WindowActionType::Resize:
+              graphics.setFramebufferSize(action->width, action->height);
+              break;
+            case WindowActionType::Mouse:
+              graphics.setMouse(
+                action->mouseX, action->mouseY, action->mouseDown
+              );
+              break;
+          }
+        }
+        if (closed) {
+          break;
+        }
+        if (playlist) {
+          const auto now{std::chrono::steady_clock::now()};
+          if (
+            !playlist->isSwitching() && !paused
+            && now - playlistSwitchTime
+              >= std::chrono::seconds{parameters.playlistInterval}
+          ) {
+            playlist->skip(1);
+          }
+          // The current program keeps rendering until the next one is ready.
+          if (const std::optional<GLuint> program{playlist->update()}) {
+            graphics.showProgram(*program);
+            redraw = true;
+            playlistSwitchTime = now;
+            LOG("Showing " << playlist->getCurrentEntry().fragmentPath << '\n');
+          }
+          if (playlist->isSettled() && !playlistReported) {
+            playlistReported = true;
+            std::cout << "Built " << playlist->getSize() << " programs in "
+              << playlist->getBuildTime().count() << " ms ("
+              << playlist->getFailedCount() << " failed)\n";
+          }
+        }
+        if (watcher) {
+          const std::vector<std::string> changedPaths{watcher->poll()};
+          // Only changed files are read again, and only when a shader actually
+          // depends on one of them.
+          if (
+            !changedPaths.empty()
+            && !preprocessor.invalidate(changedPaths).empty()
+          ) {
+            if (passes) {
+              passSources = loadPassSources(
+                *passes, parameters.vertexPath, preprocessor,
+                parameters.defines
+              );
+              if (passSources && graphics.setRenderGraph(
+                std::make_unique<RenderGraph>(*passes), *passSources
+              )) {
+                redraw = true;
+                LOG("Rebuilt the render graph\n");
+              } else {
+                std::cerr << "Failed to rebuild the render graph; "
+                  "keeping the current one\n";
+              }
+            } else if (std::optional<ShaderSources> reloaded{
+              loadShaderSources(parameters, preprocessor)
+            }) {
+              compiler->submit(std::move(*reloaded));
+            } else {
+              std::cerr
+                << "Failed to load shaders; keeping the current program\n";
+            }
+            watcher->setPaths(preprocessor.getFiles());
+          }
+        }
+        if (compiler) {
+          if (const std::optional<GLuint> program{compiler->poll()}) {
+            graphics.adoptProgram(*program);
+            redraw = true;
+            LOG("Reloaded shaders\n");
+          }
+        }
+        if (idleAllowed && (paused || (!redraw && graphics.isStatic()))) {
+          debugMessages.flush();
+          actions.wait(idleTimeout);
+          continue;
+        }
+        if (profiler && frames == benchWarmupFrames) {
+          profiler->reset();
+          benchDrawCounts = graphics.getDrawCounts();
+        }
+        if (profiler) {
+          profiler->beginFrame();
+        }
+        if (!paused) {
+          graphics.render();
+          ++frames;
+          if (profiler && frames == 1) {
+            // Drivers may defer compilation until the first draw.
+            graphics.finish();
+            const std::chrono::duration<double, std::milli> elapsed{
+              std::chrono::steady_clock::now() - processStartTime
+            };
+            startupMilliseconds = elapsed.count();
+          }
+        }
+        if (profiler) {
+          profiler->endFrame();
+        }
+        redraw = false;
+        if (limiter) {
+          limiter->wait();
+        }
+        if (renderThread) {
+          windowOwner.swapBuffers();
+        } else {
+          windowOwner.update();
+        }
+        debugMessages.flush();
+      }
+    }};
+    if (renderThread) {
+      // The render thread owns the context until it is done, and the
+      // events are handled here meanwhile.
+      std::atomic<bool> rendering{true};
+      std::exception_ptr renderError{};
+      windowOwner.releaseContext();
+      std::thread thread{[&]() {
+        setTraceThreadName("render");
+        windowOwner.makeContextCurrent();
+        try {
+          renderFrames();
+        } catch (...) {
+          renderError = std::current_exception();
+        }
+        windowOwner.releaseContext();
+        rendering = false;
+        windowOwner.wakeEvents();
+      }};
+      windowOwner.handleEvents(rendering);
+      thread.join();
+      windowOwner.makeContextCurrent();
+      if (renderError) {
+        std::rethrow_exception(renderError);
+      }
+    } else {
+      renderFrames();
+    }
+    if (const std::optional<CaptureStatistics> capture{
+      graphics.stopCapture()
+    }) {
+      printCaptureStatistics(*capture);
+    }
+    if (profiler) {
+      graphics.finish();
+      profiler->finish();
+      BenchReport report{};
+      report.renderer = GraphicsEngine::getRendererString();
+      report.version = GraphicsEngine::getVersionString();
+      report.vertexPath = parameters.vertexPath.value_or("(default)");
+      report.fragmentPath = parameters.fragmentPath.value_or("(default)");
+      report.model = describeModel(parameters, modelType);
+      report.width = parameters.width;
+      report.height = parameters.height;
+      report.frames = profiler->getCPUTimes().size();
+      report.cpu = FrameStatistics::fromSamples(profiler->getCPUTimes());
+      report.gpu = FrameStatistics::fromSamples(profiler->getGPUTimes());
+      report.fps = report.cpu.mean > 0. ? 1000./report.cpu.mean : 0.;
+      // A window closed during the warmup leaves nothing to divide by.
+      if (frames > benchWarmupFrames) {
+        const DrawCounts drawCounts{graphics.getDrawCounts()};
+        const auto benchFrames{
+          static_cast<double>(frames - benchWarmupFrames)
+        };
+        report.verticesPerFrame = static_cast<double>(
+          drawCounts.vertices - benchDrawCounts.vertices
+        )/benchFrames;
+        report.trianglesPerFrame = static_cast<double>(
+          drawCounts.triangles - benchDrawCounts.triangles
+        )/benchFrames;
+      }
+      report.startupMilliseconds = startupMilliseconds;
+      if (const ProgramCache* cache{graphics.getProgramCache()}) {
+        report.cache = cache->getStatistics();
+      }
+      report.print(std::cout, parameters.benchFormat);
+      return EXIT_SUCCESS;
+    }
+    if (parameters.headless) {
+      graphics.finish();
+      const std::chrono::duration<double> elapsed{
+        std::chrono::steady_clock::now() - startTime
+      };
+      std::cout << "Rendered " << frames << " frames at "
+        << parameters.width << 'x' << parameters.height << " in "
+        << elapsed.count()*1000. << " ms ("
+        << frames/elapsed.count() << " fps)\n";
+      const bool heavyGeometry{
+        parameters.instanceCount > 1
+        || (modelType != GeometryType::Rectangle
+          && modelType != GeometryType::Triangle)
+      };
+      if (heavyGeometry && frames > 0) {
+        const DrawCounts drawCounts{graphics.getDrawCounts()};
+        std::cout << "Drew " << drawCounts.vertices/frames << " vertices and "
+          << drawCounts.triangles/frames << " triangles per frame ("
+          << static_cast<double>(drawCounts.vertices)/elapsed.count()/1e6
+          << " Mvertices/s, "
+          << static_cast<double>(drawCounts.triangles)/elapsed.count()/1e6
+          << " Mtriangles/s)\n";
       }
-      actions.reset();
-      if (!paused) {
-        graphics.render();
+      if (const ProgramCache* cache{graphics.getProgramCache()}) {
+        printCacheStatistics(*cache);
       }
-      windowOwner.update();
     }
+    printCPUUsage(usageMeter, frames);
     std::cout << "Goodbye.\n";
   } catch (std::exception& ex) {
     std::cerr << ex.what() << '\n';
@@ -0,0 +1,711 @@
+#include "mesh.hxx"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+
+#include "debug.hxx"
+#include "io.hxx"
+
+namespace {
+
+struct MeshData {
+  std::vector<float> vertices{};
+  std::vector<std::uint32_t> indices{};
+  VertexLayout layout{};
+};
+
+constexpr std::size_t maxVertexCount{
+  std::numeric_limits<std::uint32_t>::max()
+};
+
+auto skipSpaces(const char*& p, const char* end) -> void {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+    ++p;
+  }
+}
+
+// Also skips line breaks, for the free-form body of ASCII PLY files.
+auto skipWhitespace(const char*& p, const char* end) -> void {
+  while (
+    p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+  ) {
+    ++p;
+  }
+}
+
+auto skipLine(const char*& p, const char* end) -> void {
+  const void* newline{std::memchr(p, '\n', static_cast<std::size_t>(end - p))};
+  p = newline ? static_cast<const char*>(newline) + 1 : end;
+}
+
+auto readWord(const char*& p, const char* end) -> std::string_view {
+  skipSpaces(p, end);
+  const char* start{p};
+  while (
+    p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'
+  ) {
+    ++p;
+  }
+  return {start, static_cast<std::size_t>(p - start)};
+}
+
+template <typename T>
+auto readNumber(const char*& p, const char* end, T& value) -> bool {
+  // from_chars rejects a leading plus sign.
+  if (p < end && *p == '+') {
+    ++p;
+  }
+  const auto [next, error]{std::from_chars(p, end, value)};
+  if (error != std::errc{}) {
+    return false;
+  }
+  p = next;
+  return true;
+}
+
+/**
+ * Scales the positions into [-1, 1] around their centre, keeping the
+ * proportions.
+ */
+auto normalizePositions(std::vector<float>& vertices, std::size_t stride) {
+  float low[3]{
+    std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+    std::numeric_limits<float>::max()
+  };
+  float high[3]{-low[0], -low[1], -low[2]};
+  for (std::size_t i{0}; i < vertices.size(); i += stride) {
+    for (std::size_t axis{0}; axis < 3; ++axis) {
+      low[axis] = std::min(low[axis], vertices[i + axis]);
+      high[axis] = std::max(high[axis], vertices[i + axis]);
+    }
+  }
+  const float extent{std::max({
+    high[0] - low[0], high[1] - low[1], high[2] - low[2]
+  })};
+  if (!(extent > 0.f)) {
+    return;
+  }
+  const float scale{2.f/extent};
+  for (std::size_t i{0}; i < vertices.size(); i += stride) {
+    for (std::size_t axis{0}; axis < 3; ++axis) {
+      vertices[i + axis] = (vertices[i + axis] - (low[axis] + high[axis])/2.f)
+        *scale;
+    }
+  }
+}
+
+// Splits a convex polygon into a fan of triangles.
+template <typename T>
+auto addFan(const std::vector<T>& polygon, std::vector<T>& triangles) {
+  for (std::size_t i{2}; i < polygon.size(); ++i) {
+    triangles.push_back(polygon[0]);
+    triangles.push_back(polygon[i - 1]);
+    triangles.push_back(polygon[i]);
+  }
+}
+
+// 0-based indices of an OBJ face corner; -1 for a missing attribute.
+struct ObjCorner {
+  std::int64_t position;
+  std::int64_t texCoord;
+  std::int64_t normal;
+
+  auto operator==(const ObjCorner& other) const -> bool {
+    return position == other.position && texCoord == other.texCoord
+      && normal == other.normal;
+  }
+};
+
+struct ObjCornerHash {
+  auto operator()(const ObjCorner& corner) const -> std::size_t {
+    const std::hash<std::int64_t> hash{};
+    return hash(corner.position) ^ (hash(corner.texCoord) << 1)
+      ^ (hash(corner.normal) << 2);
+  }
+};
+
+// Resolves a 1-based or negative (relative) OBJ index.
+auto resolveObjIndex(
+  std::int64_t index, std::size_t count, std::int64_t& resolved
+) -> bool {
+  if (index > 0) {
+    resolved = index - 1;
+  } else if (index < 0) {
+    resolved = static_cast<std::int64_t>(count) + index;
+  } else {
+    return false;
+  }
+  return resolved >= 0;
+}
+
+auto parseObjCorner(
+  const char*& p, const char* end, std::size_t positionCount,
+  std::size_t texCoordCount, std::size_t normalCount, ObjCorner& corner
+) -> bool {
+  corner = {-1, -1, -1};
+  std::int64_t index{};
+  if (!readNumber(p, end, index)) {
+    return false;
+  }
+  if (!resolveObjIndex(index, positionCount, corner.position)) {
+    return false;
+  }
+  if (p < end && *p == '/') {
+    ++p;
+    if (p < end && *p != '/') {
+      if (
+        !readNumber(p, end, index)
+        || !resolveObjIndex(index, texCoordCount, corner.texCoord)
+      ) {
+        return false;
+      }
+    }
+    if (p < end && *p == '/') {
+      ++p;
+      if (
+        !readNumber(p, end, index)
+        || !resolveObjIndex(index, normalCount, corner.normal)
+      ) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+auto parseObj(
+  const char* p, const char* end, MeshData& mesh, std::string& error
+) -> bool {
+  std::vector<float> positions{};
+  std::vector<float> texCoords{};
+  std::vector<float> normals{};
+  std::vector<ObjCorner> corners{};
+  std::vector<ObjCorner> polygon{};
+  std::size_t line{1};
+  const auto fail{[&](const std::string& message) {
+    error = "line " + std::to_string(line) + ": " + message;
+    return false;
+  }};
+  for (; p < end; skipLine(p, end), ++line) {
+    const std::string_view keyword{readWord(p, end)};
+    if (keyword == "v" || keyword == "vn") {
+      std::vector<float>& values{keyword == "v" ? positions : normals};
+      for (int i{0}; i < 3; ++i) {
+        float value{};
+        skipSpaces(p, end);
+        if (!readNumber(p, end, value)) {
+          return fail("expected 3 coordinates");
+        }
+        values.push_back(value);
+      }
+    } else if (keyword == "vt") {
+      float value[2]{};
+      skipSpaces(p, end);
+      if (!readNumber(p, end, value[0])) {
+        return fail("expected a texture coordinate");
+      }
+      skipSpaces(p, end);
+      readNumber(p, end, value[1]);
+      texCoords.insert(texCoords.end(), value, value + 2);
+    } else if (keyword == "f") {
+      polygon.clear();
+      ObjCorner corner{};
+      while (true) {
+        skipSpaces(p, end);
+        if (p == end || *p == '\n' || *p == '#') {
+          break;
+        }
+        if (!parseObjCorner(
+          p, end, positions.size()/3, texCoords.size()/2, normals.size()/3,
+          corner
+        )) {
+          return fail("invalid face");
+        }
+        polygon.push_back(corner);
+      }
+      if (polygon.size() < 3) {
+        return fail("faces need at least 3 vertices");
+      }
+      addFan(polygon, corners);
+    }
+    // Groups, materials, smoothing, lines and points do not matter here.
+  }
+  if (corners.empty()) {
+    error = "no faces";
+    return false;
+  }
+  if (positions.size()/3 > maxVertexCount) {
+    error = "too many vertices";
+    return false;
+  }
+  VertexLayout& layout{mesh.layout};
+  for (const ObjCorner& corner : corners) {
+    if (
+      static_cast<std::size_t>(corner.position) >= positions.size()/3
+      || static_cast<std::size_t>(corner.texCoord + 1) > texCoords.size()/2
+      || static_cast<std::size_t>(corner.normal + 1) > normals.size()/3
+    ) {
+      error = "a face refers to a missing vertex";
+      return false;
+    }
+    layout.normals = layout.normals || corner.normal >= 0;
+    layout.texCoords = layout.texCoords || corner.texCoord >= 0;
+  }
+  std::vector<std::uint32_t>& indices{mesh.indices};
+  indices.reserve(corners.size());
+  if (!layout.normals && !layout.texCoords) {
+    // Positions alone need no welding.
+    for (const ObjCorner& corner : corners) {
+      indices.push_back(static_cast<std::uint32_t>(corner.position));
+    }
+    mesh.vertices = std::move(positions);
+    return true;
+  }
+  // Every distinct combination of attributes becomes one vertex.
+  const std::size_t stride{layout.getStride()};
+  std::vector<float>& vertices{mesh.vertices};
+  vertices.reserve(positions.size()/3*stride);
+  std::unordered_map<ObjCorner, std::uint32_t, ObjCornerHash> welded{};
+  welded.reserve(positions.size()/3);
+  for (const ObjCorner& corner : corners) {
+    const auto [entry, inserted]{welded.try_emplace(
+      corner, static_cast<std::uint32_t>(vertices.size()/stride)
+    )};
+    if (inserted) {
+      const float* position{positions.data() + corner.position*3};
+      vertices.insert(vertices.end(), position, position + 3);
+      if (layout.normals) {
+        if (corner.normal >= 0) {
+          const float* normal{normals.data() + corner.normal*3};
+          vertices.insert(vertices.end(), normal, normal + 3);
+        } else {
+          vertices.insert(vertices.end(), 3, 0.f);
+        }
+      }
+      if (layout.texCoords) {
+        if (corner.texCoord >= 0) {
+          const float* texCoord{texCoords.data() + corner.texCoord*2};
+          vertices.insert(vertices.end(), texCoord, texCoord + 2);
+        } else {
+          vertices.insert(vertices.end(), 2, 0.f);
+        }
+      }
+    }
+    indices.push_back(entry->second);
+  }
+  return true;
+}
+
+enum class PLYType {
+  Int8,
+  UInt8,
+  Int16,
+  UInt16,
+  Int32,
+  UInt32,
+  Float32,
+  Float64
+};
+
+enum class PLYFormat {
+  ASCII,
+  LittleEndian,
+  BigEndian
+};
+
+struct PLYProperty {
+  std::string name;
+  PLYType type;
+  bool isList;
+  PLYType countType;
+};
+
+struct PLYElement {
+  std::string name;
+  std::size_t count;
+  std::vector<PLYProperty> properties;
+};
+
+auto parsePLYType(std::string_view name, PLYType& type) -> bool {
+  static const std::pair<std::string_view, PLYType> names[]{
+    {"char", PLYType::Int8}, {"int8", PLYType::Int8},
+    {"uchar", PLYType::UInt8}, {"uint8", PLYType::UInt8},
+    {"short", PLYType::Int16}, {"int16", PLYType::Int16},
+    {"ushort", PLYType::UInt16}, {"uint16", PLYType::UInt16},
+    {"int", PLYType::Int32}, {"int32", PLYType::Int32},
+    {"uint", PLYType::UInt32}, {"uint32", PLYType::UInt32},
+    {"float", PLYType::Float32}, {"float32", PLYType::Float32},
+    {"double", PLYType::Float64}, {"float64", PLYType::Float64}
+  };
+  for (const auto& [typeName, value] : names) {
+    if (name == typeName) {
+      type = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+auto getPLYTypeSize(PLYType type) -> std::size_t {
+  switch (type) {
+    case PLYType::Int8:
+    case PLYType::UInt8:
+      return 1;
+    case PLYType::Int16:
+    case PLYType::UInt16:
+      return 2;
+    case PLYType::Int32:
+    case PLYType::UInt32:
+    case PLYType::Float32:
+      return 4;
+    case PLYType::Float64:
+      return 8;
+  }
+  return 0;
+}
+
+template <typename T>
+auto decodeBinary(const char* bytes, bool swap) -> double {
+  char copy[sizeof(T)];
+  std::memcpy(copy, bytes, sizeof(T));
+  if (swap) {
+    std::reverse(copy, copy + sizeof(T));
+  }
+  T value{};
+  std::memcpy(&value, copy, sizeof(T));
+  return static_cast<double>(value);
+}
+
+// Reads the values of PLY elements in any of the three formats.
+class PLYReader {
+public:
+  PLYReader(
+    const char* p, const char* end, PLYFormat format
+  ) : _p{p}, _end{end}, _format{format} {
+    const std::uint16_t probe{1};
+    char firstByte{};
+    std::memcpy(&firstByte, &probe, 1);
+    const bool littleEndianHost{firstByte == 1};
+    _swap = format == PLYFormat::LittleEndian ? !littleEndianHost
+      : format == PLYFormat::BigEndian && littleEndianHost;
+  }
+
+  auto read(PLYType type, double& value) -> bool {
+    if (_format == PLYFormat::ASCII) {
+      skipWhitespace(_p, _end);
+      return readNumber(_p, _end, value);
+    }
+    const std::size_t size{getPLYTypeSize(type)};
+    if (static_cast<std::size_t>(_end - _p) < size) {
+      return false;
+    }
+    switch (type) {
+      case PLYType::Int8:
+        value = decodeBinary<std::int8_t>(_p, _swap);
+        break;
+      case PLYType::UInt8:
+        value = decodeBinary<std::uint8_t>(_p, _swap);
+        break;
+      case PLYType::Int16:
+        value = decodeBinary<std::int16_t>(_p, _swap);
+        break;
+      case PLYType::UInt16:
+        value = decodeBinary<std::uint16_t>(_p, _swap);
+        break;
+      case PLYType::Int32:
+        value = decodeBinary<std::int32_t>(_p, _swap);
+        break;
+      case PLYType::UInt32:
+        value = decodeBinary<std::uint32_t>(_p, _swap);
+        break;
+      case PLYType::Float32:
+        value = decodeBinary<float>(_p, _swap);
+        break;
+      case PLYType::Float64:
+        value = decodeBinary<double>(_p, _swap);
+        break;
+    }
+    _p += size;
+    return true;
+  }
+
+  // Reads a list, calling the function with every item.
+  template <typename F>
+  auto readList(const PLYProperty& property, F onItem) -> bool {
+    double count{};
+    if (!read(property.countType, count) || count < 0.) {
+      return false;
+    }
+    for (std::size_t i{0}; i < static_cast<std::size_t>(count); ++i) {
+      double value{};
+      if (!read(property.type, value)) {
+        return false;
+      }
+      onItem(value);
+    }
+    return true;
+  }
+
+  auto skip(const PLYProperty& property) -> bool {
+    double value{};
+    if (property.isList) {
+      return readList(property, [](double) {});
+    }
+    return read(property.type, value);
+  }
+
+private:
+  const char* _p;
+  const char* _end;
+  PLYFormat _format;
+  bool _swap{false};
+};
+
+auto parsePLYHeader(
+  const char*& p, const char* end, PLYFormat& format,
+  std::vector<PLYElement>& elements, std::string& error
+) -> bool {
+  if (readWord(p, end) != "ply") {
+    error = "missing \"ply\" header";
+    return false;
+  }
+  skipLine(p, end);
+  bool hasFormat{false};
+  while (p < end) {
+    const std::string_view keyword{readWord(p, end)};
+    if (keyword == "end_header") {
+      skipLine(p, end);
+      if (!hasFormat) {
+        error = "missing format";
+        return false;
+      }
+      return true;
+    } else if (keyword == "format") {
+      const std::string_view name{readWord(p, end)};
+      if (name == "ascii") {
+        format = PLYFormat::ASCII;
+      } else if (name == "binary_little_endian") {
+        format = PLYFormat::LittleEndian;
+      } else if (name == "binary_big_endian") {
+        format = PLYFormat::BigEndian;
+      } else {
+        error = "unknown format \"" + std::string{name} + '"';
+        return false;
+      }
+      hasFormat = true;
+    } else if (keyword == "element") {
+      const std::string_view name{readWord(p, end)};
+      std::size_t count{};
+      skipSpaces(p, end);
+      if (!readNumber(p, end, count)) {
+        error = "invalid element count";
+        return false;
+      }
+      elements.push_back({std::string{name}, count, {}});
+    } else if (keyword == "property") {
+      if (elements.empty()) {
+        error = "property before element";
+        return false;
+      }
+      PLYProperty property{};
+      std::string_view type{readWord(p, end)};
+      if (type == "list") {
+        property.isList = true;
+        if (!parsePLYType(readWord(p, end), property.countType)) {
+          error = "invalid list count type";
+          return false;
+        }
+        type = readWord(p, end);
+      }
+      if (!parsePLYType(type, property.type)) {
+        error = "unknown property type \"" + std::string{type} + '"';
+        return false;
+      }
+      property.name = std::string{readWord(p, end)};
+      elements.back().properties.push_back(std::move(property));
+    }
+    // Comments and obj_info lines carry nothing needed here.
+    skipLine(p, end);
+  }
+  error = "missing end_header";
+  return false;
+}
+
+auto parsePLY(
+  const char* p, const char* end, MeshData& mesh, std::string& error
+) -> bool {
+  PLYFormat format{};
+  std::vector<PLYElement> elements{};
+  if (!parsePLYHeader(p, end, format, elements, error)) {
+    return false;
+  }
+  PLYReader reader{p, end, format};
+  VertexLayout& layout{mesh.layout};
+  std::vector<float>& vertices{mesh.vertices};
+  std::vector<std::uint32_t>& indices{mesh.indices};
+  std::size_t vertexCount{0};
+  std::vector<std::uint32_t> polygon{};
+  for (const PLYElement& element : elements) {
+    if (element.name == "vertex") {
+      // Where each property goes in the interleaved vertex, if anywhere.
+      std::vector<int> slots{};
+      bool hasPosition[3]{};
+      bool hasNormal{false};
+      bool hasTexCoord{false};
+      for (const PLYProperty& property : element.properties) {
+        int slot{-1};
+        const std::string& name{property.name};
+        if (property.isList) {
+          // Lists of a vertex are skipped.
+        } else if (name == "x" || name == "y" || name == "z") {
+          slot = name[0] - 'x';
+          hasPosition[slot] = true;
+        } else if (name == "nx" || name == "ny" || name == "nz") {
+          slot = 3 + name[1] - 'x';
+          hasNormal = true;
+        } else if (name == "s" || name == "u" || name == "texture_u") {
+          slot = 6;
+          hasTexCoord = true;
+        } else if (name == "t" || name == "v" || name == "texture_v") {
+          slot = 7;
+          hasTexCoord = true;
+        }
+        slots.push_back(slot);
+      }
+      if (!hasPosition[0] || !hasPosition[1] || !hasPosition[2]) {
+        error = "vertices need x, y and z";
+        return false;
+      }
+      if (element.count > maxVertexCount) {
+        error = "too many vertices";
+        return false;
+      }
+      layout.normals = hasNormal;
+      layout.texCoords = hasTexCoord;
+      const std::size_t stride{layout.getStride()};
+      // Slots 6 and 7 move up when there are no normals.
+      const int texCoordSlot{hasNormal ? 6 : 3};
+      vertexCount = element.count;
+      vertices.assign(element.count*stride, 0.f);
+      for (std::size_t i{0}; i < element.count; ++i) {
+        float* vertex{vertices.data() + i*stride};
+        for (std::size_t j{0}; j < element.properties.size(); ++j) {
+          const PLYProperty& property{element.properties[j]};
+          double value{};
+          if (property.isList) {
+            if (!reader.skip(property)) {
+              error = "truncated vertex data";
+              return false;
+            }
+            continue;
+          }
+          if (!reader.read(property.type, value)) {
+            error = "truncated vertex data";
+            return false;
+          }
+          const int slot{slots[j]};
+          if (slot >= 6) {
+            vertex[texCoordSlot + slot - 6] = static_cast<float>(value);
+          } else if (slot >= 0) {
+            vertex[slot] = static_cast<float>(value);
+          }
+        }
+      }
+    } else if (element.name == "face") {
+      indices.reserve(element.count*3);
+      for (std::size_t i{0}; i < element.count; ++i) {
+        for (const PLYProperty& property : element.properties) {
+          const bool isIndices{
+            property.isList
+            && (property.name == "vertex_indices"
+              || property.name == "vertex_index")
+          };
+          if (!isIndices) {
+            if (!reader.skip(property)) {
+              error = "truncated face data";
+              return false;
+            }
+            continue;
+          }
+          polygon.clear();
+          bool valid{true};
+          if (!reader.readList(property, [&](double value) {
+            valid = valid && value >= 0.
+              && static_cast<std::size_t>(value) < vertexCount;
+            polygon.push_back(static_cast<std::uint32_t>(value));
+          })) {
+            error = "truncated face data";
+            return false;
+          }
+          if (!valid) {
+            error = "a face refers to a missing vertex";
+            return false;
+          }
+          addFan(polygon, indices);
+        }
+      }
+    } else {
+      for (std::size_t i{0}; i < element.count; ++i) {
+        for (const PLYProperty& property : element.properties) {
+          if (!reader.skip(property)) {
+            error = "truncated " + element.name + " data";
+            return false;
+          }
+        }
+      }
+    }
+  }
+  if (indices.empty()) {
+    error = "no faces";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+auto loadMesh(const std::string& path) -> std::unique_ptr<Mesh> {
+  const auto startTime{std::chrono::steady_clock::now()};
+  const MappedFile file{path};
+  if (!file.getData()) {
+    std::cerr << "Failed to read mesh " << path << '\n';
+    return nullptr;
+  }
+  const char* begin{file.getData()};
+  const char* end{begin + file.getSize()};
+  std::string extension{std::filesystem::path{path}.extension().string()};
+  std::transform(
+    extension.begin(), extension.end(), extension.begin(),
+    [](unsigned char c) { return static_cast<char>(std::tolower(c)); }
+  );
+  std::string error{"unknown format; use .obj or .ply"};
+  MeshData mesh{};
+  bool loaded{false};
+  if (extension == ".obj") {
+    loaded = parseObj(begin, end, mesh, error);
+  } else if (extension == ".ply") {
+    loaded = parsePLY(begin, end, mesh, error);
+  }
+  if (!loaded) {
+    std::cerr << "Failed to load mesh " << path << ": " << error << '\n';
+    return nullptr;
+  }
+  normalizePositions(mesh.vertices, mesh.layout.getStride());
+  const std::chrono::duration<double, std::milli> elapsed{
+    std::chrono::steady_clock::now() - startTime
+  };
+  LOG("Parsed " << path << " in " << elapsed.count() << " ms\n");
+  return std::make_unique<Mesh>(
+    std::move(mesh.vertices), std::move(mesh.indices), mesh.layout
+  );
+}
@@ -0,0 +1,18 @@
+#ifndef MESH_HXX
+#define MESH_HXX
+
+#include <memory>
+#include <string>
+
+#include "geometry.hxx"
+
+/**
+ * Loads a triangle mesh from a Wavefront OBJ or PLY (ASCII or binary) file.
+ * The file is memory-mapped and parsed in a single pass; polygons are split
+ * into triangles, and the mesh is centred and scaled to fit [-1, 1] so that
+ * it shows up with a pass-through vertex shader. Errors go to std::cerr;
+ * returns null on failure.
+ */
+auto loadMesh(const std::string& path) -> std::unique_ptr<Mesh>;
+
+#endif // MESH_HXX
@@ -0,0 +1,86 @@
+#include "pacing.hxx"
+
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Sleeps are only trusted up to this long before a deadline.
+constexpr std::chrono::microseconds spinThreshold{1500};
+
+} // namespace
+
+FrameLimiter::FrameLimiter(
+  double maxFramesPerSecond
+) : _period{std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>{1./maxFramesPerSecond}
+    )} {}
+
+auto FrameLimiter::wait() -> void {
+  Clock::time_point now{Clock::now()};
+  if (_deadline == Clock::time_point{}) {
+    _deadline = now + _period;
+    return;
+  }
+  if (now < _deadline - spinThreshold) {
+    std::this_thread::sleep_until(_deadline - spinThreshold);
+  }
+  while ((now = Clock::now()) < _deadline) {
+    std::this_thread::yield();
+  }
+  _deadline += _period;
+  // After a long frame, start a new grid instead of rushing to catch up.
+  if (_deadline < now) {
+    _deadline = now + _period;
+  }
+}
+
+CPUUsageMeter::CPUUsageMeter(
+) : _startCPUTime{getProcessCPUTime()},
+    _startWallTime{std::chrono::steady_clock::now()} {}
+
+auto CPUUsageMeter::getCPUTime(
+) const -> std::chrono::duration<double, std::milli> {
+  return getProcessCPUTime() - _startCPUTime;
+}
+
+auto CPUUsageMeter::getWallTime(
+) const -> std::chrono::duration<double, std::milli> {
+  return std::chrono::steady_clock::now() - _startWallTime;
+}
+
+auto CPUUsageMeter::getProcessCPUTime(
+) -> std::chrono::duration<double, std::milli> {
+#ifdef _WIN32
+  FILETIME creation{};
+  FILETIME exit{};
+  FILETIME kernel{};
+  FILETIME user{};
+  GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+  const auto toTicks{[](const FILETIME& time) {
+    return (static_cast<unsigned long long>(time.dwHighDateTime) << 32)
+      | time.dwLowDateTime;
+  }};
+  // FILETIME counts in units of 100 ns.
+  return std::chrono::duration<double, std::milli>{
+    static_cast<double>(toTicks(kernel) + toTicks(user))/1e4
+  };
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  const auto toMilliseconds{[](const timeval& time) {
+    return static_cast<double>(time.tv_sec)*1e3
+      + static_cast<double>(time.tv_usec)/1e3;
+  }};
+  return std::chrono::duration<double, std::milli>{
+    toMilliseconds(usage.ru_utime) + toMilliseconds(usage.ru_stime)
+  };
+#endif
+}
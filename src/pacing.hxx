@@ -0,0 +1,51 @@
+#ifndef PACING_HXX
+#define PACING_HXX
+
+#include <chrono>
+
+/**
+ * Caps the frame rate. Frames are scheduled on a fixed grid of deadlines;
+ * wait() sleeps until shortly before the next deadline and spins for the
+ * rest, since sleeps alone overshoot by up to a scheduler tick.
+ */
+class FrameLimiter {
+public:
+  explicit FrameLimiter(double maxFramesPerSecond);
+  FrameLimiter() = delete;
+  FrameLimiter(const FrameLimiter&) = delete;
+  FrameLimiter(FrameLimiter&&) = delete;
+  FrameLimiter operator=(const FrameLimiter&) = delete;
+  FrameLimiter operator=(FrameLimiter&&) = delete;
+
+  auto wait() -> void;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  const Clock::duration _period;
+  Clock::time_point _deadline{};
+};
+
+/**
+ * Measures the CPU time used by the whole process (all threads, user and
+ * kernel) against wall-clock time.
+ */
+class CPUUsageMeter {
+public:
+  CPUUsageMeter();
+  CPUUsageMeter(const CPUUsageMeter&) = delete;
+  CPUUsageMeter(CPUUsageMeter&&) = delete;
+  CPUUsageMeter operator=(const CPUUsageMeter&) = delete;
+  CPUUsageMeter operator=(CPUUsageMeter&&) = delete;
+
+  auto getCPUTime() const -> std::chrono::duration<double, std::milli>;
+  auto getWallTime() const -> std::chrono::duration<double, std::milli>;
+
+private:
+  static auto getProcessCPUTime() -> std::chrono::duration<double, std::milli>;
+
+  const std::chrono::duration<double, std::milli> _startCPUTime;
+  const std::chrono::steady_clock::time_point _startWallTime;
+};
+
+#endif // PACING_HXX
@@ -1,16 +1,296 @@
 #include "parameters.hxx"
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string_view>
 
-#include "io.hxx"
+#include "procedural.hxx"
+
+namespace {
+
+auto parsePositiveInt(std::string_view value) -> std::optional<int> {
+  int result{};
+  const char* end{value.data() + value.size()};
+  const auto [pointer, error]{std::from_chars(value.data(), end, result)};
+  if (error != std::errc{} || pointer != end || result <= 0) {
+    return {};
+  }
+  return result;
+}
+
+auto parseInt(std::string_view value) -> std::optional<int> {
+  int result{};
+  const char* end{value.data() + value.size()};
+  const auto [pointer, error]{std::from_chars(value.data(), end, result)};
+  if (error != std::errc{} || pointer != end) {
+    return {};
+  }
+  return result;
+}
+
+auto parsePositiveDouble(std::string_view value) -> std::optional<double> {
+  double result{};
+  const char* end{value.data() + value.size()};
+  const auto [pointer, error]{std::from_chars(value.data(), end, result)};
+  if (error != std::errc{} || pointer != end || !(result > 0.)) {
+    return {};
+  }
+  return result;
+}
+
+auto parseDouble(std::string_view value) -> std::optional<double> {
+  double result{};
+  const char* end{value.data() + value.size()};
+  const auto [pointer, error]{std::from_chars(value.data(), end, result)};
+  if (error != std::errc{} || pointer != end) {
+    return {};
+  }
+  return result;
+}
+
+auto parseSize(
+  std::string_view value, int& width, int& height
+) -> bool {
+  const std::size_t separator{value.find('x')};
+  if (separator == std::string_view::npos) {
+    return false;
+  }
+  const std::optional<int> w{parsePositiveInt(value.substr(0, separator))};
+  const std::optional<int> h{parsePositiveInt(value.substr(separator + 1))};
+  if (!w || !h) {
+    return false;
+  }
+  width = *w;
+  height = *h;
+  return true;
+}
+
+// "<name>[=<value>]", with a C identifier as the name.
+auto parseDefine(
+  std::string_view value
+) -> std::optional<std::pair<std::string, std::string>> {
+  const std::size_t separator{value.find('=')};
+  const std::string_view name{value.substr(0, separator)};
+  if (
+    name.empty() || std::isdigit(static_cast<unsigned char>(name.front()))
+    || !std::all_of(name.begin(), name.end(), [](char c) {
+      return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    })
+  ) {
+    return {};
+  }
+  if (separator == std::string_view::npos) {
+    return {{std::string{name}, "1"}};
+  }
+  return {{std::string{name}, std::string{value.substr(separator + 1)}}};
+}
+
+// Values of a range, formatted like its bounds: integers stay integers, and
+// floating-point values keep a decimal point for GLSL.
+auto expandRange(
+  std::string_view first, std::string_view last, std::string_view step
+) -> std::optional<std::vector<std::string>> {
+  const std::optional<double> from{parseDouble(first)};
+  const std::optional<double> to{parseDouble(last)};
+  const std::optional<double> by{
+    step.empty() ? std::optional<double>{1.} : parsePositiveDouble(step)
+  };
+  if (!from || !to || !by || *to < *from) {
+    return {};
+  }
+  const auto isInteger{[](std::string_view number) {
+    return number.find_first_of(".eE") == std::string_view::npos;
+  }};
+  const bool integers{
+    isInteger(first) && isInteger(last) && (step.empty() || isInteger(step))
+  };
+  std::vector<std::string> values{};
+  // The epsilon keeps the last value despite rounding errors in the steps.
+  const auto count{static_cast<std::size_t>((*to - *from)/ *by + 1e-9) + 1};
+  constexpr std::size_t maxValues{4096};
+  if (count > maxValues) {
+    return {};
+  }
+  for (std::size_t i{0}; i < count; ++i) {
+    const double number{*from + static_cast<double>(i)* *by};
+    std::ostringstream text{};
+    if (integers) {
+      text << static_cast<long long>(std::llround(number));
+    } else {
+      text << std::setprecision(9) << number;
+      if (text.str().find_first_of(".e") == std::string::npos) {
+        text << '.';
+      }
+    }
+    values.push_back(text.str());
+  }
+  return values;
+}
+
+// "<name>=<value>,<value>..." or "<name>=<first>..<last>[:<step>]"
+auto parseTuneParameter(
+  std::string_view value
+) -> std::optional<TuneParameter> {
+  const std::size_t separator{value.find('=')};
+  if (separator == std::string_view::npos) {
+    return {};
+  }
+  const std::optional<std::pair<std::string, std::string>> define{
+    parseDefine(value.substr(0, separator))
+  };
+  std::string_view values{value.substr(separator + 1)};
+  if (!define || values.empty()) {
+    return {};
+  }
+  TuneParameter parameter{define->first, {}};
+  if (const std::size_t range{values.find("..")};
+    range != std::string_view::npos
+  ) {
+    const std::size_t stepSeparator{values.find(':', range)};
+    std::optional<std::vector<std::string>> expanded{expandRange(
+      values.substr(0, range),
+      values.substr(range + 2, stepSeparator - range - 2),
+      stepSeparator == std::string_view::npos
+        ? std::string_view{} : values.substr(stepSeparator + 1)
+    )};
+    if (!expanded) {
+      return {};
+    }
+    parameter.values = std::move(*expanded);
+    return parameter;
+  }
+  while (true) {
+    const std::size_t comma{values.find(',')};
+    if (values.substr(0, comma).empty()) {
+      return {};
+    }
+    parameter.values.emplace_back(values.substr(0, comma));
+    if (comma == std::string_view::npos) {
+      return parameter;
+    }
+    values.remove_prefix(comma + 1);
+  }
+}
+
+// "<binding>:<bytes>[:<path>]"
+auto parseComputeBuffer(
+  std::string_view value
+) -> std::optional<ComputeBufferDescription> {
+  const std::size_t separator{value.find(':')};
+  if (separator == std::string_view::npos) {
+    return {};
+  }
+  const std::optional<int> binding{parseInt(value.substr(0, separator))};
+  const std::size_t pathSeparator{value.find(':', separator + 1)};
+  const std::optional<int> size{parsePositiveInt(
+    value.substr(separator + 1, pathSeparator - separator - 1)
+  )};
+  if (!binding || *binding < 0 || !size) {
+    return {};
+  }
+  ComputeBufferDescription buffer{
+    static_cast<GLuint>(*binding), static_cast<std::size_t>(*size), {}
+  };
+  if (pathSeparator != std::string_view::npos) {
+    buffer.initialPath = std::string{value.substr(pathSeparator + 1)};
+  }
+  return buffer;
+}
+
+// "<binding>:<width>x<height>[:<format>]"
+auto parseComputeImage(
+  std::string_view value
+) -> std::optional<ComputeImageDescription> {
+  const std::size_t separator{value.find(':')};
+  if (separator == std::string_view::npos) {
+    return {};
+  }
+  const std::optional<int> binding{parseInt(value.substr(0, separator))};
+  const std::size_t formatSeparator{value.find(':', separator + 1)};
+  int width{};
+  int height{};
+  const bool sized{parseSize(
+    value.substr(separator + 1, formatSeparator - separator - 1),
+    width, height
+  )};
+  const std::optional<GLenum> format{
+    formatSeparator == std::string_view::npos
+      ? GL_RGBA8
+      : parseImageFormat(std::string{value.substr(formatSeparator + 1)})
+  };
+  if (!binding || *binding < 0 || !sized || !format) {
+    return {};
+  }
+  return {{static_cast<GLuint>(*binding), width, height, *format}};
+}
+
+// "<n>=<path>[:<width>x<height>]", after "--channel".
+auto parseChannel(
+  std::string_view value
+) -> std::optional<ChannelDescription> {
+  const std::size_t separator{value.find('=')};
+  const std::optional<int> index{parseInt(value.substr(0, separator))};
+  if (
+    separator == std::string_view::npos || !index || *index < 0
+    || *index >= TextureChannels::maxChannels
+  ) {
+    return {};
+  }
+  std::string_view path{value.substr(separator + 1)};
+  int width{};
+  int height{};
+  const std::size_t sizeSeparator{path.rfind(':')};
+  if (
+    sizeSeparator != std::string_view::npos
+    && parseSize(path.substr(sizeSeparator + 1), width, height)
+  ) {
+    path = path.substr(0, sizeSeparator);
+  }
+  if (path.empty()) {
+    return {};
+  }
+  return {{*index, std::string{path}, width, height}};
+}
+
+// "<x>[x<y>[x<z>]]"
+auto parseGroupCount(
+  std::string_view value
+) -> std::optional<std::array<GLuint, 3>> {
+  std::array<GLuint, 3> count{1, 1, 1};
+  for (std::size_t axis{0}; axis < count.size(); ++axis) {
+    const std::size_t separator{value.find('x')};
+    const std::optional<int> axisCount{
+      parsePositiveInt(value.substr(0, separator))
+    };
+    if (!axisCount) {
+      return {};
+    }
+    count[axis] = static_cast<GLuint>(*axisCount);
+    if (separator == std::string_view::npos) {
+      return count;
+    }
+    value.remove_prefix(separator + 1);
+  }
+  return {};
+}
+
+} // namespace
 
 ShaderSources::ShaderSources(
-  std::string vertex_, std::string fragment_
-) : vertex{vertex_}, fragment{fragment_} {}
+  ShaderSource vertex_, ShaderSource fragment_
+) : vertex{std::move(vertex_)}, fragment{std::move(fragment_)} {}
 
 auto parseCLIArguments(int argc, char** argv) -> CLIParameters {
   std::vector<std::string> args{argv, argv + argc};
   CLIParameters parameters{};
+  // Whether an option needs the virtual clock even without --fps.
+  bool virtualClock{false};
   for (int a{1}; a < argc; ++a) {
     const std::string arg{args.at(a)};
     if (arg == "-vs") {
@@ -41,6 +321,429 @@ auto parseCLIArguments(int argc, char** argv) -> CLIParameters {
       } else {
         parameters.fragmentPath = value;
       }
+    } else if (arg == "-cs") {
+      if (a == argc - 1) {
+        std::cerr << "Missing compute shader path\n";
+      } else {
+        ++a;
+        parameters.computePath = args.at(a);
+      }
+    } else if (arg.find("--compute-shader=", 0) == 0) {
+      std::string value{arg.substr(17)};
+      if (value.length() == 0) {
+        std::cerr << "Missing compute shader path\n";
+      } else {
+        parameters.computePath = value;
+      }
+    } else if (arg.find("--buffer=", 0) == 0) {
+      if (const std::optional<ComputeBufferDescription> buffer{
+        parseComputeBuffer(arg.substr(9))
+      }) {
+        parameters.compute.buffers.push_back(*buffer);
+      } else {
+        std::cerr << "Invalid buffer \"" << arg.substr(9) << "\"\n";
+      }
+    } else if (arg.find("--image=", 0) == 0) {
+      if (const std::optional<ComputeImageDescription> image{
+        parseComputeImage(arg.substr(8))
+      }) {
+        parameters.compute.images.push_back(*image);
+      } else {
+        std::cerr << "Invalid image \"" << arg.substr(8) << "\"\n";
+      }
+    } else if (arg.find("--groups=", 0) == 0) {
+      parameters.compute.groupCount = parseGroupCount(arg.substr(9));
+      if (!parameters.compute.groupCount) {
+        std::cerr << "Invalid work group count \"" << arg.substr(9)
+          << "\"\n";
+      }
+    } else if (arg.find("--blit=", 0) == 0) {
+      const std::optional<int> value{parseInt(arg.substr(7))};
+      if (value && *value >= 0) {
+        parameters.compute.blitBinding = static_cast<GLuint>(*value);
+      } else {
+        std::cerr << "Invalid image binding \"" << arg.substr(7) << "\"\n";
+      }
+    } else if (arg.find("--dump=", 0) == 0) {
+      std::string value{arg.substr(7)};
+      if (value.length() == 0) {
+        std::cerr << "Missing dump directory\n";
+      } else {
+        parameters.dumpDirectory = value;
+      }
+    } else if (arg == "-D" && a == argc - 1) {
+      std::cerr << "Missing macro definition\n";
+    } else if (arg.find("-D", 0) == 0 || arg.find("--define=", 0) == 0) {
+      // "-D <definition>", "-D<definition>" or "--define=<definition>".
+      std::string value{arg.substr(arg[1] == 'D' ? 2 : 9)};
+      if (arg == "-D") {
+        ++a;
+        value = args.at(a);
+      }
+      if (const std::optional<std::pair<std::string, std::string>> define{
+        parseDefine(value)
+      }) {
+        setDefine(parameters.defines, define->first, define->second);
+      } else {
+        std::cerr << "Invalid macro definition \"" << value << "\"\n";
+      }
+    } else if (arg == "-I") {
+      if (a == argc - 1) {
+        std::cerr << "Missing include directory\n";
+      } else {
+        ++a;
+        parameters.includeDirectories.push_back(args.at(a));
+      }
+    } else if (arg.find("--include-dir=", 0) == 0) {
+      std::string value{arg.substr(14)};
+      if (value.length() == 0) {
+        std::cerr << "Missing include directory\n";
+      } else {
+        parameters.includeDirectories.push_back(value);
+      }
+    } else if (arg.find("--playlist=", 0) == 0) {
+      std::string value{arg.substr(11)};
+      if (value.length() == 0) {
+        std::cerr << "Missing playlist path\n";
+      } else {
+        parameters.playlistPath = value;
+      }
+    } else if (arg.find("--playlist-interval=", 0) == 0) {
+      const std::optional<int> interval{parsePositiveInt(arg.substr(20))};
+      if (interval) {
+        parameters.playlistInterval = *interval;
+      } else {
+        std::cerr << "Invalid playlist interval \"" << arg.substr(20)
+          << "\"\n";
+      }
+    } else if (arg.find("--passes=", 0) == 0) {
+      std::string value{arg.substr(9)};
+      if (value.length() == 0) {
+        std::cerr << "Missing render graph path\n";
+      } else {
+        parameters.passesPath = value;
+      }
+    } else if (arg.find("--swap-interval=", 0) == 0) {
+      // -1 requests adaptive vsync where supported.
+      const std::optional<int> interval{parseInt(arg.substr(16))};
+      if (interval && *interval >= -1) {
+        parameters.swapInterval = interval;
+      } else {
+        std::cerr << "Invalid swap interval \"" << arg.substr(16) << "\"\n";
+      }
+    } else if (arg.find("--max-fps=", 0) == 0) {
+      parameters.maxFPS = parsePositiveDouble(arg.substr(10));
+      if (!parameters.maxFPS) {
+        std::cerr << "Invalid frame rate \"" << arg.substr(10) << "\"\n";
+      }
+    } else if (arg == "--no-idle") {
+      parameters.idle = false;
+    } else if (arg.find("--target-ms=", 0) == 0) {
+      parameters.targetMilliseconds = parsePositiveDouble(arg.substr(12));
+      if (!parameters.targetMilliseconds) {
+        std::cerr << "Invalid target frame time \"" << arg.substr(12)
+          << "\"\n";
+      }
+    } else if (arg.find("--scale=", 0) == 0) {
+      const std::optional<double> scale{parsePositiveDouble(arg.substr(8))};
+      if (scale && *scale <= 1.) {
+        parameters.fixedScale = scale;
+      } else {
+        std::cerr << "Invalid scale \"" << arg.substr(8) << "\"\n";
+      }
+    } else if (arg == "--progressive") {
+      parameters.progressive = true;
+    } else if (arg.find("--tile-budget=", 0) == 0) {
+      const std::optional<double> budget{parsePositiveDouble(arg.substr(14))};
+      if (budget) {
+        parameters.tileBudget = *budget;
+      } else {
+        std::cerr << "Invalid tile budget \"" << arg.substr(14) << "\"\n";
+      }
+    } else if (arg.find("--tile-size=", 0) == 0) {
+      const std::optional<int> size{parsePositiveInt(arg.substr(12))};
+      if (size) {
+        parameters.tileSize = *size;
+      } else {
+        std::cerr << "Invalid tile size \"" << arg.substr(12) << "\"\n";
+      }
+    } else if (arg == "--coarse-to-fine") {
+      parameters.progressive = true;
+      parameters.coarseToFine = true;
+    } else if (arg.find("--size=", 0) == 0) {
+      if (!parseSize(arg.substr(7), parameters.width, parameters.height)) {
+        std::cerr << "Invalid size \"" << arg.substr(7) << "\"\n";
+      }
+    } else if (arg == "--headless") {
+      parameters.headless = true;
+    } else if (arg == "--software") {
+      parameters.software = true;
+    } else if (arg.find("--threads=", 0) == 0) {
+      const std::optional<int> value{parsePositiveInt(arg.substr(10))};
+      if (!value) {
+        std::cerr << "Invalid thread count \"" << arg.substr(10) << "\"\n";
+      } else {
+        parameters.threadCount = *value;
+      }
+    } else if (arg.find("--golden=", 0) == 0) {
+      std::string value{arg.substr(9)};
+      if (value.length() == 0) {
+        std::cerr << "Missing golden image list path\n";
+      } else {
+        parameters.goldenPath = value;
+        parameters.headless = true;
+      }
+    } else if (arg == "--golden-update") {
+      parameters.goldenUpdate = true;
+    } else if (arg.find("--golden-output=", 0) == 0) {
+      std::string value{arg.substr(16)};
+      if (value.length() == 0) {
+        std::cerr << "Missing golden image output directory\n";
+      } else {
+        parameters.goldenOutput = value;
+      }
+    } else if (arg.find("--max-error=", 0) == 0) {
+      const std::optional<int> value{parseInt(arg.substr(12))};
+      if (value && *value >= 0 && *value <= 255) {
+        parameters.maxError = *value;
+      } else {
+        std::cerr << "Invalid maximum error \"" << arg.substr(12) << "\"\n";
+      }
+    } else if (arg.find("--frames=", 0) == 0) {
+      parameters.frameCount = parsePositiveInt(arg.substr(9));
+      if (!parameters.frameCount) {
+        std::cerr << "Invalid frame count \"" << arg.substr(9) << "\"\n";
+      }
+    } else if (arg.find("--fps=", 0) == 0) {
+      parameters.fps = parsePositiveDouble(arg.substr(6));
+      if (!parameters.fps) {
+        std::cerr << "Invalid frame rate \"" << arg.substr(6) << "\"\n";
+      }
+    } else if (arg.find("--start-time=", 0) == 0) {
+      const std::optional<double> value{parseDouble(arg.substr(13))};
+      if (!value) {
+        std::cerr << "Invalid start time \"" << arg.substr(13) << "\"\n";
+      } else {
+        parameters.startTime = *value;
+        virtualClock = true;
+      }
+    } else if (arg.find("--frame-range=", 0) == 0) {
+      const std::string value{arg.substr(14)};
+      const std::size_t separator{value.find('-')};
+      const std::optional<int> first{
+        parseInt(std::string_view{value}.substr(0, separator))
+      };
+      const std::optional<int> last{
+        separator == std::string::npos
+          ? std::nullopt
+          : parseInt(std::string_view{value}.substr(separator + 1))
+      };
+      if (!first || !last || *first < 0 || *last < *first) {
+        std::cerr << "Invalid frame range \"" << value << "\"\n";
+      } else {
+        parameters.firstFrame = *first;
+        parameters.frameCount = *last - *first + 1;
+        virtualClock = true;
+      }
+    } else if (arg.find("--jobs=", 0) == 0) {
+      const std::optional<int> value{parsePositiveInt(arg.substr(7))};
+      if (!value) {
+        std::cerr << "Invalid job count \"" << arg.substr(7) << "\"\n";
+      } else {
+        parameters.jobCount = *value;
+      }
+    } else if (arg == "--bench") {
+      if (a == argc - 1) {
+        std::cerr << "Missing benchmark frame count\n";
+      } else {
+        ++a;
+        parameters.benchFrames = parsePositiveInt(args.at(a));
+        if (!parameters.benchFrames) {
+          std::cerr << "Invalid frame count \"" << args.at(a) << "\"\n";
+        }
+      }
+    } else if (arg.find("--bench=", 0) == 0) {
+      parameters.benchFrames = parsePositiveInt(arg.substr(8));
+      if (!parameters.benchFrames) {
+        std::cerr << "Invalid frame count \"" << arg.substr(8) << "\"\n";
+      }
+    } else if (arg.find("--bench-format=", 0) == 0) {
+      const std::string value{arg.substr(15)};
+      if (value == "text") {
+        parameters.benchFormat = BenchFormat::Text;
+      } else if (value == "json") {
+        parameters.benchFormat = BenchFormat::JSON;
+      } else if (value == "csv") {
+        parameters.benchFormat = BenchFormat::CSV;
+      } else {
+        std::cerr << "Unknown benchmark format \"" << value << "\"\n";
+      }
+    } else if (arg.find("--tune=", 0) == 0) {
+      if (const std::optional<TuneParameter> parameter{
+        parseTuneParameter(arg.substr(7))
+      }) {
+        parameters.tuneParameters.push_back(*parameter);
+        parameters.headless = true;
+      } else {
+        std::cerr << "Invalid tuning parameter \"" << arg.substr(7)
+          << "\"\n";
+      }
+    } else if (arg.find("--tune-budget=", 0) == 0) {
+      const std::optional<double> value{parsePositiveDouble(arg.substr(14))};
+      if (!value) {
+        std::cerr << "Invalid frame time budget \"" << arg.substr(14)
+          << "\"\n";
+      } else {
+        parameters.tuneBudget = *value;
+      }
+    } else if (arg.find("--tune-frames=", 0) == 0) {
+      const std::optional<int> value{parsePositiveInt(arg.substr(14))};
+      if (!value) {
+        std::cerr << "Invalid frame count \"" << arg.substr(14) << "\"\n";
+      } else {
+        parameters.tuneFrames = *value;
+      }
+    } else if (arg.find("--model=", 0) == 0) {
+      const std::string value{arg.substr(8)};
+      if (value == "rectangle") {
+        parameters.modelType = GeometryType::Rectangle;
+      } else if (value == "triangle") {
+        parameters.modelType = GeometryType::Triangle;
+      } else if (value == "mesh") {
+        parameters.modelType = GeometryType::Mesh;
+      } else if (value == "plane") {
+        parameters.modelType = GeometryType::Plane;
+      } else if (value == "sphere") {
+        parameters.modelType = GeometryType::Sphere;
+      } else if (value == "cube") {
+        parameters.modelType = GeometryType::Cube;
+      } else {
+        std::cerr << "Unknown model \"" << value << "\"\n";
+      }
+    } else if (arg.find("--subdivisions=", 0) == 0) {
+      const std::optional<int> value{parsePositiveInt(arg.substr(15))};
+      if (!value || *value > maxSubdivisions) {
+        std::cerr << "Invalid subdivisions \"" << arg.substr(15)
+          << "\" (at most " << maxSubdivisions << ")\n";
+        parameters.invalidSubdivisions = true;
+      } else {
+        parameters.subdivisions = *value;
+      }
+    } else if (arg.find("--instances=", 0) == 0) {
+      const std::optional<int> value{parsePositiveInt(arg.substr(12))};
+      if (!value) {
+        std::cerr << "Invalid instance count \"" << arg.substr(12) << "\"\n";
+      } else {
+        parameters.instanceCount = *value;
+      }
+    } else if (arg.find("--channel-fps=", 0) == 0) {
+      const std::optional<double> value{parsePositiveDouble(arg.substr(14))};
+      if (!value) {
+        std::cerr << "Invalid channel frame rate \"" << arg.substr(14)
+          << "\"\n";
+      } else {
+        parameters.channelFPS = *value;
+      }
+    } else if (arg.find("--channel-prefetch=", 0) == 0) {
+      const std::optional<int> value{parsePositiveInt(arg.substr(19))};
+      if (!value) {
+        std::cerr << "Invalid channel prefetch \"" << arg.substr(19)
+          << "\"\n";
+      } else {
+        parameters.channelPrefetch = *value;
+      }
+    } else if (
+      arg.find("--channel", 0) == 0 && arg.size() > 9
+      && std::isdigit(static_cast<unsigned char>(arg[9]))
+    ) {
+      if (const std::optional<ChannelDescription> channel{
+        parseChannel(arg.substr(9))
+      }) {
+        // A channel given again replaces the earlier one.
+        std::vector<ChannelDescription>& channels{parameters.channels};
+        channels.erase(std::remove_if(
+          channels.begin(), channels.end(),
+          [&channel](const ChannelDescription& other) {
+            return other.index == channel->index;
+          }
+        ), channels.end());
+        channels.push_back(*channel);
+      } else {
+        std::cerr << "Invalid channel \"" << arg.substr(9) << "\"\n";
+      }
+    } else if (arg.find("--mesh=", 0) == 0) {
+      std::string value{arg.substr(7)};
+      if (value.length() == 0) {
+        std::cerr << "Missing mesh path\n";
+      } else {
+        parameters.meshPath = value;
+        parameters.modelType = GeometryType::Mesh;
+      }
+    } else if (arg.find("--capture=", 0) == 0) {
+      std::string value{arg.substr(10)};
+      if (value.length() == 0) {
+        std::cerr << "Missing capture path\n";
+      } else {
+        parameters.capturePath = value;
+      }
+    } else if (arg.find("--capture-format=", 0) == 0) {
+      const std::string value{arg.substr(17)};
+      if (value == "png") {
+        parameters.captureFormat = CaptureFormat::PNG;
+      } else if (value == "raw") {
+        parameters.captureFormat = CaptureFormat::Raw;
+      } else if (value == "y4m") {
+        parameters.captureFormat = CaptureFormat::Y4M;
+      } else {
+        std::cerr << "Unknown capture format \"" << value << "\"\n";
+      }
+    } else if (arg.find("--capture-fps=", 0) == 0) {
+      parameters.captureFPS = parsePositiveDouble(arg.substr(14));
+      if (!parameters.captureFPS) {
+        std::cerr << "Invalid capture frame rate \"" << arg.substr(14)
+          << "\"\n";
+      }
+    } else if (arg.find("--capture-queue=", 0) == 0) {
+      const std::optional<int> value{parsePositiveInt(arg.substr(16))};
+      if (!value) {
+        std::cerr << "Invalid capture queue size \"" << arg.substr(16)
+          << "\"\n";
+      } else {
+        parameters.captureQueue = *value;
+      }
+    } else if (arg == "--capture-drop") {
+      parameters.captureDrop = true;
+    } else if (arg.find("--trace=", 0) == 0) {
+      std::string value{arg.substr(8)};
+      if (value.length() == 0) {
+        std::cerr << "Missing trace path\n";
+      } else {
+        parameters.tracePath = value;
+      }
+    } else if (arg == "--gl-debug" || arg == "--gl-debug=async") {
+      parameters.glDebugMode = GLDebugMode::Asynchronous;
+    } else if (arg == "--gl-debug=sync") {
+      parameters.glDebugMode = GLDebugMode::Synchronous;
+    } else if (arg == "--gl-debug=off") {
+      parameters.glDebugMode = GLDebugMode::Off;
+    } else if (arg == "--watch") {
+      parameters.watch = true;
+    } else if (arg == "--no-cache") {
+      parameters.useCache = false;
+    } else if (arg.find("--cache-dir=", 0) == 0) {
+      std::string value{arg.substr(12)};
+      if (value.length() == 0) {
+        std::cerr << "Missing cache directory\n";
+      } else {
+        parameters.cacheDirectory = value;
+      }
+    } else if (arg.find("--cache-size=", 0) == 0) {
+      const std::optional<int> value{parsePositiveInt(arg.substr(13))};
+      if (!value) {
+        std::cerr << "Invalid cache size \"" << arg.substr(13) << "\"\n";
+      } else {
+        parameters.cacheSizeMiB = *value;
+      }
     } else if (arg.find("--echo", 0) == 0) {
       parameters.echo = true;
     } else if (arg == "-h" || arg.find("--help", 0) == 0) {
@@ -49,23 +752,34 @@ auto parseCLIArguments(int argc, char** argv) -> CLIParameters {
       std::cerr << "Unknown argument \"" << arg << "\"\n";
     }
   }
+  // Workers render frames of the virtual clock.
+  if (parameters.jobCount > 1) {
+    parameters.headless = true;
+    virtualClock = true;
+  }
+  if (virtualClock && !parameters.fps) {
+    parameters.fps = 60.;
+  }
+  if ((parameters.headless || parameters.software) && !parameters.frameCount) {
+    parameters.frameCount = 1;
+  }
   return parameters;
 }
 
 auto loadShaderSources(
-  const CLIParameters& parameters
+  const CLIParameters& parameters, ShaderPreprocessor& preprocessor
 ) -> std::optional<ShaderSources> {
   if (!parameters.vertexPath || !parameters.fragmentPath) {
     return {};
   }
-  std::optional<std::string> vertex{
-    readFile(*parameters.vertexPath)
+  std::optional<ShaderSource> vertex{
+    preprocessor.process(*parameters.vertexPath, parameters.defines)
   };
-  std::optional<std::string> fragment{
-    readFile(*parameters.fragmentPath)
+  std::optional<ShaderSource> fragment{
+    preprocessor.process(*parameters.fragmentPath, parameters.defines)
   };
   if (vertex && fragment) {
-    return {{*vertex, *fragment}};
+    return {{std::move(*vertex), std::move(*fragment)}};
   }
   return {};
 }
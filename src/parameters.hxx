@@ -5,6 +5,15 @@
 #include <string>
 #include <vector>
 
+#include "channels.hxx"
+#include "compute.hxx"
+#include "debug.hxx"
+#include "framewriter.hxx"
+#include "geometry.hxx"
+#include "gldebug.hxx"
+#include "preprocessor.hxx"
+#include "source.hxx"
+
 constexpr const char* defaultVertexSource{
 #include "default.vert"
 };
@@ -21,8 +30,174 @@ Options:
         Set the vertex shader path
     -fs <path>, --fragment-shader=<path>
         Set the fragment shader path
+    -D <name>[=<value>], --define=<name>[=<value>]
+        Define a macro right after the #version directive of the shaders
+        (default value: 1; repeatable, the last definition of a name wins)
+    -I <path>, --include-dir=<path>
+        Add a directory to search for #include "file" directives, after
+        the directory of the including file (repeatable)
+    --playlist=<path>
+        Cycle through the fragment shaders in a directory, or in a list
+        file with one "<fragment>" or "<vertex> <fragment>" entry per line.
+        All programs are built up front; -vs sets the default vertex shader
+    --playlist-interval=<seconds>
+        Switch to the next playlist shader after the given number of seconds
+        (default: 5)
+    --passes=<path>
+        Render a multi-pass render graph described in a file with one
+        "<name> <fragment> [<input>...] [format=<format>] [scale=<factor>]"
+        entry per line; the "image" pass is shown. -vs sets the vertex
+        shader of every pass
+    -cs <path>, --compute-shader=<path>
+        Run a compute shader once per frame instead of drawing, on the
+        buffers and images below, and print its dispatch times
+    --buffer=<binding>:<bytes>[:<path>]
+        Add a shader storage buffer for the compute shader, zeroed or
+        filled from a file (repeatable)
+    --image=<binding>:<width>x<height>[:<format>]
+        Add an image for the compute shader, of the format rgba8 (default),
+        rgba16f, rgba32f or r32f (repeatable). The first one is shown
+    --groups=<x>[x<y>[x<z>]]
+        Set the number of work groups per dispatch (default: enough to
+        cover the first image, or 1)
+    --blit=<binding>
+        Show the compute image at the given binding instead
+    --dump=<path>
+        Write every compute buffer and image to a directory at exit
+    --swap-interval=<n>
+        Set the number of vertical blanks to wait for between frames;
+        0 disables vsync (default: 1, or 0 when benchmarking)
+    --max-fps=<fps>
+        Limit the frame rate
+    --no-idle
+        Keep rendering while paused or when the shader does not depend
+        on time (by default, the window then waits for input instead)
+    --target-ms=<ms>
+        Render at a lower internal resolution whenever the GPU frame time
+        exceeds the target, and upscale to the output
+    --scale=<factor>
+        Render at a fixed fraction of the output resolution, between 0 and
+        1 (overrides --target-ms)
+    --progressive
+        Render expensive shaders in tiles spread over several frames,
+        presenting each image once it is complete
+    --tile-budget=<ms>
+        Set the GPU time per frame for progressive rendering (default: 8)
+    --tile-size=<pixels>
+        Set the tile size for progressive rendering (default: 128)
+    --coarse-to-fine
+        Refine progressive images from 1/8 resolution up to full
+        resolution, showing each step
     --echo
         Echo shaders to the console
+    --watch
+        Rebuild the shaders in the background whenever their files change
+    --no-cache
+        Always build programs from source instead of using the on-disk
+        program binary cache
+    --cache-dir=<path>
+        Set the program binary cache directory
+    --cache-size=<MiB>
+        Limit the size of the program binary cache (default: 64)
+    --size=<width>x<height>
+        Set the window size, or the offscreen framebuffer size when
+        headless (default: 400x400)
+    --headless
+        Render offscreen without a window or display server
+    --software
+        Render on the CPU instead of the GPU, without a window, GL context
+        or display server; prints timings and quits
+    --threads=<n>
+        Set the number of threads for software rendering, image comparison
+        and geometry generation (default: one per hardware thread)
+    --golden=<path>
+        Render the shaders of a list file with one
+        "[<vertex>] <fragment> [<time>...]" entry per line offscreen at the
+        given times, compare the images with the references next to the
+        list file, print the differences and quit
+    --golden-update
+        Write the rendered images as the new references instead
+    --golden-output=<path>
+        Set the directory for the images and difference heatmaps of failed
+        comparisons (default: golden-output)
+    --max-error=<n>
+        Set the largest channel difference, from 0 to 255, that still
+        matches a reference (default: 2)
+    --frames=<count>
+        Quit after rendering the given number of frames (default: 1 when
+        headless or rendering in software)
+    --fps=<fps>
+        Advance time by exactly 1/fps per frame instead of following the
+        wall clock, so that every run renders the same frames (default: 60
+        with --start-time or --frame-range)
+    --start-time=<seconds>
+        Set the time of frame 0 of the virtual clock (default: 0)
+    --frame-range=<first>-<last>
+        Render the given frames of the virtual clock, inclusive, and quit
+    --jobs=<n>
+        Split the frames across the given number of headless worker
+        processes, and stitch their captures back together in order
+    --bench <frames>, --bench=<frames>
+        Measure CPU and GPU frame times over the given number of frames
+        (after a short warm-up), print statistics and quit
+    --bench-format=<text|json|csv>
+        Set the benchmark and tuning report format (default: text)
+    --tune=<name>=<values>
+        Sweep a macro over comma-separated values, or a range
+        "<first>..<last>[:<step>]" (repeatable: every combination is
+        built once), measure the GPU time of each variant headless, print
+        the Pareto-optimal ones and quit
+    --tune-budget=<ms>
+        Set the frame time budget for tuning (default: 16.667)
+    --tune-frames=<n>
+        Set the number of frames measured per variant and round
+        (default: 20)
+    --channel<n>=<path>[:<width>x<height>]
+        Bind an image to "uniform sampler2D channel<n>", n from 0 to 7:
+        a PNG, PPM or PAM file, or raw RGBA (".rgba" or ".raw", top row
+        first) of the given size. Raw files holding several frames, and
+        paths with a run of '#' (numbered files from 0 or 1), play as
+        looping sequences, decoded ahead in the background
+    --channel-fps=<fps>
+        Set the frame rate of channel sequences, in frames per second of
+        shader time (default: 60)
+    --channel-prefetch=<frames>
+        Set the number of sequence frames decoded ahead (default: 16)
+    --model=<rectangle|triangle|mesh|plane|sphere|cube>
+        Set the initial model (default: rectangle, or mesh with --mesh).
+        Planes, spheres and cubes are generated with normals and texture
+        coordinates
+    --subdivisions=<n>
+        Set the number of grid cells along each side of generated planes,
+        spheres and cube faces, at most 16384 (default: 64)
+    --instances=<n>
+        Draw the given number of instances of the model, with per-instance
+        data in the ShaderTestInstances storage buffer block
+    --mesh=<path>
+        Load a triangle mesh from an OBJ or PLY file as the model, with
+        "position", "normal" and "texCoord" attributes
+    --capture=<path>
+        Write every rendered frame to PNG files (a run of '#' in the path
+        becomes the frame number), a raw RGBA (".rgba") or YUV4MPEG2
+        (".y4m") file, or to stdout ("-", Y4M by default). Messages then
+        go to stderr
+    --capture-format=<png|raw|y4m>
+        Set the capture format instead of guessing it from the path
+    --capture-fps=<fps>
+        Set the frame rate stored in Y4M captures (default: --fps, or 60)
+    --capture-queue=<frames>
+        Set the most captured frames waiting to be written; rendering
+        waits for the writer beyond that (default: 8)
+    --capture-drop
+        Drop frames instead of waiting when the capture queue is full
+    --trace=<path>
+        Record file I/O, shader builds, rendering, buffer swaps and event
+        handling of every thread, and write them as a Chrome trace JSON
+        file (for chrome://tracing or Perfetto) at exit
+    --gl-debug[=<async|sync|off>]
+        Print the GL debug output, each message once: queued and printed
+        between frames (async, the default in debug builds), or from the
+        offending GL call (sync)
     -h, --help
         Print this help message and quit
 
@@ -30,27 +205,101 @@ Notes:
     If no shaders are passed in, then a default shader will be provided.
 
     If a vertex shader is passed in, then a fragment shader must also be
-    passed in, and vice versa.
+    passed in, and vice versa. Software rendering only needs a fragment
+    shader.
 )"};
 
+enum class BenchFormat {
+  Text,
+  JSON,
+  CSV
+};
+
+// A macro and the values to tune it over.
+struct TuneParameter {
+  std::string name;
+  std::vector<std::string> values;
+};
+
 struct CLIParameters {
   std::optional<std::string> vertexPath{};
   std::optional<std::string> fragmentPath{};
+  ShaderDefines defines{};
+  std::vector<std::string> includeDirectories{};
+  std::optional<std::string> playlistPath{};
+  int playlistInterval{5};
+  std::optional<std::string> passesPath{};
+  std::optional<std::string> computePath{};
+  ComputeSettings compute{};
+  std::optional<std::string> dumpDirectory{};
+  std::optional<int> swapInterval{};
+  std::optional<double> maxFPS{};
+  bool idle{true};
+  std::optional<double> targetMilliseconds{};
+  std::optional<double> fixedScale{};
+  bool progressive{false};
+  double tileBudget{8.};
+  int tileSize{128};
+  bool coarseToFine{false};
   bool echo{false};
+  bool watch{false};
+  bool useCache{true};
+  std::optional<std::string> cacheDirectory{};
+  int cacheSizeMiB{64};
   bool helpOnly{false};
+  int width{400};
+  int height{400};
+  bool headless{false};
+  bool software{false};
+  int threadCount{0};
+  std::optional<std::string> goldenPath{};
+  bool goldenUpdate{false};
+  std::string goldenOutput{"golden-output"};
+  int maxError{2};
+  std::optional<int> frameCount{};
+  // Set whenever the virtual clock is on.
+  std::optional<double> fps{};
+  double startTime{0.};
+  int firstFrame{0};
+  int jobCount{1};
+  std::optional<int> benchFrames{};
+  std::vector<TuneParameter> tuneParameters{};
+  double tuneBudget{1000./60.};
+  int tuneFrames{20};
+  BenchFormat benchFormat{BenchFormat::Text};
+  std::vector<ChannelDescription> channels{};
+  double channelFPS{60.};
+  int channelPrefetch{16};
+  GeometryType modelType{GeometryType::Rectangle};
+  std::optional<std::string> meshPath{};
+  int subdivisions{64};
+  // Other geometry would be drawn instead, so main() fails on this.
+  bool invalidSubdivisions{false};
+  int instanceCount{1};
+  std::optional<std::string> capturePath{};
+  std::optional<CaptureFormat> captureFormat{};
+  std::optional<double> captureFPS{};
+  int captureQueue{8};
+  bool captureDrop{false};
+  std::optional<std::string> tracePath{};
+#ifdef DEBUG
+  GLDebugMode glDebugMode{GLDebugMode::Asynchronous};
+#else
+  GLDebugMode glDebugMode{GLDebugMode::Off};
+#endif
 };
 
 struct ShaderSources {
-  std::string vertex;
-  std::string fragment;
+  ShaderSource vertex;
+  ShaderSource fragment;
 
-  ShaderSources(std::string vertex, std::string fragment);
+  ShaderSources(ShaderSource vertex, ShaderSource fragment);
   ShaderSources() = delete;
 };
 
 auto parseCLIArguments(int argc, char** argv) -> CLIParameters;
 auto loadShaderSources(
-  const CLIParameters& parameters
+  const CLIParameters& parameters, ShaderPreprocessor& preprocessor
 ) -> std::optional<ShaderSources>;
 
 #endif // PARAMETERS_HXX
@@ -0,0 +1,191 @@
+#include "playlist.hxx"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+#include "io.hxx"
+
+auto loadPlaylist(
+  const std::string& path, const std::optional<std::string>& vertexPath
+) -> std::optional<std::vector<PlaylistEntry>> {
+  std::vector<PlaylistEntry> entries{};
+  std::error_code error{};
+  if (std::filesystem::is_directory(path, error)) {
+    for (const auto& file : std::filesystem::directory_iterator{path, error}) {
+      if (file.is_regular_file() && file.path().extension() == ".frag") {
+        entries.push_back({vertexPath.value_or(""), file.path().string()});
+      }
+    }
+    std::sort(
+      entries.begin(), entries.end(),
+      [](const PlaylistEntry& a, const PlaylistEntry& b) {
+        return a.fragmentPath < b.fragmentPath;
+      }
+    );
+  } else {
+    const std::optional<std::string> text{readFile(path)};
+    if (!text) {
+      std::cerr << "Failed to read playlist " << path << '\n';
+      return {};
+    }
+    const std::filesystem::path directory{
+      std::filesystem::path{path}.parent_path()
+    };
+    std::istringstream lines{*text};
+    std::string line{};
+    while (std::getline(lines, line)) {
+      std::istringstream fields{line};
+      std::vector<std::string> paths{};
+      std::string field{};
+      while (fields >> field && field.front() != '#') {
+        paths.push_back((directory / field).lexically_normal().string());
+      }
+      if (paths.size() == 1) {
+        entries.push_back({vertexPath.value_or(""), paths.front()});
+      } else if (paths.size() == 2) {
+        entries.push_back({paths.front(), paths.back()});
+      } else if (!paths.empty()) {
+        std::cerr << "Invalid playlist entry \"" << line << "\"\n";
+      }
+    }
+  }
+  if (entries.empty()) {
+    std::cerr << "Playlist " << path << " has no shaders\n";
+    return {};
+  }
+  return entries;
+}
+
+Playlist::Playlist(
+  std::vector<PlaylistEntry> entries, ShaderPreprocessor& preprocessor,
+  const ShaderDefines& defines, ProgramCache* cache
+) : _cache{cache}, _startTime{std::chrono::steady_clock::now()} {
+  _slots.reserve(entries.size());
+  for (PlaylistEntry& entry : entries) {
+    Slot& slot{_slots.emplace_back(Slot{std::move(entry)})};
+    std::optional<ShaderSource> vertex{};
+    if (slot.entry.vertexPath.empty()) {
+      vertex = ShaderSource::fromLiteral(defaultVertexSource);
+    } else {
+      vertex = preprocessor.process(slot.entry.vertexPath, defines);
+    }
+    std::optional<ShaderSource> fragment{
+      preprocessor.process(slot.entry.fragmentPath, defines)
+    };
+    if (vertex && fragment) {
+      slot.sources = {std::move(*vertex), std::move(*fragment)};
+    } else {
+      std::cerr << "Failed to load " << slot.entry.fragmentPath << '\n';
+      slot.failed = true;
+    }
+  }
+  // Submit everything before asking about any of it, so that the driver can
+  // work on all links at once.
+  for (Slot& slot : _slots) {
+    if (slot.sources) {
+      slot.pending = GraphicsEngine::beginProgram(*slot.sources, _cache);
+      ++_pendingCount;
+    }
+  }
+  if (_pendingCount == 0) {
+    _buildTime = std::chrono::steady_clock::now() - _startTime;
+  }
+}
+
+Playlist::~Playlist() {
+  for (Slot& slot : _slots) {
+    if (slot.program) {
+      glDeleteProgram(*slot.program);
+    }
+    if (slot.pending) {
+      glDeleteShader(slot.pending->vertexShader);
+      glDeleteShader(slot.pending->fragmentShader);
+      glDeleteProgram(slot.pending->program);
+    }
+  }
+}
+
+auto Playlist::collect() -> void {
+  if (_pendingCount == 0) {
+    return;
+  }
+  for (Slot& slot : _slots) {
+    if (!slot.pending || !GraphicsEngine::isProgramReady(*slot.pending)) {
+      continue;
+    }
+    slot.program = GraphicsEngine::finishProgram(
+      *slot.pending, *slot.sources, _cache
+    );
+    if (!slot.program) {
+      std::cerr << "Failed to build " << slot.entry.fragmentPath << '\n';
+      slot.failed = true;
+    }
+    slot.pending.reset();
+    slot.sources.reset();
+    --_pendingCount;
+  }
+  if (_pendingCount == 0) {
+    _buildTime = std::chrono::steady_clock::now() - _startTime;
+  }
+}
+
+auto Playlist::skip(int step) -> void {
+  _target = findNext(_target.value_or(_current), step);
+  _targetStep = step < 0 ? -1 : 1;
+}
+
+auto Playlist::update() -> std::optional<GLuint> {
+  collect();
+  if (_target && _slots[*_target].failed) {
+    _target = findNext(*_target, _targetStep);
+  }
+  if (!_target || !_slots[*_target].program) {
+    return {};
+  }
+  _current = *_target;
+  _target.reset();
+  return _slots[_current].program;
+}
+
+auto Playlist::isSwitching() const -> bool {
+  return _target.has_value();
+}
+
+auto Playlist::getCurrentEntry() const -> const PlaylistEntry& {
+  return _slots[_current].entry;
+}
+
+auto Playlist::getSize() const -> std::size_t {
+  return _slots.size();
+}
+
+auto Playlist::findNext(
+  std::size_t index, int step
+) const -> std::optional<std::size_t> {
+  const std::size_t size{_slots.size()};
+  for (std::size_t i{}; i < size; ++i) {
+    index = (index + size + step) % size;
+    if (!_slots[index].failed) {
+      return index;
+    }
+  }
+  return {};
+}
+
+auto Playlist::isSettled() const -> bool {
+  return _pendingCount == 0;
+}
+
+auto Playlist::getFailedCount() const -> std::size_t {
+  return static_cast<std::size_t>(std::count_if(
+    _slots.begin(), _slots.end(), [](const Slot& slot) { return slot.failed; }
+  ));
+}
+
+auto Playlist::getBuildTime(
+) const -> std::chrono::duration<double, std::milli> {
+  return _buildTime;
+}
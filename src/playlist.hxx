@@ -0,0 +1,86 @@
+#ifndef PLAYLIST_HXX
+#define PLAYLIST_HXX
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cache.hxx"
+#include "graphics.hxx"
+#include "parameters.hxx"
+#include "preprocessor.hxx"
+
+struct PlaylistEntry {
+  // Empty for the default vertex shader.
+  std::string vertexPath;
+  std::string fragmentPath;
+};
+
+/**
+ * Reads a playlist from a directory (every *.frag file in it, sorted by
+ * name) or from a list file with one "<fragment>" or "<vertex> <fragment>"
+ * entry per line. Relative paths in a list file are relative to the file.
+ */
+auto loadPlaylist(
+  const std::string& path, const std::optional<std::string>& vertexPath
+) -> std::optional<std::vector<PlaylistEntry>>;
+
+/**
+ * Owns the programs of a playlist. Every program is compiled and linked up
+ * front; with parallel shader compilation the driver does the work on its
+ * own threads, and update() collects programs as their links complete
+ * without ever waiting on one. Switching to an entry happens on the first
+ * update() after its program is ready; failed entries are skipped.
+ */
+class Playlist {
+public:
+  Playlist(
+    std::vector<PlaylistEntry> entries, ShaderPreprocessor& preprocessor,
+    const ShaderDefines& defines, ProgramCache* cache
+  );
+  Playlist() = delete;
+  Playlist(const Playlist&) = delete;
+  Playlist(Playlist&&) = delete;
+  Playlist operator=(const Playlist&) = delete;
+  Playlist operator=(Playlist&&) = delete;
+  ~Playlist();
+
+  auto skip(int step) -> void;
+  auto update() -> std::optional<GLuint>;
+  auto isSwitching() const -> bool;
+  auto getCurrentEntry() const -> const PlaylistEntry&;
+  auto getSize() const -> std::size_t;
+  auto isSettled() const -> bool;
+  auto getFailedCount() const -> std::size_t;
+  auto getBuildTime() const -> std::chrono::duration<double, std::milli>;
+
+private:
+  struct Slot {
+    PlaylistEntry entry;
+    std::optional<ShaderSources> sources{};
+    std::optional<PendingProgram> pending{};
+    std::optional<GLuint> program{};
+    bool failed{false};
+  };
+
+  auto collect() -> void;
+  auto findNext(
+    std::size_t index, int step
+  ) const -> std::optional<std::size_t>;
+
+  std::vector<Slot> _slots{};
+  std::size_t _current{};
+  std::optional<std::size_t> _target{0};
+  // The direction of the last skip, kept for passing over failed targets.
+  int _targetStep{1};
+  ProgramCache* _cache;
+  std::size_t _pendingCount{};
+  std::chrono::steady_clock::time_point _startTime;
+  std::chrono::steady_clock::duration _buildTime{};
+};
+
+#endif // PLAYLIST_HXX
@@ -0,0 +1,382 @@
+#include "png.hxx"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <string_view>
+
+#include "debug.hxx"
+#include "deflate.hxx"
+
+namespace {
+
+constexpr std::size_t bytesPerPixel{4};
+// The filtered bytes per band; smaller bands compress worse, as no match
+// reaches past the 32 KiB before a band.
+constexpr std::size_t bandBytes{256*1024};
+// The largest width and height decoded, as most GPUs' texture size limit.
+constexpr std::uint32_t maxDecodedSize{16384};
+constexpr std::array<std::uint8_t, 8> signature{
+  0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+};
+
+const std::array<std::uint32_t, 256> crcTable{[]() {
+  std::array<std::uint32_t, 256> table{};
+  for (std::uint32_t index{0}; index < table.size(); ++index) {
+    std::uint32_t crc{index};
+    for (int bit{0}; bit < 8; ++bit) {
+      crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+    }
+    table[index] = crc;
+  }
+  return table;
+}()};
+
+auto crc32(
+  const std::uint8_t* data, std::size_t size, std::uint32_t crc
+) -> std::uint32_t {
+  crc = ~crc;
+  for (std::size_t index{0}; index < size; ++index) {
+    crc = crcTable[(crc ^ data[index]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+auto appendBigEndian(
+  std::vector<std::uint8_t>& output, std::uint32_t value
+) -> void {
+  for (int shift{24}; shift >= 0; shift -= 8) {
+    output.push_back(static_cast<std::uint8_t>(value >> shift));
+  }
+}
+
+auto appendChunk(
+  std::vector<std::uint8_t>& file, const char* type,
+  const std::vector<std::uint8_t>& data
+) -> void {
+  appendBigEndian(file, static_cast<std::uint32_t>(data.size()));
+  const std::size_t typeOffset{file.size()};
+  file.insert(file.end(), type, type + 4);
+  file.insert(file.end(), data.begin(), data.end());
+  appendBigEndian(file, crc32(
+    file.data() + typeOffset, file.size() - typeOffset, 0
+  ));
+}
+
+auto paeth(int left, int above, int aboveLeft) -> int {
+  // The distances of left + above - aboveLeft to each neighbour.
+  const int toLeft{std::abs(above - aboveLeft)};
+  const int toAbove{std::abs(left - aboveLeft)};
+  const int toAboveLeft{std::abs(left + above - 2*aboveLeft)};
+  const int nearest{toAbove <= toAboveLeft ? above : aboveLeft};
+  return toLeft <= toAbove && toLeft <= toAboveLeft ? left : nearest;
+}
+
+// The prediction of filter types 0 (none) to 4 (Paeth).
+auto predict(int type, int left, int up, int upLeft) -> int {
+  switch (type) {
+    case 1:
+      return left;
+    case 2:
+      return up;
+    case 3:
+      return (left + up)/2;
+    case 4:
+      return paeth(left, up, upLeft);
+    default:
+      return 0;
+  }
+}
+
+auto score(int value, int prediction) -> std::uint64_t {
+  return static_cast<std::uint64_t>(
+    std::abs(static_cast<int>(static_cast<std::int8_t>(value - prediction)))
+  );
+}
+
+// Writes the filter type and the filtered row to target, picking the type
+// with the smallest sum of absolute (signed) values. The row above the
+// first one is all zeros.
+auto filterRow(
+  const std::uint8_t* row, const std::uint8_t* above, std::size_t rowBytes,
+  std::uint8_t* target
+) -> void {
+  // Every type is scored in a single pass over the row. The first pixel
+  // has no left neighbours.
+  std::array<std::uint64_t, 5> scores{};
+  const auto scoreAll{[&](std::size_t index, int left, int upLeft) {
+    const int value{row[index]};
+    const int up{above[index]};
+    scores[0] += score(value, 0);
+    scores[1] += score(value, left);
+    scores[2] += score(value, up);
+    scores[3] += score(value, (left + up)/2);
+    scores[4] += score(value, paeth(left, up, upLeft));
+  }};
+  const std::size_t first{std::min(bytesPerPixel, rowBytes)};
+  for (std::size_t index{0}; index < first; ++index) {
+    scoreAll(index, 0, 0);
+  }
+  for (std::size_t index{first}; index < rowBytes; ++index) {
+    scoreAll(
+      index, row[index - bytesPerPixel], above[index - bytesPerPixel]
+    );
+  }
+  const int type{static_cast<int>(
+    std::min_element(scores.begin(), scores.end()) - scores.begin()
+  )};
+  target[0] = static_cast<std::uint8_t>(type);
+  for (std::size_t index{0}; index < first; ++index) {
+    target[index + 1] = static_cast<std::uint8_t>(
+      row[index] - predict(type, 0, above[index], 0)
+    );
+  }
+  for (std::size_t index{first}; index < rowBytes; ++index) {
+    target[index + 1] = static_cast<std::uint8_t>(row[index] - predict(
+      type, row[index - bytesPerPixel], above[index],
+      above[index - bytesPerPixel]
+    ));
+  }
+}
+
+auto readBigEndian(const std::uint8_t* bytes) -> std::uint32_t {
+  return static_cast<std::uint32_t>(bytes[0]) << 24
+    | static_cast<std::uint32_t>(bytes[1]) << 16
+    | static_cast<std::uint32_t>(bytes[2]) << 8 | bytes[3];
+}
+
+// Samples per pixel of a color type, or 0 for unknown types.
+auto getSampleCount(int colorType) -> std::size_t {
+  switch (colorType) {
+    case 0:
+    case 3:
+      return 1;
+    case 2:
+      return 3;
+    case 4:
+      return 2;
+    case 6:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+auto isValidDepth(int colorType, int depth) -> bool {
+  switch (colorType) {
+    case 0:
+      return depth == 1 || depth == 2 || depth == 4 || depth == 8
+        || depth == 16;
+    case 3:
+      return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+    default:
+      return depth == 8 || depth == 16;
+  }
+}
+
+} // namespace
+
+auto decodePNG(
+  const std::uint8_t* data, std::size_t size
+) -> std::optional<Image> {
+  if (
+    size < signature.size()
+    || !std::equal(signature.begin(), signature.end(), data)
+  ) {
+    return {};
+  }
+  std::uint32_t width{};
+  std::uint32_t height{};
+  int depth{};
+  int colorType{};
+  int interlace{};
+  // RGBA entries.
+  std::vector<std::uint8_t> palette{};
+  std::vector<std::uint8_t> stream{};
+  bool ended{false};
+  std::size_t position{signature.size()};
+  while (!ended && size - position >= 12) {
+    const std::size_t length{readBigEndian(data + position)};
+    if (length > size - position - 12) {
+      return {};
+    }
+    const std::string_view type{
+      reinterpret_cast<const char*>(data + position + 4), 4
+    };
+    const std::uint8_t* chunk{data + position + 8};
+    if (type == "IHDR" && length >= 13) {
+      width = readBigEndian(chunk);
+      height = readBigEndian(chunk + 4);
+      depth = chunk[8];
+      colorType = chunk[9];
+      interlace = chunk[12];
+    } else if (type == "PLTE") {
+      palette.clear();
+      for (std::size_t entry{0}; entry + 3 <= length; entry += 3) {
+        palette.insert(palette.end(), chunk + entry, chunk + entry + 3);
+        palette.push_back(255);
+      }
+    } else if (type == "tRNS" && colorType == 3) {
+      for (std::size_t entry{0}; entry < length; ++entry) {
+        if (entry*4 + 3 < palette.size()) {
+          palette[entry*4 + 3] = chunk[entry];
+        }
+      }
+    } else if (type == "IDAT") {
+      stream.insert(stream.end(), chunk, chunk + length);
+    } else if (type == "IEND") {
+      ended = true;
+    }
+    position += length + 12;
+  }
+  const std::size_t samples{getSampleCount(colorType)};
+  if (
+    !ended || samples == 0 || !isValidDepth(colorType, depth)
+    || width == 0 || height == 0 || width > maxDecodedSize
+    || height > maxDecodedSize || (colorType == 3 && palette.empty())
+  ) {
+    return {};
+  }
+  if (interlace != 0) {
+    LOG_ERROR("Interlaced PNG files are not supported\n");
+    return {};
+  }
+  // A zlib header for a deflate stream without a preset dictionary.
+  if (
+    stream.size() < 2 || (stream[0] & 0x0f) != 8
+    || (stream[0]*256 + stream[1])%31 != 0 || (stream[1] & 0x20)
+  ) {
+    return {};
+  }
+  const std::size_t bitsPerPixel{samples*static_cast<std::size_t>(depth)};
+  const std::size_t rowBytes{(width*bitsPerPixel + 7)/8};
+  const std::size_t stride{rowBytes + 1};
+  std::vector<std::uint8_t> filtered{};
+  filtered.reserve(height*stride);
+  if (
+    !inflate(stream.data() + 2, stream.size() - 2, filtered)
+    || filtered.size() < height*stride
+  ) {
+    return {};
+  }
+  // Filters work on whole bytes, on those of the pixel to the left.
+  const std::size_t filterBytes{std::max<std::size_t>(bitsPerPixel/8, 1)};
+  for (std::size_t y{0}; y < height; ++y) {
+    std::uint8_t* row{filtered.data() + y*stride + 1};
+    const std::uint8_t* above{y > 0 ? row - stride : nullptr};
+    const int type{row[-1]};
+    if (type > 4) {
+      return {};
+    }
+    for (std::size_t index{0}; index < rowBytes; ++index) {
+      const bool hasLeft{index >= filterBytes};
+      row[index] = static_cast<std::uint8_t>(row[index] + predict(
+        type, hasLeft ? row[index - filterBytes] : 0,
+        above ? above[index] : 0,
+        above && hasLeft ? above[index - filterBytes] : 0
+      ));
+    }
+  }
+
+  // The most significant byte of 16-bit samples, and sub-byte samples
+  // from the most significant bits on.
+  const int maxSample{(1 << std::min(depth, 8)) - 1};
+  const auto getSample{[depth, maxSample](
+    const std::uint8_t* row, std::size_t index
+  ) -> int {
+    if (depth >= 8) {
+      return row[index*static_cast<std::size_t>(depth/8)];
+    }
+    const std::size_t bit{index*static_cast<std::size_t>(depth)};
+    return (row[bit/8] >> (8 - depth - static_cast<int>(bit%8))) & maxSample;
+  }};
+  Image image{
+    static_cast<int>(width), static_cast<int>(height),
+    std::vector<std::uint8_t>(static_cast<std::size_t>(width)*height*4)
+  };
+  // PNG rows are stored top first, Image rows bottom first.
+  for (std::size_t y{0}; y < height; ++y) {
+    const std::uint8_t* row{filtered.data() + y*stride + 1};
+    std::uint8_t* target{image.pixels.data() + (height - 1 - y)*width*4};
+    for (std::size_t x{0}; x < width; ++x, target += 4) {
+      if (colorType == 3) {
+        const auto entry{static_cast<std::size_t>(getSample(row, x))*4};
+        if (entry < palette.size()) {
+          std::copy_n(palette.begin() + entry, 4, target);
+        }
+        continue;
+      }
+      const bool hasColor{colorType == 2 || colorType == 6};
+      const bool hasAlpha{colorType == 4 || colorType == 6};
+      for (std::size_t channel{0}; channel < 3; ++channel) {
+        const int value{
+          getSample(row, x*samples + (hasColor ? channel : 0))
+        };
+        target[channel] = static_cast<std::uint8_t>(value*255/maxSample);
+      }
+      target[3] = hasAlpha
+        ? static_cast<std::uint8_t>(getSample(row, x*samples + samples - 1))
+        : 255;
+    }
+  }
+  return image;
+}
+
+auto encodePNG(
+  const Image& image, ThreadPool& pool
+) -> std::vector<std::uint8_t> {
+  const auto width{static_cast<std::size_t>(image.width)};
+  const auto height{static_cast<std::size_t>(image.height)};
+  const std::size_t rowBytes{width*bytesPerPixel};
+  const std::size_t stride{rowBytes + 1};
+  const std::size_t rowsPerBand{std::max<std::size_t>(bandBytes/stride, 1)};
+  const std::size_t bandCount{(height + rowsPerBand - 1)/rowsPerBand};
+  std::vector<std::uint8_t> filtered(height*stride);
+  const std::vector<std::uint8_t> zeros(rowBytes);
+  // Image rows are stored bottom first, PNG rows top first.
+  const auto getRow{[&image, height, rowBytes](std::size_t y) {
+    return image.pixels.data() + (height - 1 - y)*rowBytes;
+  }};
+  pool.run(bandCount, [&](std::size_t band, std::size_t) {
+    const std::size_t last{std::min((band + 1)*rowsPerBand, height)};
+    for (std::size_t y{band*rowsPerBand}; y < last; ++y) {
+      filterRow(
+        getRow(y), y > 0 ? getRow(y - 1) : zeros.data(), rowBytes,
+        filtered.data() + y*stride
+      );
+    }
+  });
+  // Bands only look back into bands that are already filtered.
+  std::vector<std::vector<std::uint8_t>> segments(bandCount);
+  std::vector<std::uint32_t> checksums(bandCount);
+  pool.run(bandCount, [&](std::size_t band, std::size_t) {
+    const std::size_t begin{band*rowsPerBand*stride};
+    const std::size_t end{std::min((band + 1)*rowsPerBand, height)*stride};
+    deflateSegment(
+      filtered.data(), begin, end, band + 1 == bandCount, segments[band]
+    );
+    checksums[band] = adler32(filtered.data() + begin, end - begin);
+  });
+
+  std::vector<std::uint8_t> stream{0x78, 0x9c};
+  std::uint32_t checksum{1};
+  for (std::size_t band{0}; band < bandCount; ++band) {
+    stream.insert(stream.end(), segments[band].begin(), segments[band].end());
+    const std::size_t begin{band*rowsPerBand*stride};
+    const std::size_t end{std::min((band + 1)*rowsPerBand, height)*stride};
+    checksum = combineAdler32(checksum, checksums[band], end - begin);
+  }
+  appendBigEndian(stream, checksum);
+
+  std::vector<std::uint8_t> header{};
+  appendBigEndian(header, static_cast<std::uint32_t>(width));
+  appendBigEndian(header, static_cast<std::uint32_t>(height));
+  // 8 bits per channel, RGBA, deflate, adaptive filters, no interlacing.
+  header.insert(header.end(), {8, 6, 0, 0, 0});
+  std::vector<std::uint8_t> file(signature.begin(), signature.end());
+  appendChunk(file, "IHDR", header);
+  appendChunk(file, "IDAT", stream);
+  appendChunk(file, "IEND", {});
+  return file;
+}
@@ -0,0 +1,30 @@
+#ifndef PNG_HXX
+#define PNG_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "image.hxx"
+#include "threadpool.hxx"
+
+/**
+ * Encodes an RGBA8 PNG file. Every row gets the filter that minimizes its
+ * absolute differences, and bands of rows are filtered and then deflated in
+ * parallel on the pool, each band as its own run of blocks.
+ */
+auto encodePNG(
+  const Image& image, ThreadPool& pool
+) -> std::vector<std::uint8_t>;
+
+/**
+ * Decodes a PNG file of any color type and bit depth to RGBA8, keeping the
+ * most significant byte of 16-bit samples. Interlaced files are not
+ * supported.
+ */
+auto decodePNG(
+  const std::uint8_t* data, std::size_t size
+) -> std::optional<Image>;
+
+#endif // PNG_HXX
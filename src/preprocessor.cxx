@@ -0,0 +1,356 @@
+#include "preprocessor.hxx"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string_view>
+#include <system_error>
+
+#include "debug.hxx"
+#include "io.hxx"
+#include "trace.hxx"
+
+namespace {
+
+auto normalize(const std::filesystem::path& path) -> std::filesystem::path {
+  std::error_code error{};
+  std::filesystem::path result{std::filesystem::absolute(path, error)};
+  if (error) {
+    return path.lexically_normal();
+  }
+  return result.lexically_normal();
+}
+
+auto skipSpaces(std::string_view line, std::size_t position) -> std::size_t {
+  while (
+    position < line.size() && (line[position] == ' ' || line[position] == '\t')
+  ) {
+    ++position;
+  }
+  return position;
+}
+
+// Matches "#<directive>" with optional whitespace around the '#' and returns
+// the position just after the directive name.
+auto matchDirective(
+  std::string_view line, std::string_view directive
+) -> std::optional<std::size_t> {
+  std::size_t position{skipSpaces(line, 0)};
+  if (position >= line.size() || line[position] != '#') {
+    return {};
+  }
+  position = skipSpaces(line, position + 1);
+  if (line.substr(position, directive.size()) != directive) {
+    return {};
+  }
+  position += directive.size();
+  if (position < line.size() && std::isalnum(line[position])) {
+    return {};
+  }
+  return position;
+}
+
+// Before GLSL 3.30 (and in GLSL ES 1.00), "#line n" numbers the following
+// line n + 1; later versions number it n, as in C.
+auto usesNextLineNumbering(std::string_view text) -> bool {
+  std::size_t position{};
+  while (position < text.size()) {
+    std::size_t end{text.find('\n', position)};
+    end = end == std::string_view::npos ? text.size() : end;
+    const std::string_view line{text.substr(position, end - position)};
+    position = end + 1;
+    if (const std::optional<std::size_t> after{matchDirective(line, "version")}) {
+      const std::string_view rest{line.substr(*after)};
+      const std::size_t digits{skipSpaces(rest, 0)};
+      int version{};
+      for (std::size_t i{digits}; i < rest.size() && std::isdigit(rest[i]); ++i) {
+        version = version*10 + (rest[i] - '0');
+      }
+      const bool es{rest.find("es") != std::string_view::npos};
+      return es ? version >= 300 : version >= 330;
+    }
+    if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+      break;
+    }
+  }
+  // Without a #version directive the shader is GLSL 1.10.
+  return false;
+}
+
+} // namespace
+
+auto setDefine(
+  ShaderDefines& defines, const std::string& name, const std::string& value
+) -> void {
+  const auto define{std::find_if(
+    defines.begin(), defines.end(),
+    [&name](const auto& entry) { return entry.first == name; }
+  )};
+  if (define != defines.end()) {
+    define->second = value;
+  } else {
+    defines.emplace_back(name, value);
+  }
+}
+
+ShaderPreprocessor::ShaderPreprocessor(
+  std::vector<std::string> includeDirectories
+) : _includeDirectories{std::move(includeDirectories)} {}
+
+auto ShaderPreprocessor::process(
+  const std::string& path, const ShaderDefines& defines
+) -> std::optional<ShaderSource> {
+  TRACE_SPAN("shader", "preprocess");
+  const std::filesystem::path root{normalize(path)};
+  _roots[root] = path;
+  Expansion expansion{};
+  expansion.defines = &defines;
+  const ParsedFile* file{parse(root, path)};
+  if (!file) {
+    return {};
+  }
+  expansion.lineIsNextLine = usesNextLineNumbering(*file->text);
+  if (!expand(root, path, expansion)) {
+    return {};
+  }
+  return std::move(expansion.source);
+}
+
+auto ShaderPreprocessor::invalidate(
+  const std::vector<std::string>& changedPaths
+) -> std::set<std::string> {
+  std::set<std::string> affectedRoots{};
+  std::set<std::filesystem::path> visited{};
+  std::vector<std::filesystem::path> pending{};
+  for (const std::string& changedPath : changedPaths) {
+    const std::filesystem::path changed{normalize(changedPath)};
+    pending.push_back(changed);
+    // Only the changed file itself needs to be read again; everything that
+    // includes it is still parsed correctly.
+    const auto file{_files.find(changed)};
+    if (file != _files.end()) {
+      for (const std::filesystem::path& dependency : file->second.dependencies) {
+        _includers[dependency].erase(changed);
+      }
+      _files.erase(file);
+    }
+  }
+  while (!pending.empty()) {
+    const std::filesystem::path path{pending.back()};
+    pending.pop_back();
+    if (!visited.insert(path).second) {
+      continue;
+    }
+    const auto root{_roots.find(path)};
+    if (root != _roots.end()) {
+      affectedRoots.insert(root->second);
+    }
+    const auto includers{_includers.find(path)};
+    if (includers != _includers.end()) {
+      pending.insert(
+        pending.end(), includers->second.begin(), includers->second.end()
+      );
+    }
+  }
+  return affectedRoots;
+}
+
+auto ShaderPreprocessor::getFiles() const -> std::vector<std::string> {
+  std::vector<std::string> files{};
+  for (const auto& [path, root] : _roots) {
+    files.push_back(root);
+  }
+  for (const auto& [path, file] : _files) {
+    if (_roots.find(path) == _roots.end()) {
+      files.push_back(file.displayName);
+    }
+  }
+  return files;
+}
+
+auto ShaderPreprocessor::parse(
+  const std::filesystem::path& path, const std::string& displayName
+) -> const ParsedFile* {
+  const auto cached{_files.find(path)};
+  if (cached != _files.end()) {
+    return &cached->second;
+  }
+  std::optional<std::string> text{readFile(displayName)};
+  if (!text) {
+    return nullptr;
+  }
+  ParsedFile file{
+    std::make_shared<const std::string>(std::move(*text)), displayName
+  };
+  const std::string_view view{*file.text};
+  std::size_t position{};
+  int line{1};
+  while (position < view.size()) {
+    std::size_t end{view.find('\n', position)};
+    end = end == std::string_view::npos ? view.size() : end + 1;
+    const std::string_view content{view.substr(position, end - position)};
+    if (const std::optional<std::size_t> after{matchDirective(content, "include")}) {
+      const std::size_t open{content.find('"', *after)};
+      const std::size_t close{
+        open == std::string_view::npos
+          ? std::string_view::npos
+          : content.find('"', open + 1)
+      };
+      if (close == std::string_view::npos) {
+        std::cerr << displayName << ':' << line
+          << ": malformed #include directive\n";
+        return nullptr;
+      }
+      file.includes.push_back({
+        position, end - position, line,
+        std::string{content.substr(open + 1, close - open - 1)}
+      });
+    } else if (
+      !file.versionEnd && matchDirective(content, "version")
+    ) {
+      file.versionEnd = end;
+      file.versionLine = line;
+    } else if (const std::optional<std::size_t> pragma{
+      matchDirective(content, "pragma")
+    }) {
+      // The directive is left in place; compilers ignore unknown pragmas.
+      const std::size_t argument{skipSpaces(content, *pragma)};
+      if (content.substr(argument, 4) == "once") {
+        file.pragmaOnce = true;
+      }
+    }
+    position = end;
+    ++line;
+  }
+  for (const Include& include : file.includes) {
+    if (const auto resolved{resolve(path, include.name)}) {
+      file.dependencies.insert(resolved->first);
+      _includers[resolved->first].insert(path);
+    }
+  }
+  return &_files.emplace(path, std::move(file)).first->second;
+}
+
+auto ShaderPreprocessor::resolve(
+  const std::filesystem::path& includer, const std::string& name
+) const -> std::optional<std::pair<std::filesystem::path, std::string>> {
+  const auto includerFile{_files.find(includer)};
+  const std::filesystem::path includerName{
+    includerFile != _files.end()
+      ? std::filesystem::path{includerFile->second.displayName}
+      : includer
+  };
+  std::vector<std::filesystem::path> candidates{
+    includerName.parent_path() / name
+  };
+  for (const std::string& directory : _includeDirectories) {
+    candidates.push_back(std::filesystem::path{directory} / name);
+  }
+  for (const std::filesystem::path& candidate : candidates) {
+    std::error_code error{};
+    if (std::filesystem::is_regular_file(candidate, error)) {
+      return {{
+        normalize(candidate), candidate.lexically_normal().generic_string()
+      }};
+    }
+  }
+  return {};
+}
+
+auto ShaderPreprocessor::expand(
+  const std::filesystem::path& path, const std::string& displayName,
+  Expansion& expansion
+) -> bool {
+  const ParsedFile* file{parse(path, displayName)};
+  if (!file) {
+    return false;
+  }
+  // Keep a reference to the text; the cache entry may be replaced by a
+  // later invalidation while the expanded source is still in use.
+  const std::shared_ptr<const std::string> text{file->text};
+  expansion.source.storage.push_back(text);
+  const auto [number, inserted]{
+    expansion.fileNumbers.emplace(path, expansion.source.files.size())
+  };
+  if (inserted) {
+    expansion.source.files.push_back(file->displayName);
+  }
+  const std::size_t fileNumber{number->second};
+  if (!expansion.stack.empty()) {
+    appendLineDirective(expansion, 1, fileNumber);
+  }
+  expansion.stack.push_back(path);
+  expansion.included.insert(path);
+
+  const std::string_view view{*text};
+  std::size_t position{};
+  if (expansion.stack.size() == 1 && !expansion.defines->empty()) {
+    // Nothing but comments may precede #version.
+    position = file->versionEnd.value_or(0);
+    expansion.source.append(view.substr(0, position));
+    std::string defines{};
+    if (position > 0 && view[position - 1] != '\n') {
+      defines += '\n';
+    }
+    for (const auto& [name, value] : *expansion.defines) {
+      defines += "#define " + name + ' ' + value + '\n';
+    }
+    expansion.source.append(
+      std::make_shared<const std::string>(std::move(defines))
+    );
+    appendLineDirective(
+      expansion, file->versionEnd ? file->versionLine + 1 : 1, fileNumber
+    );
+  }
+  for (const Include& include : file->includes) {
+    expansion.source.append(view.substr(position, include.offset - position));
+    position = include.offset + include.length;
+    const auto resolved{resolve(path, include.name)};
+    if (!resolved) {
+      std::cerr << file->displayName << ':' << include.line
+        << ": cannot find include file \"" << include.name << "\"\n";
+      return false;
+    }
+    const auto& [includedPath, includedName]{*resolved};
+    bool skip{false};
+    for (const std::filesystem::path& open : expansion.stack) {
+      if (open == includedPath) {
+        // Cyclic includes can only terminate through include guards, which
+        // would leave the nested copy empty anyway.
+        LOG_ERROR(file->displayName << ':' << include.line
+          << ": skipping recursive include of \"" << include.name << "\"\n");
+        skip = true;
+      }
+    }
+    const auto includedFile{_files.find(includedPath)};
+    if (
+      includedFile != _files.end() && includedFile->second.pragmaOnce
+      && expansion.included.count(includedPath) > 0
+    ) {
+      skip = true;
+    }
+    if (!skip) {
+      if (!expand(includedPath, includedName, expansion)) {
+        return false;
+      }
+    }
+    appendLineDirective(expansion, include.line + 1, fileNumber);
+  }
+  expansion.source.append(view.substr(position));
+  expansion.stack.pop_back();
+  return true;
+}
+
+auto ShaderPreprocessor::appendLineDirective(
+  Expansion& expansion, int line, std::size_t fileNumber
+) -> void {
+  std::string directive{};
+  const std::vector<std::string_view>& segments{expansion.source.segments};
+  if (!segments.empty() && segments.back().back() != '\n') {
+    directive += '\n';
+  }
+  const int number{expansion.lineIsNextLine ? line : line - 1};
+  directive += "#line " + std::to_string(number) + ' '
+    + std::to_string(fileNumber) + '\n';
+  expansion.source.append(std::make_shared<const std::string>(directive));
+}
@@ -0,0 +1,95 @@
+#ifndef PREPROCESSOR_HXX
+#define PREPROCESSOR_HXX
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "source.hxx"
+
+// Macros defined right after the #version directive, in order, as with -D.
+using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+// Replaces the value of an earlier definition of the name, or appends one.
+auto setDefine(
+  ShaderDefines& defines, const std::string& name, const std::string& value
+) -> void;
+
+/**
+ * Resolves #include "file" directives. Parsed files are cached together with
+ * a dependency graph, so that after a change only the changed files are
+ * re-read and only the root shaders that depend on them need rebuilding.
+ * Expanded sources reference the cached file contents directly and carry
+ * #line directives, so compiler logs can be mapped back to file names.
+ */
+class ShaderPreprocessor {
+public:
+  explicit ShaderPreprocessor(std::vector<std::string> includeDirectories);
+  ShaderPreprocessor() = delete;
+  ShaderPreprocessor(const ShaderPreprocessor&) = delete;
+  ShaderPreprocessor(ShaderPreprocessor&&) = delete;
+  ShaderPreprocessor operator=(const ShaderPreprocessor&) = delete;
+  ShaderPreprocessor operator=(ShaderPreprocessor&&) = delete;
+
+  auto process(
+    const std::string& path, const ShaderDefines& defines = {}
+  ) -> std::optional<ShaderSource>;
+  auto invalidate(
+    const std::vector<std::string>& changedPaths
+  ) -> std::set<std::string>;
+  auto getFiles() const -> std::vector<std::string>;
+
+private:
+  struct Include {
+    std::size_t offset;
+    std::size_t length;
+    int line;
+    std::string name;
+  };
+
+  struct ParsedFile {
+    std::shared_ptr<const std::string> text;
+    std::string displayName;
+    std::vector<Include> includes{};
+    // Where the line after the #version directive starts, and its number.
+    std::optional<std::size_t> versionEnd{};
+    int versionLine{};
+    std::set<std::filesystem::path> dependencies{};
+    bool pragmaOnce{false};
+  };
+
+  struct Expansion {
+    ShaderSource source{};
+    std::map<std::filesystem::path, std::size_t> fileNumbers{};
+    std::set<std::filesystem::path> included{};
+    std::vector<std::filesystem::path> stack{};
+    const ShaderDefines* defines{};
+    bool lineIsNextLine{true};
+  };
+
+  auto parse(
+    const std::filesystem::path& path, const std::string& displayName
+  ) -> const ParsedFile*;
+  auto resolve(
+    const std::filesystem::path& includer, const std::string& name
+  ) const -> std::optional<std::pair<std::filesystem::path, std::string>>;
+  auto expand(
+    const std::filesystem::path& path, const std::string& displayName,
+    Expansion& expansion
+  ) -> bool;
+  auto appendLineDirective(
+    Expansion& expansion, int line, std::size_t fileNumber
+  ) -> void;
+
+  std::vector<std::string> _includeDirectories;
+  std::map<std::filesystem::path, ParsedFile> _files{};
+  // Reverse edges of the include graph: file -> files that include it.
+  std::map<std::filesystem::path, std::set<std::filesystem::path>> _includers{};
+  std::map<std::filesystem::path, std::string> _roots{};
+};
+
+#endif // PREPROCESSOR_HXX
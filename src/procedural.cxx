@@ -0,0 +1,115 @@
+#include "procedural.hxx"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "threadpool.hxx"
+
+namespace {
+
+constexpr float pi{3.14159265358979f};
+
+// A cube face: its normal, and the directions of u and v across it, which
+// make the triangles counter-clockwise seen from outside.
+struct CubeFace {
+  float normal[3];
+  float right[3];
+  float up[3];
+};
+
+constexpr CubeFace cubeFaces[6]{
+  {{0.f, 0.f, 1.f}, {1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}},
+  {{0.f, 0.f, -1.f}, {-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}},
+  {{1.f, 0.f, 0.f}, {0.f, 0.f, -1.f}, {0.f, 1.f, 0.f}},
+  {{-1.f, 0.f, 0.f}, {0.f, 0.f, 1.f}, {0.f, 1.f, 0.f}},
+  {{0.f, 1.f, 0.f}, {1.f, 0.f, 0.f}, {0.f, 0.f, -1.f}},
+  {{0.f, -1.f, 0.f}, {1.f, 0.f, 0.f}, {0.f, 0.f, 1.f}}
+};
+
+// Writes the position, normal and texture coordinate at (u, v) of a grid.
+auto placeVertex(
+  GeometryType type, std::size_t grid, float u, float v, float* vertex
+) -> void {
+  if (type == GeometryType::Sphere) {
+    const float latitude{(v - .5f)*pi};
+    const float longitude{u*2.f*pi};
+    const float normal[3]{
+      std::cos(latitude)*std::sin(longitude), std::sin(latitude),
+      std::cos(latitude)*std::cos(longitude)
+    };
+    for (std::size_t axis{0}; axis < 3; ++axis) {
+      vertex[axis] = normal[axis];
+      vertex[3 + axis] = normal[axis];
+    }
+  } else {
+    const CubeFace& face{cubeFaces[grid]};
+    // Planes are the front face without the offset along its normal.
+    const float depth{type == GeometryType::Cube ? 1.f : 0.f};
+    for (std::size_t axis{0}; axis < 3; ++axis) {
+      vertex[axis] = depth*face.normal[axis]
+        + (2.f*u - 1.f)*face.right[axis] + (2.f*v - 1.f)*face.up[axis];
+      vertex[3 + axis] = face.normal[axis];
+    }
+  }
+  vertex[6] = u;
+  vertex[7] = v;
+}
+
+} // namespace
+
+auto createProceduralGeometry(
+  GeometryType type, int subdivisions, std::size_t threadCount
+) -> std::unique_ptr<Mesh> {
+  if (
+    type != GeometryType::Plane && type != GeometryType::Sphere
+    && type != GeometryType::Cube
+  ) {
+    return nullptr;
+  }
+  const auto cells{static_cast<std::size_t>(subdivisions)};
+  const std::size_t side{cells + 1};
+  const std::size_t grids{type == GeometryType::Cube ? 6u : 1u};
+  const std::size_t vertexCount{grids*side*side};
+  if (subdivisions <= 0 || subdivisions > maxSubdivisions) {
+    std::cerr << "Invalid number of subdivisions " << subdivisions << '\n';
+    return nullptr;
+  }
+  const VertexLayout layout{true, true};
+  const std::size_t stride{layout.getStride()};
+  std::vector<float> vertices(vertexCount*stride);
+  std::vector<std::uint32_t> indices(grids*cells*cells*6);
+  ThreadPool pool{threadCount};
+  // Each task fills a row of vertices and the cells above it.
+  pool.run(grids*side, [&](std::size_t row, std::size_t) {
+    const std::size_t grid{row/side};
+    const std::size_t y{row%side};
+    const float v{static_cast<float>(y)/static_cast<float>(cells)};
+    for (std::size_t x{0}; x < side; ++x) {
+      placeVertex(
+        type, grid, static_cast<float>(x)/static_cast<float>(cells), v,
+        vertices.data() + (row*side + x)*stride
+      );
+    }
+    if (y == cells) {
+      return;
+    }
+    std::uint32_t* cell{
+      indices.data() + ((grid*cells + y)*cells)*6
+    };
+    for (std::size_t x{0}; x < cells; ++x, cell += 6) {
+      const auto corner{static_cast<std::uint32_t>(row*side + x)};
+      const auto above{static_cast<std::uint32_t>(corner + side)};
+      cell[0] = corner;
+      cell[1] = corner + 1;
+      cell[2] = above + 1;
+      cell[3] = corner;
+      cell[4] = above + 1;
+      cell[5] = above;
+    }
+  });
+  return std::make_unique<Mesh>(
+    std::move(vertices), std::move(indices), layout
+  );
+}
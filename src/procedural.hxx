@@ -0,0 +1,23 @@
+#ifndef PROCEDURAL_HXX
+#define PROCEDURAL_HXX
+
+#include <cstddef>
+#include <memory>
+
+#include "geometry.hxx"
+
+// Keeps the vertices of every type within 32-bit indices.
+constexpr int maxSubdivisions{16384};
+
+/**
+ * Generates a plane (the [-1, 1] square facing +z), a unit sphere or the
+ * [-1, 1] cube as grids of subdivisions x subdivisions cells (one grid per
+ * cube face), with normals and texture coordinates. The buffers are sized
+ * up front and the rows filled in parallel. Errors go to std::cerr; returns
+ * null for other types or subdivisions outside [1, maxSubdivisions].
+ */
+auto createProceduralGeometry(
+  GeometryType type, int subdivisions, std::size_t threadCount
+) -> std::unique_ptr<Mesh>;
+
+#endif // PROCEDURAL_HXX
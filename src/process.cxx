@@ -0,0 +1,169 @@
+#include "process.hxx"
+
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+namespace {
+
+#ifdef _WIN32
+// Quotes an argument as CommandLineToArgvW and the C runtime split them.
+auto quoteArgument(const std::string& argument) -> std::string {
+  if (
+    !argument.empty()
+    && argument.find_first_of(" \t\"") == std::string::npos
+  ) {
+    return argument;
+  }
+  std::string quoted{"\""};
+  std::size_t backslashes{0};
+  for (const char c : argument) {
+    if (c == '\\') {
+      ++backslashes;
+      continue;
+    }
+    // Backslashes only escape when they precede a quote.
+    quoted.append(c == '"' ? backslashes*2 + 1 : backslashes, '\\');
+    backslashes = 0;
+    quoted += c;
+  }
+  quoted.append(backslashes*2, '\\');
+  quoted += '"';
+  return quoted;
+}
+#endif
+
+} // namespace
+
+ChildProcess::ChildProcess(
+  const std::string& program, const std::vector<std::string>& arguments
+) {
+#ifdef _WIN32
+  std::string commandLine{quoteArgument(program)};
+  for (const std::string& argument : arguments) {
+    commandLine += ' ' + quoteArgument(argument);
+  }
+  SECURITY_ATTRIBUTES security{};
+  security.nLength = sizeof(security);
+  security.bInheritHandle = TRUE;
+  const HANDLE null{CreateFileA(
+    "NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &security, OPEN_EXISTING, 0,
+    nullptr
+  )};
+  STARTUPINFOA startup{};
+  startup.cb = sizeof(startup);
+  startup.dwFlags = STARTF_USESTDHANDLES;
+  startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+  startup.hStdOutput = null;
+  startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+  PROCESS_INFORMATION information{};
+  const BOOL created{CreateProcessA(
+    program.c_str(), commandLine.data(), nullptr, nullptr, TRUE, 0, nullptr,
+    nullptr, &startup, &information
+  )};
+  if (null != INVALID_HANDLE_VALUE) {
+    CloseHandle(null);
+  }
+  if (!created) {
+    throw std::runtime_error{"Failed to start " + program};
+  }
+  CloseHandle(information.hThread);
+  _process = information.hProcess;
+#else
+  std::vector<char*> argv{const_cast<char*>(program.c_str())};
+  for (const std::string& argument : arguments) {
+    argv.push_back(const_cast<char*>(argument.c_str()));
+  }
+  argv.push_back(nullptr);
+  posix_spawn_file_actions_t actions{};
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(
+    &actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0
+  );
+  const int error{posix_spawn(
+    &_pid, program.c_str(), &actions, nullptr, argv.data(), environ
+  )};
+  posix_spawn_file_actions_destroy(&actions);
+  if (error != 0) {
+    throw std::runtime_error{"Failed to start " + program};
+  }
+#endif
+}
+
+ChildProcess::~ChildProcess() {
+  wait();
+#ifdef _WIN32
+  CloseHandle(_process);
+#endif
+}
+
+auto ChildProcess::wait() -> int {
+  if (_exited) {
+    return _exitCode;
+  }
+  _exited = true;
+#ifdef _WIN32
+  DWORD exitCode{};
+  if (
+    WaitForSingleObject(_process, INFINITE) == WAIT_OBJECT_0
+    && GetExitCodeProcess(_process, &exitCode)
+  ) {
+    _exitCode = static_cast<int>(exitCode);
+  }
+#else
+  int status{};
+  pid_t result{};
+  do {
+    result = waitpid(_pid, &status, 0);
+  } while (result < 0 && errno == EINTR);
+  if (result == _pid && WIFEXITED(status)) {
+    _exitCode = WEXITSTATUS(status);
+  }
+#endif
+  return _exitCode;
+}
+
+auto getExecutablePath(const char* argv0) -> std::string {
+#ifdef _WIN32
+  char path[MAX_PATH]{};
+  const DWORD length{GetModuleFileNameA(nullptr, path, MAX_PATH)};
+  if (length > 0 && length < MAX_PATH) {
+    return path;
+  }
+#else
+  std::error_code error{};
+  const std::filesystem::path path{
+    std::filesystem::read_symlink("/proc/self/exe", error)
+  };
+  if (!error) {
+    return path.string();
+  }
+#endif
+  return std::filesystem::absolute(argv0).string();
+}
+
+auto setEnvironmentDefault(
+  const std::string& name, const std::string& value
+) -> void {
+  if (std::getenv(name.c_str())) {
+    return;
+  }
+#ifdef _WIN32
+  _putenv_s(name.c_str(), value.c_str());
+#else
+  setenv(name.c_str(), value.c_str(), 0);
+#endif
+}
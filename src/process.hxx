@@ -0,0 +1,46 @@
+#ifndef PROCESS_HXX
+#define PROCESS_HXX
+
+#include <string>
+#include <vector>
+
+/**
+ * Another process running a program, with the same environment and stderr
+ * as this one. Its stdout is discarded, so that it cannot interleave with
+ * frames written to this process's stdout.
+ */
+class ChildProcess {
+public:
+  // Throws if the process cannot be started.
+  ChildProcess(
+    const std::string& program, const std::vector<std::string>& arguments
+  );
+  ChildProcess() = delete;
+  ChildProcess(const ChildProcess&) = delete;
+  ChildProcess(ChildProcess&&) = delete;
+  ChildProcess operator=(const ChildProcess&) = delete;
+  ChildProcess operator=(ChildProcess&&) = delete;
+  // Waits for the process if nobody has.
+  ~ChildProcess();
+
+  // Returns the exit code, or -1 if the process did not exit normally.
+  auto wait() -> int;
+
+private:
+#ifdef _WIN32
+  void* _process{};
+#else
+  int _pid{};
+#endif
+  bool _exited{false};
+  int _exitCode{-1};
+};
+
+// The path of the running executable, falling back to argv[0].
+auto getExecutablePath(const char* argv0) -> std::string;
+// Sets an environment variable for child processes unless it is set.
+auto setEnvironmentDefault(
+  const std::string& name, const std::string& value
+) -> void;
+
+#endif // PROCESS_HXX
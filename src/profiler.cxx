@@ -0,0 +1,258 @@
+#include "profiler.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+namespace {
+
+auto percentile(const std::vector<double>& sorted, double p) -> double {
+  if (sorted.empty()) {
+    return 0.;
+  }
+  // Nearest-rank percentile.
+  const double rank{std::ceil(p/100.*static_cast<double>(sorted.size()))};
+  const std::size_t index{
+    static_cast<std::size_t>(std::max(rank, 1.)) - 1
+  };
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+auto printStatisticsText(
+  std::ostream& out, const char* label, const FrameStatistics& stats
+) -> void {
+  out << label << " frame time (ms): min " << stats.min
+    << ", median " << stats.median << ", p95 " << stats.p95
+    << ", p99 " << stats.p99 << ", mean " << stats.mean << '\n';
+}
+
+auto printStatisticsJSON(
+  std::ostream& out, const FrameStatistics& stats
+) -> void {
+  out << "{\"min\": " << stats.min << ", \"median\": " << stats.median
+    << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99
+    << ", \"mean\": " << stats.mean << '}';
+}
+
+auto printStatisticsCSV(
+  std::ostream& out, const FrameStatistics& stats
+) -> void {
+  out << ',' << stats.min << ',' << stats.median << ',' << stats.p95
+    << ',' << stats.p99 << ',' << stats.mean;
+}
+
+} // namespace
+
+auto printStringJSON(std::ostream& out, const std::string& value) -> void {
+  out << '"';
+  for (const char c : value) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+auto FrameStatistics::fromSamples(
+  std::vector<double> samples
+) -> FrameStatistics {
+  if (samples.empty()) {
+    return {};
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum{};
+  for (const double sample : samples) {
+    sum += sample;
+  }
+  return {
+    samples.front(), percentile(samples, 50.), percentile(samples, 95.),
+    percentile(samples, 99.), sum/static_cast<double>(samples.size())
+  };
+}
+
+auto BenchReport::getVertexRate() const -> std::optional<double> {
+  const double milliseconds{gpu.mean > 0. ? gpu.mean : cpu.mean};
+  if (!verticesPerFrame) {
+    return {};
+  }
+  return milliseconds > 0. ? *verticesPerFrame/milliseconds/1e3 : 0.;
+}
+
+auto BenchReport::getTriangleRate() const -> std::optional<double> {
+  const double milliseconds{gpu.mean > 0. ? gpu.mean : cpu.mean};
+  if (!trianglesPerFrame) {
+    return {};
+  }
+  return milliseconds > 0. ? *trianglesPerFrame/milliseconds/1e3 : 0.;
+}
+
+auto BenchReport::print(std::ostream& out, BenchFormat format) const -> void {
+  if (format == BenchFormat::CSV) {
+    // Paths are written verbatim, so they must not contain commas.
+    out << vertexPath << ',' << fragmentPath << ',' << model << ','
+      << width << ',' << height << ',' << frames << ',' << fps;
+    printStatisticsCSV(out, cpu);
+    printStatisticsCSV(out, gpu);
+    // Empty fields when too few frames were measured.
+    for (const std::optional<double>& value : {
+      verticesPerFrame, trianglesPerFrame, getVertexRate(), getTriangleRate()
+    }) {
+      out << ',';
+      if (value) {
+        out << *value;
+      }
+    }
+    out << '\n';
+    return;
+  }
+  if (format == BenchFormat::JSON) {
+    out << "{\"renderer\": ";
+    printStringJSON(out, renderer);
+    out << ", \"version\": ";
+    printStringJSON(out, version);
+    out << ", \"vertex\": ";
+    printStringJSON(out, vertexPath);
+    out << ", \"fragment\": ";
+    printStringJSON(out, fragmentPath);
+    out << ", \"model\": ";
+    printStringJSON(out, model);
+    out << ", \"width\": " << width << ", \"height\": " << height
+      << ", \"frames\": " << frames << ", \"fps\": " << fps
+      << ", \"cpu_ms\": ";
+    printStatisticsJSON(out, cpu);
+    out << ", \"gpu_ms\": ";
+    printStatisticsJSON(out, gpu);
+    if (verticesPerFrame && trianglesPerFrame) {
+      out << ", \"vertices_per_frame\": " << *verticesPerFrame
+        << ", \"triangles_per_frame\": " << *trianglesPerFrame
+        << ", \"mvertices_per_s\": " << getVertexRate().value_or(0.)
+        << ", \"mtriangles_per_s\": " << getTriangleRate().value_or(0.);
+    }
+    out << ", \"startup_ms\": " << startupMilliseconds;
+    if (cache) {
+      out << ", \"cache\": {\"hits\": " << cache->hits
+        << ", \"misses\": " << cache->misses
+        << ", \"rejected\": " << cache->rejected << '}';
+    }
+    out << "}\n";
+    return;
+  }
+  out << "Renderer: " << renderer << " (" << version << ")\n";
+  out << "Shaders: " << vertexPath << ", " << fragmentPath << '\n';
+  out << "Model: " << model << '\n';
+  out << "Frames: " << frames << " at " << width << 'x' << height
+    << " (" << fps << " fps)\n";
+  printStatisticsText(out, "CPU", cpu);
+  printStatisticsText(out, "GPU", gpu);
+  if (verticesPerFrame && trianglesPerFrame) {
+    out << "Geometry: " << *verticesPerFrame << " vertices, "
+      << *trianglesPerFrame << " triangles per frame ("
+      << getVertexRate().value_or(0.) << " Mvertices/s, "
+      << getTriangleRate().value_or(0.) << " Mtriangles/s)\n";
+  } else {
+    out << "Geometry: too few frames measured\n";
+  }
+  out << "Startup (ms): " << startupMilliseconds << '\n';
+  if (cache) {
+    out << "Program cache: " << cache->hits << " hits, " << cache->misses
+      << " misses (" << cache->rejected << " rejected)\n";
+  }
+}
+
+FrameProfiler::FrameProfiler() : _slots(_ringSize) {
+  for (QuerySlot& slot : _slots) {
+    glGenQueries(1, &slot.begin);
+    glGenQueries(1, &slot.end);
+  }
+}
+
+FrameProfiler::~FrameProfiler() {
+  for (QuerySlot& slot : _slots) {
+    glDeleteQueries(1, &slot.begin);
+    glDeleteQueries(1, &slot.end);
+  }
+}
+
+auto FrameProfiler::beginFrame() -> void {
+  const Clock::time_point now{Clock::now()};
+  if (_lastFrameStart) {
+    const std::chrono::duration<double, std::milli> elapsed{
+      now - *_lastFrameStart
+    };
+    _cpuTimes.push_back(elapsed.count());
+  }
+  _lastFrameStart = now;
+
+  QuerySlot& slot{_slots[_current]};
+  if (slot.pending) {
+    // This slot was issued _ringSize frames ago; by now its result is
+    // almost always available. Waiting only happens when the GPU is
+    // further behind than the ring is deep.
+    collect(slot, true);
+  }
+  glQueryCounter(slot.begin, GL_TIMESTAMP);
+}
+
+auto FrameProfiler::endFrame() -> void {
+  QuerySlot& slot{_slots[_current]};
+  glQueryCounter(slot.end, GL_TIMESTAMP);
+  slot.pending = true;
+  _current = (_current + 1) % _slots.size();
+  // Pick up whatever has already completed, oldest first, without blocking.
+  for (std::size_t i{}; i < _slots.size(); ++i) {
+    QuerySlot& oldest{_slots[(_current + i) % _slots.size()]};
+    if (oldest.pending && !collect(oldest, false)) {
+      break;
+    }
+  }
+}
+
+auto FrameProfiler::finish() -> void {
+  if (_lastFrameStart) {
+    const std::chrono::duration<double, std::milli> elapsed{
+      Clock::now() - *_lastFrameStart
+    };
+    _cpuTimes.push_back(elapsed.count());
+    _lastFrameStart.reset();
+  }
+  // Drain in submission order, oldest slot first.
+  for (std::size_t i{}; i < _slots.size(); ++i) {
+    QuerySlot& slot{_slots[(_current + i) % _slots.size()]};
+    if (slot.pending) {
+      collect(slot, true);
+    }
+  }
+}
+
+auto FrameProfiler::reset() -> void {
+  finish();
+  _cpuTimes.clear();
+  _gpuTimes.clear();
+}
+
+auto FrameProfiler::getCPUTimes() const -> const std::vector<double>& {
+  return _cpuTimes;
+}
+
+auto FrameProfiler::getGPUTimes() const -> const std::vector<double>& {
+  return _gpuTimes;
+}
+
+auto FrameProfiler::collect(QuerySlot& slot, bool wait) -> bool {
+  if (!wait) {
+    GLint available{};
+    glGetQueryObjectiv(slot.end, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      return false;
+    }
+  }
+  GLuint64 begin{};
+  GLuint64 end{};
+  glGetQueryObjectui64v(slot.begin, GL_QUERY_RESULT, &begin);
+  glGetQueryObjectui64v(slot.end, GL_QUERY_RESULT, &end);
+  _gpuTimes.push_back(static_cast<double>(end - begin)/1.e6);
+  slot.pending = false;
+  return true;
+}
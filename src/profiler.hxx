@@ -0,0 +1,94 @@
+#ifndef PROFILER_HXX
+#define PROFILER_HXX
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cache.hxx"
+#include "parameters.hxx"
+
+struct FrameStatistics {
+  double min{};
+  double median{};
+  double p95{};
+  double p99{};
+  double mean{};
+
+  static auto fromSamples(std::vector<double> samples) -> FrameStatistics;
+};
+
+struct BenchReport {
+  std::string renderer;
+  std::string version;
+  std::string vertexPath;
+  std::string fragmentPath;
+  std::string model;
+  int width{};
+  int height{};
+  std::size_t frames{};
+  double fps{};
+  double startupMilliseconds{};
+  std::optional<ProgramCacheStatistics> cache{};
+  FrameStatistics cpu{};
+  FrameStatistics gpu{};
+  // Empty when no frame was measured after the warmup.
+  std::optional<double> verticesPerFrame{};
+  std::optional<double> trianglesPerFrame{};
+
+  // Millions of vertices and triangles per second of mean GPU time (or of
+  // CPU time without GPU timings).
+  auto getVertexRate() const -> std::optional<double>;
+  auto getTriangleRate() const -> std::optional<double>;
+  auto print(std::ostream& out, BenchFormat format) const -> void;
+};
+
+// Writes a quoted JSON string, dropping control characters.
+auto printStringJSON(std::ostream& out, const std::string& value) -> void;
+
+/**
+ * Measures CPU and GPU time per frame. GPU time comes from a ring of
+ * GL_TIMESTAMP query pairs that are only read back once the ring wraps
+ * around, i.e. several frames late, so sampling never stalls the pipeline.
+ */
+class FrameProfiler {
+public:
+  FrameProfiler();
+  FrameProfiler(const FrameProfiler&) = delete;
+  FrameProfiler(FrameProfiler&&) = delete;
+  FrameProfiler operator=(const FrameProfiler&) = delete;
+  FrameProfiler operator=(FrameProfiler&&) = delete;
+  ~FrameProfiler();
+
+  auto beginFrame() -> void;
+  auto endFrame() -> void;
+  auto finish() -> void;
+  auto reset() -> void;
+  auto getCPUTimes() const -> const std::vector<double>&;
+  auto getGPUTimes() const -> const std::vector<double>&;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct QuerySlot {
+    GLuint begin{};
+    GLuint end{};
+    bool pending{false};
+  };
+
+  auto collect(QuerySlot& slot, bool wait) -> bool;
+
+  static constexpr std::size_t _ringSize{5};
+  std::vector<QuerySlot> _slots{};
+  std::size_t _current{};
+  std::optional<Clock::time_point> _lastFrameStart{};
+  std::vector<double> _cpuTimes{};
+  std::vector<double> _gpuTimes{};
+};
+
+#endif // PROFILER_HXX
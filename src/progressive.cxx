@@ -0,0 +1,203 @@
+#include "progressive.hxx"
+
+#include <algorithm>
+
+namespace {
+
+constexpr int coarsestLevelShift{3};
+
+} // namespace
+
+ProgressiveRenderer::ProgressiveRenderer(
+  const ProgressiveSettings& settings
+) : _settings{settings} {
+  glGenQueries(2, _queries);
+}
+
+ProgressiveRenderer::~ProgressiveRenderer() {
+  glDeleteQueries(2, _queries);
+}
+
+auto ProgressiveRenderer::restart() -> void {
+  _hasFinished = false;
+  _newImage = true;
+  _level = 0;
+  _nextTile = 0;
+}
+
+auto ProgressiveRenderer::beginFrame(GLsizei width, GLsizei height) -> bool {
+  if (width != _width || height != _height || _levels.empty()) {
+    _width = width;
+    _height = height;
+    createLevels();
+    restart();
+  }
+  collectTiming();
+  return _newImage;
+}
+
+auto ProgressiveRenderer::renderTiles(const DrawFunction& draw) -> void {
+  _newImage = false;
+  const Framebuffer& level{*_levels[_level]};
+  if (_nextTile == 0 && _level > 0 && !_hasFinished) {
+    // Start from the previous level, so that refinement only ever adds
+    // detail.
+    const Framebuffer& coarser{*_levels[_level - 1]};
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, coarser.getFramebuffer());
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, level.getFramebuffer());
+    glBlitFramebuffer(
+      0, 0, coarser.getWidth(), coarser.getHeight(),
+      0, 0, level.getWidth(), level.getHeight(),
+      GL_COLOR_BUFFER_BIT, GL_LINEAR
+    );
+  }
+  // Until the first measurement arrives, one tile per frame is the safe
+  // choice for shaders that are slow enough to need this mode.
+  const std::size_t tilePixels{
+    static_cast<std::size_t>(_settings.tileSize)*_settings.tileSize
+  };
+  std::size_t tileCount{1};
+  if (_nanosecondsPerPixel) {
+    const double tileNanoseconds{
+      *_nanosecondsPerPixel*static_cast<double>(tilePixels)
+    };
+    tileCount = std::max<std::size_t>(1, static_cast<std::size_t>(
+      _settings.budgetMilliseconds*1e6/std::max(tileNanoseconds, 1.)
+    ));
+    // Measurements lag behind by a frame or two, so grow gradually in
+    // case one of them was too optimistic.
+    tileCount = std::min(tileCount, _lastTileCount*2);
+  }
+  _lastTileCount = tileCount;
+
+  const bool measure{!_queryPending};
+  if (measure) {
+    glQueryCounter(_queries[0], GL_TIMESTAMP);
+    _queryPixels = 0;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, level.getFramebuffer());
+  glViewport(0, 0, level.getWidth(), level.getHeight());
+  glEnable(GL_SCISSOR_TEST);
+  const std::size_t levelTiles{getTileCount()};
+  for (std::size_t i{}; i < tileCount && _nextTile < levelTiles; ++i) {
+    GLint rectangle[4]{};
+    getTileRectangle(_nextTile, rectangle);
+    glScissor(rectangle[0], rectangle[1], rectangle[2], rectangle[3]);
+    glClear(GL_COLOR_BUFFER_BIT);
+    draw(level.getWidth(), level.getHeight());
+    // Submit each tile on its own, so that no single submission runs long
+    // enough to trip the driver's watchdog.
+    glFlush();
+    if (measure) {
+      _queryPixels += static_cast<std::size_t>(rectangle[2])*rectangle[3];
+    }
+    ++_nextTile;
+  }
+  glDisable(GL_SCISSOR_TEST);
+  if (measure) {
+    glQueryCounter(_queries[1], GL_TIMESTAMP);
+    _queryPending = true;
+  }
+
+  if (_nextTile < levelTiles) {
+    return;
+  }
+  _nextTile = 0;
+  if (_level + 1 < _levels.size()) {
+    ++_level;
+    return;
+  }
+  // The full-size level becomes the presented image, and the previous
+  // image becomes the next one to accumulate into. Coarse levels are only
+  // worth rendering while there is nothing better to show.
+  std::swap(_levels.back(), _finished);
+  _hasFinished = true;
+  _newImage = true;
+}
+
+auto ProgressiveRenderer::present(GLuint framebuffer) -> void {
+  const Framebuffer& image{_hasFinished ? *_finished : *_levels[_level]};
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, image.getFramebuffer());
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+  glBlitFramebuffer(
+    0, 0, image.getWidth(), image.getHeight(), 0, 0, _width, _height,
+    GL_COLOR_BUFFER_BIT, GL_LINEAR
+  );
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+auto ProgressiveRenderer::hasFinishedImage() const -> bool {
+  return _hasFinished;
+}
+
+auto ProgressiveRenderer::createLevels() -> void {
+  _levels.clear();
+  if (_settings.coarseToFine) {
+    for (int shift{coarsestLevelShift}; shift > 0; --shift) {
+      _levels.push_back(std::make_unique<Framebuffer>(
+        std::max(_width >> shift, 1), std::max(_height >> shift, 1)
+      ));
+    }
+  }
+  _levels.push_back(std::make_unique<Framebuffer>(_width, _height));
+  _finished = std::make_unique<Framebuffer>(_width, _height);
+  // Start from a defined image; the triangle model does not cover
+  // everything.
+  for (const std::unique_ptr<Framebuffer>& level : _levels) {
+    glBindFramebuffer(GL_FRAMEBUFFER, level->getFramebuffer());
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+}
+
+auto ProgressiveRenderer::collectTiming() -> void {
+  if (!_queryPending) {
+    return;
+  }
+  GLint available{};
+  glGetQueryObjectiv(_queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    return;
+  }
+  _queryPending = false;
+  GLuint64 begin{};
+  GLuint64 end{};
+  glGetQueryObjectui64v(_queries[0], GL_QUERY_RESULT, &begin);
+  glGetQueryObjectui64v(_queries[1], GL_QUERY_RESULT, &end);
+  const GLuint64 elapsed{end - begin};
+  if (_queryPixels == 0) {
+    return;
+  }
+  const double measured{
+    static_cast<double>(elapsed)/static_cast<double>(_queryPixels)
+  };
+  // Smooth out noise, but follow changes (e.g. a new program) quickly.
+  _nanosecondsPerPixel = _nanosecondsPerPixel
+    ? *_nanosecondsPerPixel*.5 + measured*.5
+    : measured;
+}
+
+auto ProgressiveRenderer::getTileRectangle(
+  std::size_t tile, GLint rectangle[4]
+) const -> void {
+  const Framebuffer& level{*_levels[_level]};
+  const GLsizei size{_settings.tileSize};
+  const std::size_t columns{
+    static_cast<std::size_t>((level.getWidth() + size - 1)/size)
+  };
+  const GLint column{static_cast<GLint>(tile%columns)};
+  const GLint row{static_cast<GLint>(tile/columns)};
+  // Rows run from the top of the image, as it appears on screen.
+  const GLint top{level.getHeight() - row*size};
+  const GLint bottom{std::max(top - size, 0)};
+  rectangle[0] = column*size;
+  rectangle[1] = bottom;
+  rectangle[2] = std::min(size, level.getWidth() - column*size);
+  rectangle[3] = top - bottom;
+}
+
+auto ProgressiveRenderer::getTileCount() const -> std::size_t {
+  const Framebuffer& level{*_levels[_level]};
+  const GLsizei size{_settings.tileSize};
+  return static_cast<std::size_t>((level.getWidth() + size - 1)/size)
+    *static_cast<std::size_t>((level.getHeight() + size - 1)/size);
+}
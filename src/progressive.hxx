@@ -0,0 +1,77 @@
+#ifndef PROGRESSIVE_HXX
+#define PROGRESSIVE_HXX
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "framebuffer.hxx"
+
+struct ProgressiveSettings {
+  double budgetMilliseconds;
+  GLsizei tileSize;
+  bool coarseToFine;
+};
+
+/**
+ * Spreads the rendering of one image over several frames. The image is
+ * split into scissored tiles and each frame renders as many tiles as fit in
+ * the time budget, based on the GPU time measured for previous frames. The
+ * tiles accumulate in an FBO, and the last finished image is presented
+ * until the next one is complete.
+ *
+ * In coarse-to-fine order the image is first rendered at 1/8 resolution,
+ * then refined at 1/4, 1/2 and full resolution, each level starting from an
+ * upscaled copy of the previous one. Until the first image has finished,
+ * the level in progress is presented instead. beginFrame() returns true when
+ * a new image starts, so that the caller can take a new time snapshot; all
+ * tiles of an image must be drawn with the same time.
+ */
+class ProgressiveRenderer {
+public:
+  // Draws the scene at the given size; called once per tile with the
+  // scissor rectangle set.
+  using DrawFunction = std::function<void(GLsizei width, GLsizei height)>;
+
+  explicit ProgressiveRenderer(const ProgressiveSettings& settings);
+  ProgressiveRenderer() = delete;
+  ProgressiveRenderer(const ProgressiveRenderer&) = delete;
+  ProgressiveRenderer(ProgressiveRenderer&&) = delete;
+  ProgressiveRenderer operator=(const ProgressiveRenderer&) = delete;
+  ProgressiveRenderer operator=(ProgressiveRenderer&&) = delete;
+  ~ProgressiveRenderer();
+
+  auto restart() -> void;
+  auto beginFrame(GLsizei width, GLsizei height) -> bool;
+  auto renderTiles(const DrawFunction& draw) -> void;
+  auto present(GLuint framebuffer) -> void;
+  auto hasFinishedImage() const -> bool;
+
+private:
+  auto createLevels() -> void;
+  auto collectTiming() -> void;
+  auto getTileRectangle(std::size_t tile, GLint rectangle[4]) const -> void;
+  auto getTileCount() const -> std::size_t;
+
+  const ProgressiveSettings _settings;
+  GLsizei _width{};
+  GLsizei _height{};
+  // Coarsest first; the last level is full size.
+  std::vector<std::unique_ptr<Framebuffer>> _levels{};
+  std::unique_ptr<Framebuffer> _finished{};
+  bool _hasFinished{false};
+  bool _newImage{true};
+  std::size_t _level{};
+  std::size_t _nextTile{};
+  std::size_t _lastTileCount{1};
+  GLuint _queries[2]{};
+  bool _queryPending{false};
+  std::size_t _queryPixels{};
+  std::optional<double> _nanosecondsPerPixel{};
+};
+
+#endif // PROGRESSIVE_HXX
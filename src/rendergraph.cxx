@@ -0,0 +1,430 @@
+#include "rendergraph.hxx"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#include "debug.hxx"
+#include "io.hxx"
+
+namespace {
+
+constexpr std::string_view imagePassName{"image"};
+constexpr std::size_t noReader{static_cast<std::size_t>(-1)};
+
+auto isIdentifier(std::string_view name) -> bool {
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name.front()))) {
+    return false;
+  }
+  if (name.substr(0, 3) == "gl_") {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+  });
+}
+
+auto parseFormat(std::string_view value) -> std::optional<GLenum> {
+  if (value == "rgba8") {
+    return GL_RGBA8;
+  } else if (value == "rgba16f") {
+    return GL_RGBA16F;
+  } else if (value == "rgba32f") {
+    return GL_RGBA32F;
+  }
+  return {};
+}
+
+auto getPixelBytes(GLenum format) -> std::size_t {
+  switch (format) {
+    case GL_RGBA16F:
+      return 8;
+    case GL_RGBA32F:
+      return 16;
+    default:
+      return 4;
+  }
+}
+
+auto parseScale(std::string_view value) -> std::optional<double> {
+  double result{};
+  const char* end{value.data() + value.size()};
+  const auto [pointer, error]{std::from_chars(value.data(), end, result)};
+  if (error != std::errc{} || pointer != end || result <= 0. || result > 1.) {
+    return {};
+  }
+  return result;
+}
+
+auto parsePass(
+  const std::string& line, const std::filesystem::path& directory
+) -> std::optional<PassDescription> {
+  std::istringstream fields{line};
+  std::vector<std::string> tokens{};
+  std::string field{};
+  while (fields >> field && field.front() != '#') {
+    tokens.push_back(field);
+  }
+  if (tokens.size() < 2 || !isIdentifier(tokens.front())) {
+    std::cerr << "Invalid render graph entry \"" << line << "\"\n";
+    return {};
+  }
+  PassDescription pass{
+    tokens.at(0), (directory / tokens.at(1)).lexically_normal().string(), {},
+    GL_RGBA8, 1.
+  };
+  for (std::size_t t{2}; t < tokens.size(); ++t) {
+    const std::string& token{tokens.at(t)};
+    if (token.find("format=", 0) == 0) {
+      const std::optional<GLenum> format{parseFormat(token.substr(7))};
+      if (!format) {
+        std::cerr << "Unknown format \"" << token.substr(7) << "\"\n";
+        return {};
+      }
+      pass.format = *format;
+    } else if (token.find("scale=", 0) == 0) {
+      const std::optional<double> scale{parseScale(token.substr(6))};
+      if (!scale) {
+        std::cerr << "Invalid scale \"" << token.substr(6) << "\"\n";
+        return {};
+      }
+      pass.scale = *scale;
+    } else {
+      pass.inputs.push_back(token);
+    }
+  }
+  return pass;
+}
+
+} // namespace
+
+auto loadRenderGraph(
+  const std::string& path
+) -> std::optional<std::vector<PassDescription>> {
+  const std::optional<std::string> text{readFile(path)};
+  if (!text) {
+    std::cerr << "Failed to read render graph " << path << '\n';
+    return {};
+  }
+  const std::filesystem::path directory{
+    std::filesystem::path{path}.parent_path()
+  };
+  std::vector<PassDescription> passes{};
+  std::unordered_map<std::string, std::size_t> indices{};
+  std::istringstream lines{*text};
+  std::string line{};
+  while (std::getline(lines, line)) {
+    const std::size_t start{line.find_first_not_of(" \t\r")};
+    if (start == std::string::npos || line.at(start) == '#') {
+      continue;
+    }
+    std::optional<PassDescription> pass{parsePass(line, directory)};
+    if (!pass) {
+      return {};
+    }
+    if (!indices.emplace(pass->name, passes.size()).second) {
+      std::cerr << "Duplicate render graph pass \"" << pass->name << "\"\n";
+      return {};
+    }
+    passes.push_back(std::move(*pass));
+  }
+  const auto image{indices.find(std::string{imagePassName})};
+  if (image == indices.end()) {
+    std::cerr << "Render graph " << path << " has no image pass\n";
+    return {};
+  }
+  const PassDescription& imagePass{passes.at(image->second)};
+  if (imagePass.format != GL_RGBA8 || imagePass.scale != 1.) {
+    std::cerr << "The image pass takes the output format and size\n";
+    return {};
+  }
+
+  // Order the passes with Kahn's algorithm, keeping the file order among
+  // independent passes. Reading one's own output is not a dependency.
+  std::vector<std::size_t> pendingInputs(passes.size());
+  std::vector<std::vector<std::size_t>> readers(passes.size());
+  for (std::size_t p{0}; p < passes.size(); ++p) {
+    for (const std::string& input : passes.at(p).inputs) {
+      const auto found{indices.find(input)};
+      if (found == indices.end()) {
+        std::cerr << "Pass \"" << passes.at(p).name
+          << "\" reads unknown pass \"" << input << "\"\n";
+        return {};
+      }
+      if (found->second == image->second) {
+        std::cerr << "Pass \"" << passes.at(p).name
+          << "\" reads the image pass, which has no texture\n";
+        return {};
+      }
+      if (found->second != p) {
+        ++pendingInputs.at(p);
+        readers.at(found->second).push_back(p);
+      }
+    }
+  }
+  std::vector<std::size_t> order{};
+  order.reserve(passes.size());
+  std::vector<bool> done(passes.size(), false);
+  while (order.size() < passes.size()) {
+    std::size_t next{noReader};
+    for (std::size_t p{0}; p < passes.size(); ++p) {
+      // The image pass goes last, after everything else it may not read.
+      const bool deferred{
+        p == image->second && order.size() + 1 < passes.size()
+      };
+      if (!done.at(p) && pendingInputs.at(p) == 0 && !deferred) {
+        next = p;
+        break;
+      }
+    }
+    if (next == noReader) {
+      std::cerr << "Render graph " << path << " has a cycle through";
+      for (std::size_t p{0}; p < passes.size(); ++p) {
+        if (!done.at(p) && p != image->second) {
+          std::cerr << " \"" << passes.at(p).name << '"';
+        }
+      }
+      std::cerr << '\n';
+      return {};
+    }
+    done.at(next) = true;
+    order.push_back(next);
+    for (const std::size_t reader : readers.at(next)) {
+      --pendingInputs.at(reader);
+    }
+  }
+  std::vector<PassDescription> sorted{};
+  sorted.reserve(passes.size());
+  for (const std::size_t p : order) {
+    sorted.push_back(std::move(passes.at(p)));
+  }
+  return sorted;
+}
+
+auto loadPassSources(
+  const std::vector<PassDescription>& passes,
+  const std::optional<std::string>& vertexPath,
+  ShaderPreprocessor& preprocessor, const ShaderDefines& defines
+) -> std::optional<std::vector<ShaderSources>> {
+  std::vector<ShaderSources> sources{};
+  sources.reserve(passes.size());
+  for (const PassDescription& pass : passes) {
+    std::optional<ShaderSource> vertex{};
+    if (vertexPath) {
+      vertex = preprocessor.process(*vertexPath, defines);
+    } else {
+      vertex = ShaderSource::fromLiteral(defaultVertexSource);
+    }
+    std::optional<ShaderSource> fragment{
+      preprocessor.process(pass.fragmentPath, defines)
+    };
+    if (!vertex || !fragment) {
+      std::cerr << "Failed to load pass \"" << pass.name << "\"\n";
+      return {};
+    }
+    sources.emplace_back(std::move(*vertex), std::move(*fragment));
+  }
+  return sources;
+}
+
+auto RenderTargetPool::acquire(
+  GLsizei width, GLsizei height, GLenum format
+) -> Framebuffer* {
+  for (Slot& slot : _slots) {
+    const Framebuffer& target{*slot.target};
+    if (
+      !slot.inUse && target.getWidth() == width
+      && target.getHeight() == height && target.getFormat() == format
+    ) {
+      slot.inUse = true;
+      slot.usedThisFrame = true;
+      return slot.target.get();
+    }
+  }
+  Slot& slot{_slots.emplace_back(Slot{
+    std::make_unique<Framebuffer>(width, height, format), true, true
+  })};
+  return slot.target.get();
+}
+
+auto RenderTargetPool::release(Framebuffer* target) -> void {
+  for (Slot& slot : _slots) {
+    if (slot.target.get() == target) {
+      slot.inUse = false;
+      return;
+    }
+  }
+}
+
+auto RenderTargetPool::collect() -> void {
+  _slots.erase(
+    std::remove_if(_slots.begin(), _slots.end(), [](const Slot& slot) {
+      return !slot.inUse && !slot.usedThisFrame;
+    }),
+    _slots.end()
+  );
+  for (Slot& slot : _slots) {
+    slot.usedThisFrame = slot.inUse;
+  }
+}
+
+auto RenderTargetPool::getCount() const -> std::size_t {
+  return _slots.size();
+}
+
+auto RenderTargetPool::getBytes() const -> std::size_t {
+  std::size_t bytes{};
+  for (const Slot& slot : _slots) {
+    const Framebuffer& target{*slot.target};
+    bytes += static_cast<std::size_t>(target.getWidth())
+      *static_cast<std::size_t>(target.getHeight())
+      *getPixelBytes(target.getFormat());
+  }
+  return bytes;
+}
+
+RenderGraph::RenderGraph(
+  std::vector<PassDescription> passes
+) : _passes{std::move(passes)} {
+  const std::size_t count{_passes.size()};
+  std::unordered_map<std::string, std::size_t> indices{};
+  for (std::size_t p{0}; p < count; ++p) {
+    indices.emplace(_passes.at(p).name, p);
+  }
+  _inputs.resize(count);
+  _feedback.resize(count, false);
+  _lastReader.resize(count, noReader);
+  _outputs.resize(count, nullptr);
+  _history.resize(count, nullptr);
+  for (std::size_t p{0}; p < count; ++p) {
+    for (const std::string& input : _passes.at(p).inputs) {
+      const std::size_t source{indices.at(input)};
+      _inputs.at(p).push_back(source);
+      if (source == p) {
+        _feedback.at(p) = true;
+      } else {
+        // Passes are in dependency order, so the last reader comes last.
+        _lastReader.at(source) = p;
+      }
+    }
+  }
+}
+
+auto RenderGraph::getPassCount() const -> std::size_t {
+  return _passes.size();
+}
+
+auto RenderGraph::hasFeedback() const -> bool {
+  return std::find(_feedback.begin(), _feedback.end(), true)
+    != _feedback.end();
+}
+
+auto RenderGraph::assignTextureUnits(
+  std::size_t pass, GLuint program
+) const -> void {
+  const std::vector<std::string>& inputs{_passes.at(pass).inputs};
+  for (std::size_t unit{0}; unit < inputs.size(); ++unit) {
+    const GLint location{
+      glGetUniformLocation(program, inputs.at(unit).c_str())
+    };
+    if (location >= 0) {
+      glProgramUniform1i(program, location, static_cast<GLint>(unit));
+    }
+  }
+}
+
+auto RenderGraph::execute(
+  GLsizei width, GLsizei height, const DrawFunction& draw
+) -> void {
+  constexpr GLfloat transparent[4]{0., 0., 0., 0.};
+  const std::size_t imagePass{_passes.size() - 1};
+  for (std::size_t p{0}; p < imagePass; ++p) {
+    const PassDescription& pass{_passes.at(p)};
+    const GLsizei passWidth{
+      std::max(static_cast<GLsizei>(std::lround(width*pass.scale)), 1)
+    };
+    const GLsizei passHeight{
+      std::max(static_cast<GLsizei>(std::lround(height*pass.scale)), 1)
+    };
+    if (_feedback.at(p)) {
+      Framebuffer*& history{_history.at(p)};
+      if (
+        history
+        && (history->getWidth() != passWidth
+          || history->getHeight() != passHeight)
+      ) {
+        _pool.release(history);
+        history = nullptr;
+      }
+      if (!history) {
+        // The first frame (and the first after a resize) reads black.
+        history = _pool.acquire(passWidth, passHeight, pass.format);
+        glBindFramebuffer(GL_FRAMEBUFFER, history->getFramebuffer());
+        glClearBufferfv(GL_COLOR, 0, transparent);
+      }
+    }
+    Framebuffer* target{_pool.acquire(passWidth, passHeight, pass.format)};
+    _outputs.at(p) = target;
+    glBindFramebuffer(GL_FRAMEBUFFER, target->getFramebuffer());
+    glViewport(0, 0, passWidth, passHeight);
+    glClearBufferfv(GL_COLOR, 0, transparent);
+    bindInputs(p);
+    draw(p, passWidth, passHeight);
+    // Whatever nothing reads any more can serve the remaining passes.
+    for (const std::size_t source : _inputs.at(p)) {
+      if (
+        source != p && _lastReader.at(source) == p && !_feedback.at(source)
+        && _outputs.at(source)
+      ) {
+        _pool.release(_outputs.at(source));
+        _outputs.at(source) = nullptr;
+      }
+    }
+    if (_lastReader.at(p) == noReader && !_feedback.at(p)) {
+      _pool.release(target);
+      _outputs.at(p) = nullptr;
+    }
+  }
+  bindInputs(imagePass);
+}
+
+auto RenderGraph::endFrame() -> void {
+  for (std::size_t p{0}; p < _outputs.size(); ++p) {
+    Framebuffer*& output{_outputs.at(p)};
+    if (!output) {
+      continue;
+    }
+    if (_feedback.at(p)) {
+      _pool.release(_history.at(p));
+      _history.at(p) = output;
+    } else {
+      _pool.release(output);
+    }
+    output = nullptr;
+  }
+  _pool.collect();
+  if (_pool.getCount() != _reportedCount) {
+    _reportedCount = _pool.getCount();
+    LOG("Render target pool: " << _reportedCount << " targets, "
+      << _pool.getBytes()/1024 << " KiB\n");
+  }
+}
+
+auto RenderGraph::bindInputs(std::size_t pass) -> void {
+  const std::vector<std::size_t>& inputs{_inputs.at(pass)};
+  for (std::size_t unit{0}; unit < inputs.size(); ++unit) {
+    const std::size_t source{inputs.at(unit)};
+    const Framebuffer* texture{
+      source == pass ? _history.at(pass) : _outputs.at(source)
+    };
+    glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(unit));
+    glBindTexture(GL_TEXTURE_2D, texture ? texture->getTexture() : 0);
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,122 @@
+#ifndef RENDERGRAPH_HXX
+#define RENDERGRAPH_HXX
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "framebuffer.hxx"
+#include "parameters.hxx"
+#include "preprocessor.hxx"
+
+struct PassDescription {
+  std::string name;
+  std::string fragmentPath;
+  // Names of the passes this one samples; its own name means its output
+  // from the previous frame.
+  std::vector<std::string> inputs;
+  GLenum format;
+  // Size relative to the output.
+  double scale;
+};
+
+/**
+ * Reads a render graph description with one pass per line:
+ *
+ *   <name> <fragment> [<input>...] [format=rgba8|rgba16f|rgba32f]
+ *     [scale=<factor>]
+ *
+ * The pass named "image" is drawn to the output and may not be read by
+ * other passes. The passes are returned in dependency order, with the image
+ * pass last. Relative paths are relative to the description file.
+ */
+auto loadRenderGraph(
+  const std::string& path
+) -> std::optional<std::vector<PassDescription>>;
+
+auto loadPassSources(
+  const std::vector<PassDescription>& passes,
+  const std::optional<std::string>& vertexPath,
+  ShaderPreprocessor& preprocessor, const ShaderDefines& defines
+) -> std::optional<std::vector<ShaderSources>>;
+
+/**
+ * Hands out framebuffers by size and format. Released framebuffers are
+ * reused by later requests within the frame (and in later frames);
+ * those that went unused for a whole frame are freed by collect().
+ */
+class RenderTargetPool {
+public:
+  RenderTargetPool() = default;
+  RenderTargetPool(const RenderTargetPool&) = delete;
+  RenderTargetPool(RenderTargetPool&&) = delete;
+  RenderTargetPool operator=(const RenderTargetPool&) = delete;
+  RenderTargetPool operator=(RenderTargetPool&&) = delete;
+
+  auto acquire(GLsizei width, GLsizei height, GLenum format) -> Framebuffer*;
+  auto release(Framebuffer* target) -> void;
+  auto collect() -> void;
+  auto getCount() const -> std::size_t;
+  auto getBytes() const -> std::size_t;
+
+private:
+  struct Slot {
+    std::unique_ptr<Framebuffer> target;
+    bool inUse;
+    bool usedThisFrame;
+  };
+
+  std::vector<Slot> _slots{};
+};
+
+/**
+ * Runs the buffer passes of a render graph in dependency order. Each pass
+ * renders into a pooled framebuffer that goes back to the pool as soon as
+ * its last reader has run, except for passes that read themselves, whose
+ * output is kept as the input of the next frame. Inputs are bound to
+ * consecutive texture units and read through sampler2D uniforms named
+ * after the input passes.
+ */
+class RenderGraph {
+public:
+  using DrawFunction = std::function<
+    void(std::size_t pass, GLsizei width, GLsizei height)
+  >;
+
+  explicit RenderGraph(std::vector<PassDescription> passes);
+  RenderGraph() = delete;
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph(RenderGraph&&) = delete;
+  RenderGraph operator=(const RenderGraph&) = delete;
+  RenderGraph operator=(RenderGraph&&) = delete;
+
+  auto getPassCount() const -> std::size_t;
+  auto hasFeedback() const -> bool;
+  auto assignTextureUnits(std::size_t pass, GLuint program) const -> void;
+  // Draws every pass but the image pass, then binds the image pass inputs.
+  auto execute(
+    GLsizei width, GLsizei height, const DrawFunction& draw
+  ) -> void;
+  // Returns this frame's targets to the pool once the image is drawn.
+  auto endFrame() -> void;
+
+private:
+  auto bindInputs(std::size_t pass) -> void;
+
+  std::vector<PassDescription> _passes;
+  std::vector<std::vector<std::size_t>> _inputs{};
+  std::vector<bool> _feedback{};
+  // The last pass to read each output within a frame.
+  std::vector<std::size_t> _lastReader{};
+  std::vector<Framebuffer*> _outputs{};
+  std::vector<Framebuffer*> _history{};
+  RenderTargetPool _pool{};
+  std::size_t _reportedCount{};
+};
+
+#endif // RENDERGRAPH_HXX
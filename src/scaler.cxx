@@ -0,0 +1,101 @@
+#include "scaler.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include "debug.hxx"
+
+namespace {
+
+constexpr double minimumScale{.25};
+constexpr double scaleStep{1./32.};
+// Scale down above the target, scale up below this fraction of it.
+constexpr double upperThreshold{1.};
+constexpr double lowerThreshold{.7};
+// Aim for the middle of the band when changing the scale.
+constexpr double aimFraction{.85};
+// Largest increase of the scale in a single change.
+constexpr double maximumGrowth{1.25};
+// Measured frames to wait after a change before changing again.
+constexpr int cooldownFrames{15};
+
+} // namespace
+
+ResolutionScaler::ResolutionScaler(
+  const ResolutionScaleSettings& settings
+) : _settings{settings} {
+  if (_settings.fixedScale) {
+    _scale = *_settings.fixedScale;
+  }
+  glGenQueries(2, _queries);
+}
+
+ResolutionScaler::~ResolutionScaler() {
+  glDeleteQueries(2, _queries);
+}
+
+auto ResolutionScaler::update() -> double {
+  if (_queryPending) {
+    GLint available{};
+    glGetQueryObjectiv(_queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 begin{};
+      GLuint64 end{};
+      glGetQueryObjectui64v(_queries[0], GL_QUERY_RESULT, &begin);
+      glGetQueryObjectui64v(_queries[1], GL_QUERY_RESULT, &end);
+      _queryPending = false;
+      adjust(static_cast<double>(end - begin)/1e6);
+    }
+  }
+  return _scale;
+}
+
+auto ResolutionScaler::beginMeasure() -> void {
+  _measuring = !_queryPending && !_settings.fixedScale;
+  if (_measuring) {
+    glQueryCounter(_queries[0], GL_TIMESTAMP);
+  }
+}
+
+auto ResolutionScaler::endMeasure() -> void {
+  if (!_measuring) {
+    return;
+  }
+  // Deferred renderers only start executing a frame once it is flushed.
+  glFlush();
+  glQueryCounter(_queries[1], GL_TIMESTAMP);
+  _queryPending = true;
+}
+
+auto ResolutionScaler::adjust(double milliseconds) -> void {
+  _averageMilliseconds = _averageMilliseconds
+    ? *_averageMilliseconds*.7 + milliseconds*.3
+    : milliseconds;
+  if (_cooldown > 0) {
+    --_cooldown;
+    return;
+  }
+  const double target{*_settings.targetMilliseconds};
+  const double average{*_averageMilliseconds};
+  if (average <= target*upperThreshold && average >= target*lowerThreshold) {
+    return;
+  }
+  if (average < target*lowerThreshold && _scale >= 1.) {
+    return;
+  }
+  // GPU time is roughly proportional to the pixel count, i.e. to the
+  // square of the scale.
+  double scale{_scale*std::sqrt(target*aimFraction/std::max(average, 1e-3))};
+  // Drop at once to recover quickly, but grow carefully.
+  scale = std::min(scale, _scale*maximumGrowth);
+  scale = std::clamp(std::round(scale/scaleStep)*scaleStep, minimumScale, 1.);
+  if (scale == _scale) {
+    return;
+  }
+  LOG("Resolution scale " << _scale << " -> " << scale << " (GPU "
+    << average << " ms)\n");
+  _scale = scale;
+  // The average was measured at the old scale.
+  _averageMilliseconds.reset();
+  _cooldown = cooldownFrames;
+}
@@ -0,0 +1,48 @@
+#ifndef SCALER_HXX
+#define SCALER_HXX
+
+#include <optional>
+
+#include <glad/gl.h>
+
+struct ResolutionScaleSettings {
+  // Frame budget for the automatic controller.
+  std::optional<double> targetMilliseconds;
+  // Overrides the controller.
+  std::optional<double> fixedScale;
+};
+
+/**
+ * Chooses the internal render resolution as a fraction of the output size.
+ * With a target frame time, the scale follows the GPU time measured around
+ * the scene: it drops as soon as frames run over the target, but only
+ * grows back once they are well below it, and every change is followed by
+ * a cool-down, so that it settles instead of oscillating.
+ */
+class ResolutionScaler {
+public:
+  explicit ResolutionScaler(const ResolutionScaleSettings& settings);
+  ResolutionScaler() = delete;
+  ResolutionScaler(const ResolutionScaler&) = delete;
+  ResolutionScaler(ResolutionScaler&&) = delete;
+  ResolutionScaler operator=(const ResolutionScaler&) = delete;
+  ResolutionScaler operator=(ResolutionScaler&&) = delete;
+  ~ResolutionScaler();
+
+  auto update() -> double;
+  auto beginMeasure() -> void;
+  auto endMeasure() -> void;
+
+private:
+  auto adjust(double milliseconds) -> void;
+
+  const ResolutionScaleSettings _settings;
+  double _scale{1.};
+  std::optional<double> _averageMilliseconds{};
+  int _cooldown{};
+  GLuint _queries[2]{};
+  bool _measuring{false};
+  bool _queryPending{false};
+};
+
+#endif // SCALER_HXX
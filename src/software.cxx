@@ -0,0 +1,2627 @@
+#include "software.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "debug.hxx"
+#include "glsl.hxx"
+
+namespace {
+
+// Unrolled iterations per loop, to keep runaway loops from exhausting memory.
+constexpr std::size_t maxIterations{1 << 16};
+
+struct CompileError : std::runtime_error {
+  CompileError(GLSLLocation where, const std::string& message) :
+    std::runtime_error{message}, location{where} {}
+
+  GLSLLocation location;
+};
+
+struct StructType;
+
+struct Type {
+  enum class Base {
+    Void,
+    Bool,
+    Int,
+    Float,
+    Struct
+  };
+
+  Base base{Base::Void};
+  std::size_t size{1};
+  const StructType* structure{};
+
+  auto componentCount() const -> std::size_t;
+  auto isNumeric() const -> bool {
+    return base == Base::Int || base == Base::Float;
+  }
+};
+
+struct StructType {
+  std::string name;
+  std::vector<std::pair<std::string, Type>> fields;
+  std::size_t componentCount;
+};
+
+auto Type::componentCount() const -> std::size_t {
+  switch (base) {
+  case Base::Void:
+    return 0;
+  case Base::Struct:
+    return structure->componentCount;
+  default:
+    return size;
+  }
+}
+
+auto operator==(const Type& a, const Type& b) -> bool {
+  return a.base == b.base && a.size == b.size && a.structure == b.structure;
+}
+
+auto operator!=(const Type& a, const Type& b) -> bool {
+  return !(a == b);
+}
+
+auto describe(const Type& type) -> std::string {
+  static const char* scalars[]{"void", "bool", "int", "float"};
+  static const char* prefixes[]{"", "b", "i", ""};
+  if (type.base == Type::Base::Struct) {
+    return type.structure->name;
+  }
+  const auto base{static_cast<std::size_t>(type.base)};
+  if (type.size == 1) {
+    return scalars[base];
+  }
+  return std::string{prefixes[base]} + "vec" + std::to_string(type.size);
+}
+
+// A compile-time constant or a register.
+struct Operand {
+  bool isConstant{true};
+  float value{};
+  std::uint32_t reg{};
+};
+
+auto constant(float value) -> Operand {
+  return {true, value, 0};
+}
+
+struct Value {
+  Type type{};
+  std::vector<Operand> components{};
+};
+
+struct Variable {
+  Value value{};
+  // Assigned after its declaration, so it lives in registers of its own.
+  bool isHome{false};
+  // For loop indices are constants, rebound by the loop step.
+  bool isLoopIndex{false};
+  bool isReadOnly{false};
+};
+
+auto operandCount(SoftwareOpcode opcode) -> std::size_t {
+  switch (opcode) {
+  case SoftwareOpcode::Move:
+  case SoftwareOpcode::Floor:
+  case SoftwareOpcode::Truncate:
+  case SoftwareOpcode::Fract:
+  case SoftwareOpcode::Sign:
+  case SoftwareOpcode::SquareRoot:
+  case SoftwareOpcode::InverseSquareRoot:
+  case SoftwareOpcode::Sine:
+  case SoftwareOpcode::Cosine:
+  case SoftwareOpcode::Tangent:
+  case SoftwareOpcode::ArcSine:
+  case SoftwareOpcode::ArcCosine:
+  case SoftwareOpcode::ArcTangent:
+  case SoftwareOpcode::SineHyperbolic:
+  case SoftwareOpcode::CosineHyperbolic:
+  case SoftwareOpcode::TangentHyperbolic:
+  case SoftwareOpcode::Exponential:
+  case SoftwareOpcode::Logarithm:
+  case SoftwareOpcode::Exponential2:
+  case SoftwareOpcode::Logarithm2:
+  case SoftwareOpcode::JumpIfNone:
+    return 1;
+  case SoftwareOpcode::Select:
+    return 3;
+  default:
+    return 2;
+  }
+}
+
+// Scalar semantics of every opcode, for constant folding and for the lanes
+// of operations without a vectorized implementation.
+auto fold(SoftwareOpcode opcode, float a, float b, float c) -> float {
+  switch (opcode) {
+  case SoftwareOpcode::Move:
+    return a;
+  case SoftwareOpcode::Add:
+    return a + b;
+  case SoftwareOpcode::Subtract:
+    return a - b;
+  case SoftwareOpcode::Multiply:
+    return a*b;
+  case SoftwareOpcode::Divide:
+    return a/b;
+  case SoftwareOpcode::Minimum:
+    return b < a ? b : a;
+  case SoftwareOpcode::Maximum:
+    return b > a ? b : a;
+  case SoftwareOpcode::Floor:
+    return std::floor(a);
+  case SoftwareOpcode::Truncate:
+    return std::trunc(a);
+  case SoftwareOpcode::Fract:
+    return a - std::floor(a);
+  case SoftwareOpcode::Modulo:
+    return a - b*std::floor(a/b);
+  case SoftwareOpcode::Step:
+    return b < a ? 0.f : 1.f;
+  case SoftwareOpcode::Sign:
+    return a > 0.f ? 1.f : (a < 0.f ? -1.f : 0.f);
+  case SoftwareOpcode::SquareRoot:
+    return std::sqrt(a);
+  case SoftwareOpcode::InverseSquareRoot:
+    return 1.f/std::sqrt(a);
+  case SoftwareOpcode::Sine:
+    return std::sin(a);
+  case SoftwareOpcode::Cosine:
+    return std::cos(a);
+  case SoftwareOpcode::Tangent:
+    return std::tan(a);
+  case SoftwareOpcode::ArcSine:
+    return std::asin(a);
+  case SoftwareOpcode::ArcCosine:
+    return std::acos(a);
+  case SoftwareOpcode::ArcTangent:
+    return std::atan(a);
+  case SoftwareOpcode::ArcTangent2:
+    return std::atan2(a, b);
+  case SoftwareOpcode::SineHyperbolic:
+    return std::sinh(a);
+  case SoftwareOpcode::CosineHyperbolic:
+    return std::cosh(a);
+  case SoftwareOpcode::TangentHyperbolic:
+    return std::tanh(a);
+  case SoftwareOpcode::Power:
+    return std::pow(a, b);
+  case SoftwareOpcode::Exponential:
+    return std::exp(a);
+  case SoftwareOpcode::Logarithm:
+    return std::log(a);
+  case SoftwareOpcode::Exponential2:
+    return std::exp2(a);
+  case SoftwareOpcode::Logarithm2:
+    return std::log2(a);
+  case SoftwareOpcode::Less:
+    return a < b ? 1.f : 0.f;
+  case SoftwareOpcode::LessEqual:
+    return a <= b ? 1.f : 0.f;
+  case SoftwareOpcode::Equal:
+    return a == b ? 1.f : 0.f;
+  case SoftwareOpcode::NotEqual:
+    return a != b ? 1.f : 0.f;
+  case SoftwareOpcode::Select:
+    return a != 0.f ? b : c;
+  case SoftwareOpcode::JumpIfNone:
+    break;
+  }
+  return 0.f;
+}
+
+auto rootName(const GLSLExpression& expression) -> const std::string* {
+  switch (expression.kind) {
+  case GLSLExpression::Kind::Identifier:
+    return &expression.text;
+  case GLSLExpression::Kind::Member:
+  case GLSLExpression::Kind::Index:
+    return rootName(*expression.operands.at(0));
+  default:
+    return nullptr;
+  }
+}
+
+using FunctionTable = std::multimap<std::string, const GLSLFunction*>;
+
+// Whether an expression may assign the named variable, directly or through
+// an out parameter. Shadowing is ignored, which only errs on the safe side.
+auto assigns(
+  const GLSLExpression& expression, const std::string& name,
+  const FunctionTable& functions
+) -> bool {
+  switch (expression.kind) {
+  case GLSLExpression::Kind::Assign:
+  case GLSLExpression::Kind::PreIncrement:
+  case GLSLExpression::Kind::PostIncrement: {
+    const std::string* root{rootName(*expression.operands.at(0))};
+    if (root && *root == name) {
+      return true;
+    }
+    break;
+  }
+  case GLSLExpression::Kind::Call: {
+    const auto range{functions.equal_range(expression.text)};
+    for (auto f{range.first}; f != range.second; ++f) {
+      const std::vector<GLSLParameter>& parameters{f->second->parameters};
+      for (
+        std::size_t p{0};
+        p < parameters.size() && p < expression.operands.size(); ++p
+      ) {
+        const std::string* root{rootName(*expression.operands.at(p))};
+        if (
+          parameters.at(p).direction != GLSLParameter::Direction::In
+          && root && *root == name
+        ) {
+          return true;
+        }
+      }
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  for (const auto& operand : expression.operands) {
+    if (assigns(*operand, name, functions)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto assigns(
+  const GLSLStatement& statement, const std::string& name,
+  const FunctionTable& functions
+) -> bool {
+  for (const auto& child : statement.statements) {
+    if (assigns(*child, name, functions)) {
+      return true;
+    }
+  }
+  for (const GLSLDeclaration& declaration : statement.declarations) {
+    if (
+      declaration.initializer
+      && assigns(*declaration.initializer, name, functions)
+    ) {
+      return true;
+    }
+  }
+  return (statement.expression
+      && assigns(*statement.expression, name, functions))
+    || (statement.step && assigns(*statement.step, name, functions));
+}
+
+// Whether a statement contains one of the given kind, not counting those
+// inside nested loops when looking for break or continue.
+auto contains(
+  const GLSLStatement& statement, GLSLStatement::Kind kind
+) -> bool {
+  if (statement.kind == kind) {
+    return true;
+  }
+  const bool isLoop{
+    statement.kind == GLSLStatement::Kind::For
+    || statement.kind == GLSLStatement::Kind::While
+    || statement.kind == GLSLStatement::Kind::DoWhile
+  };
+  if (isLoop && kind != GLSLStatement::Kind::Return) {
+    return false;
+  }
+  for (const auto& child : statement.statements) {
+    if (contains(*child, kind)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto containsNestedReturn(const GLSLStatement& body) -> bool {
+  for (const auto& statement : body.statements) {
+    if (
+      statement->kind != GLSLStatement::Kind::Return
+      && contains(*statement, GLSLStatement::Kind::Return)
+    ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto swizzleIndex(char letter) -> std::size_t {
+  static const char* sets[]{"xyzw", "rgba", "stpq"};
+  for (const char* set : sets) {
+    const char* found{std::strchr(set, letter)};
+    if (found && letter != '\0') {
+      return static_cast<std::size_t>(found - set);
+    }
+  }
+  return 4;
+}
+
+struct InputMember {
+  const char* name;
+  Type::Base base;
+  std::vector<SoftwareInput> inputs;
+};
+
+// The members of the ShaderTestInputs block, which also name the plain
+// uniforms "time" and "resolution".
+auto findInputMember(const std::string& name) -> const InputMember* {
+  static const InputMember members[]{
+    {"resolution", Type::Base::Int,
+      {SoftwareInput::ResolutionX, SoftwareInput::ResolutionY}},
+    {"time", Type::Base::Float, {SoftwareInput::Time}},
+    {"deltaTime", Type::Base::Float, {SoftwareInput::DeltaTime}},
+    {"mouse", Type::Base::Float,
+      {SoftwareInput::MouseX, SoftwareInput::MouseY, SoftwareInput::MouseZ,
+        SoftwareInput::MouseW}},
+    {"frame", Type::Base::Int, {SoftwareInput::Frame}},
+    {"date", Type::Base::Float,
+      {SoftwareInput::Year, SoftwareInput::Month, SoftwareInput::Day,
+        SoftwareInput::Seconds}}
+  };
+  for (const InputMember& member : members) {
+    if (name == member.name) {
+      return &member;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+/**
+ * Turns a parsed shader into a SoftwareProgram. Operands that are known at
+ * compile time are folded as they are produced, so that constants, loop
+ * indices and the results of uniform-free expressions cost nothing per
+ * pixel. Virtual registers are written once, except for the registers of
+ * variables ("homes"); a final pass packs them into as few as it can.
+ */
+class SoftwareCompiler {
+public:
+  SoftwareCompiler(const GLSLUnit& unit, std::string& log) :
+    _unit{unit}, _log{log} {}
+  SoftwareCompiler() = delete;
+  SoftwareCompiler(const SoftwareCompiler&) = delete;
+  SoftwareCompiler(SoftwareCompiler&&) = delete;
+  SoftwareCompiler operator=(const SoftwareCompiler&) = delete;
+  SoftwareCompiler operator=(SoftwareCompiler&&) = delete;
+
+  auto compile(SoftwareProgram& program) -> bool {
+    try {
+      compileUnit();
+    } catch (const CompileError& error) {
+      _log += std::to_string(error.location.file) + ':'
+        + std::to_string(error.location.line) + ": error: " + error.what()
+        + '\n';
+      return false;
+    }
+    allocateRegisters(program);
+    return true;
+  }
+
+private:
+  enum class RegisterKind {
+    Temporary,
+    Constant,
+    Input
+  };
+
+  struct Register {
+    RegisterKind kind;
+    float value;
+    SoftwareInput input;
+    bool isHome;
+  };
+
+  struct Loop {
+    std::size_t conditionDepth;
+    // Registers when the body can break or continue.
+    Operand broken;
+    Operand continued;
+    bool brokeAll;
+    bool continuedAll;
+  };
+
+  struct Frame {
+    const GLSLFunction* function;
+    std::size_t scopeBase;
+    Operand entry;
+    Type returnType;
+    std::vector<Operand> conditions;
+    std::vector<Loop> loops;
+    // Homes for the result when the function can return early.
+    std::optional<Value> result;
+    std::optional<Value> boundResult;
+    Operand returned;
+    bool returnedAll;
+  };
+
+  struct LValue {
+    Variable* variable;
+    std::vector<std::size_t> components;
+    Type type;
+  };
+
+  using Scope = std::unordered_map<std::string, Variable>;
+
+  auto warn(GLSLLocation location, const std::string& message) -> void {
+    _log += std::to_string(location.file) + ':'
+      + std::to_string(location.line) + ": warning: " + message + '\n';
+  }
+
+  // Registers and instructions.
+
+  auto newRegister(bool isHome = false) -> std::uint32_t {
+    _registers.push_back(
+      {RegisterKind::Temporary, 0.f, SoftwareInput::Time, isHome}
+    );
+    return static_cast<std::uint32_t>(_registers.size() - 1);
+  }
+
+  auto toRegister(Operand operand) -> std::uint32_t {
+    if (!operand.isConstant) {
+      return operand.reg;
+    }
+    std::uint32_t bits{};
+    std::memcpy(&bits, &operand.value, sizeof(bits));
+    const auto found{_constants.find(bits)};
+    if (found != _constants.end()) {
+      return found->second;
+    }
+    _registers.push_back(
+      {RegisterKind::Constant, operand.value, SoftwareInput::Time, false}
+    );
+    const auto reg{static_cast<std::uint32_t>(_registers.size() - 1)};
+    _constants.emplace(bits, reg);
+    return reg;
+  }
+
+  auto input(SoftwareInput which) -> Operand {
+    const auto found{_inputs.find(which)};
+    if (found != _inputs.end()) {
+      return {false, 0.f, found->second};
+    }
+    _registers.push_back({RegisterKind::Input, 0.f, which, false});
+    const auto reg{static_cast<std::uint32_t>(_registers.size() - 1)};
+    _inputs.emplace(which, reg);
+    return {false, 0.f, reg};
+  }
+
+  auto isHome(Operand operand) const -> bool {
+    return !operand.isConstant && _registers.at(operand.reg).isHome;
+  }
+
+  auto emitInto(
+    std::uint32_t target, SoftwareOpcode opcode, Operand a,
+    Operand b = {}, Operand c = {}
+  ) -> void {
+    const std::size_t count{operandCount(opcode)};
+    _instructions.push_back({
+      opcode, target, toRegister(a), count > 1 ? toRegister(b) : 0,
+      count > 2 ? toRegister(c) : 0
+    });
+  }
+
+  auto emit(
+    SoftwareOpcode opcode, Operand a, Operand b = {}, Operand c = {}
+  ) -> Operand {
+    const std::size_t count{operandCount(opcode)};
+    if (
+      a.isConstant && (count < 2 || b.isConstant)
+      && (count < 3 || c.isConstant)
+    ) {
+      return constant(fold(opcode, a.value, b.value, c.value));
+    }
+    const auto isConstant{[](Operand operand, float value) {
+      return operand.isConstant && operand.value == value;
+    }};
+    switch (opcode) {
+    case SoftwareOpcode::Add:
+      if (isConstant(a, 0.f)) {
+        return b;
+      }
+      if (isConstant(b, 0.f)) {
+        return a;
+      }
+      break;
+    case SoftwareOpcode::Subtract:
+    case SoftwareOpcode::Divide:
+      if (isConstant(b, opcode == SoftwareOpcode::Divide ? 1.f : 0.f)) {
+        return a;
+      }
+      break;
+    case SoftwareOpcode::Multiply:
+      if (isConstant(a, 1.f)) {
+        return b;
+      }
+      if (isConstant(b, 1.f)) {
+        return a;
+      }
+      break;
+    case SoftwareOpcode::Select:
+      if (a.isConstant) {
+        return a.value != 0.f ? b : c;
+      }
+      if (
+        b.isConstant == c.isConstant
+        && (b.isConstant ? b.value == c.value : b.reg == c.reg)
+      ) {
+        return b;
+      }
+      break;
+    default:
+      break;
+    }
+    const std::uint32_t target{newRegister()};
+    emitInto(target, opcode, a, b, c);
+    return {false, 0.f, target};
+  }
+
+  auto emitJump(Operand mask) -> std::size_t {
+    emitInto(0, SoftwareOpcode::JumpIfNone, mask);
+    return _instructions.size() - 1;
+  }
+
+  auto patchJump(std::size_t jump) -> void {
+    _instructions.at(jump).target
+      = static_cast<std::uint32_t>(_instructions.size());
+  }
+
+  // Masks (1 or 0 per lane).
+
+  auto andMask(Operand a, Operand b) -> Operand {
+    if (a.isConstant) {
+      return a.value != 0.f ? b : constant(0.f);
+    }
+    if (b.isConstant) {
+      return b.value != 0.f ? a : constant(0.f);
+    }
+    return emit(SoftwareOpcode::Minimum, a, b);
+  }
+
+  auto orMask(Operand a, Operand b) -> Operand {
+    if (a.isConstant) {
+      return a.value != 0.f ? constant(1.f) : b;
+    }
+    if (b.isConstant) {
+      return b.value != 0.f ? constant(1.f) : a;
+    }
+    return emit(SoftwareOpcode::Maximum, a, b);
+  }
+
+  auto notMask(Operand a) -> Operand {
+    return emit(SoftwareOpcode::Subtract, constant(1.f), a);
+  }
+
+  auto frame() -> Frame& {
+    return _frames.back();
+  }
+
+  auto invalidate() -> void {
+    _active.reset();
+  }
+
+  // The lanes that the code being compiled applies to.
+  auto active() -> Operand {
+    if (_active) {
+      return *_active;
+    }
+    Frame& current{frame()};
+    Operand mask{current.entry};
+    if (current.returnedAll) {
+      mask = constant(0.f);
+    }
+    for (const Loop& loop : current.loops) {
+      if (loop.brokeAll || loop.continuedAll) {
+        mask = constant(0.f);
+      }
+    }
+    for (const Operand condition : current.conditions) {
+      mask = andMask(mask, condition);
+    }
+    mask = andMask(mask, notMask(current.returned));
+    for (const Loop& loop : current.loops) {
+      mask = andMask(mask, notMask(loop.broken));
+      mask = andMask(mask, notMask(loop.continued));
+    }
+    _active = mask;
+    return mask;
+  }
+
+  auto isDead() -> bool {
+    const Operand mask{active()};
+    return mask.isConstant && mask.value == 0.f;
+  }
+
+  auto write(std::uint32_t home, Operand value) -> void {
+    if (!value.isConstant && value.reg == home) {
+      return;
+    }
+    const Operand mask{active()};
+    if (mask.isConstant) {
+      if (mask.value != 0.f) {
+        emitInto(home, SoftwareOpcode::Move, value);
+      }
+      return;
+    }
+    emitInto(
+      home, SoftwareOpcode::Select, mask, value, {false, 0.f, home}
+    );
+  }
+
+  // Values.
+
+  auto makeHome(const Value& initial) -> Value {
+    Value home{initial.type, {}};
+    for (const Operand component : initial.components) {
+      const std::uint32_t reg{newRegister(true)};
+      emitInto(reg, SoftwareOpcode::Move, component);
+      home.components.push_back({false, 0.f, reg});
+    }
+    return home;
+  }
+
+  // Copies components held by variables, which later writes would change.
+  auto snapshot(const Value& value) -> Value {
+    Value copy{value};
+    for (Operand& component : copy.components) {
+      if (isHome(component)) {
+        const std::uint32_t reg{newRegister()};
+        emitInto(reg, SoftwareOpcode::Move, component);
+        component = {false, 0.f, reg};
+      }
+    }
+    return copy;
+  }
+
+  auto zero(const Type& type) -> Value {
+    return {type, std::vector<Operand>(type.componentCount(), constant(0.f))};
+  }
+
+  auto resolveType(const std::string& name, GLSLLocation location) -> Type {
+    if (name == "void") {
+      return {Type::Base::Void, 1, nullptr};
+    }
+    if (name == "float") {
+      return {Type::Base::Float, 1, nullptr};
+    }
+    if (name == "int" || name == "uint") {
+      return {Type::Base::Int, 1, nullptr};
+    }
+    if (name == "bool") {
+      return {Type::Base::Bool, 1, nullptr};
+    }
+    const auto structure{_structs.find(name)};
+    if (structure != _structs.end()) {
+      return {Type::Base::Struct, 1, structure->second};
+    }
+    for (const auto& [prefix, base] : {
+      std::pair<const char*, Type::Base>{"vec", Type::Base::Float},
+      {"ivec", Type::Base::Int}, {"uvec", Type::Base::Int},
+      {"bvec", Type::Base::Bool}
+    }) {
+      const std::size_t length{std::strlen(prefix)};
+      if (
+        name.size() == length + 1 && name.compare(0, length, prefix) == 0
+        && name.back() >= '2' && name.back() <= '4'
+      ) {
+        return {base, static_cast<std::size_t>(name.back() - '0'), nullptr};
+      }
+    }
+    throw CompileError{
+      location, "type \"" + name + "\" is not supported by the software"
+        " renderer"
+    };
+  }
+
+  auto isTypeName(const std::string& name) -> bool {
+    if (_structs.count(name) > 0) {
+      return true;
+    }
+    try {
+      resolveType(name, {});
+      return name != "void";
+    } catch (const CompileError&) {
+      return false;
+    }
+  }
+
+  auto cast(Operand operand, Type::Base from, Type::Base to) -> Operand {
+    if (from == to) {
+      return operand;
+    }
+    if (to == Type::Base::Bool) {
+      return emit(SoftwareOpcode::NotEqual, operand, constant(0.f));
+    }
+    if (to == Type::Base::Int && from == Type::Base::Float) {
+      return emit(SoftwareOpcode::Truncate, operand);
+    }
+    return operand;
+  }
+
+  // Implicit conversions: exact matches and int to float.
+  auto convert(
+    const Value& value, const Type& type, GLSLLocation location
+  ) -> Value {
+    if (value.type == type) {
+      return value;
+    }
+    if (
+      value.type.base == Type::Base::Int && type.base == Type::Base::Float
+      && value.type.size == type.size
+    ) {
+      return {type, value.components};
+    }
+    throw CompileError{
+      location, "cannot convert from " + describe(value.type) + " to "
+        + describe(type)
+    };
+  }
+
+  auto scalarOf(
+    const Value& value, GLSLLocation location, const char* what
+  ) -> Operand {
+    if (value.type.base == Type::Base::Struct || value.type.size != 1) {
+      throw CompileError{
+        location, std::string{what} + " must be a scalar, not "
+          + describe(value.type)
+      };
+    }
+    return value.components.at(0);
+  }
+
+  auto condition(const GLSLExpression& expression) -> Operand {
+    const Value value{evaluate(expression)};
+    if (value.type.base != Type::Base::Bool) {
+      throw CompileError{
+        expression.location, "conditions must be bool, not "
+          + describe(value.type)
+      };
+    }
+    return scalarOf(value, expression.location, "conditions");
+  }
+
+  auto constantInt(const GLSLExpression& expression) -> std::size_t {
+    const Value value{evaluate(expression)};
+    const Operand index{scalarOf(value, expression.location, "indices")};
+    if (!index.isConstant || value.type.base != Type::Base::Int) {
+      throw CompileError{
+        expression.location, "indices must be constant integers"
+      };
+    }
+    if (index.value < 0.f) {
+      throw CompileError{expression.location, "negative index"};
+    }
+    return static_cast<std::size_t>(index.value);
+  }
+
+  // Scopes.
+
+  auto lookup(const std::string& name) -> Variable* {
+    const std::size_t base{_frames.empty() ? 1 : frame().scopeBase};
+    for (std::size_t s{_scopes.size()}; s > base; --s) {
+      const auto found{_scopes.at(s - 1).find(name)};
+      if (found != _scopes.at(s - 1).end()) {
+        return &found->second;
+      }
+    }
+    const auto found{_scopes.front().find(name)};
+    return found == _scopes.front().end() ? nullptr : &found->second;
+  }
+
+  auto declare(
+    const std::string& name, Variable variable, GLSLLocation location
+  ) -> void {
+    if (!_scopes.back().emplace(name, std::move(variable)).second) {
+      throw CompileError{location, "redefinition of \"" + name + '"'};
+    }
+  }
+
+  auto declareLocal(
+    const GLSLDeclaration& declaration, GLSLLocation location
+  ) -> void {
+    const Type type{resolveType(declaration.typeName, location)};
+    Value value{
+      declaration.initializer
+        ? convert(evaluate(*declaration.initializer), type, location)
+        : zero(type)
+    };
+    Variable variable{};
+    if (
+      !declaration.isConst
+      && assigns(*_blocks.back(), declaration.name, _functionTable)
+    ) {
+      variable.value = makeHome(value);
+      variable.isHome = true;
+    } else {
+      variable.value = snapshot(value);
+      variable.isReadOnly = declaration.isConst;
+    }
+    declare(declaration.name, std::move(variable), location);
+  }
+
+  // Unit and functions.
+
+  auto compileUnit() -> void {
+    for (const GLSLFunction& function : _unit.functions) {
+      _functionTable.emplace(function.name, &function);
+    }
+    for (const GLSLStruct& structure : _unit.structs) {
+      StructType type{structure.name, {}, 0};
+      for (const auto& [typeName, name] : structure.fields) {
+        const Type field{resolveType(typeName, {})};
+        type.fields.emplace_back(name, field);
+        type.componentCount += field.componentCount();
+      }
+      _structStorage.push_back(std::move(type));
+      _structs.emplace(structure.name, &_structStorage.back());
+    }
+
+    const GLSLFunction* main{};
+    for (const GLSLFunction& function : _unit.functions) {
+      if (function.name == "main" && function.body) {
+        main = &function;
+      }
+    }
+    if (!main || !main->parameters.empty()) {
+      throw CompileError{{}, "no main function"};
+    }
+
+    _scopes.emplace_back();
+    _frames.push_back({
+      main, 1, constant(1.f), {Type::Base::Void, 1, nullptr}, {}, {}, {}, {},
+      constant(0.f), false
+    });
+    const Type vec4{Type::Base::Float, 4, nullptr};
+    declare("gl_FragCoord", {
+      {vec4, {input(SoftwareInput::FragCoordX),
+        input(SoftwareInput::FragCoordY), constant(.5f), constant(1.f)}},
+      false, false, true
+    }, {});
+    std::string output{"gl_FragColor"};
+    for (const GLSLGlobal& global : _unit.globals) {
+      if (global.storage == GLSLGlobal::Storage::Out) {
+        output = global.declaration.name;
+      }
+    }
+    for (const GLSLGlobal& global : _unit.globals) {
+      declareGlobal(global);
+    }
+    if (!lookup(output)) {
+      declare(output, {makeHome(zero(vec4)), true, false, false}, {});
+    }
+
+    _scopes.emplace_back();
+    prepareReturns(*main->body);
+    _blocks.push_back(main->body.get());
+    compileStatement(*main->body);
+
+    const Value& result{lookup(output)->value};
+    if (result.type != vec4) {
+      throw CompileError{
+        {}, "the output " + output + " must be vec4, not "
+          + describe(result.type)
+      };
+    }
+    for (std::size_t c{0}; c < 4; ++c) {
+      _outputs[c] = toRegister(result.components.at(c));
+    }
+  }
+
+  auto declareGlobal(const GLSLGlobal& global) -> void {
+    const GLSLDeclaration& declaration{global.declaration};
+    const GLSLLocation location{global.location};
+    if (global.storage == GLSLGlobal::Storage::Uniform) {
+      declareUniform(global);
+      return;
+    }
+    if (global.storage == GLSLGlobal::Storage::In) {
+      warn(location, "input \"" + declaration.name + "\" reads as 0");
+      const Type type{resolveType(declaration.typeName, location)};
+      declare(declaration.name, {zero(type), false, false, true}, location);
+      return;
+    }
+    const Type type{resolveType(declaration.typeName, location)};
+    Value value{
+      declaration.initializer
+        ? convert(evaluate(*declaration.initializer), type, location)
+        : zero(type)
+    };
+    bool isAssigned{global.storage == GLSLGlobal::Storage::Out};
+    for (const GLSLFunction& function : _unit.functions) {
+      isAssigned = isAssigned || (!declaration.isConst && function.body
+        && assigns(*function.body, declaration.name, _functionTable));
+    }
+    if (isAssigned) {
+      declare(
+        declaration.name, {makeHome(value), true, false, false}, location
+      );
+    } else {
+      declare(
+        declaration.name, {snapshot(value), false, false, true}, location
+      );
+    }
+  }
+
+  auto memberValue(
+    const std::string& name, const std::string& typeName,
+    GLSLLocation location
+  ) -> std::optional<Value> {
+    if (typeName.compare(0, 7, "sampler") == 0) {
+      // Only texture lookups would read it, and those fail to compile.
+      return {};
+    }
+    const Type type{resolveType(typeName, location)};
+    const InputMember* member{findInputMember(name)};
+    if (
+      !member || type.base == Type::Base::Struct || type.base == Type::Base::Bool
+      || type.size != member->inputs.size()
+    ) {
+      warn(location, "uniform \"" + name + "\" reads as 0");
+      return zero(type);
+    }
+    Value value{type, {}};
+    for (const SoftwareInput which : member->inputs) {
+      value.components.push_back(input(which));
+    }
+    return value;
+  }
+
+  auto declareUniform(const GLSLGlobal& global) -> void {
+    const GLSLDeclaration& declaration{global.declaration};
+    const GLSLLocation location{global.location};
+    if (global.blockMembers.empty()) {
+      if (
+        const std::optional<Value> value{
+          memberValue(declaration.name, declaration.typeName, location)
+        }
+      ) {
+        declare(declaration.name, {*value, false, false, true}, location);
+      }
+      return;
+    }
+    StructType block{declaration.typeName, {}, 0};
+    Value members{};
+    for (const auto& [typeName, name] : global.blockMembers) {
+      const std::optional<Value> value{memberValue(name, typeName, location)};
+      if (!value) {
+        continue;
+      }
+      if (declaration.name.empty()) {
+        declare(name, {*value, false, false, true}, location);
+      }
+      block.fields.emplace_back(name, value->type);
+      block.componentCount += value->components.size();
+      members.components.insert(
+        members.components.end(), value->components.begin(),
+        value->components.end()
+      );
+    }
+    if (!declaration.name.empty()) {
+      _structStorage.push_back(std::move(block));
+      members.type = {Type::Base::Struct, 1, &_structStorage.back()};
+      declare(declaration.name, {members, false, false, true}, location);
+    }
+  }
+
+  auto findFunction(
+    const std::string& name, const std::vector<Value>& arguments,
+    GLSLLocation location
+  ) -> const GLSLFunction* {
+    const auto range{_functionTable.equal_range(name)};
+    const GLSLFunction* converted{};
+    const GLSLFunction* prototype{};
+    for (auto f{range.first}; f != range.second; ++f) {
+      const GLSLFunction& function{*f->second};
+      if (function.parameters.size() != arguments.size()) {
+        continue;
+      }
+      bool exact{true};
+      bool convertible{true};
+      for (std::size_t a{0}; a < arguments.size(); ++a) {
+        const Type parameter{
+          resolveType(function.parameters.at(a).typeName, function.location)
+        };
+        const Type& argument{arguments.at(a).type};
+        exact = exact && parameter == argument;
+        convertible = convertible && (parameter == argument
+          || (argument.base == Type::Base::Int
+            && parameter.base == Type::Base::Float
+            && argument.size == parameter.size));
+      }
+      if (!function.body) {
+        prototype = convertible ? &function : prototype;
+      } else if (exact) {
+        return &function;
+      } else if (convertible && !converted) {
+        converted = &function;
+      }
+    }
+    if (!converted && prototype) {
+      throw CompileError{
+        location, "function \"" + name + "\" is declared but not defined"
+      };
+    }
+    return converted;
+  }
+
+  // Returns from within branches or loops need homes for the result and
+  // for the lanes that have returned.
+  auto prepareReturns(const GLSLStatement& body) -> void {
+    if (containsNestedReturn(body)) {
+      const Type& returnType{frame().returnType};
+      if (returnType.base != Type::Base::Void) {
+        frame().result = makeHome(zero(returnType));
+      }
+      frame().returned = makeHome(zero({Type::Base::Bool, 1, nullptr}))
+        .components.at(0);
+    }
+    invalidate();
+  }
+
+  auto callFunction(
+    const GLSLFunction& function, const std::vector<Value>& arguments,
+    const GLSLExpression& call
+  ) -> Value {
+    for (const Frame& caller : _frames) {
+      if (caller.function == &function) {
+        throw CompileError{
+          call.location, "recursive call to \"" + function.name + '"'
+        };
+      }
+    }
+    const GLSLStatement& body{*function.body};
+    const Operand entry{active()};
+    _frames.push_back({
+      &function, _scopes.size(), entry,
+      resolveType(function.returnType, function.location), {}, {}, {}, {},
+      constant(0.f), false
+    });
+    _scopes.emplace_back();
+    for (std::size_t p{0}; p < function.parameters.size(); ++p) {
+      const GLSLParameter& parameter{function.parameters.at(p)};
+      const Type type{resolveType(parameter.typeName, function.location)};
+      Variable variable{};
+      if (parameter.direction == GLSLParameter::Direction::Out) {
+        variable.value = makeHome(zero(type));
+        variable.isHome = true;
+      } else {
+        const Value value{convert(arguments.at(p), type, call.location)};
+        if (
+          parameter.direction == GLSLParameter::Direction::InOut
+          || assigns(body, parameter.name, _functionTable)
+        ) {
+          variable.value = makeHome(value);
+          variable.isHome = true;
+        } else {
+          variable.value = snapshot(value);
+        }
+      }
+      if (!parameter.name.empty()) {
+        declare(parameter.name, std::move(variable), function.location);
+      }
+    }
+    prepareReturns(body);
+
+    _blocks.push_back(&body);
+    compileStatement(body);
+    _blocks.pop_back();
+
+    Value result{};
+    if (frame().result) {
+      result = *frame().result;
+    } else if (frame().boundResult) {
+      result = *frame().boundResult;
+    } else if (frame().returnType.base != Type::Base::Void) {
+      throw CompileError{
+        function.location, "\"" + function.name + "\" must return a value"
+      };
+    } else {
+      result.type = frame().returnType;
+    }
+    std::vector<Value> outputs{};
+    for (const GLSLParameter& parameter : function.parameters) {
+      if (
+        parameter.direction != GLSLParameter::Direction::In
+        && !parameter.name.empty()
+      ) {
+        outputs.push_back(_scopes.back().at(parameter.name).value);
+      } else {
+        outputs.emplace_back();
+      }
+    }
+    _scopes.pop_back();
+    _frames.pop_back();
+    invalidate();
+
+    for (std::size_t p{0}; p < function.parameters.size(); ++p) {
+      const GLSLParameter& parameter{function.parameters.at(p)};
+      if (parameter.direction == GLSLParameter::Direction::In) {
+        continue;
+      }
+      const GLSLExpression& argument{*call.operands.at(p)};
+      LValue target{resolveLValue(argument)};
+      if (parameter.name.empty()) {
+        store(target, zero(target.type), argument.location);
+      } else {
+        store(
+          target, convert(outputs.at(p), target.type, argument.location),
+          argument.location
+        );
+      }
+    }
+    return result;
+  }
+
+  // Statements.
+
+  auto compileStatement(const GLSLStatement& statement) -> void {
+    if (isDead()) {
+      return;
+    }
+    switch (statement.kind) {
+    case GLSLStatement::Kind::Block:
+      _scopes.emplace_back();
+      _blocks.push_back(&statement);
+      for (const auto& child : statement.statements) {
+        compileStatement(*child);
+      }
+      _blocks.pop_back();
+      _scopes.pop_back();
+      break;
+    case GLSLStatement::Kind::Expression:
+      evaluate(*statement.expression);
+      break;
+    case GLSLStatement::Kind::Declaration:
+      for (const GLSLDeclaration& declaration : statement.declarations) {
+        declareLocal(declaration, statement.location);
+      }
+      break;
+    case GLSLStatement::Kind::If:
+      compileIf(statement);
+      break;
+    case GLSLStatement::Kind::For:
+      compileFor(statement);
+      break;
+    case GLSLStatement::Kind::While:
+    case GLSLStatement::Kind::DoWhile:
+      throw CompileError{
+        statement.location, "while loops are not supported by the software"
+          " renderer; use a for loop with constant bounds"
+      };
+    case GLSLStatement::Kind::Return:
+      compileReturn(statement);
+      break;
+    case GLSLStatement::Kind::Break:
+    case GLSLStatement::Kind::Continue:
+      compileJump(statement);
+      break;
+    case GLSLStatement::Kind::Discard:
+      throw CompileError{
+        statement.location, "discard is not supported by the software"
+          " renderer"
+      };
+    case GLSLStatement::Kind::Empty:
+      break;
+    }
+  }
+
+  // Compiles a branch or loop iteration, skipped when no lane is active.
+  auto compileMasked(const GLSLStatement& statement) -> void {
+    const Operand mask{active()};
+    if (mask.isConstant) {
+      if (mask.value != 0.f) {
+        compileNested(statement);
+      }
+      return;
+    }
+    const std::size_t jump{emitJump(mask)};
+    compileNested(statement);
+    patchJump(jump);
+  }
+
+  // A statement with a scope of its own, even when it is not a block.
+  auto compileNested(const GLSLStatement& statement) -> void {
+    _scopes.emplace_back();
+    compileStatement(statement);
+    _scopes.pop_back();
+  }
+
+  auto compileIf(const GLSLStatement& statement) -> void {
+    Operand test{condition(*statement.expression)};
+    if (test.isConstant) {
+      if (test.value != 0.f) {
+        compileNested(*statement.statements.at(0));
+      } else if (statement.statements.size() > 1) {
+        compileNested(*statement.statements.at(1));
+      }
+      return;
+    }
+    test = snapshot({{Type::Base::Bool, 1, nullptr}, {test}}).components[0];
+    frame().conditions.push_back(test);
+    invalidate();
+    compileMasked(*statement.statements.at(0));
+    frame().conditions.pop_back();
+    if (statement.statements.size() > 1) {
+      frame().conditions.push_back(notMask(test));
+      invalidate();
+      compileMasked(*statement.statements.at(1));
+      frame().conditions.pop_back();
+    }
+    invalidate();
+  }
+
+  auto compileFor(const GLSLStatement& statement) -> void {
+    _scopes.emplace_back();
+    _blocks.push_back(&statement);
+    const GLSLStatement& initializer{*statement.statements.at(0)};
+    if (initializer.kind == GLSLStatement::Kind::Declaration) {
+      for (const GLSLDeclaration& declaration : initializer.declarations) {
+        const Type type{resolveType(declaration.typeName, initializer.location)};
+        const Value value{
+          declaration.initializer
+            ? convert(evaluate(*declaration.initializer), type,
+              initializer.location)
+            : zero(type)
+        };
+        for (const Operand component : value.components) {
+          if (!component.isConstant) {
+            throw CompileError{
+              initializer.location, "loop indices must start at a constant"
+            };
+          }
+        }
+        declare(declaration.name, {value, false, true, false}, initializer.location);
+      }
+    } else {
+      compileStatement(initializer);
+    }
+    if (!statement.expression) {
+      throw CompileError{statement.location, "loops need a condition"};
+    }
+    const GLSLStatement& body{*statement.statements.at(1)};
+    const auto flag{[this, &body](GLSLStatement::Kind kind) {
+      return contains(body, kind)
+        ? makeHome(zero({Type::Base::Bool, 1, nullptr})).components.at(0)
+        : constant(0.f);
+    }};
+    frame().loops.push_back({
+      frame().conditions.size(), flag(GLSLStatement::Kind::Break),
+      flag(GLSLStatement::Kind::Continue), false, false
+    });
+    invalidate();
+
+    std::vector<std::size_t> exits{};
+    for (std::size_t iteration{0};; ++iteration) {
+      const Operand test{condition(*statement.expression)};
+      if (!test.isConstant) {
+        throw CompileError{
+          statement.expression->location, "loop conditions must be constant"
+            " once unrolled (compare the index with a constant)"
+        };
+      }
+      if (test.value == 0.f) {
+        break;
+      }
+      if (iteration == maxIterations) {
+        throw CompileError{statement.location, "too many loop iterations"};
+      }
+      const Operand mask{active()};
+      if (mask.isConstant && mask.value == 0.f) {
+        break;
+      }
+      if (!mask.isConstant) {
+        exits.push_back(emitJump(mask));
+      }
+      compileNested(body);
+      if (frame().loops.back().brokeAll) {
+        break;
+      }
+      Loop& loop{frame().loops.back()};
+      loop.continuedAll = false;
+      if (!loop.continued.isConstant) {
+        emitInto(loop.continued.reg, SoftwareOpcode::Move, constant(0.f));
+      }
+      invalidate();
+      if (statement.step) {
+        _stepping = true;
+        evaluate(*statement.step);
+        _stepping = false;
+      }
+    }
+    for (const std::size_t exit : exits) {
+      patchJump(exit);
+    }
+    frame().loops.pop_back();
+    invalidate();
+    _blocks.pop_back();
+    _scopes.pop_back();
+  }
+
+  auto compileReturn(const GLSLStatement& statement) -> void {
+    Value value{};
+    value.type = frame().returnType;
+    if (statement.expression) {
+      value = convert(
+        evaluate(*statement.expression), frame().returnType,
+        statement.location
+      );
+    } else if (frame().returnType.base != Type::Base::Void) {
+      throw CompileError{statement.location, "missing return value"};
+    }
+    Frame& current{frame()};
+    if (current.result) {
+      for (std::size_t c{0}; c < value.components.size(); ++c) {
+        write(current.result->components.at(c).reg, value.components.at(c));
+      }
+    } else {
+      current.boundResult = snapshot(value);
+    }
+    bool unconditional{current.conditions.empty()};
+    for (const Loop& loop : current.loops) {
+      unconditional = unconditional && loop.broken.isConstant
+        && loop.continued.isConstant;
+    }
+    if (unconditional) {
+      current.returnedAll = true;
+    } else {
+      const Operand mask{active()};
+      emitInto(
+        current.returned.reg, SoftwareOpcode::Maximum, current.returned, mask
+      );
+    }
+    invalidate();
+  }
+
+  auto compileJump(const GLSLStatement& statement) -> void {
+    const bool isBreak{statement.kind == GLSLStatement::Kind::Break};
+    if (frame().loops.empty()) {
+      throw CompileError{
+        statement.location, std::string{isBreak ? "break" : "continue"}
+          + " outside of a loop"
+      };
+    }
+    const Operand mask{active()};
+    Loop& loop{frame().loops.back()};
+    const bool unconditional{
+      frame().conditions.size() == loop.conditionDepth
+      && (!isBreak || loop.continued.isConstant)
+    };
+    if (unconditional) {
+      (isBreak ? loop.brokeAll : loop.continuedAll) = true;
+    } else {
+      const Operand flag{isBreak ? loop.broken : loop.continued};
+      emitInto(flag.reg, SoftwareOpcode::Maximum, flag, mask);
+    }
+    invalidate();
+  }
+
+  // Assignment.
+
+  auto resolveLValue(const GLSLExpression& expression) -> LValue {
+    switch (expression.kind) {
+    case GLSLExpression::Kind::Identifier: {
+      Variable* variable{lookup(expression.text)};
+      if (!variable) {
+        throw CompileError{
+          expression.location, "undeclared identifier \"" + expression.text
+            + '"'
+        };
+      }
+      if (variable->isReadOnly) {
+        throw CompileError{
+          expression.location, "\"" + expression.text + "\" is read-only"
+        };
+      }
+      LValue target{variable, {}, variable->value.type};
+      for (std::size_t c{0}; c < variable->value.components.size(); ++c) {
+        target.components.push_back(c);
+      }
+      return target;
+    }
+    case GLSLExpression::Kind::Member: {
+      LValue base{resolveLValue(*expression.operands.at(0))};
+      if (base.type.base == Type::Base::Struct) {
+        std::size_t offset{};
+        for (const auto& [name, type] : base.type.structure->fields) {
+          if (name == expression.text) {
+            base.components = std::vector<std::size_t>(
+              base.components.begin() + static_cast<std::ptrdiff_t>(offset),
+              base.components.begin()
+                + static_cast<std::ptrdiff_t>(offset + type.componentCount())
+            );
+            base.type = type;
+            return base;
+          }
+          offset += type.componentCount();
+        }
+        throw CompileError{
+          expression.location, "no field \"" + expression.text + "\" in "
+            + describe(base.type)
+        };
+      }
+      const std::vector<std::size_t> indices{
+        swizzle(base.type, expression.text, expression.location)
+      };
+      LValue target{base.variable, {}, {base.type.base, indices.size(), nullptr}};
+      for (const std::size_t index : indices) {
+        if (
+          std::count(indices.begin(), indices.end(), index) > 1
+        ) {
+          throw CompileError{
+            expression.location, "repeated components in an assignment"
+          };
+        }
+        target.components.push_back(base.components.at(index));
+      }
+      return target;
+    }
+    case GLSLExpression::Kind::Index: {
+      LValue base{resolveLValue(*expression.operands.at(0))};
+      const std::size_t index{constantInt(*expression.operands.at(1))};
+      if (
+        base.type.base == Type::Base::Struct || base.type.size == 1
+        || index >= base.type.size
+      ) {
+        throw CompileError{expression.location, "invalid index"};
+      }
+      return {base.variable, {base.components.at(index)},
+        {base.type.base, 1, nullptr}};
+    }
+    default:
+      throw CompileError{expression.location, "invalid assignment target"};
+    }
+  }
+
+  auto store(LValue& target, const Value& value, GLSLLocation location)
+    -> void {
+    Variable& variable{*target.variable};
+    if (variable.isHome) {
+      for (std::size_t c{0}; c < target.components.size(); ++c) {
+        write(
+          variable.value.components.at(target.components.at(c)).reg,
+          value.components.at(c)
+        );
+      }
+      return;
+    }
+    if (!variable.isLoopIndex || !_stepping) {
+      throw CompileError{
+        location, variable.isLoopIndex
+          ? "loop indices may only change in the loop step"
+          : "cannot assign to this variable"
+      };
+    }
+    for (std::size_t c{0}; c < target.components.size(); ++c) {
+      if (!value.components.at(c).isConstant) {
+        throw CompileError{location, "loop steps must be constant"};
+      }
+      variable.value.components.at(target.components.at(c))
+        = value.components.at(c);
+    }
+  }
+
+  // Expressions.
+
+  auto swizzle(
+    const Type& type, const std::string& letters, GLSLLocation location
+  ) -> std::vector<std::size_t> {
+    if (type.base == Type::Base::Struct || type.base == Type::Base::Void) {
+      throw CompileError{
+        location, "no member \"" + letters + "\" in " + describe(type)
+      };
+    }
+    std::vector<std::size_t> indices{};
+    for (const char letter : letters) {
+      const std::size_t index{swizzleIndex(letter)};
+      if (index >= type.size || letters.size() > 4) {
+        throw CompileError{
+          location, "invalid swizzle \"" + letters + "\" of " + describe(type)
+        };
+      }
+      indices.push_back(index);
+    }
+    return indices;
+  }
+
+  auto evaluate(const GLSLExpression& expression) -> Value {
+    const GLSLLocation location{expression.location};
+    switch (expression.kind) {
+    case GLSLExpression::Kind::Number:
+      return {
+        {expression.isFloat ? Type::Base::Float : Type::Base::Int, 1, nullptr},
+        {constant(static_cast<float>(expression.number))}
+      };
+    case GLSLExpression::Kind::Boolean:
+      return {
+        {Type::Base::Bool, 1, nullptr},
+        {constant(static_cast<float>(expression.number))}
+      };
+    case GLSLExpression::Kind::Identifier: {
+      const Variable* variable{lookup(expression.text)};
+      if (!variable) {
+        throw CompileError{
+          location, "undeclared identifier \"" + expression.text + '"'
+        };
+      }
+      return variable->value;
+    }
+    case GLSLExpression::Kind::Unary:
+      return evaluateUnary(expression);
+    case GLSLExpression::Kind::Binary:
+      return evaluateBinary(expression);
+    case GLSLExpression::Kind::Assign:
+      return evaluateAssign(expression);
+    case GLSLExpression::Kind::Ternary:
+      return evaluateTernary(expression);
+    case GLSLExpression::Kind::Call:
+      return evaluateCall(expression);
+    case GLSLExpression::Kind::Member: {
+      const Value base{evaluate(*expression.operands.at(0))};
+      if (base.type.base == Type::Base::Struct) {
+        std::size_t offset{};
+        for (const auto& [name, type] : base.type.structure->fields) {
+          if (name == expression.text) {
+            const auto first{
+              base.components.begin() + static_cast<std::ptrdiff_t>(offset)
+            };
+            return {type, {first,
+              first + static_cast<std::ptrdiff_t>(type.componentCount())}};
+          }
+          offset += type.componentCount();
+        }
+        throw CompileError{
+          location, "no field \"" + expression.text + "\" in "
+            + describe(base.type)
+        };
+      }
+      const std::vector<std::size_t> indices{
+        swizzle(base.type, expression.text, location)
+      };
+      Value result{{base.type.base, indices.size(), nullptr}, {}};
+      for (const std::size_t index : indices) {
+        result.components.push_back(base.components.at(index));
+      }
+      return result;
+    }
+    case GLSLExpression::Kind::Index: {
+      const Value base{evaluate(*expression.operands.at(0))};
+      const std::size_t index{constantInt(*expression.operands.at(1))};
+      if (
+        base.type.base == Type::Base::Struct || base.type.size == 1
+        || index >= base.type.size
+      ) {
+        throw CompileError{location, "invalid index"};
+      }
+      return {{base.type.base, 1, nullptr}, {base.components.at(index)}};
+    }
+    case GLSLExpression::Kind::PreIncrement:
+    case GLSLExpression::Kind::PostIncrement: {
+      const GLSLExpression& operand{*expression.operands.at(0)};
+      const Value old{snapshot(evaluate(operand))};
+      if (!old.type.isNumeric()) {
+        throw CompileError{location, "cannot increment " + describe(old.type)};
+      }
+      const Value one{{old.type.base, 1, nullptr}, {constant(1.f)}};
+      const Value updated{
+        arithmetic(expression.text == "++" ? '+' : '-', old, one, location)
+      };
+      LValue target{resolveLValue(operand)};
+      store(target, updated, location);
+      return expression.kind == GLSLExpression::Kind::PreIncrement
+        ? updated : old;
+    }
+    }
+    throw CompileError{location, "unsupported expression"};
+  }
+
+  auto evaluateUnary(const GLSLExpression& expression) -> Value {
+    Value value{evaluate(*expression.operands.at(0))};
+    const std::string& symbol{expression.text};
+    if (symbol == "!") {
+      if (value.type.base != Type::Base::Bool || value.type.size != 1) {
+        throw CompileError{
+          expression.location, "! needs a bool, not " + describe(value.type)
+        };
+      }
+      value.components.at(0) = notMask(value.components.at(0));
+      return value;
+    }
+    if (symbol == "~" || !value.type.isNumeric()) {
+      throw CompileError{
+        expression.location, "invalid operand for " + symbol
+      };
+    }
+    if (symbol == "-") {
+      for (Operand& component : value.components) {
+        component = emit(SoftwareOpcode::Subtract, constant(0.f), component);
+      }
+    }
+    return value;
+  }
+
+  auto arithmetic(
+    char symbol, const Value& left, const Value& right, GLSLLocation location
+  ) -> Value {
+    if (!left.type.isNumeric() || !right.type.isNumeric()) {
+      throw CompileError{
+        location, std::string{"invalid operands for "} + symbol + ": "
+          + describe(left.type) + " and " + describe(right.type)
+      };
+    }
+    const Type::Base base{
+      left.type.base == Type::Base::Int && right.type.base == Type::Base::Int
+        ? Type::Base::Int : Type::Base::Float
+    };
+    const std::size_t size{std::max(left.type.size, right.type.size)};
+    if (
+      (left.type.size != size && left.type.size != 1)
+      || (right.type.size != size && right.type.size != 1)
+    ) {
+      throw CompileError{
+        location, "mismatched sizes: " + describe(left.type) + " and "
+          + describe(right.type)
+      };
+    }
+    if (symbol == '%' && base != Type::Base::Int) {
+      throw CompileError{location, "% needs integers; use mod()"};
+    }
+    Value result{{base, size, nullptr}, {}};
+    for (std::size_t c{0}; c < size; ++c) {
+      const Operand a{left.components.at(left.type.size == 1 ? 0 : c)};
+      const Operand b{right.components.at(right.type.size == 1 ? 0 : c)};
+      Operand value{};
+      switch (symbol) {
+      case '+':
+        value = emit(SoftwareOpcode::Add, a, b);
+        break;
+      case '-':
+        value = emit(SoftwareOpcode::Subtract, a, b);
+        break;
+      case '*':
+        value = emit(SoftwareOpcode::Multiply, a, b);
+        break;
+      case '/':
+        value = emit(SoftwareOpcode::Divide, a, b);
+        if (base == Type::Base::Int) {
+          value = emit(SoftwareOpcode::Truncate, value);
+        }
+        break;
+      default: {
+        const Operand quotient{
+          emit(SoftwareOpcode::Truncate, emit(SoftwareOpcode::Divide, a, b))
+        };
+        value = emit(
+          SoftwareOpcode::Subtract, a,
+          emit(SoftwareOpcode::Multiply, b, quotient)
+        );
+      }
+      }
+      result.components.push_back(value);
+    }
+    return result;
+  }
+
+  auto evaluateBinary(const GLSLExpression& expression) -> Value {
+    const std::string& symbol{expression.text};
+    const GLSLLocation location{expression.location};
+    const Type boolean{Type::Base::Bool, 1, nullptr};
+    if (symbol == "&&" || symbol == "||" || symbol == "^^") {
+      const Operand left{condition(*expression.operands.at(0))};
+      // Short-circuit what is known at compile time.
+      if (left.isConstant && symbol != "^^"
+        && (left.value != 0.f) == (symbol == "||")) {
+        return {boolean, {left}};
+      }
+      const Operand right{condition(*expression.operands.at(1))};
+      if (symbol == "&&") {
+        return {boolean, {andMask(left, right)}};
+      }
+      if (symbol == "||") {
+        return {boolean, {orMask(left, right)}};
+      }
+      return {boolean, {emit(SoftwareOpcode::NotEqual, left, right)}};
+    }
+    const Value left{evaluate(*expression.operands.at(0))};
+    const Value right{evaluate(*expression.operands.at(1))};
+    if (
+      symbol == "+" || symbol == "-" || symbol == "*" || symbol == "/"
+      || symbol == "%"
+    ) {
+      return arithmetic(symbol.at(0), left, right, location);
+    }
+    if (symbol == "==" || symbol == "!=") {
+      const bool sameType{
+        left.type == right.type
+        || (left.type.isNumeric() && right.type.isNumeric()
+          && left.type.size == right.type.size)
+      };
+      if (!sameType) {
+        throw CompileError{
+          location, "cannot compare " + describe(left.type) + " with "
+            + describe(right.type)
+        };
+      }
+      Operand equal{constant(1.f)};
+      for (std::size_t c{0}; c < left.components.size(); ++c) {
+        equal = andMask(equal, emit(
+          SoftwareOpcode::Equal, left.components.at(c),
+          right.components.at(c)
+        ));
+      }
+      return {boolean, {symbol == "==" ? equal : notMask(equal)}};
+    }
+    if (symbol == "<" || symbol == ">" || symbol == "<=" || symbol == ">=") {
+      if (
+        !left.type.isNumeric() || !right.type.isNumeric()
+        || left.type.size != 1 || right.type.size != 1
+      ) {
+        throw CompileError{
+          location, symbol + " needs scalars; use lessThan() and friends for"
+            " vectors"
+        };
+      }
+      Operand a{left.components.at(0)};
+      Operand b{right.components.at(0)};
+      if (symbol.at(0) == '>') {
+        std::swap(a, b);
+      }
+      return {boolean, {emit(
+        symbol.size() == 1 ? SoftwareOpcode::Less : SoftwareOpcode::LessEqual,
+        a, b
+      )}};
+    }
+    throw CompileError{
+      location, "the " + symbol + " operator is not supported by the software"
+        " renderer"
+    };
+  }
+
+  auto evaluateAssign(const GLSLExpression& expression) -> Value {
+    const GLSLExpression& targetExpression{*expression.operands.at(0)};
+    Value value{evaluate(*expression.operands.at(1))};
+    if (expression.text != "=") {
+      value = arithmetic(
+        expression.text.at(0), evaluate(targetExpression), value,
+        expression.location
+      );
+    }
+    LValue target{resolveLValue(targetExpression)};
+    value = convert(value, target.type, expression.location);
+    store(target, value, expression.location);
+    return value;
+  }
+
+  auto evaluateTernary(const GLSLExpression& expression) -> Value {
+    const Operand test{condition(*expression.operands.at(0))};
+    if (test.isConstant) {
+      return evaluate(*expression.operands.at(test.value != 0.f ? 1 : 2));
+    }
+    const Value a{evaluate(*expression.operands.at(1))};
+    Value b{evaluate(*expression.operands.at(2))};
+    b = convert(b, a.type, expression.location);
+    Value result{a.type, {}};
+    for (std::size_t c{0}; c < a.components.size(); ++c) {
+      result.components.push_back(emit(
+        SoftwareOpcode::Select, test, a.components.at(c),
+        b.components.at(c)
+      ));
+    }
+    return result;
+  }
+
+  auto evaluateCall(const GLSLExpression& expression) -> Value {
+    const std::string& name{expression.text};
+    const GLSLLocation location{expression.location};
+    static const std::set<std::string> unsupported{
+      "texture", "texture2D", "textureLod", "texelFetch", "textureSize",
+      "dFdx", "dFdy", "fwidth"
+    };
+    if (unsupported.count(name) > 0) {
+      throw CompileError{
+        location, name + "() is not supported by the software renderer"
+      };
+    }
+    std::vector<Value> arguments{};
+    for (const auto& operand : expression.operands) {
+      arguments.push_back(evaluate(*operand));
+    }
+    if (isTypeName(name)) {
+      return construct(resolveType(name, location), arguments, location);
+    }
+    if (
+      const GLSLFunction* function{findFunction(name, arguments, location)}
+    ) {
+      return callFunction(*function, arguments, expression);
+    }
+    if (std::optional<Value> result{builtin(name, arguments, location)}) {
+      return *result;
+    }
+    if (_functionTable.count(name) > 0) {
+      throw CompileError{
+        location, "no matching overload of \"" + name + '"'
+      };
+    }
+    throw CompileError{location, "no function named \"" + name + '"'};
+  }
+
+  auto construct(
+    const Type& type, const std::vector<Value>& arguments,
+    GLSLLocation location
+  ) -> Value {
+    Value result{type, {}};
+    if (type.base == Type::Base::Struct) {
+      const auto& fields{type.structure->fields};
+      if (arguments.size() != fields.size()) {
+        throw CompileError{
+          location, "wrong number of fields for " + describe(type)
+        };
+      }
+      for (std::size_t f{0}; f < fields.size(); ++f) {
+        const Value field{
+          convert(arguments.at(f), fields.at(f).second, location)
+        };
+        result.components.insert(
+          result.components.end(), field.components.begin(),
+          field.components.end()
+        );
+      }
+      return result;
+    }
+    for (const Value& argument : arguments) {
+      if (argument.type.base == Type::Base::Struct) {
+        throw CompileError{
+          location, "cannot construct " + describe(type) + " from "
+            + describe(argument.type)
+        };
+      }
+      for (const Operand component : argument.components) {
+        if (result.components.size() < type.size) {
+          result.components.push_back(
+            cast(component, argument.type.base, type.base)
+          );
+        }
+      }
+    }
+    if (
+      arguments.size() == 1 && arguments.at(0).type.size == 1
+      && !result.components.empty()
+    ) {
+      result.components.resize(type.size, result.components.at(0));
+    }
+    if (result.components.size() < type.size) {
+      throw CompileError{
+        location, "not enough components to construct " + describe(type)
+      };
+    }
+    return result;
+  }
+
+  using ComponentFunction = std::function<Operand(const Operand*)>;
+
+  // Applies a function per component, repeating scalar arguments.
+  auto componentwise(
+    const std::vector<Value>& arguments, bool keepsInt,
+    GLSLLocation location, const ComponentFunction& function
+  ) -> Value {
+    std::size_t size{1};
+    bool allInt{true};
+    for (const Value& argument : arguments) {
+      if (!argument.type.isNumeric()) {
+        throw CompileError{
+          location, "invalid argument of type " + describe(argument.type)
+        };
+      }
+      size = std::max(size, argument.type.size);
+      allInt = allInt && argument.type.base == Type::Base::Int;
+    }
+    Value result{
+      {keepsInt && allInt ? Type::Base::Int : Type::Base::Float, size,
+        nullptr}, {}
+    };
+    for (std::size_t c{0}; c < size; ++c) {
+      Operand operands[3]{};
+      for (std::size_t a{0}; a < arguments.size(); ++a) {
+        const Value& argument{arguments.at(a)};
+        if (argument.type.size != size && argument.type.size != 1) {
+          throw CompileError{location, "mismatched argument sizes"};
+        }
+        operands[a] = argument.components.at(argument.type.size == 1 ? 0 : c);
+      }
+      result.components.push_back(function(operands));
+    }
+    return result;
+  }
+
+  auto dot(const Value& a, const Value& b, GLSLLocation location) -> Operand {
+    if (
+      !a.type.isNumeric() || a.type.size != b.type.size
+      || !b.type.isNumeric()
+    ) {
+      throw CompileError{location, "mismatched vectors"};
+    }
+    Operand sum{constant(0.f)};
+    for (std::size_t c{0}; c < a.components.size(); ++c) {
+      sum = emit(SoftwareOpcode::Add, sum, emit(
+        SoftwareOpcode::Multiply, a.components.at(c), b.components.at(c)
+      ));
+    }
+    return sum;
+  }
+
+  auto builtin(
+    const std::string& name, const std::vector<Value>& arguments,
+    GLSLLocation location
+  ) -> std::optional<Value> {
+    using Op = SoftwareOpcode;
+    static const std::unordered_map<std::string, SoftwareOpcode> unary{
+      {"sin", Op::Sine}, {"cos", Op::Cosine}, {"tan", Op::Tangent},
+      {"asin", Op::ArcSine}, {"acos", Op::ArcCosine},
+      {"exp", Op::Exponential}, {"log", Op::Logarithm},
+      {"exp2", Op::Exponential2}, {"log2", Op::Logarithm2},
+      {"sqrt", Op::SquareRoot}, {"inversesqrt", Op::InverseSquareRoot},
+      {"floor", Op::Floor}, {"fract", Op::Fract}, {"trunc", Op::Truncate},
+      {"sinh", Op::SineHyperbolic}, {"cosh", Op::CosineHyperbolic},
+      {"tanh", Op::TangentHyperbolic}
+    };
+    static const std::unordered_map<std::string, SoftwareOpcode> binary{
+      {"pow", Op::Power}, {"mod", Op::Modulo}, {"step", Op::Step}
+    };
+    static const std::unordered_map<std::string, SoftwareOpcode> compare{
+      {"lessThan", Op::Less}, {"lessThanEqual", Op::LessEqual},
+      {"greaterThan", Op::Less}, {"greaterThanEqual", Op::LessEqual},
+      {"equal", Op::Equal}, {"notEqual", Op::NotEqual}
+    };
+    const std::size_t count{arguments.size()};
+    const auto expect{[&](std::size_t expected) {
+      if (count != expected) {
+        throw CompileError{
+          location, name + "() takes " + std::to_string(expected)
+            + " arguments"
+        };
+      }
+    }};
+
+    if (const auto found{unary.find(name)}; found != unary.end()) {
+      expect(1);
+      return componentwise(arguments, false, location,
+        [&](const Operand* x) { return emit(found->second, x[0]); });
+    }
+    if (const auto found{binary.find(name)}; found != binary.end()) {
+      expect(2);
+      return componentwise(arguments, false, location,
+        [&](const Operand* x) { return emit(found->second, x[0], x[1]); });
+    }
+    if (const auto found{compare.find(name)}; found != compare.end()) {
+      expect(2);
+      const bool swapped{name.compare(0, 7, "greater") == 0};
+      Value result{componentwise(arguments, false, location,
+        [&](const Operand* x) {
+          return swapped
+            ? emit(found->second, x[1], x[0])
+            : emit(found->second, x[0], x[1]);
+        })};
+      result.type.base = Type::Base::Bool;
+      return result;
+    }
+    if (name == "radians" || name == "degrees") {
+      expect(1);
+      const float factor{
+        name == "radians" ? 3.14159265358979f/180.f : 180.f/3.14159265358979f
+      };
+      return componentwise(arguments, false, location, [&](const Operand* x) {
+        return emit(Op::Multiply, x[0], constant(factor));
+      });
+    }
+    if (name == "ceil") {
+      expect(1);
+      return componentwise(arguments, false, location, [&](const Operand* x) {
+        return emit(Op::Subtract, constant(0.f), emit(Op::Floor,
+          emit(Op::Subtract, constant(0.f), x[0])));
+      });
+    }
+    if (name == "round" || name == "roundEven") {
+      expect(1);
+      return componentwise(arguments, false, location, [&](const Operand* x) {
+        return emit(Op::Floor, emit(Op::Add, x[0], constant(.5f)));
+      });
+    }
+    if (name == "abs") {
+      expect(1);
+      return componentwise(arguments, true, location, [&](const Operand* x) {
+        return emit(
+          Op::Maximum, x[0], emit(Op::Subtract, constant(0.f), x[0])
+        );
+      });
+    }
+    if (name == "sign") {
+      expect(1);
+      return componentwise(arguments, true, location,
+        [&](const Operand* x) { return emit(Op::Sign, x[0]); });
+    }
+    if (name == "atan") {
+      if (count == 1) {
+        return componentwise(arguments, false, location,
+          [&](const Operand* x) { return emit(Op::ArcTangent, x[0]); });
+      }
+      expect(2);
+      return componentwise(arguments, false, location, [&](const Operand* x) {
+        return emit(Op::ArcTangent2, x[0], x[1]);
+      });
+    }
+    if (name == "min" || name == "max") {
+      expect(2);
+      const Op opcode{name == "min" ? Op::Minimum : Op::Maximum};
+      return componentwise(arguments, true, location,
+        [&](const Operand* x) { return emit(opcode, x[0], x[1]); });
+    }
+    if (name == "clamp") {
+      expect(3);
+      return componentwise(arguments, true, location, [&](const Operand* x) {
+        return emit(Op::Minimum, emit(Op::Maximum, x[0], x[1]), x[2]);
+      });
+    }
+    if (name == "mix") {
+      expect(3);
+      if (arguments.at(2).type.base == Type::Base::Bool) {
+        Value selector{arguments.at(2)};
+        selector.type.base = Type::Base::Float;
+        return componentwise(
+          {arguments.at(0), arguments.at(1), selector}, false, location,
+          [&](const Operand* x) { return emit(Op::Select, x[2], x[1], x[0]); }
+        );
+      }
+      return componentwise(arguments, false, location, [&](const Operand* x) {
+        return emit(Op::Add, x[0], emit(Op::Multiply,
+          emit(Op::Subtract, x[1], x[0]), x[2]));
+      });
+    }
+    if (name == "smoothstep") {
+      expect(3);
+      return componentwise(arguments, false, location, [&](const Operand* x) {
+        const Operand t{emit(Op::Minimum, emit(Op::Maximum, emit(Op::Divide,
+          emit(Op::Subtract, x[2], x[0]), emit(Op::Subtract, x[1], x[0])),
+          constant(0.f)), constant(1.f))};
+        return emit(Op::Multiply, emit(Op::Multiply, t, t), emit(
+          Op::Subtract, constant(3.f), emit(Op::Multiply, constant(2.f), t)
+        ));
+      });
+    }
+    const Type scalar{Type::Base::Float, 1, nullptr};
+    if (name == "dot") {
+      expect(2);
+      return Value{
+        scalar, {dot(arguments.at(0), arguments.at(1), location)}
+      };
+    }
+    if (name == "length") {
+      expect(1);
+      return Value{scalar, {emit(
+        Op::SquareRoot, dot(arguments.at(0), arguments.at(0), location)
+      )}};
+    }
+    if (name == "distance") {
+      expect(2);
+      const Value difference{
+        arithmetic('-', arguments.at(0), arguments.at(1), location)
+      };
+      return Value{scalar, {emit(
+        Op::SquareRoot, dot(difference, difference, location)
+      )}};
+    }
+    if (name == "normalize") {
+      expect(1);
+      const Operand factor{emit(
+        Op::InverseSquareRoot, dot(arguments.at(0), arguments.at(0), location)
+      )};
+      return arithmetic(
+        '*', arguments.at(0), {scalar, {factor}}, location
+      );
+    }
+    if (name == "reflect") {
+      expect(2);
+      const Value& incident{arguments.at(0)};
+      const Value& normal{arguments.at(1)};
+      const Operand factor{emit(
+        Op::Multiply, constant(2.f), dot(normal, incident, location)
+      )};
+      return arithmetic('-', incident,
+        arithmetic('*', normal, {scalar, {factor}}, location), location);
+    }
+    if (name == "cross") {
+      expect(2);
+      const Value& a{arguments.at(0)};
+      const Value& b{arguments.at(1)};
+      if (a.type.size != 3 || b.type.size != 3) {
+        throw CompileError{location, "cross() needs vec3 arguments"};
+      }
+      Value result{{Type::Base::Float, 3, nullptr}, {}};
+      for (std::size_t c{0}; c < 3; ++c) {
+        const std::size_t i{(c + 1) % 3};
+        const std::size_t j{(c + 2) % 3};
+        result.components.push_back(emit(Op::Subtract,
+          emit(Op::Multiply, a.components.at(i), b.components.at(j)),
+          emit(Op::Multiply, a.components.at(j), b.components.at(i))));
+      }
+      return result;
+    }
+    if (name == "any" || name == "all" || name == "not") {
+      expect(1);
+      Value value{arguments.at(0)};
+      if (value.type.base != Type::Base::Bool) {
+        throw CompileError{location, name + "() needs a bool vector"};
+      }
+      if (name == "not") {
+        for (Operand& component : value.components) {
+          component = notMask(component);
+        }
+        return value;
+      }
+      Operand result{value.components.at(0)};
+      for (std::size_t c{1}; c < value.components.size(); ++c) {
+        result = name == "any"
+          ? orMask(result, value.components.at(c))
+          : andMask(result, value.components.at(c));
+      }
+      return Value{{Type::Base::Bool, 1, nullptr}, {result}};
+    }
+    return {};
+  }
+
+  // Packs virtual registers into physical ones: constants and inputs first,
+  // then temporaries, which share a register when their lifetimes (from
+  // first to last mention; jumps only go forward) do not overlap.
+  auto allocateRegisters(SoftwareProgram& program) -> void {
+    const std::size_t count{_registers.size()};
+    std::vector<std::uint32_t> physical(count, 0);
+    std::uint32_t next{0};
+    for (std::size_t r{0}; r < count; ++r) {
+      const Register& reg{_registers.at(r)};
+      if (reg.kind == RegisterKind::Constant) {
+        physical.at(r) = next;
+        program._constants.emplace_back(next++, reg.value);
+      } else if (reg.kind == RegisterKind::Input) {
+        physical.at(r) = next;
+        program._bindings.push_back({next++, reg.input});
+      }
+    }
+
+    constexpr std::size_t unused{~std::size_t{}};
+    std::vector<std::size_t> first(count, unused);
+    std::vector<std::size_t> last(count, 0);
+    const auto mention{[&](std::uint32_t reg, std::size_t position) {
+      first.at(reg) = std::min(first.at(reg), position);
+      last.at(reg) = std::max(last.at(reg), position);
+    }};
+    for (std::size_t i{0}; i < _instructions.size(); ++i) {
+      const SoftwareInstruction& instruction{_instructions.at(i)};
+      const std::size_t operands{operandCount(instruction.opcode)};
+      if (instruction.opcode != SoftwareOpcode::JumpIfNone) {
+        mention(instruction.target, i);
+      }
+      mention(instruction.a, i);
+      if (operands > 1) {
+        mention(instruction.b, i);
+      }
+      if (operands > 2) {
+        mention(instruction.c, i);
+      }
+    }
+    for (const std::uint32_t output : _outputs) {
+      mention(output, _instructions.size());
+    }
+
+    std::vector<std::uint32_t> order{};
+    for (std::uint32_t r{0}; r < count; ++r) {
+      if (
+        _registers.at(r).kind == RegisterKind::Temporary
+        && first.at(r) != unused
+      ) {
+        order.push_back(r);
+      }
+    }
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+      return first.at(a) < first.at(b);
+    });
+    using Lifetime = std::pair<std::size_t, std::uint32_t>;
+    std::priority_queue<
+      Lifetime, std::vector<Lifetime>, std::greater<Lifetime>
+    > live{};
+    std::vector<std::uint32_t> free{};
+    for (const std::uint32_t r : order) {
+      while (!live.empty() && live.top().first < first.at(r)) {
+        free.push_back(live.top().second);
+        live.pop();
+      }
+      std::uint32_t slot{};
+      if (free.empty()) {
+        slot = next++;
+      } else {
+        slot = free.back();
+        free.pop_back();
+      }
+      physical.at(r) = slot;
+      live.emplace(last.at(r), slot);
+    }
+
+    for (SoftwareInstruction& instruction : _instructions) {
+      const std::size_t operands{operandCount(instruction.opcode)};
+      if (instruction.opcode != SoftwareOpcode::JumpIfNone) {
+        instruction.target = physical.at(instruction.target);
+      }
+      instruction.a = physical.at(instruction.a);
+      instruction.b = operands > 1 ? physical.at(instruction.b) : 0;
+      instruction.c = operands > 2 ? physical.at(instruction.c) : 0;
+    }
+    for (std::size_t c{0}; c < 4; ++c) {
+      program._outputs[c] = physical.at(_outputs[c]);
+    }
+    program._instructions = std::move(_instructions);
+    program._registerCount = std::max<std::size_t>(next, 1);
+    LOG(
+      "Software program: " << program._instructions.size()
+        << " instructions, " << program._registerCount << " registers ("
+        << count << " virtual)\n"
+    );
+  }
+
+  const GLSLUnit& _unit;
+  std::string& _log;
+  FunctionTable _functionTable{};
+  std::deque<StructType> _structStorage{};
+  std::unordered_map<std::string, const StructType*> _structs{};
+  std::vector<Register> _registers{};
+  std::unordered_map<std::uint32_t, std::uint32_t> _constants{};
+  std::map<SoftwareInput, std::uint32_t> _inputs{};
+  std::vector<SoftwareInstruction> _instructions{};
+  std::uint32_t _outputs[4]{};
+  // Deques keep variables in place while scopes come and go.
+  std::deque<Scope> _scopes{};
+  std::vector<Frame> _frames{};
+  // Innermost blocks, where declarations look for later assignments.
+  std::vector<const GLSLStatement*> _blocks{};
+  std::optional<Operand> _active{};
+  bool _stepping{false};
+};
+
+namespace {
+
+// Cephes-style sine and cosine: reduction to an octant, then polynomials.
+auto nativeSineCosine(NativeFloats x, bool cosine) -> NativeFloats {
+  const NativeFloats zero{nativeSet(0.f)};
+  const NativeFloats magnitude{nativeMax(x, nativeSub(zero, x))};
+  NativeFloats octant{
+    nativeFloor(nativeMul(magnitude, nativeSet(1.27323954473516f)))
+  };
+  // Odd octants round up, so that the reduced angle is within pi/4.
+  octant = nativeAdd(octant, nativeSub(octant, nativeMul(
+    nativeSet(2.f), nativeFloor(nativeMul(octant, nativeSet(.5f)))
+  )));
+  const NativeFloats reduced{nativeSub(
+    nativeSub(
+      nativeSub(magnitude, nativeMul(octant, nativeSet(.78515625f))),
+      nativeMul(octant, nativeSet(2.4187564849853515625e-4f))
+    ),
+    nativeMul(octant, nativeSet(3.77489497744594108e-8f))
+  )};
+  const NativeFloats quadrant{nativeSub(octant, nativeMul(
+    nativeSet(8.f), nativeFloor(nativeMul(octant, nativeSet(.125f)))
+  ))};
+  const NativeFloats z{nativeMul(reduced, reduced)};
+  NativeFloats cosines{nativeSet(2.443315711809948e-5f)};
+  cosines = nativeSub(nativeMul(cosines, z), nativeSet(1.388731625493765e-3f));
+  cosines = nativeAdd(nativeMul(cosines, z), nativeSet(4.166664568298827e-2f));
+  cosines = nativeMul(nativeMul(cosines, z), z);
+  cosines = nativeAdd(
+    nativeSub(cosines, nativeMul(nativeSet(.5f), z)), nativeSet(1.f)
+  );
+  NativeFloats sines{nativeSet(-1.9515295891e-4f)};
+  sines = nativeAdd(nativeMul(sines, z), nativeSet(8.3321608736e-3f));
+  sines = nativeSub(nativeMul(sines, z), nativeSet(1.6666654611e-1f));
+  sines = nativeAdd(nativeMul(nativeMul(sines, z), reduced), reduced);
+
+  const NativeFloats two{nativeEqual(quadrant, nativeSet(2.f))};
+  const NativeFloats four{nativeEqual(quadrant, nativeSet(4.f))};
+  const NativeFloats six{nativeEqual(quadrant, nativeSet(6.f))};
+  const NativeFloats swapped{nativeOr(two, six)};
+  const NativeFloats one{nativeSet(1.f)};
+  const NativeFloats minusOne{nativeSet(-1.f)};
+  if (cosine) {
+    const NativeFloats value{nativeSelect(swapped, sines, cosines)};
+    return nativeMul(value, nativeSelect(nativeOr(two, four), minusOne, one));
+  }
+  const NativeFloats value{nativeSelect(swapped, cosines, sines)};
+  const NativeFloats sign{nativeMul(
+    nativeSelect(nativeLessEqual(nativeSet(4.f), quadrant), minusOne, one),
+    nativeSelect(nativeLess(x, zero), minusOne, one)
+  )};
+  return nativeMul(value, sign);
+}
+
+// Runs an operation without a vectorized version lane by lane.
+auto applyScalar(
+  SoftwareOpcode opcode, Lanes& target, const Lanes& a, const Lanes& b
+) -> void {
+  alignas(32) float as[laneCount];
+  alignas(32) float bs[laneCount];
+  for (std::size_t p{0}; p < nativeCount; ++p) {
+    nativeStore(as + p*nativeWidth, a.parts[p]);
+    nativeStore(bs + p*nativeWidth, b.parts[p]);
+  }
+  for (std::size_t lane{0}; lane < laneCount; ++lane) {
+    as[lane] = fold(opcode, as[lane], bs[lane], 0.f);
+  }
+  for (std::size_t p{0}; p < nativeCount; ++p) {
+    target.parts[p] = nativeLoad(as + p*nativeWidth);
+  }
+}
+
+} // namespace
+
+auto SoftwareProgram::compile(
+  const ShaderSource& source
+) -> std::optional<SoftwareProgram> {
+  std::string text{};
+  for (const std::string_view segment : source.segments) {
+    text.append(segment);
+  }
+  std::string log{};
+  const std::optional<GLSLUnit> unit{parseGLSL(text, log)};
+  SoftwareProgram program{};
+  bool compiled{false};
+  if (unit) {
+    SoftwareCompiler compiler{*unit, log};
+    compiled = compiler.compile(program);
+  }
+  if (!log.empty()) {
+    std::cerr << "Software shader " << (compiled ? "warning: " : "error: ")
+      << source.remapLog(log);
+  }
+  if (!compiled) {
+    return {};
+  }
+  return program;
+}
+
+auto SoftwareProgram::getRegisterCount() const -> std::size_t {
+  return _registerCount;
+}
+
+auto SoftwareProgram::getInstructionCount() const -> std::size_t {
+  return _instructions.size();
+}
+
+auto SoftwareProgram::getConstants() const
+  -> const std::vector<std::pair<std::uint32_t, float>>& {
+  return _constants;
+}
+
+auto SoftwareProgram::getBindings() const -> const std::vector<Binding>& {
+  return _bindings;
+}
+
+auto SoftwareProgram::getOutputs() const -> const std::uint32_t* {
+  return _outputs;
+}
+
+auto SoftwareProgram::run(Lanes* registers) const -> void {
+  const NativeFloats zero{nativeSet(0.f)};
+  const NativeFloats one{nativeSet(1.f)};
+  const std::size_t count{_instructions.size()};
+  for (std::size_t i{0}; i < count; ++i) {
+    const SoftwareInstruction& instruction{_instructions[i]};
+    Lanes& target{registers[instruction.target]};
+    const Lanes& a{registers[instruction.a]};
+    const Lanes& b{registers[instruction.b]};
+    const Lanes& c{registers[instruction.c]};
+    switch (instruction.opcode) {
+#define LANES_APPLY(EXPRESSION) \
+  for (std::size_t p{0}; p < nativeCount; ++p) { \
+    const NativeFloats x{a.parts[p]}; \
+    const NativeFloats y{b.parts[p]}; \
+    static_cast<void>(y); \
+    target.parts[p] = (EXPRESSION); \
+  } \
+  break
+    case SoftwareOpcode::Move:
+      target = a;
+      break;
+    case SoftwareOpcode::Add:
+      LANES_APPLY(nativeAdd(x, y));
+    case SoftwareOpcode::Subtract:
+      LANES_APPLY(nativeSub(x, y));
+    case SoftwareOpcode::Multiply:
+      LANES_APPLY(nativeMul(x, y));
+    case SoftwareOpcode::Divide:
+      LANES_APPLY(nativeDiv(x, y));
+    case SoftwareOpcode::Minimum:
+      LANES_APPLY(nativeMin(x, y));
+    case SoftwareOpcode::Maximum:
+      LANES_APPLY(nativeMax(x, y));
+    case SoftwareOpcode::Floor:
+      LANES_APPLY(nativeFloor(x));
+    case SoftwareOpcode::Truncate:
+      LANES_APPLY(nativeTrunc(x));
+    case SoftwareOpcode::Fract:
+      LANES_APPLY(nativeSub(x, nativeFloor(x)));
+    case SoftwareOpcode::Modulo:
+      LANES_APPLY(nativeSub(x, nativeMul(y, nativeFloor(nativeDiv(x, y)))));
+    case SoftwareOpcode::Step:
+      LANES_APPLY(nativeAnd(nativeLessEqual(x, y), one));
+    case SoftwareOpcode::Sign:
+      LANES_APPLY(nativeSub(
+        nativeAnd(nativeLess(zero, x), one), nativeAnd(nativeLess(x, zero), one)
+      ));
+    case SoftwareOpcode::SquareRoot:
+      LANES_APPLY(nativeSqrt(x));
+    case SoftwareOpcode::InverseSquareRoot:
+      LANES_APPLY(nativeDiv(one, nativeSqrt(x)));
+    case SoftwareOpcode::Sine:
+      LANES_APPLY(nativeSineCosine(x, false));
+    case SoftwareOpcode::Cosine:
+      LANES_APPLY(nativeSineCosine(x, true));
+    case SoftwareOpcode::Tangent:
+      LANES_APPLY(nativeDiv(
+        nativeSineCosine(x, false), nativeSineCosine(x, true)
+      ));
+    case SoftwareOpcode::Less:
+      LANES_APPLY(nativeAnd(nativeLess(x, y), one));
+    case SoftwareOpcode::LessEqual:
+      LANES_APPLY(nativeAnd(nativeLessEqual(x, y), one));
+    case SoftwareOpcode::Equal:
+      LANES_APPLY(nativeAnd(nativeEqual(x, y), one));
+    case SoftwareOpcode::NotEqual:
+      LANES_APPLY(nativeAnd(nativeNotEqual(x, y), one));
+    case SoftwareOpcode::Select:
+      LANES_APPLY(nativeSelect(nativeNotEqual(x, zero), y, c.parts[p]));
+#undef LANES_APPLY
+    case SoftwareOpcode::JumpIfNone: {
+      bool any{false};
+      for (std::size_t p{0}; p < nativeCount; ++p) {
+        any = any || nativeAny(nativeNotEqual(a.parts[p], zero));
+      }
+      if (!any) {
+        i = instruction.target - 1;
+      }
+      break;
+    }
+    default:
+      applyScalar(instruction.opcode, target, a, b);
+      break;
+    }
+  }
+}
+
+SoftwareRenderer::SoftwareRenderer(
+  SoftwareProgram program, std::size_t threadCount
+) : _program{std::move(program)}, _pool{threadCount} {
+  _registers.resize(_pool.getThreadCount());
+  for (std::vector<Lanes>& registers : _registers) {
+    registers.resize(_program.getRegisterCount());
+    for (const auto& [reg, value] : _program.getConstants()) {
+      for (NativeFloats& part : registers.at(reg).parts) {
+        part = nativeSet(value);
+      }
+    }
+  }
+}
+
+auto SoftwareRenderer::render(
+  int width, int height, const ShaderInputs& inputs
+) -> void {
+  _width = width;
+  _height = height;
+  _pixels.resize(static_cast<std::size_t>(width)*height*4);
+  const float values[]{
+    inputs.time, static_cast<float>(inputs.resolution[0]),
+    static_cast<float>(inputs.resolution[1]), inputs.deltaTime,
+    inputs.mouse[0], inputs.mouse[1], inputs.mouse[2], inputs.mouse[3],
+    static_cast<float>(inputs.frame), inputs.date[0], inputs.date[1],
+    inputs.date[2], inputs.date[3]
+  };
+  const int columns{(width + tileWidth - 1)/tileWidth};
+  const int rows{(height + tileHeight - 1)/tileHeight};
+  _pool.run(
+    static_cast<std::size_t>(columns)*static_cast<std::size_t>(rows),
+    [this, values](std::size_t tile, std::size_t worker) {
+      renderTile(static_cast<int>(tile), worker, values);
+    }
+  );
+}
+
+auto SoftwareRenderer::renderTile(
+  int tile, std::size_t worker, const float* inputs
+) -> void {
+  Lanes* registers{_registers.at(worker).data()};
+  const std::vector<SoftwareProgram::Binding>& bindings{
+    _program.getBindings()
+  };
+  for (const SoftwareProgram::Binding& binding : bindings) {
+    if (binding.input < SoftwareInput::FragCoordX) {
+      const float value{inputs[static_cast<std::size_t>(binding.input)]};
+      for (NativeFloats& part : registers[binding.reg].parts) {
+        part = nativeSet(value);
+      }
+    }
+  }
+  alignas(32) float offsets[laneCount];
+  for (std::size_t lane{0}; lane < laneCount; ++lane) {
+    offsets[lane] = static_cast<float>(lane) + .5f;
+  }
+  const int columns{(_width + tileWidth - 1)/tileWidth};
+  const int x0{(tile % columns)*tileWidth};
+  const int y0{tile/columns*tileHeight};
+  const std::uint32_t* outputs{_program.getOutputs()};
+  alignas(32) float colors[4][laneCount];
+  for (int y{y0}; y < std::min(y0 + tileHeight, _height); ++y) {
+    for (
+      int x{x0}; x < std::min(x0 + tileWidth, _width);
+      x += static_cast<int>(laneCount)
+    ) {
+      for (const SoftwareProgram::Binding& binding : bindings) {
+        Lanes& lanes{registers[binding.reg]};
+        for (std::size_t p{0}; p < nativeCount; ++p) {
+          if (binding.input == SoftwareInput::FragCoordX) {
+            lanes.parts[p] = nativeAdd(
+              nativeSet(static_cast<float>(x)),
+              nativeLoad(offsets + p*nativeWidth)
+            );
+          } else if (binding.input == SoftwareInput::FragCoordY) {
+            lanes.parts[p] = nativeSet(static_cast<float>(y) + .5f);
+          }
+        }
+      }
+      _program.run(registers);
+      for (std::size_t channel{0}; channel < 4; ++channel) {
+        for (std::size_t p{0}; p < nativeCount; ++p) {
+          nativeStore(
+            colors[channel] + p*nativeWidth,
+            registers[outputs[channel]].parts[p]
+          );
+        }
+      }
+      const auto count{static_cast<std::size_t>(
+        std::min(static_cast<int>(laneCount), _width - x)
+      )};
+      std::uint8_t* pixel{
+        _pixels.data() + (static_cast<std::size_t>(y)*_width + x)*4
+      };
+      for (std::size_t lane{0}; lane < count; ++lane) {
+        for (std::size_t channel{0}; channel < 4; ++channel) {
+          const float value{colors[channel][lane]};
+          // Also maps NaN to 0.
+          const float clamped{value > 0.f ? std::min(value, 1.f) : 0.f};
+          *pixel++ = static_cast<std::uint8_t>(clamped*255.f + .5f);
+        }
+      }
+    }
+  }
+}
+
+auto SoftwareRenderer::getPixels() const -> const std::vector<std::uint8_t>& {
+  return _pixels;
+}
+
+auto SoftwareRenderer::getThreadCount() const -> std::size_t {
+  return _pool.getThreadCount();
+}
+
+auto SoftwareRenderer::getStealCount() const -> std::size_t {
+  return _pool.getStealCount();
+}
@@ -0,0 +1,153 @@
+#ifndef SOFTWARE_HXX
+#define SOFTWARE_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "inputs.hxx"
+#include "lanes.hxx"
+#include "source.hxx"
+#include "threadpool.hxx"
+
+enum class SoftwareOpcode : std::uint8_t {
+  Move,
+  Add,
+  Subtract,
+  Multiply,
+  Divide,
+  Minimum,
+  Maximum,
+  Floor,
+  Truncate,
+  Fract,
+  Modulo,
+  Step,
+  Sign,
+  SquareRoot,
+  InverseSquareRoot,
+  Sine,
+  Cosine,
+  Tangent,
+  ArcSine,
+  ArcCosine,
+  ArcTangent,
+  ArcTangent2,
+  SineHyperbolic,
+  CosineHyperbolic,
+  TangentHyperbolic,
+  Power,
+  Exponential,
+  Logarithm,
+  Exponential2,
+  Logarithm2,
+  Less,
+  LessEqual,
+  Equal,
+  NotEqual,
+  // target = a != 0 ? b : c
+  Select,
+  // Continues at instruction target when a is 0 in every lane.
+  JumpIfNone
+};
+
+struct SoftwareInstruction {
+  SoftwareOpcode opcode;
+  std::uint32_t target;
+  std::uint32_t a;
+  std::uint32_t b;
+  std::uint32_t c;
+};
+
+// Values that uniforms and the ShaderTestInputs block read.
+enum class SoftwareInput : std::uint8_t {
+  Time,
+  ResolutionX,
+  ResolutionY,
+  DeltaTime,
+  MouseX,
+  MouseY,
+  MouseZ,
+  MouseW,
+  Frame,
+  Year,
+  Month,
+  Day,
+  Seconds,
+  FragCoordX,
+  FragCoordY
+};
+
+/**
+ * A fragment shader compiled for the CPU. Functions are inlined, loops
+ * with constant bounds unrolled and vectors split into components, which
+ * leaves a straight list of instructions on registers holding one value
+ * per pixel of a group (Lanes). Divergent control flow runs both ways
+ * under a mask; a forward jump skips code that no pixel of the group needs,
+ * e.g. the rest of a loop once every pixel has left it.
+ */
+class SoftwareProgram {
+public:
+  struct Binding {
+    std::uint32_t reg;
+    SoftwareInput input;
+  };
+
+  // Errors go to std::cerr, like those of GL shaders.
+  static auto compile(
+    const ShaderSource& source
+  ) -> std::optional<SoftwareProgram>;
+
+  auto getRegisterCount() const -> std::size_t;
+  auto getInstructionCount() const -> std::size_t;
+  auto getConstants() const -> const std::vector<std::pair<std::uint32_t, float>>&;
+  auto getBindings() const -> const std::vector<Binding>&;
+  auto getOutputs() const -> const std::uint32_t*;
+  auto run(Lanes* registers) const -> void;
+
+private:
+  friend class SoftwareCompiler;
+
+  std::vector<SoftwareInstruction> _instructions{};
+  std::vector<std::pair<std::uint32_t, float>> _constants{};
+  std::vector<Binding> _bindings{};
+  std::uint32_t _outputs[4]{};
+  std::size_t _registerCount{};
+};
+
+/**
+ * Renders a software program into an RGBA8 image (bottom row first, like
+ * glReadPixels). The image is split into tiles that a work-stealing thread
+ * pool shades in groups of laneCount pixels along a row.
+ */
+class SoftwareRenderer {
+public:
+  SoftwareRenderer(SoftwareProgram program, std::size_t threadCount);
+  SoftwareRenderer() = delete;
+  SoftwareRenderer(const SoftwareRenderer&) = delete;
+  SoftwareRenderer(SoftwareRenderer&&) = delete;
+  SoftwareRenderer operator=(const SoftwareRenderer&) = delete;
+  SoftwareRenderer operator=(SoftwareRenderer&&) = delete;
+
+  auto render(int width, int height, const ShaderInputs& inputs) -> void;
+  auto getPixels() const -> const std::vector<std::uint8_t>&;
+  auto getThreadCount() const -> std::size_t;
+  auto getStealCount() const -> std::size_t;
+
+private:
+  static constexpr int tileWidth{static_cast<int>(laneCount)*4};
+  static constexpr int tileHeight{8};
+
+  auto renderTile(int tile, std::size_t worker, const float* inputs) -> void;
+
+  SoftwareProgram _program;
+  ThreadPool _pool;
+  // One register file per worker.
+  std::vector<std::vector<Lanes>> _registers{};
+  std::vector<std::uint8_t> _pixels{};
+  int _width{};
+  int _height{};
+};
+
+#endif // SOFTWARE_HXX
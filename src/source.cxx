@@ -0,0 +1,80 @@
+#include "source.hxx"
+
+#include <cctype>
+
+ShaderSource::ShaderSource(std::string text) {
+  append(std::make_shared<const std::string>(std::move(text)));
+}
+
+auto ShaderSource::fromLiteral(std::string_view text) -> ShaderSource {
+  ShaderSource source{};
+  source.append(text);
+  return source;
+}
+
+auto ShaderSource::append(std::string_view segment) -> void {
+  if (!segment.empty()) {
+    segments.push_back(segment);
+  }
+}
+
+auto ShaderSource::append(std::shared_ptr<const std::string> text) -> void {
+  append(std::string_view{*text});
+  storage.push_back(std::move(text));
+}
+
+auto ShaderSource::remapLog(std::string_view log) const -> std::string {
+  if (files.empty()) {
+    return std::string{log};
+  }
+  // Drivers prefix messages with the source string number followed by the
+  // line, e.g. "0:12(3): error" (Mesa), "0(12) : error" (NVIDIA) or
+  // "ERROR: 0:12:" (AMD). Replace the number with the file name.
+  std::string result{};
+  result.reserve(log.size());
+  std::size_t position{};
+  while (position < log.size()) {
+    std::size_t end{log.find('\n', position)};
+    end = end == std::string_view::npos ? log.size() : end + 1;
+    std::string_view line{log.substr(position, end - position)};
+    position = end;
+
+    std::size_t start{};
+    for (const std::string_view prefix : {"ERROR: ", "WARNING: "}) {
+      if (line.substr(0, prefix.size()) == prefix) {
+        start = prefix.size();
+      }
+    }
+    std::size_t digits{start};
+    while (digits < line.size() && std::isdigit(line[digits])) {
+      ++digits;
+    }
+    if (
+      digits == start || digits >= line.size()
+      || (line[digits] != ':' && line[digits] != '(')
+    ) {
+      result.append(line);
+      continue;
+    }
+    const std::size_t index{
+      std::stoul(std::string{line.substr(start, digits - start)})
+    };
+    if (index >= files.size()) {
+      result.append(line);
+      continue;
+    }
+    result.append(line.substr(0, start));
+    result.append(files[index]);
+    result.append(line.substr(digits));
+  }
+  return result;
+}
+
+auto operator<<(
+  std::ostream& out, const ShaderSource& source
+) -> std::ostream& {
+  for (const std::string_view segment : source.segments) {
+    out << segment;
+  }
+  return out;
+}
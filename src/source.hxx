@@ -0,0 +1,32 @@
+#ifndef SOURCE_HXX
+#define SOURCE_HXX
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * GLSL source code as a list of segments, passed to glShaderSource as a
+ * multi-string array. Segments point into shared, immutable buffers (e.g.
+ * cached file contents), so copying a ShaderSource never copies the text.
+ */
+struct ShaderSource {
+  std::vector<std::string_view> segments{};
+  std::vector<std::shared_ptr<const std::string>> storage{};
+  // Source string numbers used by #line directives, indexing file names.
+  std::vector<std::string> files{};
+
+  ShaderSource() = default;
+  explicit ShaderSource(std::string text);
+  static auto fromLiteral(std::string_view text) -> ShaderSource;
+
+  auto append(std::string_view segment) -> void;
+  auto append(std::shared_ptr<const std::string> text) -> void;
+  auto remapLog(std::string_view log) const -> std::string;
+};
+
+auto operator<<(std::ostream& out, const ShaderSource& source) -> std::ostream&;
+
+#endif // SOURCE_HXX
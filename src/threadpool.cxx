@@ -0,0 +1,114 @@
+#include "threadpool.hxx"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+  if (threadCount == 0) {
+    threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  for (std::size_t q{0}; q < threadCount; ++q) {
+    _queues.push_back(std::make_unique<Queue>());
+  }
+  for (std::size_t worker{1}; worker < threadCount; ++worker) {
+    _threads.emplace_back(&ThreadPool::work, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _stopping = true;
+  }
+  _wake.notify_all();
+  for (std::thread& thread : _threads) {
+    thread.join();
+  }
+}
+
+auto ThreadPool::getThreadCount() const -> std::size_t {
+  return _queues.size();
+}
+
+auto ThreadPool::getStealCount() const -> std::size_t {
+  return _steals.load(std::memory_order_relaxed);
+}
+
+auto ThreadPool::run(std::size_t count, const Task& task) -> void {
+  if (count == 0) {
+    return;
+  }
+  const std::size_t workers{_queues.size()};
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    for (std::size_t worker{0}; worker < workers; ++worker) {
+      Queue& queue{*_queues.at(worker)};
+      std::lock_guard<std::mutex> queueLock{queue.mutex};
+      // Neighbouring tasks (e.g. tiles) tend to cost about the same.
+      for (
+        std::size_t index{count*worker/workers};
+        index < count*(worker + 1)/workers; ++index
+      ) {
+        queue.tasks.push_back(index);
+      }
+    }
+    _task = &task;
+    _busyWorkers = _threads.size();
+    ++_batch;
+  }
+  _wake.notify_all();
+  drain(0);
+  std::unique_lock<std::mutex> lock{_mutex};
+  _done.wait(lock, [this]() { return _busyWorkers == 0; });
+  _task = nullptr;
+}
+
+auto ThreadPool::work(std::size_t worker) -> void {
+  std::size_t batch{};
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock{_mutex};
+      _wake.wait(lock, [this, batch]() {
+        return _stopping || _batch != batch;
+      });
+      if (_stopping) {
+        return;
+      }
+      batch = _batch;
+    }
+    drain(worker);
+    std::lock_guard<std::mutex> lock{_mutex};
+    if (--_busyWorkers == 0) {
+      _done.notify_one();
+    }
+  }
+}
+
+auto ThreadPool::drain(std::size_t worker) -> void {
+  while (const std::optional<std::size_t> index{takeTask(worker)}) {
+    (*_task)(*index, worker);
+  }
+}
+
+auto ThreadPool::takeTask(std::size_t worker) -> std::optional<std::size_t> {
+  {
+    Queue& own{*_queues.at(worker)};
+    std::lock_guard<std::mutex> lock{own.mutex};
+    if (!own.tasks.empty()) {
+      const std::size_t index{own.tasks.front()};
+      own.tasks.pop_front();
+      return index;
+    }
+  }
+  const std::size_t workers{_queues.size()};
+  for (std::size_t offset{1}; offset < workers; ++offset) {
+    Queue& victim{*_queues.at((worker + offset) % workers)};
+    std::lock_guard<std::mutex> lock{victim.mutex};
+    if (!victim.tasks.empty()) {
+      const std::size_t index{victim.tasks.back()};
+      victim.tasks.pop_back();
+      _steals.fetch_add(1, std::memory_order_relaxed);
+      return index;
+    }
+  }
+  return {};
+}
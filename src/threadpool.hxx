@@ -0,0 +1,62 @@
+#ifndef THREADPOOL_HXX
+#define THREADPOOL_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads for batches of independent tasks. Each
+ * batch is split into contiguous runs, one per worker queue; workers take
+ * tasks from the front of their own queue and, once it is empty, steal
+ * from the back of the others, so uneven task costs even out.
+ */
+class ThreadPool {
+public:
+  using Task = std::function<void(std::size_t index, std::size_t worker)>;
+
+  // Zero threads means one per hardware thread.
+  explicit ThreadPool(std::size_t threadCount);
+  ThreadPool() = delete;
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool operator=(const ThreadPool&) = delete;
+  ThreadPool operator=(ThreadPool&&) = delete;
+  ~ThreadPool();
+
+  // Includes the calling thread, which works as worker 0 during run().
+  auto getThreadCount() const -> std::size_t;
+  // Runs the task for every index below count and returns once all are done.
+  auto run(std::size_t count, const Task& task) -> void;
+  auto getStealCount() const -> std::size_t;
+
+private:
+  struct Queue {
+    std::mutex mutex{};
+    std::deque<std::size_t> tasks{};
+  };
+
+  auto work(std::size_t worker) -> void;
+  auto drain(std::size_t worker) -> void;
+  auto takeTask(std::size_t worker) -> std::optional<std::size_t>;
+
+  std::vector<std::unique_ptr<Queue>> _queues{};
+  std::vector<std::thread> _threads{};
+  std::mutex _mutex{};
+  std::condition_variable _wake{};
+  std::condition_variable _done{};
+  const Task* _task{};
+  std::size_t _batch{};
+  std::size_t _busyWorkers{};
+  std::atomic<std::size_t> _steals{};
+  bool _stopping{false};
+};
+
+#endif // THREADPOOL_HXX
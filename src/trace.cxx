@@ -0,0 +1,134 @@
+#include "trace.hxx"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "profiler.hxx"
+
+std::atomic<bool> traceEnabled{false};
+
+namespace {
+
+// Spans kept per thread: 512 KiB, only allocated for threads that trace.
+constexpr std::size_t traceRingSize{1 << 14};
+
+struct TraceEvent {
+  const char* category;
+  const char* name;
+  std::int64_t start;
+  std::int64_t duration;
+};
+
+struct TraceRing {
+  std::array<TraceEvent, traceRingSize> events{};
+  // Spans ever recorded; the ring holds the last ones.
+  std::atomic<std::uint64_t> written{};
+  std::atomic<const char*> threadName{};
+  int threadId{};
+};
+
+// Rings are only added here, and outlive their threads.
+std::mutex ringsMutex{};
+std::vector<std::unique_ptr<TraceRing>> rings{};
+thread_local TraceRing* localRing{};
+thread_local const char* localThreadName{};
+
+auto registerRing() -> TraceRing* {
+  auto ring{std::make_unique<TraceRing>()};
+  ring->threadName = localThreadName;
+  std::lock_guard<std::mutex> lock{ringsMutex};
+  ring->threadId = static_cast<int>(rings.size()) + 1;
+  rings.push_back(std::move(ring));
+  return rings.back().get();
+}
+
+} // namespace
+
+auto getTraceClock() -> std::int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+auto recordTraceSpan(
+  const char* category, const char* name, std::int64_t start,
+  std::int64_t end
+) -> void {
+  if (!localRing) {
+    localRing = registerRing();
+  }
+  // Only this thread writes to its ring.
+  const std::uint64_t index{
+    localRing->written.load(std::memory_order_relaxed)
+  };
+  localRing->events[index%traceRingSize] = {
+    category, name, start, end - start
+  };
+  localRing->written.store(index + 1, std::memory_order_release);
+}
+
+auto setTraceThreadName(const char* name) -> void {
+  localThreadName = name;
+  if (localRing) {
+    localRing->threadName = name;
+  }
+}
+
+TraceSession::TraceSession(std::string path) :
+  _path{std::move(path)}, _start{getTraceClock()} {
+  traceEnabled = true;
+}
+
+TraceSession::~TraceSession() {
+  traceEnabled = false;
+  std::ofstream stream{_path, std::ios::trunc};
+  std::uint64_t recorded{0};
+  std::uint64_t overwritten{0};
+  stream << std::fixed << std::setprecision(3)
+    << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  std::lock_guard<std::mutex> lock{ringsMutex};
+  for (const std::unique_ptr<TraceRing>& ring : rings) {
+    const std::uint64_t written{
+      ring->written.load(std::memory_order_acquire)
+    };
+    const std::uint64_t count{std::min<std::uint64_t>(written, traceRingSize)};
+    const char* threadName{ring->threadName};
+    stream << (ring == rings.front() ? "" : ",")
+      << "\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+      << "\"tid\": " << ring->threadId << ", \"args\": {\"name\": ";
+    printStringJSON(
+      stream, threadName
+        ? threadName : "thread " + std::to_string(ring->threadId)
+    );
+    stream << "}}";
+    for (std::uint64_t index{written - count}; index < written; ++index) {
+      const TraceEvent& event{ring->events[index%traceRingSize]};
+      stream << ",\n{\"name\": ";
+      printStringJSON(stream, event.name);
+      stream << ", \"cat\": ";
+      printStringJSON(stream, event.category);
+      stream << ", \"ph\": \"X\", \"ts\": "
+        << static_cast<double>(event.start - _start)/1000.
+        << ", \"dur\": " << static_cast<double>(event.duration)/1000.
+        << ", \"pid\": 1, \"tid\": " << ring->threadId << '}';
+    }
+    recorded += count;
+    overwritten += written - count;
+  }
+  stream << "\n]}\n";
+  if (!stream) {
+    std::cerr << "Failed to write " << _path << '\n';
+    return;
+  }
+  std::cout << "Wrote " << recorded << " trace spans to " << _path;
+  if (overwritten > 0) {
+    std::cout << " (" << overwritten << " older spans overwritten)";
+  }
+  std::cout << '\n';
+}
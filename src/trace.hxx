@@ -0,0 +1,82 @@
+#ifndef TRACE_HXX
+#define TRACE_HXX
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Whether spans are recorded. A span costs one relaxed load when they are
+// not, so the instrumentation can stay in release builds.
+extern std::atomic<bool> traceEnabled;
+
+auto getTraceClock() -> std::int64_t;
+auto recordTraceSpan(
+  const char* category, const char* name, std::int64_t start,
+  std::int64_t end
+) -> void;
+// Names the calling thread in the trace; the name must outlive the trace,
+// e.g. a string literal.
+auto setTraceThreadName(const char* name) -> void;
+
+/**
+ * Records the time from its construction to its destruction as a span of
+ * the calling thread. Spans go into a fixed-size ring per thread that only
+ * that thread writes to, so recording one takes no locks; when a ring
+ * wraps around, its oldest spans are overwritten. The category and name
+ * are stored as pointers and must outlive the trace, e.g. string literals.
+ */
+class TraceSpan {
+public:
+  TraceSpan(const char* category, const char* name) {
+    if (traceEnabled.load(std::memory_order_relaxed)) {
+      _category = category;
+      _name = name;
+      _start = getTraceClock();
+    }
+  }
+  TraceSpan() = delete;
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan(TraceSpan&&) = delete;
+  TraceSpan operator=(const TraceSpan&) = delete;
+  TraceSpan operator=(TraceSpan&&) = delete;
+  ~TraceSpan() {
+    if (_name) {
+      recordTraceSpan(_category, _name, _start, getTraceClock());
+    }
+  }
+
+private:
+  const char* _category{};
+  const char* _name{};
+  std::int64_t _start{};
+};
+
+#define TRACE_CONCAT(a, b) a##b
+#define TRACE_VARIABLE(line) TRACE_CONCAT(traceSpan, line)
+// Traces the rest of the enclosing scope.
+#define TRACE_SPAN(category, name) \
+  const TraceSpan TRACE_VARIABLE(__LINE__){category, name}
+
+/**
+ * Turns tracing on for its lifetime, and then writes every recorded span as
+ * a Chrome trace ("chrome://tracing" or Perfetto) JSON file. The file is
+ * only consistent once the traced threads are done, so a session should
+ * outlive everything it traces.
+ */
+class TraceSession {
+public:
+  explicit TraceSession(std::string path);
+  TraceSession() = delete;
+  TraceSession(const TraceSession&) = delete;
+  TraceSession(TraceSession&&) = delete;
+  TraceSession operator=(const TraceSession&) = delete;
+  TraceSession operator=(TraceSession&&) = delete;
+  ~TraceSession();
+
+private:
+  const std::string _path;
+  const std::int64_t _start;
+};
+
+#endif // TRACE_HXX
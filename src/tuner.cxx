@@ -0,0 +1,263 @@
+#include "tuner.hxx"
+
+#include <algorithm>
+#include <charconv>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+#include "debug.hxx"
+
+namespace {
+
+// Rounds of measurements per variant.
+constexpr int tuneRounds{3};
+// Frames rendered before each measurement, e.g. for lazy compilation.
+constexpr int tuneWarmupFrames{2};
+
+auto parseNumber(const std::string& value) -> std::optional<double> {
+  double result{};
+  const char* end{value.data() + value.size()};
+  const auto [pointer, error]{std::from_chars(value.data(), end, result)};
+  if (error != std::errc{} || pointer != end) {
+    return {};
+  }
+  return result;
+}
+
+// Whether a is at least as good as b in every value: higher numbers, or the
+// same text.
+auto hasNoLowerValue(
+  const ShaderDefines& a, const ShaderDefines& b
+) -> bool {
+  for (std::size_t i{0}; i < a.size(); ++i) {
+    const std::optional<double> first{parseNumber(a[i].second)};
+    const std::optional<double> second{parseNumber(b[i].second)};
+    if (first && second ? *first < *second : a[i].second != b[i].second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+auto dominates(const VariantResult& a, const VariantResult& b) -> bool {
+  return !a.failed && a.gpu.median <= b.gpu.median
+    && hasNoLowerValue(a.defines, b.defines)
+    && (a.gpu.median < b.gpu.median || a.defines != b.defines);
+}
+
+auto describe(const ShaderDefines& defines) -> std::string {
+  std::string text{};
+  for (const auto& [name, value] : defines) {
+    text += (text.empty() ? "" : " ") + name + '=' + value;
+  }
+  return text;
+}
+
+auto formatMilliseconds(double milliseconds) -> std::string {
+  std::ostringstream text{};
+  text << std::fixed << std::setprecision(3) << milliseconds;
+  return text.str();
+}
+
+} // namespace
+
+VariantCache::VariantCache(
+  ShaderPreprocessor& preprocessor, std::string vertexPath,
+  std::string fragmentPath, ProgramCache* programCache
+) : _preprocessor{preprocessor}, _vertexPath{std::move(vertexPath)},
+    _fragmentPath{std::move(fragmentPath)}, _programCache{programCache} {}
+
+VariantCache::~VariantCache() {
+  for (const auto& [defines, program] : _programs) {
+    if (program) {
+      glDeleteProgram(*program);
+    }
+  }
+}
+
+auto VariantCache::get(
+  const ShaderDefines& defines
+) -> std::optional<GLuint> {
+  const auto cached{_programs.find(defines)};
+  if (cached != _programs.end()) {
+    ++_hits;
+    return cached->second;
+  }
+  std::optional<GLuint> program{};
+  std::optional<ShaderSource> vertex{
+    _preprocessor.process(_vertexPath, defines)
+  };
+  std::optional<ShaderSource> fragment{
+    _preprocessor.process(_fragmentPath, defines)
+  };
+  if (vertex && fragment) {
+    program = GraphicsEngine::createProgram(
+      {std::move(*vertex), std::move(*fragment)}, _programCache
+    );
+  }
+  LOG("Built variant " << describe(defines)
+    << (program ? "" : " (failed)") << '\n');
+  _programs.emplace(defines, program);
+  return program;
+}
+
+auto VariantCache::getBuildCount() const -> std::size_t {
+  return _programs.size();
+}
+
+auto VariantCache::getHitCount() const -> std::size_t {
+  return _hits;
+}
+
+auto runTuner(
+  GraphicsEngine& graphics, VariantCache& cache, const TuneSettings& settings
+) -> std::vector<VariantResult> {
+  // Every combination, the last parameter varying fastest.
+  std::vector<VariantResult> results{{}};
+  for (const TuneParameter& parameter : settings.parameters) {
+    std::vector<VariantResult> expanded{};
+    for (const VariantResult& partial : results) {
+      for (const std::string& value : parameter.values) {
+        expanded.push_back(partial);
+        expanded.back().defines.emplace_back(parameter.name, value);
+      }
+    }
+    results = std::move(expanded);
+  }
+
+  std::vector<std::vector<double>> samples(results.size());
+  FrameProfiler profiler{};
+  for (int round{0}; round < tuneRounds; ++round) {
+    for (std::size_t index{0}; index < results.size(); ++index) {
+      VariantResult& result{results[index]};
+      // Swept values override the same names given with -D.
+      ShaderDefines defines{settings.baseDefines};
+      for (const auto& [name, value] : result.defines) {
+        setDefine(defines, name, value);
+      }
+      const std::optional<GLuint> program{cache.get(defines)};
+      if (!program) {
+        result.failed = true;
+        continue;
+      }
+      graphics.showProgram(*program);
+      graphics.setFixedTime(settings.time);
+      for (int frame{0}; frame < tuneWarmupFrames; ++frame) {
+        graphics.render();
+      }
+      graphics.finish();
+      profiler.reset();
+      for (int frame{0}; frame < settings.frames; ++frame) {
+        profiler.beginFrame();
+        graphics.render();
+        profiler.endFrame();
+      }
+      profiler.finish();
+      const std::vector<double>& times{profiler.getGPUTimes()};
+      samples[index].insert(
+        samples[index].end(), times.begin(), times.end()
+      );
+    }
+  }
+  for (std::size_t index{0}; index < results.size(); ++index) {
+    results[index].gpu = FrameStatistics::fromSamples(samples[index]);
+  }
+  for (VariantResult& result : results) {
+    result.paretoOptimal = !result.failed && std::none_of(
+      results.begin(), results.end(),
+      [&result](const VariantResult& other) {
+        return &other != &result && dominates(other, result);
+      }
+    );
+  }
+  return results;
+}
+
+auto printTuneResults(
+  std::ostream& out, const std::vector<VariantResult>& results,
+  const TuneSettings& settings, BenchFormat format
+) -> void {
+  const double budget{settings.budgetMilliseconds};
+  if (format == BenchFormat::CSV) {
+    for (const TuneParameter& parameter : settings.parameters) {
+      out << parameter.name << ',';
+    }
+    out << "median_ms,p95_ms,mean_ms,within_budget,pareto_optimal\n";
+    for (const VariantResult& result : results) {
+      for (const auto& [name, value] : result.defines) {
+        out << value << ',';
+      }
+      if (result.failed) {
+        out << ",,,0,0\n";
+        continue;
+      }
+      out << result.gpu.median << ',' << result.gpu.p95 << ','
+        << result.gpu.mean << ',' << (result.gpu.median <= budget) << ','
+        << result.paretoOptimal << '\n';
+    }
+    return;
+  }
+  if (format == BenchFormat::JSON) {
+    out << "{\"budget_ms\": " << budget << ", \"variants\": [";
+    for (std::size_t index{0}; index < results.size(); ++index) {
+      const VariantResult& result{results[index]};
+      out << (index > 0 ? ", " : "") << "{\"defines\": {";
+      for (std::size_t i{0}; i < result.defines.size(); ++i) {
+        out << (i > 0 ? ", " : "");
+        printStringJSON(out, result.defines[i].first);
+        out << ": ";
+        printStringJSON(out, result.defines[i].second);
+      }
+      out << "}, \"failed\": " << (result.failed ? "true" : "false");
+      if (!result.failed) {
+        out << ", \"median_ms\": " << result.gpu.median
+          << ", \"p95_ms\": " << result.gpu.p95
+          << ", \"mean_ms\": " << result.gpu.mean
+          << ", \"within_budget\": "
+          << (result.gpu.median <= budget ? "true" : "false")
+          << ", \"pareto_optimal\": "
+          << (result.paretoOptimal ? "true" : "false");
+      }
+      out << '}';
+    }
+    out << "]}\n";
+    return;
+  }
+
+  std::vector<const VariantResult*> table{};
+  std::size_t failed{0};
+  std::size_t withinBudget{0};
+  for (const VariantResult& result : results) {
+    failed += result.failed;
+    withinBudget += !result.failed && result.gpu.median <= budget;
+    if (result.paretoOptimal && result.gpu.median <= budget) {
+      table.push_back(&result);
+    }
+  }
+  std::sort(
+    table.begin(), table.end(),
+    [](const VariantResult* a, const VariantResult* b) {
+      return a->gpu.median < b->gpu.median;
+    }
+  );
+  out << "Tuned " << results.size() << " variants (" << failed
+    << " failed); " << withinBudget << " within " << budget << " ms, "
+    << table.size() << " of them Pareto-optimal:\n";
+  std::size_t width{8};
+  for (const VariantResult* result : table) {
+    width = std::max(width, describe(result->defines).size());
+  }
+  out << "  " << std::left << std::setw(static_cast<int>(width))
+    << "Variant" << std::right << "  median ms     p95 ms\n";
+  for (const VariantResult* result : table) {
+    out << "  " << std::left << std::setw(static_cast<int>(width))
+      << describe(result->defines) << std::right << "  " << std::setw(9)
+      << formatMilliseconds(result->gpu.median) << "  " << std::setw(9)
+      << formatMilliseconds(result->gpu.p95) << '\n';
+  }
+  if (!table.empty()) {
+    // The slowest Pareto-optimal variant has the highest values.
+    out << "Best within budget: " << describe(table.back()->defines) << '\n';
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef TUNER_HXX
+#define TUNER_HXX
+
+#include <cstddef>
+#include <iosfwd>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "cache.hxx"
+#include "graphics.hxx"
+#include "parameters.hxx"
+#include "preprocessor.hxx"
+#include "profiler.hxx"
+
+/**
+ * Programs of one vertex and fragment shader pair built with different
+ * macro definitions, each built once (failures included) and kept until
+ * the cache is destroyed.
+ */
+class VariantCache {
+public:
+  VariantCache(
+    ShaderPreprocessor& preprocessor, std::string vertexPath,
+    std::string fragmentPath, ProgramCache* programCache
+  );
+  VariantCache() = delete;
+  VariantCache(const VariantCache&) = delete;
+  VariantCache(VariantCache&&) = delete;
+  VariantCache operator=(const VariantCache&) = delete;
+  VariantCache operator=(VariantCache&&) = delete;
+  ~VariantCache();
+
+  // The program belongs to the cache; empty if it failed to build.
+  auto get(const ShaderDefines& defines) -> std::optional<GLuint>;
+  auto getBuildCount() const -> std::size_t;
+  auto getHitCount() const -> std::size_t;
+
+private:
+  ShaderPreprocessor& _preprocessor;
+  const std::string _vertexPath;
+  const std::string _fragmentPath;
+  ProgramCache* _programCache;
+  std::map<ShaderDefines, std::optional<GLuint>> _programs{};
+  std::size_t _hits{};
+};
+
+struct TuneSettings {
+  std::vector<TuneParameter> parameters;
+  // Defined before the tuned macros, e.g. from -D.
+  ShaderDefines baseDefines;
+  double budgetMilliseconds;
+  int frames;
+  // Every variant renders the same image at this time.
+  GLfloat time;
+};
+
+struct VariantResult {
+  // The tuned macros only, in parameter order.
+  ShaderDefines defines;
+  FrameStatistics gpu{};
+  bool failed{false};
+  // No other variant is at least as fast with every numeric value at
+  // least as high (and the other values the same), i.e. higher values are
+  // taken to mean higher quality.
+  bool paretoOptimal{false};
+};
+
+/**
+ * Renders every combination of the parameter values offscreen and
+ * measures its GPU time. The variants are measured in several interleaved
+ * rounds, so that clock ramps and thermal throttling affect them alike.
+ */
+auto runTuner(
+  GraphicsEngine& graphics, VariantCache& cache, const TuneSettings& settings
+) -> std::vector<VariantResult>;
+// Text reports list the Pareto-optimal variants within the budget; JSON and
+// CSV reports list every variant.
+auto printTuneResults(
+  std::ostream& out, const std::vector<VariantResult>& results,
+  const TuneSettings& settings, BenchFormat format
+) -> void;
+
+#endif // TUNER_HXX
@@ -0,0 +1,153 @@
+#include "watcher.hxx"
+
+#include <system_error>
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "debug.hxx"
+
+namespace {
+
+auto normalize(const std::string& path) -> std::filesystem::path {
+  std::error_code error{};
+  std::filesystem::path result{std::filesystem::absolute(path, error)};
+  if (error) {
+    return path;
+  }
+  return result.lexically_normal();
+}
+
+#ifndef __linux__
+constexpr std::chrono::milliseconds scanInterval{250};
+
+auto getWriteTime(
+  const std::string& path
+) -> std::filesystem::file_time_type {
+  std::error_code error{};
+  const auto time{std::filesystem::last_write_time(path, error)};
+  return error ? std::filesystem::file_time_type{} : time;
+}
+#endif
+
+} // namespace
+
+FileWatcher::FileWatcher(
+  std::chrono::milliseconds debounce
+) : _debounce{debounce} {
+#ifdef __linux__
+  _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (_inotify < 0) {
+    LOG_ERROR("Failed to initialize inotify\n");
+  }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+  if (_inotify >= 0) {
+    close(_inotify);
+  }
+#endif
+}
+
+auto FileWatcher::setPaths(const std::vector<std::string>& paths) -> void {
+  std::map<std::filesystem::path, std::string> normalizedPaths{};
+  for (const std::string& path : paths) {
+    normalizedPaths.emplace(normalize(path), path);
+  }
+  if (normalizedPaths == _paths) {
+    return;
+  }
+  _paths = std::move(normalizedPaths);
+#ifdef __linux__
+  if (_inotify < 0) {
+    return;
+  }
+  for (const auto& [descriptor, directory] : _directories) {
+    inotify_rm_watch(_inotify, descriptor);
+  }
+  _directories.clear();
+  // Watch the parent directories rather than the files themselves, since
+  // many editors save by writing a new file and renaming it over the old.
+  std::set<std::filesystem::path> directories{};
+  for (const auto& [path, original] : _paths) {
+    directories.insert(path.parent_path());
+  }
+  for (const std::filesystem::path& directory : directories) {
+    const int descriptor{inotify_add_watch(
+      _inotify, directory.c_str(),
+      IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE
+    )};
+    if (descriptor < 0) {
+      LOG_ERROR("Failed to watch directory: " << directory << '\n');
+      continue;
+    }
+    _directories[descriptor] = directory;
+  }
+#else
+  _writeTimes.clear();
+  for (const auto& [path, original] : _paths) {
+    _writeTimes[original] = getWriteTime(original);
+  }
+#endif
+}
+
+auto FileWatcher::poll() -> std::vector<std::string> {
+  readEvents();
+  if (_pending.empty() || Clock::now() - _lastEvent < _debounce) {
+    return {};
+  }
+  std::vector<std::string> changed{_pending.begin(), _pending.end()};
+  _pending.clear();
+  return changed;
+}
+
+auto FileWatcher::readEvents() -> void {
+#ifdef __linux__
+  if (_inotify < 0) {
+    return;
+  }
+  alignas(inotify_event) char buffer[sizeof(inotify_event) + NAME_MAX + 1];
+  while (true) {
+    const ssize_t length{read(_inotify, buffer, sizeof(buffer))};
+    if (length <= 0) {
+      break;
+    }
+    for (ssize_t offset{}; offset < length;) {
+      const auto event{reinterpret_cast<const inotify_event*>(buffer + offset)};
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      const auto directory{_directories.find(event->wd)};
+      if (directory == _directories.end() || event->len == 0) {
+        continue;
+      }
+      const auto path{_paths.find(directory->second / event->name)};
+      if (path != _paths.end()) {
+        markChanged(path->second);
+      }
+    }
+  }
+#else
+  const Clock::time_point now{Clock::now()};
+  if (now - _lastScan < scanInterval) {
+    return;
+  }
+  _lastScan = now;
+  for (auto& [path, writeTime] : _writeTimes) {
+    const auto current{getWriteTime(path)};
+    if (current != writeTime) {
+      writeTime = current;
+      markChanged(path);
+    }
+  }
+#endif
+}
+
+auto FileWatcher::markChanged(const std::string& path) -> void {
+  _pending.insert(path);
+  _lastEvent = Clock::now();
+}
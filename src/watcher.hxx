@@ -0,0 +1,50 @@
+#ifndef WATCHER_HXX
+#define WATCHER_HXX
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Reports files that changed on disk. Bursts of events (e.g. an editor
+ * truncating and then writing a file) are coalesced: a change is only
+ * reported once no further events arrived for the debounce interval.
+ */
+class FileWatcher {
+public:
+  explicit FileWatcher(std::chrono::milliseconds debounce);
+  FileWatcher() = delete;
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher(FileWatcher&&) = delete;
+  FileWatcher operator=(const FileWatcher&) = delete;
+  FileWatcher operator=(FileWatcher&&) = delete;
+  ~FileWatcher();
+
+  auto setPaths(const std::vector<std::string>& paths) -> void;
+  auto poll() -> std::vector<std::string>;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  auto readEvents() -> void;
+  auto markChanged(const std::string& path) -> void;
+
+  std::chrono::milliseconds _debounce;
+  // Maps normalized absolute paths to the paths as they were passed in.
+  std::map<std::filesystem::path, std::string> _paths{};
+  std::set<std::string> _pending{};
+  Clock::time_point _lastEvent{};
+#ifdef __linux__
+  int _inotify{-1};
+  // Maps inotify watch descriptors to the directories they watch.
+  std::map<int, std::filesystem::path> _directories{};
+#else
+  Clock::time_point _lastScan{};
+  std::map<std::string, std::filesystem::file_time_type> _writeTimes{};
+#endif
+};
+
+#endif // WATCHER_HXX
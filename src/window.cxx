@@ -1,11 +1,20 @@
 #include "window.hxx"
 
+#include <optional>
 #include <stdexcept>
 
 #include <GLFW/glfw3.h>
 
 #include "debug.hxx"
 #include "icon.hxx"
+#include "trace.hxx"
+
+namespace {
+
+// How often deferred actions are retried while the queue is full.
+constexpr double deferredRetrySeconds{.005};
+
+} // namespace
 
 #ifdef DEBUG
 auto errorCallbackGLFW(
@@ -15,14 +24,14 @@ auto errorCallbackGLFW(
 }
 #endif
 
-auto WindowActions::reset() -> void {
-  changeModelType = false;
-  closeWindow = false;
-  resetWindowSize = false;
-  pauseResume = false;
-}
-
-WindowOwner::WindowOwner() {
+WindowOwner::WindowOwner(
+  int width, int height, bool headless, bool debugContext
+) : _initialWidth{width}, _initialHeight{height}, _headless{headless} {
+  if (_headless) {
+    // The null platform needs no display server; the context is created
+    // through EGL (surfaceless) or OSMesa below.
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+  }
   if (!glfwInit()) {
     throw std::runtime_error{"Failed to initialize GLFW"};
   }
@@ -33,21 +42,40 @@ WindowOwner::WindowOwner() {
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   glfwWindowHint(GLFW_DECORATED, true);
-#ifdef DEBUG
-  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
-#endif
+  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debugContext);
 #ifdef __APPLE__
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, true);
 #endif
+  if (_headless) {
+    glfwWindowHint(GLFW_VISIBLE, false);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+  }
   _window = glfwCreateWindow(
     _initialWidth, _initialHeight, _title, nullptr, nullptr
   );
+  if (!_window && _headless) {
+    LOG_ERROR("EGL context unavailable, falling back to OSMesa\n");
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    _window = glfwCreateWindow(
+      _initialWidth, _initialHeight, _title, nullptr, nullptr
+    );
+  }
   if (!_window) {
     glfwTerminate();
     throw std::runtime_error{"Failed to create GLFW window"};
   }
   glfwMakeContextCurrent(_window);
+  glfwGetFramebufferSize(_window, &_framebufferWidth, &_framebufferHeight);
+  if (_headless) {
+    // Nothing is presented, so never wait on a vertical blank.
+    glfwSwapInterval(0);
+    return;
+  }
   glfwSetKeyCallback(_window, WindowOwner::onKeyGLFW);
+  glfwSetWindowRefreshCallback(_window, WindowOwner::onRedrawGLFW);
+  glfwSetFramebufferSizeCallback(_window, WindowOwner::onFramebufferSizeGLFW);
+  glfwSetCursorPosCallback(_window, WindowOwner::onCursorPosGLFW);
+  glfwSetMouseButtonCallback(_window, WindowOwner::onMouseButtonGLFW);
   glfwSetWindowUserPointer(_window, this);
   const GLFWimage icon_data{
     mainIconWidth, mainIconHeight, static_cast<unsigned char*>(mainIcon)
@@ -64,25 +92,167 @@ auto WindowOwner::getWindow() -> GLFWwindow* {
   return _window;
 }
 
-auto WindowOwner::getActions() -> WindowActions& {
+auto WindowOwner::createSharedContext() -> GLFWwindow* {
+  // The remaining context hints still match those of the main window.
+  glfwWindowHint(GLFW_VISIBLE, false);
+  GLFWwindow* context{glfwCreateWindow(1, 1, _title, nullptr, _window)};
+  if (!context) {
+    throw std::runtime_error{"Failed to create shared GL context"};
+  }
+  return context;
+}
+
+auto WindowOwner::getActions() -> ActionQueue& {
   return _actions;
 }
 
-auto WindowOwner::isActive() -> bool {
-  return !glfwWindowShouldClose(_window);
+auto WindowOwner::getFramebufferWidth() const -> int {
+  return _framebufferWidth;
+}
+
+auto WindowOwner::getFramebufferHeight() const -> int {
+  return _framebufferHeight;
+}
+
+auto WindowOwner::setSwapInterval(int interval) -> void {
+  glfwSwapInterval(interval);
+}
+
+auto WindowOwner::makeContextCurrent() -> void {
+  glfwMakeContextCurrent(_window);
 }
 
-auto WindowOwner::closeWindow() -> void {
-  glfwSetWindowShouldClose(_window, true);
+auto WindowOwner::releaseContext() -> void {
+  glfwMakeContextCurrent(nullptr);
 }
 
-auto WindowOwner::resetWindowSize() -> void {
-  glfwSetWindowSize(_window, _initialWidth, _initialHeight);
+auto WindowOwner::swapBuffers() -> void {
+  if (!_headless) {
+    TRACE_SPAN("window", "swap");
+    glfwSwapBuffers(_window);
+  }
 }
 
 auto WindowOwner::update() -> void {
-  glfwSwapBuffers(_window);
+  swapBuffers();
+  TRACE_SPAN("window", "poll events");
   glfwPollEvents();
+  postPending();
+}
+
+auto WindowOwner::handleEvents(const std::atomic<bool>& rendering) -> void {
+  // Moving or resizing a window blocks in here on some platforms, while
+  // the render thread carries on.
+  while (rendering) {
+    if (_deferred.empty()) {
+      glfwWaitEvents();
+    } else {
+      glfwWaitEventsTimeout(deferredRetrySeconds);
+    }
+    postPending();
+  }
+}
+
+auto WindowOwner::wakeEvents() -> void {
+  glfwPostEmptyEvent();
+}
+
+auto WindowOwner::post(const WindowAction& action) -> void {
+  if (_deferred.empty() && _actions.push(action)) {
+    return;
+  }
+  // Only the latest cursor position matters.
+  if (
+    action.type == WindowActionType::Mouse && !_deferred.empty()
+    && _deferred.back().type == WindowActionType::Mouse
+  ) {
+    _deferred.back() = action;
+  } else {
+    _deferred.push_back(action);
+  }
+}
+
+auto WindowOwner::postMouse() -> void {
+  WindowAction action{WindowActionType::Mouse};
+  action.mouseX = _mouseX;
+  action.mouseY = _mouseY;
+  action.mouseDown = _mouseDown;
+  post(action);
+}
+
+auto WindowOwner::postPending() -> void {
+  while (!_deferred.empty() && _actions.push(_deferred.front())) {
+    _deferred.pop_front();
+  }
+  if (!_closePosted && glfwWindowShouldClose(_window)) {
+    _closePosted = true;
+    post({WindowActionType::Close});
+  }
+}
+
+auto WindowOwner::onRedrawGLFW(GLFWwindow* window) -> void {
+  const auto windowOwner{
+    static_cast<WindowOwner*>(glfwGetWindowUserPointer(window))
+  };
+  if (windowOwner) {
+    windowOwner->post({WindowActionType::Redraw});
+  }
+}
+
+auto WindowOwner::onFramebufferSizeGLFW(
+  GLFWwindow* window, int width, int height
+) -> void {
+  const auto windowOwner{
+    static_cast<WindowOwner*>(glfwGetWindowUserPointer(window))
+  };
+  if (windowOwner) {
+    windowOwner->_framebufferWidth = width;
+    windowOwner->_framebufferHeight = height;
+    WindowAction action{WindowActionType::Resize};
+    action.width = width;
+    action.height = height;
+    windowOwner->post(action);
+  }
+}
+
+auto WindowOwner::onCursorPosGLFW(
+  GLFWwindow* window, double x, double y
+) -> void {
+  const auto windowOwner{
+    static_cast<WindowOwner*>(glfwGetWindowUserPointer(window))
+  };
+  if (!windowOwner) {
+    return;
+  }
+  // Cursor positions are in screen coordinates from the top left, which
+  // differ from framebuffer pixels on high-DPI displays.
+  int windowWidth{};
+  int windowHeight{};
+  glfwGetWindowSize(window, &windowWidth, &windowHeight);
+  if (windowWidth <= 0 || windowHeight <= 0) {
+    return;
+  }
+  const double scaleX{
+    static_cast<double>(windowOwner->_framebufferWidth)/windowWidth
+  };
+  const double scaleY{
+    static_cast<double>(windowOwner->_framebufferHeight)/windowHeight
+  };
+  windowOwner->_mouseX = x*scaleX;
+  windowOwner->_mouseY = (windowHeight - y)*scaleY;
+  windowOwner->postMouse();
+}
+
+auto WindowOwner::onMouseButtonGLFW(
+  GLFWwindow* window, int button, int action, int /*mods*/
+) -> void {
+  const auto windowOwner{
+    static_cast<WindowOwner*>(glfwGetWindowUserPointer(window))
+  };
+  if (windowOwner && button == GLFW_MOUSE_BUTTON_LEFT) {
+    windowOwner->_mouseDown = action == GLFW_PRESS;
+    windowOwner->postMouse();
+  }
 }
 
 auto WindowOwner::onKeyGLFW(
@@ -117,21 +287,56 @@ auto WindowOwner::onKey(
   const bool model2Key{
     action == GLFW_RELEASE && mods == GLFW_MOD_ALT && key == GLFW_KEY_2
   };
+  const bool model3Key{
+    action == GLFW_RELEASE && mods == GLFW_MOD_ALT && key == GLFW_KEY_3
+  };
+  const bool model4Key{
+    action == GLFW_RELEASE && mods == GLFW_MOD_ALT && key == GLFW_KEY_4
+  };
+  const bool model5Key{
+    action == GLFW_RELEASE && mods == GLFW_MOD_ALT && key == GLFW_KEY_5
+  };
+  const bool model6Key{
+    action == GLFW_RELEASE && mods == GLFW_MOD_ALT && key == GLFW_KEY_6
+  };
   const bool pauseResumeKey{
     action == GLFW_RELEASE && mods == 0 && key == GLFW_KEY_SPACE
   };
+  const bool nextShaderKey{
+    action == GLFW_RELEASE && mods == 0 && key == GLFW_KEY_RIGHT
+  };
+  const bool previousShaderKey{
+    action == GLFW_RELEASE && mods == 0 && key == GLFW_KEY_LEFT
+  };
 
+  // Other keys change nothing, so they do not ask for a frame either.
+  std::optional<WindowAction> windowAction{};
   if (closeKey1 || closeKey2 || closeKey3) {
-    _actions.closeWindow = true;
+    // Announced to the render loop by postPending().
+    glfwSetWindowShouldClose(_window, true);
   } else if (resetWindowKey) {
-    _actions.resetWindowSize = true;
+    // The render loop learns of the new size from the resize event.
+    glfwSetWindowSize(_window, _initialWidth, _initialHeight);
   } else if (model1Key) {
-    _actions.changeModelType = true;
-    _actions.modelType = GeometryType::Rectangle;
+    windowAction = {WindowActionType::ChangeModel, GeometryType::Rectangle};
   } else if (model2Key) {
-    _actions.changeModelType = true;
-    _actions.modelType = GeometryType::Triangle;
+    windowAction = {WindowActionType::ChangeModel, GeometryType::Triangle};
+  } else if (model3Key) {
+    windowAction = {WindowActionType::ChangeModel, GeometryType::Mesh};
+  } else if (model4Key) {
+    windowAction = {WindowActionType::ChangeModel, GeometryType::Plane};
+  } else if (model5Key) {
+    windowAction = {WindowActionType::ChangeModel, GeometryType::Sphere};
+  } else if (model6Key) {
+    windowAction = {WindowActionType::ChangeModel, GeometryType::Cube};
   } else if (pauseResumeKey) {
-    _actions.pauseResume = true;
+    windowAction = {WindowActionType::PauseResume};
+  } else if (nextShaderKey) {
+    windowAction = {WindowActionType::NextShader};
+  } else if (previousShaderKey) {
+    windowAction = {WindowActionType::PreviousShader};
+  }
+  if (windowAction) {
+    post(*windowAction);
   }
 }
@@ -1,23 +1,24 @@
 #ifndef WINDOW_HXX
 #define WINDOW_HXX
 
-#include "geometry.hxx"
+#include <atomic>
+#include <deque>
 
-struct GLFWwindow;
-
-struct WindowActions {
-  bool changeModelType{false};
-  GeometryType modelType{GeometryType::Rectangle};
-  bool closeWindow{false};
-  bool resetWindowSize{false};
-  bool pauseResume{false};
+#include "actionqueue.hxx"
 
-  auto reset() -> void;
-};
+struct GLFWwindow;
 
+/**
+ * Owns the window and its GL context, and turns the window's events into
+ * actions for the render loop. Events are handled on the main thread,
+ * either between frames in update() or, while a separate render thread
+ * owns the context, in handleEvents().
+ */
 class WindowOwner {
 public:
-  WindowOwner();
+  // Debug contexts report more through the GL debug output.
+  WindowOwner(int width, int height, bool headless, bool debugContext);
+  WindowOwner() = delete;
   WindowOwner(const WindowOwner&) = delete;
   WindowOwner(WindowOwner&&) = delete;
   WindowOwner operator=(const WindowOwner&) = delete;
@@ -25,18 +26,45 @@ public:
   ~WindowOwner();
 
   auto getWindow() -> GLFWwindow*;
-  auto getActions() -> WindowActions&;
-  auto isActive() -> bool;
-  auto closeWindow() -> void;
-  auto resetWindowSize() -> void;
+  auto createSharedContext() -> GLFWwindow*;
+  // The consumer side belongs to the render loop.
+  auto getActions() -> ActionQueue&;
+  auto getFramebufferWidth() const -> int;
+  auto getFramebufferHeight() const -> int;
+  auto setSwapInterval(int interval) -> void;
+  // Makes the context current on the calling thread, or on none.
+  auto makeContextCurrent() -> void;
+  auto releaseContext() -> void;
+  // May be called from the thread that owns the context.
+  auto swapBuffers() -> void;
+  // Swaps and handles pending events.
   auto update() -> void;
+  // Handles events until rendering is cleared and wakeEvents() is called.
+  auto handleEvents(const std::atomic<bool>& rendering) -> void;
+  // May be called from any thread.
+  auto wakeEvents() -> void;
 
 private:
   GLFWwindow* _window;
-  const int _initialWidth{400};
-  const int _initialHeight{400};
+  const int _initialWidth;
+  const int _initialHeight;
+  const bool _headless;
   const char* _title{"ShaderTest"};
-  WindowActions _actions{};
+  ActionQueue _actions{};
+  // Actions that did not fit into the queue yet, in order.
+  std::deque<WindowAction> _deferred{};
+  bool _closePosted{false};
+  int _framebufferWidth{};
+  int _framebufferHeight{};
+  // Cursor in framebuffer pixels, origin at the bottom left.
+  double _mouseX{};
+  double _mouseY{};
+  bool _mouseDown{false};
+
+  auto post(const WindowAction& action) -> void;
+  auto postMouse() -> void;
+  // Retries deferred actions, and announces a close once.
+  auto postPending() -> void;
 
   static auto onKeyGLFW(
     GLFWwindow* window, int key, int scancode, int action, int mods
@@ -44,6 +72,14 @@ private:
   auto onKey(
     int key, int action, int mods
   ) -> void;
+  static auto onRedrawGLFW(GLFWwindow* window) -> void;
+  static auto onFramebufferSizeGLFW(
+    GLFWwindow* window, int width, int height
+  ) -> void;
+  static auto onCursorPosGLFW(GLFWwindow* window, double x, double y) -> void;
+  static auto onMouseButtonGLFW(
+    GLFWwindow* window, int button, int action, int mods
+  ) -> void;
 };
 
 #endif // WINDOW_HXX